@@ -5,3 +5,4 @@
 // Shared
 #import "ALTWrappedError.h"
 #import "NSError+ALTServerError.h"
+#import "ALTGDBRemoteConnection.h"
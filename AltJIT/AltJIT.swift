@@ -14,5 +14,5 @@ struct AltJIT: AsyncParsableCommand
 {
     static let configuration = CommandConfiguration(commandName: "altjit", 
                                                     abstract: "Enable JIT for sideloaded apps.",
-                                                    subcommands: [EnableJIT.self, MountDisk.self])
+                                                    subcommands: [EnableJIT.self, MountDisk.self, StartJITServer.self])
 }
@@ -0,0 +1,196 @@
+//
+//  StartJITServer.swift
+//  AltJIT
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import Foundation
+import OSLog
+import Network
+
+import ArgumentParser
+
+struct StartJITServer: PythonCommand
+{
+    static let configuration = CommandConfiguration(commandName: "serve", abstract: "Listen for JIT requests, keeping device connections open between requests.")
+    
+    @Option(help: "Path of the Unix socket to listen on.")
+    var socketPath: String = JITServer.socketPath
+    
+    @Option(help: "User ID allowed to connect to the socket.")
+    var ownerUID: UInt32
+    
+    @Option(help: "Number of seconds a device connection may be idle before it is closed.")
+    var sessionTimeout: TimeInterval = 300.0
+    
+    @Option(help: "Number of seconds without any open device connections before the server exits.")
+    var idleTimeout: TimeInterval = 1800.0
+    
+    // PythonCommand
+    var pythonPath: String?
+    
+    mutating func run() async throws
+    {
+        do
+        {
+            try await self.prepare()
+            
+            let sessionManager = JITSessionManager(environment: self.processEnvironment, idleTimeout: self.sessionTimeout)
+            
+            let listener = try await self.startListener(sessionManager: sessionManager)
+            defer {
+                listener.cancel()
+                unlink(self.socketPath)
+            }
+            
+            print("Listening for JIT requests at \(self.socketPath).")
+            
+            // Periodically close idle sessions, and exit once nothing has happened for a while.
+            var lastActiveDate = Date()
+            while true
+            {
+                try await Task.sleep(for: .seconds(15))
+                
+                await sessionManager.closeIdleSessions()
+                
+                if await sessionManager.activeSessionCount > 0
+                {
+                    lastActiveDate = Date()
+                }
+                else if Date().timeIntervalSince(lastActiveDate) > self.idleTimeout
+                {
+                    Logger.main.info("JIT server has been idle for \(self.idleTimeout)s, exiting.")
+                    break
+                }
+            }
+            
+            await sessionManager.closeAllSessions()
+        }
+        catch
+        {
+            print("❌ Unable to start JIT server.")
+            print(error.localizedDescription)
+            
+            Logger.main.error("Failed to start JIT server. \(error, privacy: .public)")
+            
+            throw ExitCode.failure
+        }
+    }
+}
+
+private extension StartJITServer
+{
+    func startListener(sessionManager: JITSessionManager) async throws -> NWListener
+    {
+        // Remove stale socket from previous run.
+        unlink(self.socketPath)
+        
+        // Create socket without any group or world permissions, so there's no window before chmod() where others can connect.
+        let previousUmask = umask(0o077)
+        
+        let parameters = NWParameters.tcp
+        parameters.requiredLocalEndpoint = .unix(path: self.socketPath)
+        
+        let listener = try NWListener(using: parameters)
+        listener.newConnectionHandler = { connection in
+            connection.start(queue: .global())
+            
+            Task {
+                await self.handle(connection, sessionManager: sessionManager)
+            }
+        }
+        
+        let socketPath = self.socketPath
+        let ownerUID = self.ownerUID
+        
+        try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<Void, Error>) in
+            listener.stateUpdateHandler = { state in
+                switch state
+                {
+                case .ready:
+                    listener.stateUpdateHandler = nil
+                    umask(previousUmask)
+                    
+                    // We're running as root, so restrict socket to the user who launched us.
+                    // If that fails, stop rather than leave a root-owned socket others might be able to use.
+                    guard chown(socketPath, ownerUID, gid_t.max) == 0, chmod(socketPath, 0o600) == 0 else {
+                        let error = POSIXError(POSIXErrorCode(rawValue: errno) ?? .EPERM)
+                        Logger.main.error("Failed to restrict JIT server socket to owner. \(error.localizedDescription, privacy: .public)")
+                        
+                        listener.cancel()
+                        unlink(socketPath)
+                        
+                        continuation.resume(throwing: error)
+                        return
+                    }
+                    
+                    continuation.resume()
+                
+                case .failed(let error):
+                    listener.stateUpdateHandler = nil
+                    umask(previousUmask)
+                    
+                    continuation.resume(throwing: error)
+                
+                default: break
+                }
+            }
+            
+            listener.start(queue: .global())
+        }
+        
+        return listener
+    }
+    
+    func handle(_ connection: NWConnection, sessionManager: JITSessionManager) async
+    {
+        defer { connection.cancel() }
+        
+        let response: JITServerResponse
+        
+        do
+        {
+            let request = try await connection.receiveJITServerMessage(JITServerRequest.self)
+            
+            switch request.action
+            {
+            case .statistics:
+                let statistics = await sessionManager.statistics()
+                response = JITServerResponse(success: true, statistics: statistics)
+            
+            case .enableJIT:
+                guard let udid = request.udid, let value = request.process else { throw ValidationError("JIT requests must include a UDID and process.") }
+                
+                let process = AppProcess(value)
+                
+                do
+                {
+                    Logger.main.info("Received JIT request for \(process, privacy: .private(mask: .hash)) on device \(udid, privacy: .private(mask: .hash)).")
+                    
+                    let latency = try await sessionManager.enableJIT(for: process, udid: udid, timeout: request.timeout ?? JITServer.defaultTimeout)
+                    response = JITServerResponse(success: true, latency: latency, statistics: await sessionManager.statistics())
+                }
+                catch let error as ProcessError
+                {
+                    response = JITServerResponse(success: false, output: error.output, errorDescription: error.localizedDescription)
+                }
+            }
+        }
+        catch
+        {
+            Logger.main.error("Failed to handle JIT request. \(error, privacy: .public)")
+            response = JITServerResponse(success: false, errorDescription: error.localizedDescription)
+        }
+        
+        do
+        {
+            try await connection.sendJITServerMessage(response)
+        }
+        catch
+        {
+            Logger.main.error("Failed to send JIT response. \(error, privacy: .public)")
+        }
+    }
+}
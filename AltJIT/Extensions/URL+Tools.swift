@@ -11,5 +11,4 @@ import Foundation
 extension URL
 {
     static let python3 = URL(fileURLWithPath: "/usr/bin/python3")
-    static let lldb = URL(fileURLWithPath: "/usr/bin/lldb")
 }
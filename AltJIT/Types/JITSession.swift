@@ -0,0 +1,247 @@
+//
+//  JITSession.swift
+//  AltJIT
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import Foundation
+import OSLog
+import RegexBuilder
+
+// Long-lived connection to a device's debugserver.
+// The RSD tunnel and debugserver are started once and reused, so enabling JIT for subsequent apps
+// only costs a few GDB remote packets (connect, attach, detach).
+final class JITSession
+{
+    let udid: String
+    let environment: [String: String]
+    let timeout: TimeInterval
+    
+    private(set) var lastUsedDate = Date()
+    
+    private var rsdTunnel: RemoteServiceDiscoveryTunnel?
+    private var debugServerPort: Int?
+    
+    var isConnected: Bool {
+        guard let rsdTunnel, self.debugServerPort != nil else { return false }
+        return rsdTunnel.process.isRunning
+    }
+    
+    init(udid: String, environment: [String: String], timeout: TimeInterval)
+    {
+        self.udid = udid
+        self.environment = environment
+        self.timeout = timeout
+    }
+    
+    deinit
+    {
+        self.close()
+    }
+    
+    func enableJIT(for process: AppProcess) async throws
+    {
+        self.lastUsedDate = Date()
+        defer { self.lastUsedDate = Date() }
+        
+        if !self.isConnected
+        {
+            self.close()
+            try await self.connect()
+        }
+        
+        guard let rsdTunnel, let debugServerPort else { preconditionFailure("JITSession must be connected before enabling JIT.") }
+        
+        do
+        {
+            print("Attaching debugger...")
+            
+            // debugserver exits after each detach, so connect for every attach.
+            let connection = try await self.connectToDebugServer(ipAddress: rsdTunnel.ipAddress, port: debugServerPort)
+            defer { connection.disconnect() }
+            
+            // Attach + detach are pipelined, so this is a single round trip.
+            try await self.attachAndDetachDebugger(connection, process: process)
+            print("Attached and detached debugger from \(process).")
+        }
+        catch let error as ALTServerError where error.code == .lostConnection || error.code == .connectionFailed
+        {
+            // Tunnel may have gone away, so start from scratch next time.
+            self.close()
+            throw error
+        }
+    }
+    
+    func close()
+    {
+        // Terminates tunnel process.
+        self.rsdTunnel = nil
+        self.debugServerPort = nil
+    }
+}
+
+private extension JITSession
+{
+    func connect() async throws
+    {
+        let rsdTunnel = try await self.startRSDTunnel()
+        print("Connected to device \(self.udid)!", rsdTunnel)
+        
+        let port = try await self.startDebugServer(rsdTunnel: rsdTunnel)
+        print("Started debugserver on port \(port).")
+        
+        self.rsdTunnel = rsdTunnel
+        self.debugServerPort = port
+    }
+    
+    func startRSDTunnel() async throws -> RemoteServiceDiscoveryTunnel
+    {
+        do
+        {
+            Logger.main.info("Starting RSD tunnel with timeout: \(self.timeout)")
+            
+            let process = try Process.launch(.python3, arguments: ["-u", "-m", "pymobiledevice3", "remote", "start-quic-tunnel", "--udid", self.udid], environment: self.environment)
+            
+            do
+            {
+                let rsdTunnel = try await withTimeout(seconds: self.timeout) {
+                    let regex = Regex {
+                        "--rsd"
+                        
+                        OneOrMore(.whitespace)
+                        
+                        Capture {
+                            OneOrMore(.anyGraphemeCluster)
+                        }
+                        
+                        OneOrMore(.whitespace)
+                        
+                        TryCapture {
+                            OneOrMore(.digit)
+                        } transform: { match in
+                            Int(match)
+                        }
+                    }
+                    
+                    for try await line in process.outputLines
+                    {
+                        if let match = line.firstMatch(of: regex)
+                        {
+                            let rsdTunnel = RemoteServiceDiscoveryTunnel(ipAddress: String(match.1), port: match.2, process: process)
+                            return rsdTunnel
+                        }
+                    }
+                    
+                    throw ProcessError.unexpectedOutput(executableURL: .python3, output: process.output)
+                }
+                
+                // MUST close standardOutput in order to stream output later.
+                process.stopOutput()
+                
+                return rsdTunnel
+            }
+            catch is TimedOutError
+            {
+                process.terminate()
+                
+                let error = ProcessError.timedOut(executableURL: .python3, output: process.output)
+                throw error
+            }
+            catch
+            {
+                process.terminate()
+                throw error
+            }
+        }
+        catch let error as NSError
+        {
+            let localizedFailure = NSLocalizedString("Could not connect to device \(self.udid).", comment: "")
+            throw error.withLocalizedFailure(localizedFailure)
+        }
+    }
+    
+    func startDebugServer(rsdTunnel: RemoteServiceDiscoveryTunnel) async throws -> Int
+    {
+        do
+        {
+            Logger.main.info("Starting debugserver with timeout: \(self.timeout)")
+            
+            return try await withTimeout(seconds: self.timeout) {
+                let arguments = ["-u", "-m", "pymobiledevice3", "developer", "debugserver", "start-server"] + rsdTunnel.commandArguments
+                
+                let output = try await Process.launchAndWait(.python3, arguments: arguments, environment: self.environment)
+                
+                let port = Reference(Int.self)
+                let regex = Regex {
+                    "connect://"
+                    
+                    OneOrMore(.anyGraphemeCluster, .eager)
+                    
+                    ":"
+                    
+                    TryCapture(as: port) {
+                        OneOrMore(.digit)
+                    } transform: { match in
+                        Int(match)
+                    }
+                }
+                
+                if let match = output.firstMatch(of: regex)
+                {
+                    return match[port]
+                }
+                
+                throw ProcessError.unexpectedOutput(executableURL: .python3, output: output)
+            }
+        }
+        catch let error as NSError
+        {
+            let localizedFailure = NSLocalizedString("Could not start debugserver on device \(self.udid).", comment: "")
+            throw error.withLocalizedFailure(localizedFailure)
+        }
+    }
+    
+    func connectToDebugServer(ipAddress: String, port: Int) async throws -> GDBRemoteConnection
+    {
+        do
+        {
+            Logger.main.info("Connecting to debugserver...")
+            
+            let connection = try await GDBRemoteConnection.connect(toHost: ipAddress, port: port)
+            return connection
+        }
+        catch let error as NSError
+        {
+            let localizedFailure = NSLocalizedString("Could not connect to debugserver on device \(self.udid).", comment: "")
+            throw error.withLocalizedFailure(localizedFailure)
+        }
+    }
+    
+    func attachAndDetachDebugger(_ connection: GDBRemoteConnection, process: AppProcess) async throws
+    {
+        do
+        {
+            Logger.main.info("Attaching and detaching debugger...")
+            
+            do
+            {
+                switch process
+                {
+                case .pid(let pid): try await connection.attachToAndDetachFromProcess(withID: pid)
+                case .name(let name): try await connection.attachToAndDetachFromProcess(withName: name, waitForLaunch: false)
+                }
+            }
+            catch let error as ALTServerError where error.code == .requestedAppNotRunning
+            {
+                throw JITError.processNotRunning(process)
+            }
+        }
+        catch let error as NSError
+        {
+            let localizedFailure = String(format: NSLocalizedString("Could not attach debugger to %@.", comment: ""), process.description)
+            throw error.withLocalizedFailure(localizedFailure)
+        }
+    }
+}
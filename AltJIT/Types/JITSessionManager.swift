@@ -0,0 +1,158 @@
+//
+//  JITSessionManager.swift
+//  AltJIT
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import Foundation
+import OSLog
+
+// Keeps one JITSession per device alive between requests, closing sessions that have been idle too long.
+actor JITSessionManager
+{
+    let environment: [String: String]
+    let idleTimeout: TimeInterval
+    
+    private var sessions = [String: JITSession]()
+    
+    // Devices with a request in flight. Requests for the same device are serialized since they share one tunnel and debugserver.
+    private var busyDevices = Set<String>()
+    private var busyDeviceWaiters = [String: [CheckedContinuation<Void, Never>]]()
+    
+    private var requestCount = 0
+    private var reusedSessionCount = 0
+    private var latencies = [TimeInterval]()
+    private let maximumLatencySampleCount = 100
+    
+    var activeSessionCount: Int {
+        self.sessions.count
+    }
+    
+    init(environment: [String: String], idleTimeout: TimeInterval)
+    {
+        self.environment = environment
+        self.idleTimeout = idleTimeout
+    }
+    
+    func enableJIT(for process: AppProcess, udid: String, timeout: TimeInterval) async throws -> TimeInterval
+    {
+        await self.beginRequest(for: udid)
+        defer { self.finishRequest(for: udid) }
+        
+        let startDate = Date()
+        
+        let session: JITSession
+        if let existingSession = self.sessions[udid], existingSession.isConnected
+        {
+            Logger.main.info("Reusing JIT session for device \(udid, privacy: .private(mask: .hash)).")
+            
+            session = existingSession
+            self.reusedSessionCount += 1
+        }
+        else
+        {
+            self.sessions[udid]?.close()
+            
+            session = JITSession(udid: udid, environment: self.environment, timeout: timeout)
+            self.sessions[udid] = session
+        }
+        
+        do
+        {
+            try await session.enableJIT(for: process)
+        }
+        catch
+        {
+            self.sessions[udid] = nil
+            throw error
+        }
+        
+        let latency = Date().timeIntervalSince(startDate)
+        self.recordLatency(latency)
+        
+        return latency
+    }
+    
+    func statistics() -> JITServerStatistics
+    {
+        let sortedLatencies = self.latencies.sorted()
+        
+        func percentile(_ percentile: Double) -> TimeInterval?
+        {
+            guard !sortedLatencies.isEmpty else { return nil }
+            
+            let index = Int((Double(sortedLatencies.count - 1) * percentile).rounded())
+            return sortedLatencies[index]
+        }
+        
+        let statistics = JITServerStatistics(requestCount: self.requestCount, reusedSessionCount: self.reusedSessionCount, activeSessionCount: self.sessions.count,
+                                             p50: percentile(0.5), p90: percentile(0.9), p99: percentile(0.99))
+        return statistics
+    }
+    
+    func closeIdleSessions()
+    {
+        for (udid, session) in self.sessions where !self.busyDevices.contains(udid)
+        {
+            guard Date().timeIntervalSince(session.lastUsedDate) > self.idleTimeout || !session.isConnected else { continue }
+            
+            Logger.main.info("Closing idle JIT session for device \(udid, privacy: .private(mask: .hash)).")
+            
+            session.close()
+            self.sessions[udid] = nil
+        }
+    }
+    
+    func closeAllSessions()
+    {
+        for session in self.sessions.values
+        {
+            session.close()
+        }
+        
+        self.sessions.removeAll()
+    }
+}
+
+private extension JITSessionManager
+{
+    func beginRequest(for udid: String) async
+    {
+        while self.busyDevices.contains(udid)
+        {
+            await withCheckedContinuation { continuation in
+                self.busyDeviceWaiters[udid, default: []].append(continuation)
+            }
+        }
+        
+        self.busyDevices.insert(udid)
+    }
+    
+    func finishRequest(for udid: String)
+    {
+        self.busyDevices.remove(udid)
+        
+        guard var waiters = self.busyDeviceWaiters[udid], !waiters.isEmpty else { return }
+        
+        let continuation = waiters.removeFirst()
+        self.busyDeviceWaiters[udid] = waiters.isEmpty ? nil : waiters
+        
+        continuation.resume()
+    }
+    
+    func recordLatency(_ latency: TimeInterval)
+    {
+        self.requestCount += 1
+        
+        self.latencies.append(latency)
+        if self.latencies.count > self.maximumLatencySampleCount
+        {
+            self.latencies.removeFirst(self.latencies.count - self.maximumLatencySampleCount)
+        }
+        
+        let statistics = self.statistics()
+        Logger.main.info("Enabled JIT in \(latency, format: .fixed(precision: 2))s. Requests: \(statistics.requestCount). Reused Sessions: \(statistics.reusedSessionCount). p50: \(statistics.p50 ?? 0, format: .fixed(precision: 2))s. p90: \(statistics.p90 ?? 0, format: .fixed(precision: 2))s. p99: \(statistics.p99 ?? 0, format: .fixed(precision: 2))s.")
+    }
+}
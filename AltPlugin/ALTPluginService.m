@@ -9,6 +9,9 @@
 #import "ALTPluginService.h"
 
 #import <dlfcn.h>
+#import <fcntl.h>
+#import <sys/socket.h>
+#import <sys/un.h>
 
 #import "ALTAnisetteData.h"
 
@@ -25,10 +28,54 @@
 - (NSString *)serverFriendlyDescription;
 @end
 
+// Binary framing for the point-to-point channel between AltServer and AltPlugin. All integers are little-endian.
+//
+// Every message starts with a header: UInt32 payload length, UInt32 request ID, UInt8 message type.
+// Anisette data payload: machineID, oneTimePassword, localUserID (strings), routingInfo (UInt64), deviceUniqueIdentifier,
+// deviceSerialNumber, deviceDescription (strings), date (Float64 seconds since 1970), locale and time zone identifiers (strings).
+// Error payload: localized description (string). Strings are a UInt32 byte count followed by UTF-8 bytes.
+//
+// Keep in sync with PluginChannel.swift.
+typedef NS_ENUM(uint8_t, ALTPluginChannelMessageType)
+{
+    ALTPluginChannelMessageTypeAnisetteDataRequest = 1,
+    ALTPluginChannelMessageTypeAnisetteDataResponse = 2,
+    ALTPluginChannelMessageTypeErrorResponse = 3,
+};
+
+static const size_t ALTPluginChannelHeaderLength = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint8_t);
+static const uint32_t ALTPluginChannelMaximumPayloadLength = 64 * 1024;
+
+static NSNotificationName const ALTPluginChannelAvailableNotification = @"com.rileytestut.AltServer.PluginChannelAvailable";
+static NSNotificationName const ALTFindPluginChannelNotification = @"com.rileytestut.AltServer.FindPluginChannel";
+
+static void ALTAppendUInt32(NSMutableData *data, uint32_t value)
+{
+    value = CFSwapInt32HostToLittle(value);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void ALTAppendUInt64(NSMutableData *data, uint64_t value)
+{
+    value = CFSwapInt64HostToLittle(value);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static void ALTAppendString(NSMutableData *data, NSString *string)
+{
+    NSData *utf8Data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    ALTAppendUInt32(data, (uint32_t)utf8Data.length);
+    [data appendData:utf8Data];
+}
+
 @interface ALTPluginService ()
 
 @property (nonatomic, readonly) NSISO8601DateFormatter *dateFormatter;
 
+@property (nonatomic, readonly) dispatch_queue_t channelQueue;
+@property (nonatomic, nullable) dispatch_source_t channelListenerSource;
+@property (nonatomic, copy, nullable) NSString *channelSocketPath;
+
 @end
 
 @implementation ALTPluginService
@@ -50,6 +97,9 @@
     if (self)
     {
         _dateFormatter = [[NSISO8601DateFormatter alloc] init];
+        
+        // Serial, so requests are handled one at a time and slow clients block further reads (back-pressure).
+        _channelQueue = dispatch_queue_create("com.rileytestut.AltPlugin.channel", DISPATCH_QUEUE_SERIAL);
     }
     
     return self;
@@ -65,6 +115,19 @@
     dlopen("/System/Library/PrivateFrameworks/AuthKit.framework/AuthKit", RTLD_NOW);
     
     [[NSDistributedNotificationCenter defaultCenter] addObserver:self selector:@selector(receiveNotification:) name:@"com.rileytestut.AltServer.FetchAnisetteData" object:nil];
+    
+    // Older AltServer versions only support notifications, so keep handling them alongside the channel.
+    [[NSDistributedNotificationCenter defaultCenter] addObserver:self selector:@selector(announceChannel) name:ALTFindPluginChannelNotification object:nil];
+    
+    NSError *error = nil;
+    if ([self startChannel:&error])
+    {
+        [self announceChannel];
+    }
+    else
+    {
+        NSLog(@"Failed to start AltPlugin channel. %@", error);
+    }
 }
 
 - (ALTAnisetteData *)requestAnisetteData
@@ -102,4 +165,226 @@
     [[NSDistributedNotificationCenter defaultCenter] postNotificationName:@"com.rileytestut.AltServer.AnisetteDataResponse" object:nil userInfo:@{@"requestUUID": requestUUID, @"anisetteData": data} deliverImmediately:YES];
 }
 
+#pragma mark - Channel -
+
+- (BOOL)startChannel:(NSError **)error
+{
+    NSString *socketPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"AltPlugin.sock"];
+    
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    
+    if (socketPath.fileSystemRepresentation == NULL || strlen(socketPath.fileSystemRepresentation) >= sizeof(address.sun_path))
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENAMETOOLONG userInfo:@{NSFilePathErrorKey: socketPath}];
+        }
+        
+        return NO;
+    }
+    
+    strlcpy(address.sun_path, socketPath.fileSystemRepresentation, sizeof(address.sun_path));
+    
+    int listenerSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenerSocket == -1)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        }
+        
+        return NO;
+    }
+    
+    // Remove stale socket from previous launch.
+    unlink(address.sun_path);
+    
+    if (bind(listenerSocket, (struct sockaddr *)&address, sizeof(address)) == -1 || chmod(address.sun_path, 0600) == -1 || listen(listenerSocket, 8) == -1)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSFilePathErrorKey: socketPath}];
+        }
+        
+        close(listenerSocket);
+        return NO;
+    }
+    
+    fcntl(listenerSocket, F_SETFL, fcntl(listenerSocket, F_GETFL) | O_NONBLOCK);
+    
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, listenerSocket, 0, self.channelQueue);
+    dispatch_source_set_event_handler(source, ^{
+        int clientSocket = accept(listenerSocket, NULL, NULL);
+        if (clientSocket == -1)
+        {
+            return;
+        }
+        
+        // Accepted sockets inherit listener's O_NONBLOCK, but client reads + writes expect blocking semantics.
+        fcntl(clientSocket, F_SETFL, fcntl(clientSocket, F_GETFL) & ~O_NONBLOCK);
+        
+        [self handleChannelClient:clientSocket];
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+        close(listenerSocket);
+    });
+    dispatch_resume(source);
+    
+    self.channelListenerSource = source;
+    self.channelSocketPath = socketPath;
+    
+    return YES;
+}
+
+- (void)announceChannel
+{
+    if (self.channelSocketPath == nil)
+    {
+        return;
+    }
+    
+    [[NSDistributedNotificationCenter defaultCenter] postNotificationName:ALTPluginChannelAvailableNotification object:nil userInfo:@{@"socketPath": self.channelSocketPath} deliverImmediately:YES];
+}
+
+- (void)handleChannelClient:(int)clientSocket
+{
+    // Don't crash Mail if AltServer disconnects while we're writing.
+    int noSIGPIPE = 1;
+    setsockopt(clientSocket, SOL_SOCKET, SO_NOSIGPIPE, &noSIGPIPE, sizeof(noSIGPIPE));
+    
+    NSMutableData *buffer = [NSMutableData data];
+    
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, clientSocket, 0, self.channelQueue);
+    dispatch_source_set_event_handler(source, ^{
+        char bytes[4096];
+        ssize_t count = read(clientSocket, bytes, sizeof(bytes));
+        if (count == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            // Spurious wakeup, so wait for next event rather than treating it as a disconnect.
+            return;
+        }
+        
+        if (count <= 0)
+        {
+            dispatch_source_cancel(source);
+            return;
+        }
+        
+        [buffer appendBytes:bytes length:count];
+        
+        while (buffer.length >= ALTPluginChannelHeaderLength)
+        {
+            uint32_t payloadLength = 0;
+            uint32_t requestID = 0;
+            uint8_t messageType = 0;
+            
+            [buffer getBytes:&payloadLength range:NSMakeRange(0, sizeof(uint32_t))];
+            [buffer getBytes:&requestID range:NSMakeRange(sizeof(uint32_t), sizeof(uint32_t))];
+            [buffer getBytes:&messageType range:NSMakeRange(sizeof(uint32_t) * 2, sizeof(uint8_t))];
+            
+            payloadLength = CFSwapInt32LittleToHost(payloadLength);
+            requestID = CFSwapInt32LittleToHost(requestID);
+            
+            if (payloadLength > ALTPluginChannelMaximumPayloadLength)
+            {
+                NSLog(@"Received invalid AltPlugin channel message, disconnecting.");
+                dispatch_source_cancel(source);
+                return;
+            }
+            
+            if (buffer.length < ALTPluginChannelHeaderLength + payloadLength)
+            {
+                // Wait for rest of message.
+                break;
+            }
+            
+            [buffer replaceBytesInRange:NSMakeRange(0, ALTPluginChannelHeaderLength + payloadLength) withBytes:NULL length:0];
+            
+            NSData *response = [self responseForChannelMessageType:messageType requestID:requestID];
+            if (![self writeData:response toSocket:clientSocket])
+            {
+                dispatch_source_cancel(source);
+                return;
+            }
+        }
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+        close(clientSocket);
+    });
+    dispatch_resume(source);
+}
+
+- (NSData *)responseForChannelMessageType:(ALTPluginChannelMessageType)messageType requestID:(uint32_t)requestID
+{
+    NSMutableData *payload = [NSMutableData data];
+    ALTPluginChannelMessageType responseType = ALTPluginChannelMessageTypeErrorResponse;
+    
+    if (messageType == ALTPluginChannelMessageTypeAnisetteDataRequest)
+    {
+        ALTAnisetteData *anisetteData = [self requestAnisetteData];
+        if (anisetteData.machineID != nil && anisetteData.oneTimePassword != nil && anisetteData.date != nil)
+        {
+            double timeInterval = anisetteData.date.timeIntervalSince1970;
+            
+            uint64_t dateBits = 0;
+            memcpy(&dateBits, &timeInterval, sizeof(dateBits));
+            
+            ALTAppendString(payload, anisetteData.machineID);
+            ALTAppendString(payload, anisetteData.oneTimePassword);
+            ALTAppendString(payload, anisetteData.localUserID ?: @"");
+            ALTAppendUInt64(payload, anisetteData.routingInfo);
+            ALTAppendString(payload, anisetteData.deviceUniqueIdentifier ?: @"");
+            ALTAppendString(payload, anisetteData.deviceSerialNumber ?: @"");
+            ALTAppendString(payload, anisetteData.deviceDescription ?: @"");
+            ALTAppendUInt64(payload, dateBits);
+            ALTAppendString(payload, anisetteData.locale.localeIdentifier);
+            ALTAppendString(payload, anisetteData.timeZone.name);
+            
+            responseType = ALTPluginChannelMessageTypeAnisetteDataResponse;
+        }
+        else
+        {
+            ALTAppendString(payload, @"AuthKit did not return anisette data.");
+        }
+    }
+    else
+    {
+        ALTAppendString(payload, [NSString stringWithFormat:@"Unsupported message type %@.", @(messageType)]);
+    }
+    
+    NSMutableData *message = [NSMutableData dataWithCapacity:ALTPluginChannelHeaderLength + payload.length];
+    ALTAppendUInt32(message, (uint32_t)payload.length);
+    ALTAppendUInt32(message, requestID);
+    [message appendBytes:&responseType length:sizeof(responseType)];
+    [message appendData:payload];
+    
+    return message;
+}
+
+- (BOOL)writeData:(NSData *)data toSocket:(int)socket
+{
+    const char *bytes = (const char *)data.bytes;
+    size_t remainingLength = data.length;
+    
+    while (remainingLength > 0)
+    {
+        ssize_t count = write(socket, bytes, remainingLength);
+        if (count == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            
+            return NO;
+        }
+        
+        bytes += count;
+        remainingLength -= count;
+    }
+    
+    return YES;
+}
+
 @end
@@ -44,13 +44,55 @@ private extension ALTAnisetteData
     func retrieveOTPHeadersForDSID(_ dsid: String) -> [String: Any]?
 }
 
+extension AnisetteDataManager
+{
+    struct CacheStatistics
+    {
+        var hitCount = 0
+        var missCount = 0
+        
+        // Misses that joined an in-flight fetch rather than starting their own.
+        var coalescedCount = 0
+        
+        // Fetches started in the background before cached anisette data expired.
+        var refreshCount = 0
+    }
+}
+
 class AnisetteDataManager: NSObject
 {
     static let shared = AnisetteDataManager()
     
+    // One-time passwords are only valid briefly, so don't reuse anisette data for long.
+    static let anisetteDataLifetime: TimeInterval = 30.0
+    
+    // Refresh cached anisette data this long before it expires...
+    static let refreshMargin: TimeInterval = 5.0
+    
+    // ...but only if it's been requested recently, so we don't keep fetching while idle.
+    static let refreshWindow: TimeInterval = 5 * 60.0
+    
+    var cacheStatistics: CacheStatistics {
+        self.cacheQueue.sync { self._cacheStatistics }
+    }
+    
+    // Serializes access to cache state below.
+    private let cacheQueue = DispatchQueue(label: "com.rileytestut.AltServer.AnisetteDataManager.cache")
+    
+    private var cachedAnisetteData: ALTAnisetteData?
+    private var lastRequestDate: Date?
+    private var refreshWorkItem: DispatchWorkItem?
+    private var _cacheStatistics = CacheStatistics()
+    
+    // Non-nil while fetching anisette data. All requests during that time share the result of a single fetch.
+    private var pendingCompletionHandlers: [(Result<ALTAnisetteData, Error>) -> Void]?
+    
     private var anisetteDataCompletionHandlers: [String: (Result<ALTAnisetteData, Error>) -> Void] = [:]
     private var anisetteDataTimers: [String: Timer] = [:]
     
+    // Only accessed from main thread.
+    private var pluginChannel: PluginChannel?
+    
     private lazy var xpcConnection: NSXPCConnection = {
         let connection = NSXPCConnection(serviceName: Bundle.ID.altXPC)
         connection.remoteObjectInterface = NSXPCInterface(with: AltXPCProtocol.self)
@@ -63,9 +105,120 @@ class AnisetteDataManager: NSObject
         super.init()
         
         DistributedNotificationCenter.default().addObserver(self, selector: #selector(AnisetteDataManager.handleAnisetteDataResponse(_:)), name: Notification.Name("com.rileytestut.AltServer.AnisetteDataResponse"), object: nil)
+        DistributedNotificationCenter.default().addObserver(self, selector: #selector(AnisetteDataManager.handlePluginChannelAvailable(_:)), name: PluginChannel.availableNotification, object: nil)
+        
+        // Ask already-running plug-in for its channel. Plug-ins that don't support channels ignore this.
+        DistributedNotificationCenter.default().postNotificationName(PluginChannel.findNotification, object: nil, userInfo: nil, deliverImmediately: true)
     }
     
     func requestAnisetteData(_ completion: @escaping (Result<ALTAnisetteData, Error>) -> Void)
+    {
+        self.cacheQueue.async {
+            self.lastRequestDate = Date()
+            
+            if let anisetteData = self.cachedAnisetteData, !self.isExpired(anisetteData)
+            {
+                self._cacheStatistics.hitCount += 1
+                
+                // Return copy so callers can't modify cached anisette data.
+                let copiedAnisetteData = anisetteData.copy() as! ALTAnisetteData
+                DispatchQueue.global().async {
+                    completion(.success(copiedAnisetteData))
+                }
+                
+                return
+            }
+            
+            self._cacheStatistics.missCount += 1
+            
+            if self.pendingCompletionHandlers != nil
+            {
+                self._cacheStatistics.coalescedCount += 1
+                self.pendingCompletionHandlers?.append(completion)
+            }
+            else
+            {
+                self.pendingCompletionHandlers = [completion]
+                self.startFetchingAnisetteData()
+            }
+            
+            let statistics = self._cacheStatistics
+            Logger.main.info("Anisette data cache miss. Hits: \(statistics.hitCount). Misses: \(statistics.missCount). Coalesced: \(statistics.coalescedCount). Refreshes: \(statistics.refreshCount).")
+        }
+    }
+}
+
+private extension AnisetteDataManager
+{
+    func isExpired(_ anisetteData: ALTAnisetteData) -> Bool
+    {
+        let expirationDate = anisetteData.date.addingTimeInterval(AnisetteDataManager.anisetteDataLifetime)
+        return expirationDate <= Date()
+    }
+    
+    // Must be called on cacheQueue.
+    func startFetchingAnisetteData()
+    {
+        DispatchQueue.global(qos: .userInitiated).async {
+            self.fetchAnisetteData { (result) in
+                self.cacheQueue.async {
+                    self.finishFetchingAnisetteData(with: result)
+                }
+            }
+        }
+    }
+    
+    // Must be called on cacheQueue.
+    func finishFetchingAnisetteData(with result: Result<ALTAnisetteData, Error>)
+    {
+        let completionHandlers = self.pendingCompletionHandlers ?? []
+        self.pendingCompletionHandlers = nil
+        
+        if case .success(let anisetteData) = result
+        {
+            self.cachedAnisetteData = anisetteData
+            self.scheduleRefresh(for: anisetteData)
+        }
+        
+        for completionHandler in completionHandlers
+        {
+            let result = result.map { $0.copy() as! ALTAnisetteData }
+            DispatchQueue.global().async {
+                completionHandler(result)
+            }
+        }
+    }
+    
+    // Must be called on cacheQueue.
+    func scheduleRefresh(for anisetteData: ALTAnisetteData)
+    {
+        self.refreshWorkItem?.cancel()
+        
+        let workItem = DispatchWorkItem { [weak self] in
+            guard let self else { return }
+            
+            guard let lastRequestDate = self.lastRequestDate, Date().timeIntervalSince(lastRequestDate) < AnisetteDataManager.refreshWindow else {
+                // Not requested recently, so let cached anisette data expire.
+                self.refreshWorkItem = nil
+                return
+            }
+            
+            guard self.pendingCompletionHandlers == nil else { return }
+            
+            Logger.main.info("Refreshing anisette data before it expires.")
+            
+            self._cacheStatistics.refreshCount += 1
+            self.pendingCompletionHandlers = []
+            self.startFetchingAnisetteData()
+        }
+        self.refreshWorkItem = workItem
+        
+        let refreshDate = anisetteData.date.addingTimeInterval(AnisetteDataManager.anisetteDataLifetime - AnisetteDataManager.refreshMargin)
+        let delay = max(refreshDate.timeIntervalSinceNow, 0)
+        self.cacheQueue.asyncAfter(deadline: .now() + delay, execute: workItem)
+    }
+    
+    func fetchAnisetteData(completion: @escaping (Result<ALTAnisetteData, Error>) -> Void)
     {
         self.requestAnisetteDataFromAOSKit { (result) in
             do
@@ -111,10 +264,7 @@ class AnisetteDataManager: NSObject
             }
         }
     }
-}
-
-private extension AnisetteDataManager
-{
+    
     func requestAnisetteDataFromAOSKit(completion: @escaping (Result<ALTAnisetteData, Error>) -> Void)
     {
         do
@@ -196,6 +346,30 @@ private extension AnisetteDataManager
     }
     
     func requestAnisetteDataFromPlugin(completion: @escaping (Result<ALTAnisetteData, Error>) -> Void)
+    {
+        DispatchQueue.main.async {
+            guard let pluginChannel = self.pluginChannel else { return self.requestAnisetteDataViaNotification(completion: completion) }
+            
+            pluginChannel.requestAnisetteData { (result) in
+                switch result
+                {
+                case .success(let anisetteData):
+                    anisetteData.sanitize(byReplacingBundleID: Bundle.ID.mail)
+                    completion(.success(anisetteData))
+                
+                case .failure(let error):
+                    Logger.main.error("Failed to fetch anisette data via AltPlugin channel, falling back to notifications. \(error.localizedDescription, privacy: .public)")
+                    
+                    DispatchQueue.main.async {
+                        self.requestAnisetteDataViaNotification(completion: completion)
+                    }
+                }
+            }
+        }
+    }
+    
+    // Must be called on main thread.
+    func requestAnisetteDataViaNotification(completion: @escaping (Result<ALTAnisetteData, Error>) -> Void)
     {
         let requestUUID = UUID().uuidString
         self.anisetteDataCompletionHandlers[requestUUID] = completion
@@ -210,10 +384,28 @@ private extension AnisetteDataManager
         DistributedNotificationCenter.default().postNotificationName(Notification.Name("com.rileytestut.AltServer.FetchAnisetteData"), object: nil, userInfo: ["requestUUID": requestUUID], options: .deliverImmediately)
     }
     
+    @objc func handlePluginChannelAvailable(_ notification: Notification)
+    {
+        guard let socketPath = notification.userInfo?["socketPath"] as? String, socketPath != self.pluginChannel?.socketPath else { return }
+        
+        Logger.main.info("Connecting to AltPlugin channel at \(socketPath, privacy: .public).")
+        
+        self.pluginChannel?.cancel()
+        
+        let pluginChannel = PluginChannel(socketPath: socketPath)
+        pluginChannel.invalidationHandler = { [weak self, weak pluginChannel] in
+            DispatchQueue.main.async {
+                guard let self, self.pluginChannel === pluginChannel else { return }
+                self.pluginChannel = nil
+            }
+        }
+        self.pluginChannel = pluginChannel
+    }
+    
     @objc func handleAnisetteDataResponse(_ notification: Notification)
     {
         guard let userInfo = notification.userInfo, let requestUUID = userInfo["requestUUID"] as? String else { return }
-                
+        
         if
             let archivedAnisetteData = userInfo["anisetteData"] as? Data,
             let anisetteData = try? NSKeyedUnarchiver.unarchivedObject(ofClass: ALTAnisetteData.self, from: archivedAnisetteData)
@@ -0,0 +1,302 @@
+//
+//  PluginChannel.swift
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import Foundation
+import Network
+import OSLog
+
+extension PluginChannel
+{
+    // Keep in sync with ALTPluginService.m, which also documents wire format.
+    enum MessageType: UInt8
+    {
+        case anisetteDataRequest = 1
+        case anisetteDataResponse = 2
+        case errorResponse = 3
+    }
+    
+    static let availableNotification = Notification.Name("com.rileytestut.AltServer.PluginChannelAvailable")
+    static let findNotification = Notification.Name("com.rileytestut.AltServer.FindPluginChannel")
+    
+    static let headerLength = MemoryLayout<UInt32>.size + MemoryLayout<UInt32>.size + MemoryLayout<UInt8>.size
+    static let maximumPayloadLength = 64 * 1024
+    
+    // AltPlugin handles requests serially, so don't queue up more than this many at once.
+    static let maximumPendingRequestCount = 4
+    
+    static let requestTimeout: TimeInterval = 5.0
+}
+
+private extension PluginChannel
+{
+    struct PendingRequest
+    {
+        var completionHandler: (Result<ALTAnisetteData, Error>) -> Void
+        var timeoutWorkItem: DispatchWorkItem?
+    }
+    
+    struct Reader
+    {
+        var data: Data
+        var offset = 0
+        
+        init(data: Data)
+        {
+            // Copy data so indices start at 0.
+            self.data = Data(data)
+        }
+        
+        mutating func readInteger<T: FixedWidthInteger>(_ type: T.Type) throws -> T
+        {
+            let size = MemoryLayout<T>.size
+            guard self.offset + size <= self.data.count else { throw ALTServerError(.invalidAnisetteData) }
+            
+            var value: T = 0
+            withUnsafeMutableBytes(of: &value) { buffer in
+                _ = self.data.copyBytes(to: buffer, from: self.offset ..< self.offset + size)
+            }
+            self.offset += size
+            
+            return T(littleEndian: value)
+        }
+        
+        mutating func readString() throws -> String
+        {
+            let length = Int(try self.readInteger(UInt32.self))
+            guard self.offset + length <= self.data.count, let string = String(data: self.data[self.offset ..< self.offset + length], encoding: .utf8) else { throw ALTServerError(.invalidAnisetteData) }
+            self.offset += length
+            
+            return string
+        }
+    }
+}
+
+// Point-to-point connection to AltPlugin's Unix socket. Requests are tagged with IDs, so several may be in flight at once.
+class PluginChannel
+{
+    let socketPath: String
+    
+    // Called once channel can no longer be used, e.g. because Mail quit.
+    var invalidationHandler: (() -> Void)?
+    
+    private let connection: NWConnection
+    private let queue = DispatchQueue(label: "com.rileytestut.AltServer.PluginChannel")
+    
+    private var isInvalidated = false
+    private var nextRequestID: UInt32 = 1
+    private var pendingRequests = [UInt32: PendingRequest]()
+    
+    // Requests waiting for a pending request to finish before being sent.
+    private var queuedRequestIDs = [UInt32]()
+    
+    private var receivedData = Data()
+    
+    init(socketPath: String)
+    {
+        self.socketPath = socketPath
+        self.connection = NWConnection(to: .unix(path: socketPath), using: .tcp)
+        
+        self.connection.stateUpdateHandler = { [weak self] state in
+            switch state
+            {
+            case .failed(let error):
+                Logger.main.error("AltPlugin channel failed. \(error.localizedDescription, privacy: .public)")
+                self?.invalidate()
+            
+            case .waiting(let error):
+                // Socket file exists but nothing is listening (e.g. Mail crashed), which NWConnection would otherwise keep retrying.
+                // Treat as failure so requests fall back immediately rather than waiting out their timeouts.
+                Logger.main.error("AltPlugin channel is unreachable. \(error.localizedDescription, privacy: .public)")
+                self?.connection.cancel()
+                self?.invalidate()
+            
+            case .cancelled: self?.invalidate()
+            default: break
+            }
+        }
+        self.connection.start(queue: self.queue)
+        
+        self.receiveData()
+    }
+    
+    func requestAnisetteData(completionHandler: @escaping (Result<ALTAnisetteData, Error>) -> Void)
+    {
+        self.queue.async {
+            guard !self.isInvalidated else { return completionHandler(.failure(ALTServerError(.pluginNotFound))) }
+            
+            let requestID = self.nextRequestID
+            self.nextRequestID &+= 1
+            
+            self.pendingRequests[requestID] = PendingRequest(completionHandler: completionHandler)
+            self.queuedRequestIDs.append(requestID)
+            
+            self.sendQueuedRequests()
+        }
+    }
+    
+    func cancel()
+    {
+        self.connection.cancel()
+    }
+}
+
+private extension PluginChannel
+{
+    var inFlightRequestCount: Int {
+        self.pendingRequests.count - self.queuedRequestIDs.count
+    }
+    
+    func sendQueuedRequests()
+    {
+        guard !self.isInvalidated else { return }
+        
+        while !self.queuedRequestIDs.isEmpty && self.inFlightRequestCount < PluginChannel.maximumPendingRequestCount
+        {
+            let requestID = self.queuedRequestIDs.removeFirst()
+            
+            // Only start timing out once request is actually sent.
+            let timeoutWorkItem = DispatchWorkItem { [weak self] in
+                self?.finishRequest(requestID, result: .failure(ALTServerError(.pluginNotFound)))
+            }
+            self.pendingRequests[requestID]?.timeoutWorkItem = timeoutWorkItem
+            self.queue.asyncAfter(deadline: .now() + PluginChannel.requestTimeout, execute: timeoutWorkItem)
+            
+            var message = Data(capacity: PluginChannel.headerLength)
+            withUnsafeBytes(of: UInt32(0).littleEndian) { message.append(contentsOf: $0) }
+            withUnsafeBytes(of: requestID.littleEndian) { message.append(contentsOf: $0) }
+            message.append(MessageType.anisetteDataRequest.rawValue)
+            
+            self.connection.send(content: message, completion: .contentProcessed { [weak self] error in
+                guard let error else { return }
+                
+                Logger.main.error("Failed to send AltPlugin channel request. \(error.localizedDescription, privacy: .public)")
+                self?.connection.cancel()
+            })
+        }
+    }
+    
+    func receiveData()
+    {
+        self.connection.receive(minimumIncompleteLength: 1, maximumLength: PluginChannel.maximumPayloadLength) { [weak self] (data, _, isComplete, error) in
+            guard let self else { return }
+            
+            if let data
+            {
+                self.receivedData.append(data)
+                
+                do
+                {
+                    try self.processReceivedData()
+                }
+                catch
+                {
+                    Logger.main.error("Received invalid AltPlugin channel message. \(error.localizedDescription, privacy: .public)")
+                    self.connection.cancel()
+                    return
+                }
+            }
+            
+            if isComplete || error != nil
+            {
+                self.connection.cancel()
+            }
+            else
+            {
+                self.receiveData()
+            }
+        }
+    }
+    
+    func processReceivedData() throws
+    {
+        while self.receivedData.count >= PluginChannel.headerLength
+        {
+            var header = Reader(data: self.receivedData.prefix(PluginChannel.headerLength))
+            let payloadLength = Int(try header.readInteger(UInt32.self))
+            let requestID = try header.readInteger(UInt32.self)
+            let rawMessageType = try header.readInteger(UInt8.self)
+            
+            guard payloadLength <= PluginChannel.maximumPayloadLength else { throw ALTServerError(.invalidAnisetteData) }
+            guard self.receivedData.count >= PluginChannel.headerLength + payloadLength else { break }
+            
+            let payload = self.receivedData.dropFirst(PluginChannel.headerLength).prefix(payloadLength)
+            self.receivedData = Data(self.receivedData.dropFirst(PluginChannel.headerLength + payloadLength))
+            
+            var reader = Reader(data: payload)
+            
+            switch MessageType(rawValue: rawMessageType)
+            {
+            case .anisetteDataResponse?:
+                let anisetteData = try self.decodeAnisetteData(from: &reader)
+                self.finishRequest(requestID, result: .success(anisetteData))
+            
+            case .errorResponse?:
+                let errorDescription = try reader.readString()
+                Logger.main.error("AltPlugin failed to fetch anisette data. \(errorDescription, privacy: .public)")
+                
+                self.finishRequest(requestID, result: .failure(ALTServerError(.invalidAnisetteData)))
+            
+            case .anisetteDataRequest?, nil: throw ALTServerError(.invalidAnisetteData)
+            }
+        }
+    }
+    
+    func decodeAnisetteData(from reader: inout Reader) throws -> ALTAnisetteData
+    {
+        let machineID = try reader.readString()
+        let oneTimePassword = try reader.readString()
+        let localUserID = try reader.readString()
+        let routingInfo = try reader.readInteger(UInt64.self)
+        let deviceUniqueIdentifier = try reader.readString()
+        let deviceSerialNumber = try reader.readString()
+        let deviceDescription = try reader.readString()
+        let timeInterval = Double(bitPattern: try reader.readInteger(UInt64.self))
+        let localeIdentifier = try reader.readString()
+        let timeZoneIdentifier = try reader.readString()
+        
+        let anisetteData = ALTAnisetteData(machineID: machineID,
+                                           oneTimePassword: oneTimePassword,
+                                           localUserID: localUserID,
+                                           routingInfo: routingInfo,
+                                           deviceUniqueIdentifier: deviceUniqueIdentifier,
+                                           deviceSerialNumber: deviceSerialNumber,
+                                           deviceDescription: deviceDescription,
+                                           date: Date(timeIntervalSince1970: timeInterval),
+                                           locale: Locale(identifier: localeIdentifier),
+                                           timeZone: TimeZone(identifier: timeZoneIdentifier) ?? .current)
+        return anisetteData
+    }
+    
+    func finishRequest(_ requestID: UInt32, result: Result<ALTAnisetteData, Error>)
+    {
+        guard let request = self.pendingRequests.removeValue(forKey: requestID) else { return }
+        request.timeoutWorkItem?.cancel()
+        
+        if let index = self.queuedRequestIDs.firstIndex(of: requestID)
+        {
+            self.queuedRequestIDs.remove(at: index)
+        }
+        
+        request.completionHandler(result)
+        
+        self.sendQueuedRequests()
+    }
+    
+    func invalidate()
+    {
+        guard !self.isInvalidated else { return }
+        self.isInvalidated = true
+        
+        for requestID in Array(self.pendingRequests.keys)
+        {
+            self.finishRequest(requestID, result: .failure(ALTServerError(.pluginNotFound)))
+        }
+        
+        self.invalidationHandler?()
+    }
+}
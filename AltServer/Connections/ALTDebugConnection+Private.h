@@ -7,9 +7,7 @@
 //
 
 #import "ALTDebugConnection.h"
-
-#include <libimobiledevice/libimobiledevice.h>
-#include <libimobiledevice/debugserver.h>
+#import "ALTGDBRemoteConnection.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -17,7 +15,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property (nonatomic, readonly) dispatch_queue_t connectionQueue;
 
-@property (nonatomic, nullable) debugserver_client_t client;
+@property (nonatomic, nullable) ALTGDBRemoteConnection *connection;
 
 - (instancetype)initWithDevice:(ALTDevice *)device;
 
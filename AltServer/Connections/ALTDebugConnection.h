@@ -10,6 +10,19 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+NS_SWIFT_NAME(DebugProcessResult)
+@interface ALTDebugProcessResult : NSObject
+
+// Either the process name (NSString) or PID (NSNumber) that was requested.
+@property (nonatomic, copy, readonly) id<NSCopying> process;
+
+// nil if JIT was successfully enabled.
+@property (nonatomic, nullable, readonly) NSError *error;
+
+@property (nonatomic, readonly) NSTimeInterval duration;
+
+@end
+
 NS_SWIFT_NAME(DebugConnection)
 @interface ALTDebugConnection : NSObject
 
@@ -18,6 +31,10 @@ NS_SWIFT_NAME(DebugConnection)
 - (void)enableUnsignedCodeExecutionForProcessWithName:(NSString *)processName completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
 - (void)enableUnsignedCodeExecutionForProcessWithID:(NSInteger)pid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
 
+// Enables JIT for each process in order. debugserver exits after detaching, so each process gets its own debugserver connection.
+// processes may contain process names (NSString) and/or PIDs (NSNumber). Results are returned in the same order.
+- (void)enableUnsignedCodeExecutionForProcesses:(NSArray<id<NSCopying>> *)processes completionHandler:(void (^)(NSArray<ALTDebugProcessResult *> *results))completionHandler;
+
 - (void)disconnect;
 
 @end
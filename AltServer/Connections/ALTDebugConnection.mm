@@ -7,28 +7,84 @@
 //
 
 #import "ALTDebugConnection+Private.h"
+#import "ALTGDBRemoteConnection+Private.h"
 
 #import "NSError+ALTServerError.h"
 #import "NSError+libimobiledevice.h"
 
-char *bin2hex(const unsigned char *bin, size_t length)
+#include <libimobiledevice/libimobiledevice.h>
+#include <libimobiledevice/debugserver.h>
+
+// Raw byte stream over a lockdown debugserver service connection. Owns client.
+class DebugServerTransport : public gdbremote::Transport
 {
-    if (bin == NULL || length == 0)
+public:
+    explicit DebugServerTransport(debugserver_client_t client) : _client(client)
     {
-        return NULL;
     }
-
-    char *hex = (char *)malloc(length * 2 + 1);
-    for (size_t i = 0; i < length; i++)
+    
+    ~DebugServerTransport() override
+    {
+        debugserver_client_free(_client);
+    }
+    
+    bool send(const char *data, size_t length) override
+    {
+        size_t totalSent = 0;
+        while (totalSent < length)
+        {
+            uint32_t sent = 0;
+            if (debugserver_client_send(_client, data + totalSent, (uint32_t)(length - totalSent), &sent) != DEBUGSERVER_E_SUCCESS || sent == 0)
+            {
+                return false;
+            }
+            
+            totalSent += sent;
+        }
+        
+        return true;
+    }
+    
+    ssize_t receive(char *buffer, size_t length, unsigned int timeoutMilliseconds) override
     {
-        hex[i * 2] = "0123456789ABCDEF"[bin[i] >> 4];
-        hex[i * 2 + 1] = "0123456789ABCDEF"[bin[i] & 0x0F];
+        uint32_t received = 0;
+        debugserver_error_t error = debugserver_client_receive_with_timeout(_client, buffer, (uint32_t)length, &received, timeoutMilliseconds);
+        
+        switch (error)
+        {
+            case DEBUGSERVER_E_SUCCESS: return (ssize_t)received;
+            case DEBUGSERVER_E_TIMEOUT: return 0;
+            default: return -1;
+        }
     }
-    hex[length * 2] = '\0';
+    
+private:
+    debugserver_client_t _client;
+};
+
+@interface ALTDebugProcessResult ()
+
+- (instancetype)initWithProcess:(id<NSCopying>)process error:(nullable NSError *)error duration:(NSTimeInterval)duration;
+
+@end
 
-    return hex;
+@implementation ALTDebugProcessResult
+
+- (instancetype)initWithProcess:(id<NSCopying>)process error:(nullable NSError *)error duration:(NSTimeInterval)duration
+{
+    self = [super init];
+    if (self)
+    {
+        _process = [(id)process copy];
+        _error = error;
+        _duration = duration;
+    }
+    
+    return self;
 }
 
+@end
+
 @implementation ALTDebugConnection
 
 - (instancetype)initWithDevice:(ALTDevice *)device
@@ -52,13 +108,8 @@ char *bin2hex(const unsigned char *bin, size_t length)
 
 - (void)disconnect
 {
-    if (_client == nil)
-    {
-        return;
-    }
-    
-    debugserver_client_free(_client);
-    _client = nil;
+    [_connection disconnect];
+    _connection = nil;
 }
 
 - (void)connectWithCompletionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
@@ -89,7 +140,9 @@ char *bin2hex(const unsigned char *bin, size_t length)
             return finish(NO, [NSError errorWithDebugServerError:error device:self.device]);
         }
         
-        self.client = client;
+        // Speak GDB remote protocol directly rather than via debugserver_client_send_command(), which always waits for acks.
+        std::unique_ptr<gdbremote::Transport> transport = std::make_unique<DebugServerTransport>(client);
+        self.connection = [[ALTGDBRemoteConnection alloc] initWithTransport:std::move(transport)];
         
         finish(YES, nil);
     });
@@ -97,222 +150,105 @@ char *bin2hex(const unsigned char *bin, size_t length)
 
 - (void)enableUnsignedCodeExecutionForProcessWithName:(NSString *)processName completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
 {
-    [self _enableUnsignedCodeExecutionForProcessWithName:processName pid:0 completionHandler:completionHandler];
+    [self enableUnsignedCodeExecutionForProcesses:@[processName] completionHandler:^(NSArray<ALTDebugProcessResult *> *results) {
+        NSError *error = results.firstObject.error;
+        completionHandler(error == nil, error);
+    }];
 }
 
 - (void)enableUnsignedCodeExecutionForProcessWithID:(NSInteger)pid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
 {
-    [self _enableUnsignedCodeExecutionForProcessWithName:nil pid:(int32_t)pid completionHandler:completionHandler];
+    [self enableUnsignedCodeExecutionForProcesses:@[@(pid)] completionHandler:^(NSArray<ALTDebugProcessResult *> *results) {
+        NSError *error = results.firstObject.error;
+        completionHandler(error == nil, error);
+    }];
 }
 
-- (void)_enableUnsignedCodeExecutionForProcessWithName:(nullable NSString *)processName pid:(int32_t)pid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+- (void)enableUnsignedCodeExecutionForProcesses:(NSArray<id<NSCopying>> *)processes completionHandler:(void (^)(NSArray<ALTDebugProcessResult *> *results))completionHandler
 {
-    dispatch_async(self.connectionQueue, ^{
-        NSString *attachCommand = nil;
-        
-        if (processName)
-        {
-            NSString *encodedName = @(bin2hex((const unsigned char *)processName.UTF8String, (size_t)strlen(processName.UTF8String)));
-            attachCommand = [NSString stringWithFormat:@"vAttachOrWait;%@", encodedName];
-        }
-        else
-        {
-            // Convert to Big-endian.
-            int32_t rawPID = CFSwapInt32HostToBig(pid);
-            
-            NSString *encodedName = @(bin2hex((const unsigned char *)&rawPID, 4));
-            attachCommand = [NSString stringWithFormat:@"vAttach;%@", encodedName];
-        }
-        
-        NSError *error = nil;
-        if (![self sendCommand:attachCommand arguments:nil error:&error])
-        {
-            NSMutableDictionary *userInfo = [error.userInfo mutableCopy];
-            userInfo[ALTAppNameErrorKey] = processName;
-            userInfo[ALTDeviceNameErrorKey] = self.device.name;
-            
-            NSError *returnError = [NSError errorWithDomain:error.domain code:error.code userInfo:userInfo];
-            return completionHandler(NO, returnError);
-        }
-        
-        NSString *detachCommand = @"D";
-        if (![self sendCommand:detachCommand arguments:nil error:&error])
-        {
-            NSMutableDictionary *userInfo = [error.userInfo mutableCopy];
-            userInfo[ALTAppNameErrorKey] = processName;
-            userInfo[ALTDeviceNameErrorKey] = self.device.name;
-            
-            NSError *returnError = [NSError errorWithDomain:error.domain code:error.code userInfo:userInfo];
-            return completionHandler(NO, returnError);
-        }
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    
+    NSMutableArray<ALTDebugProcessResult *> *results = [NSMutableArray arrayWithCapacity:processes.count];
+    [self _enableUnsignedCodeExecutionForProcesses:processes index:0 results:results completionHandler:^{
+        NSUInteger failureCount = [[results filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"error != nil"]] count];
+        NSLog(@"Enabled JIT for %@ of %@ processes on %@ in %.2fs (one debugserver connection per process).", @(results.count - failureCount), @(results.count), self.device.name, CFAbsoluteTimeGetCurrent() - startTime);
         
-        completionHandler(YES, nil);
-    });
+        completionHandler(results);
+    }];
 }
 
 #pragma mark - Private -
 
-- (BOOL)sendCommand:(NSString *)command arguments:(nullable NSArray<NSString *> *)arguments error:(NSError **)error
+- (void)_enableUnsignedCodeExecutionForProcesses:(NSArray<id<NSCopying>> *)processes index:(NSUInteger)index results:(NSMutableArray<ALTDebugProcessResult *> *)results completionHandler:(void (^)(void))completionHandler
 {
-    int argc = (int)arguments.count;
-    char **argv = new char*[argc + 1];
-    
-    for (int i = 0; i < argc; i++)
+    if (index >= processes.count)
     {
-        NSString *argument = arguments[i];
-        argv[i] = (char *)argument.UTF8String;
+        return completionHandler();
     }
     
-    argv[argc] = NULL;
-    
-    debugserver_command_t debugCommand = NULL;
-    debugserver_command_new(command.UTF8String, argc, argv, &debugCommand);
+    id<NSCopying> process = processes[index];
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
     
-    delete[] argv;
-    
-    char *response = NULL;
-    size_t responseSize = 0;
-    debugserver_error_t debugServerError = debugserver_client_send_command(self.client, debugCommand, &response, &responseSize);
-    debugserver_command_free(debugCommand);
-    
-    if (debugServerError != DEBUGSERVER_E_SUCCESS)
-    {
-        if (error)
+    void (^finish)(NSError *) = ^(NSError *error) {
+        if (error != nil)
         {
-            *error = [NSError errorWithDebugServerError:debugServerError device:self.device];
+            NSMutableDictionary *userInfo = [error.userInfo mutableCopy];
+            userInfo[ALTAppNameErrorKey] = [(id)process isKindOfClass:[NSString class]] ? process : nil;
+            userInfo[ALTDeviceNameErrorKey] = self.device.name;
+            
+            error = [NSError errorWithDomain:error.domain code:error.code userInfo:userInfo];
         }
         
-        return NO;
-    }
-    
-    NSString *rawResponse = (response != nil) ? @(response) : nil;
-    if (![self processResponse:rawResponse error:error])
-    {
-        return NO;
-    }
-    
-    return YES;
-}
-
-- (BOOL)processResponse:(NSString *)rawResponse error:(NSError **)error
-{
-    if (rawResponse == nil)
-    {
-        if (error)
-        {
-            *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorRequestedAppNotRunning userInfo:nil];
-            return NO;
-        }
-    }
+        ALTDebugProcessResult *result = [[ALTDebugProcessResult alloc] initWithProcess:process error:error duration:CFAbsoluteTimeGetCurrent() - startTime];
+        [results addObject:result];
+        
+        NSLog(@"Enabling JIT for %@ %@ after %.2fs.", process, (error == nil) ? @"succeeded" : @"failed", result.duration);
+        
+        [self _enableUnsignedCodeExecutionForProcesses:processes index:index + 1 results:results completionHandler:completionHandler];
+    };
     
-    if (rawResponse.length == 0 || [rawResponse isEqualToString:@"OK"])
+    if (index > 0)
     {
-        return YES;
+        // debugserver exits after detaching from previous process, so connect again up front rather than waste a round trip discovering that.
+        [self disconnect];
     }
     
-    char type = [rawResponse characterAtIndex:0];
-    NSString *response = [rawResponse substringFromIndex:1];
-    
-    switch (type)
-    {
-        case 'O':
+    [self connectIfNeededWithCompletionHandler:^(BOOL success, NSError *error) {
+        if (!success)
         {
-            // stdout/stderr
-            
-            char *decodedResponse = NULL;
-            debugserver_decode_string(response.UTF8String, response.length, &decodedResponse);
-            
-            NSLog(@"Response: %@", @(decodedResponse));
-            
-            if (decodedResponse)
-            {
-                free(decodedResponse);
-            }
-            
-            return YES;
+            return finish(error);
         }
-            
-        case 'T':
+        
+        void (^attachCompletionHandler)(BOOL, NSError *) = ^(BOOL success, NSError *error) {
+            finish(success ? nil : error);
+        };
+        
+        ALTGDBRemoteConnection *connection = self.connection;
+        if (connection == nil)
         {
-            // Thread Information
-            
-            NSLog(@"Thread stopped. Details:\n%s", response.UTF8String + 1);
-            
-            // Parse thread state to determine if app is running.
-            NSArray<NSString *> *components = [response componentsSeparatedByString:@";"];
-            if (components.count <= 1)
-            {
-                if (error)
-                {
-                    *error = [NSError errorWithDomain:AltServerConnectionErrorDomain code:ALTServerConnectionErrorUnknown userInfo:@{
-                        NSLocalizedFailureReasonErrorKey: response,
-                        ALTSourceFileErrorKey: @(__FILE__).lastPathComponent,
-                        ALTSourceLineErrorKey: @(__LINE__)
-                    }];
-                }
-                
-                return NO;
-            }
-            
-            NSString *mainThread = components[1];
-            NSString *threadState = [[mainThread componentsSeparatedByString:@":"] lastObject];
-            
-            NSScanner *scanner = [NSScanner scannerWithString:threadState];
-
-            unsigned long long mainThreadState = 0;
-            [scanner scanHexLongLong:&mainThreadState];
-            
-            // If main thread state == 0, app is not running.
-            if (mainThreadState == 0)
-            {
-                if (error)
-                {
-                    *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorRequestedAppNotRunning userInfo:nil];
-                }
-                
-                return NO;
-            }
-            
-            return YES;
+            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorLostConnection userInfo:nil]);
         }
-            
-        case 'E':
+        
+        // Pipeline attach + detach packets so each process costs a single round trip.
+        if ([(id)process isKindOfClass:[NSNumber class]])
         {
-            // Error
-            
-            if (error)
-            {
-                NSInteger errorCode = [[[response componentsSeparatedByString:@";"] firstObject] integerValue];
-                
-                switch (errorCode)
-                {
-                    case 96:
-                        *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorRequestedAppNotRunning userInfo:nil];
-                        break;
-                        
-                    default:
-                        *error = [NSError errorWithDomain:AltServerConnectionErrorDomain code:ALTServerConnectionErrorUnknown userInfo:@{
-                            NSLocalizedFailureReasonErrorKey: response,
-                            ALTSourceFileErrorKey: @(__FILE__).lastPathComponent,
-                            ALTSourceLineErrorKey: @(__LINE__)
-                        }];
-                        break;
-                }
-            }
-            
-            return NO;
+            [connection attachToAndDetachFromProcessWithID:[(NSNumber *)process integerValue] completionHandler:attachCompletionHandler];
         }
-            
-        case 'W':
+        else
         {
-            // Warning
-            
-            NSLog(@"WARNING: %@", response);
-            return YES;
+            [connection attachToAndDetachFromProcessWithName:(NSString *)process waitForLaunch:YES completionHandler:attachCompletionHandler];
         }
+    }];
+}
+
+- (void)connectIfNeededWithCompletionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    if (self.connection != nil)
+    {
+        return completionHandler(YES, nil);
     }
     
-    return YES;
+    [self connectWithCompletionHandler:completionHandler];
 }
 
 @end
@@ -20,7 +20,9 @@ NS_SWIFT_NAME(WiredConnection)
 @property (nonatomic, copy, readonly) ALTDevice *device;
 
 - (void)sendData:(NSData *)data completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler;
+- (void)sendDataRegions:(NSArray<NSData *> *)regions completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler;
 - (void)receiveDataWithExpectedSize:(NSInteger)expectedSize completionHandler:(void (^)(NSData * _Nullable, NSError * _Nullable))completionHandler;
+- (void)receiveDataWithExpectedSize:(NSInteger)expectedSize toFileDescriptor:(int)fileDescriptor chunkHandler:(nullable void (^)(NSData *chunk))chunkHandler completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler;
 
 - (void)disconnect;
 
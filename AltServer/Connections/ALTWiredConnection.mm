@@ -11,6 +11,9 @@
 #import "ALTConnection.h"
 #import "NSError+ALTServerError.h"
 
+// Maximum number of bytes requested from the device in a single receive call.
+static const uint32_t ALTWiredConnectionReceiveWindowSize = 1024 * 1024;
+
 @implementation ALTWiredConnection
 
 - (instancetype)initWithDevice:(ALTDevice *)device connection:(idevice_connection_t)connection
@@ -46,6 +49,11 @@
 }
 
 - (void)sendData:(NSData *)data completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler
+{
+    [self sendDataRegions:@[data] completionHandler:completionHandler];
+}
+
+- (void)sendDataRegions:(NSArray<NSData *> *)regions completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler
 {
     void (^finish)(NSError *error) = ^(NSError *error) {
         if (error != nil)
@@ -60,16 +68,23 @@
     };
     
     dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
-        NSMutableData *mutableData = [data mutableCopy];
-        while (mutableData.length > 0)
+        for (NSData *data in regions)
         {
-            uint32_t sentBytes = 0;
-            if (idevice_connection_send(self.connection, (const char *)mutableData.bytes, (int32_t)mutableData.length, &sentBytes) != IDEVICE_E_SUCCESS)
+            __block BOOL success = YES;
+            
+            // Enumerate byte ranges instead of accessing data.bytes, which would copy discontiguous data (e.g. dispatch_data_t) into a single buffer.
+            [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+                if (![self sendBytes:(const char *)bytes length:byteRange.length])
+                {
+                    success = NO;
+                    *stop = YES;
+                }
+            }];
+            
+            if (!success)
             {
                 return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorLostConnection userInfo:nil]);
             }
-            
-            [mutableData replaceBytesInRange:NSMakeRange(0, sentBytes) withBytes:NULL length:0];
         }
         
         finish(nil);
@@ -87,28 +102,147 @@
         completionHandler(data, error);
     };
     
+    if (expectedSize < 0)
+    {
+        // expectedSize comes straight from peer, so never trust it.
+        return finish(nil, [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorInvalidRequest userInfo:nil]);
+    }
+    
     dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
-        char bytes[4096];
-        NSMutableData *receivedData = [NSMutableData dataWithCapacity:expectedSize];
+        // Receive directly into buffer rather than appending small chunks, but only grow it as data actually arrives
+        // so a bogus expectedSize can't make us allocate gigabytes up front.
+        NSMutableData *receivedData = [NSMutableData dataWithCapacity:MIN((NSInteger)ALTWiredConnectionReceiveWindowSize, expectedSize)];
         
-        while (receivedData.length < expectedSize)
+        NSInteger receivedBytes = 0;
+        while (receivedBytes < expectedSize)
         {
-            uint32_t size = MIN(4096, (uint32_t)expectedSize - (uint32_t)receivedData.length);
+            uint32_t size = (uint32_t)MIN((NSInteger)ALTWiredConnectionReceiveWindowSize, expectedSize - receivedBytes);
+            receivedData.length = receivedBytes + size;
             
-            uint32_t receivedBytes = 0;
-            if (idevice_connection_receive_timeout(self.connection, bytes, size, &receivedBytes, 10000) != IDEVICE_E_SUCCESS)
+            uint32_t count = 0;
+            if (![self receiveBytes:(char *)receivedData.mutableBytes + receivedBytes length:size count:&count])
             {
                 return finish(nil, [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorLostConnection userInfo:nil]);
             }
             
-            NSData *data = [NSData dataWithBytesNoCopy:bytes length:receivedBytes freeWhenDone:NO];
-            [receivedData appendData:data];
+            receivedBytes += count;
         }
         
+        receivedData.length = receivedBytes;
         finish(receivedData, nil);
     });
 }
 
+- (void)receiveDataWithExpectedSize:(NSInteger)expectedSize toFileDescriptor:(int)fileDescriptor chunkHandler:(nullable void (^)(NSData *chunk))chunkHandler completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler
+{
+    void (^finish)(NSError *error) = ^(NSError *error) {
+        if (error != nil)
+        {
+            NSLog(@"Receive Data Error: %@", error);
+            completionHandler(NO, error);
+        }
+        else
+        {
+            completionHandler(YES, nil);
+        }
+    };
+    
+    if (expectedSize < 0)
+    {
+        return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorInvalidRequest userInfo:nil]);
+    }
+    
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        // Reuse a single window-sized buffer so memory usage doesn't depend on message size.
+        size_t bufferSize = (size_t)MAX(MIN((NSInteger)ALTWiredConnectionReceiveWindowSize, expectedSize), 1);
+        char *buffer = (char *)malloc(bufferSize);
+        
+        NSError *error = nil;
+        
+        NSInteger receivedBytes = 0;
+        while (receivedBytes < expectedSize)
+        {
+            uint32_t size = (uint32_t)MIN((NSInteger)bufferSize, expectedSize - receivedBytes);
+            
+            uint32_t count = 0;
+            if (![self receiveBytes:buffer length:size count:&count])
+            {
+                error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorLostConnection userInfo:nil];
+                break;
+            }
+            
+            size_t writtenBytes = 0;
+            while (writtenBytes < count)
+            {
+                ssize_t result = write(fileDescriptor, buffer + writtenBytes, count - writtenBytes);
+                if (result < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    
+                    error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+                    break;
+                }
+                
+                writtenBytes += result;
+            }
+            
+            if (error != nil)
+            {
+                break;
+            }
+            
+            if (chunkHandler != nil)
+            {
+                NSData *chunk = [NSData dataWithBytesNoCopy:buffer length:count freeWhenDone:NO];
+                chunkHandler(chunk);
+            }
+            
+            receivedBytes += count;
+        }
+        
+        free(buffer);
+        
+        finish(error);
+    });
+}
+
+#pragma mark - Private -
+
+- (BOOL)receiveBytes:(char *)bytes length:(uint32_t)length count:(uint32_t *)count
+{
+    *count = 0;
+    
+    if (idevice_connection_receive_timeout(self.connection, bytes, length, count, 10000) != IDEVICE_E_SUCCESS)
+    {
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (BOOL)sendBytes:(const char *)bytes length:(NSUInteger)length
+{
+    NSUInteger offset = 0;
+    
+    while (offset < length)
+    {
+        uint32_t size = (uint32_t)MIN(length - offset, (NSUInteger)INT32_MAX);
+        
+        uint32_t sentBytes = 0;
+        if (idevice_connection_send(self.connection, bytes + offset, size, &sentBytes) != IDEVICE_E_SUCCESS)
+        {
+            return NO;
+        }
+        
+        offset += sentBytes;
+    }
+    
+    return YES;
+}
+
 #pragma mark - NSObject -
 
 - (NSString *)description
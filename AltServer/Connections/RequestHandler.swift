@@ -7,6 +7,7 @@
 //
 
 import Foundation
+import CryptoKit
 
 typealias ServerConnectionManager = ConnectionManager<ServerRequestHandler>
 
@@ -146,7 +147,7 @@ struct ServerRequestHandler: RequestHandler
     
     func handleEnableUnsignedCodeExecutionRequest(_ request: EnableUnsignedCodeExecutionRequest, for connection: Connection, completionHandler: @escaping (Result<EnableUnsignedCodeExecutionResponse, Error>) -> Void)
     {
-        guard let device = ALTDeviceManager.shared.availableDevices.first(where: { $0.identifier == request.udid }) else { return completionHandler(.failure(ALTServerError(.deviceNotFound))) }
+        guard let device = ALTDeviceManager.shared.availableDevice(withUDID: request.udid) else { return completionHandler(.failure(ALTServerError(.deviceNotFound))) }
                 
         let process: AppProcess
         
@@ -186,19 +187,54 @@ private extension RequestHandler
 {
     func receiveApp(for request: PrepareAppRequest, from connection: Connection, completionHandler: @escaping (Result<URL, ALTServerError>) -> Void)
     {
-        connection.receiveData(expectedSize: request.contentSize) { (result) in
+        let temporaryURL = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString + ".ipa")
+        
+        let fileHandle: FileHandle
+        
+        do
+        {
+            guard FileManager.default.createFile(atPath: temporaryURL.path, contents: nil) else { throw CocoaError(.fileWriteUnknown, userInfo: [NSURLErrorKey: temporaryURL]) }
+            fileHandle = try FileHandle(forWritingTo: temporaryURL)
+        }
+        catch
+        {
+            print("Error creating app file:", error)
+            return completionHandler(.failure(ALTServerError(error)))
+        }
+        
+        // Write app data to disk as it arrives rather than holding entire .ipa in memory,
+        // hashing it and keeping just enough of the end to read the ZIP central directory.
+        var hasher = SHA256()
+        var archiveTail = Data()
+        
+        print("Receiving app data...")
+        
+        connection.receiveData(expectedSize: request.contentSize, to: fileHandle, chunkHandler: { (chunk) in
+            hasher.update(data: chunk)
+            
+            archiveTail.append(chunk)
+            if archiveTail.count > ZipArchiveTail.maximumSize * 2
+            {
+                archiveTail = Data(archiveTail.suffix(ZipArchiveTail.maximumSize))
+            }
+        }) { (result) in
             do
             {
-                print("Received app data!")
+                try? fileHandle.close()
                 
-                let data = try result.get()
-                                
-                guard ALTDeviceManager.shared.availableDevices.contains(where: { $0.identifier == request.udid }) else { throw ALTServerError(.deviceNotFound) }
+                try result.get()
                 
-                print("Writing app data...")
+                let digest = hasher.finalize().map { String(format: "%02x", $0) }.joined()
+                print("Received app data! SHA-256:", digest)
                 
-                let temporaryURL = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString + ".ipa")
-                try data.write(to: temporaryURL, options: .atomic)
+                guard ALTDeviceManager.shared.availableDevice(withUDID: request.udid) != nil else { throw ALTServerError(.deviceNotFound) }
+                
+                // Validate archive using the tail we already have in memory, so we can fail before unzipping anything.
+                let tail = ZipArchiveTail(data: archiveTail.suffix(ZipArchiveTail.maximumSize), archiveSize: request.contentSize)
+                if let appBundleName = try tail.appBundleName()
+                {
+                    print("Found app bundle \(appBundleName) in archive.")
+                }
                 
                 print("Wrote app to URL:", temporaryURL)
                 
@@ -208,6 +244,7 @@ private extension RequestHandler
             {
                 print("Error processing app data:", error)
                 
+                try? FileManager.default.removeItem(at: temporaryURL)
                 completionHandler(.failure(ALTServerError(error)))
             }
         }
@@ -253,3 +290,105 @@ private extension RequestHandler
         })
     }
 }
+
+// End of a ZIP archive, which is enough to read the central directory of most .ipas without touching disk.
+private struct ZipArchiveTail
+{
+    // Central directories larger than this (e.g. apps with tens of thousands of files) are skipped rather than validated.
+    static let maximumSize = 4 * 1024 * 1024
+    
+    private static let endOfCentralDirectorySignature: UInt32 = 0x06054b50
+    private static let centralDirectoryFileHeaderSignature: UInt32 = 0x02014b50
+    
+    private static let endOfCentralDirectorySize = 22
+    private static let centralDirectoryFileHeaderSize = 46
+    
+    var data: Data
+    var archiveSize: Int
+    
+    init(data: Data, archiveSize: Int)
+    {
+        self.data = Data(data) // Rebase indices to 0.
+        self.archiveSize = archiveSize
+    }
+    
+    // Returns nil if central directory can't be read from tail alone (e.g. ZIP64 archives), in which case validation is left to unzipping.
+    func appBundleName() throws -> String?
+    {
+        guard let endRecordOffset = self.endOfCentralDirectoryOffset() else { throw ALTServerError(.invalidApp) }
+        
+        let entryCount = Int(self.readInteger(UInt16.self, at: endRecordOffset + 10))
+        let directorySize = Int(self.readInteger(UInt32.self, at: endRecordOffset + 12))
+        let directoryOffset = Int(self.readInteger(UInt32.self, at: endRecordOffset + 16))
+        
+        guard entryCount != 0xFFFF, directorySize != 0xFFFFFFFF, directoryOffset != 0xFFFFFFFF else { return nil } // ZIP64
+        
+        let tailStartOffset = self.archiveSize - self.data.count
+        guard directoryOffset >= tailStartOffset else { return nil }
+        
+        var offset = directoryOffset - tailStartOffset
+        guard offset + directorySize <= endRecordOffset else { throw ALTServerError(.invalidApp) }
+        
+        for _ in 0 ..< entryCount
+        {
+            guard offset + ZipArchiveTail.centralDirectoryFileHeaderSize <= endRecordOffset,
+                  self.readInteger(UInt32.self, at: offset) == ZipArchiveTail.centralDirectoryFileHeaderSignature
+            else { throw ALTServerError(.invalidApp) }
+            
+            let nameLength = Int(self.readInteger(UInt16.self, at: offset + 28))
+            let extraFieldLength = Int(self.readInteger(UInt16.self, at: offset + 30))
+            let commentLength = Int(self.readInteger(UInt16.self, at: offset + 32))
+            
+            let nameOffset = offset + ZipArchiveTail.centralDirectoryFileHeaderSize
+            guard nameOffset + nameLength <= endRecordOffset else { throw ALTServerError(.invalidApp) }
+            
+            if let name = String(data: self.data[nameOffset ..< nameOffset + nameLength], encoding: .utf8)
+            {
+                let components = name.split(separator: "/")
+                if components.count >= 2, components[0] == "Payload", components[1].lowercased().hasSuffix(".app")
+                {
+                    return String(components[1])
+                }
+            }
+            
+            offset = nameOffset + nameLength + extraFieldLength + commentLength
+        }
+        
+        // Archive is intact, but doesn't contain an app bundle.
+        throw ALTServerError(.invalidApp)
+    }
+}
+
+private extension ZipArchiveTail
+{
+    func endOfCentralDirectoryOffset() -> Int?
+    {
+        let lastPossibleOffset = self.data.count - ZipArchiveTail.endOfCentralDirectorySize
+        guard lastPossibleOffset >= 0 else { return nil }
+        
+        // End record is followed by a comment of at most UInt16.max bytes.
+        let firstPossibleOffset = max(0, lastPossibleOffset - Int(UInt16.max))
+        
+        for offset in stride(from: lastPossibleOffset, through: firstPossibleOffset, by: -1)
+        {
+            if self.readInteger(UInt32.self, at: offset) == ZipArchiveTail.endOfCentralDirectorySignature
+            {
+                return offset
+            }
+        }
+        
+        return nil
+    }
+    
+    func readInteger<T: FixedWidthInteger>(_ type: T.Type, at offset: Int) -> T
+    {
+        // ZIP integers are little-endian and unaligned.
+        var value: T = 0
+        for index in 0 ..< MemoryLayout<T>.size
+        {
+            value |= T(self.data[offset + index]) << (index * 8)
+        }
+        
+        return value
+    }
+}
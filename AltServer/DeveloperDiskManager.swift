@@ -7,6 +7,8 @@
 //
 
 import Foundation
+import CryptoKit
+import OSLog
 
 import AltSign
 
@@ -16,6 +18,7 @@ enum DeveloperDiskErrorCode: Int, ALTErrorEnum
     case unknownDownloadURL
     case unsupportedOperatingSystem
     case downloadedDiskNotFound
+    case cachedDiskCorrupted
     
     var errorFailureReason: String {
         switch self
@@ -23,6 +26,7 @@ enum DeveloperDiskErrorCode: Int, ALTErrorEnum
         case .unknownDownloadURL: return NSLocalizedString("The URL to download the Developer disk image could not be determined.", comment: "")
         case .unsupportedOperatingSystem: return NSLocalizedString("The device's operating system does not support installing Developer disk images.", comment: "")
         case .downloadedDiskNotFound: return NSLocalizedString("DeveloperDiskImage.dmg and its signature could not be found in the downloaded archive.", comment: "")
+        case .cachedDiskCorrupted: return NSLocalizedString("The cached Developer disk image does not match its recorded hash.", comment: "")
         }
     }
 }
@@ -81,10 +85,38 @@ private extension DeveloperDiskManager
     }
 }
 
+private extension DeveloperDiskManager
+{
+    // Developer disks are stored by the SHA-256 hash of their contents, with an index mapping each OS version to its disk and signature.
+    struct CacheEntry: Codable
+    {
+        var diskHash: String
+        var signatureHash: String
+        var date: Date
+    }
+}
+
 class DeveloperDiskManager
 {
     private let session = URLSession(configuration: .ephemeral)
     
+    private var objectsDirectory: URL {
+        FileManager.default.developerDisksDirectory.appendingPathComponent("Objects", isDirectory: true)
+    }
+    
+    private var indexURL: URL {
+        FileManager.default.developerDisksDirectory.appendingPathComponent("Index.json")
+    }
+    
+    // Serializes access to cache index and verifiedHashes.
+    private let cacheQueue = DispatchQueue(label: "com.rileytestut.AltServer.DeveloperDiskManager.cache")
+    
+    // Hashes of cached files already verified since launch, so we only re-hash each file once.
+    private var verifiedHashes = Set<String>()
+    
+    // Whether disks cached in the legacy <osName>/<version>/ layout have been moved into Objects/.
+    private var didMigrateLegacyCache = false
+    
     func downloadDeveloperDisk(for device: ALTDevice, completionHandler: @escaping (Result<(URL, URL), Error>) -> Void)
     {
         do
@@ -102,18 +134,13 @@ class DeveloperDiskManager
             var osVersion = device.osVersion
             osVersion.patchVersion = 0 // Patch is irrelevant for developer disks
             
-            let osDirectoryURL = FileManager.default.developerDisksDirectory.appendingPathComponent(osName)
-            let developerDiskDirectoryURL = osDirectoryURL.appendingPathComponent(osVersion.stringValue, isDirectory: true)
-            try FileManager.default.createDirectory(at: developerDiskDirectoryURL, withIntermediateDirectories: true, attributes: nil)
-            
-            let developerDiskURL = developerDiskDirectoryURL.appendingPathComponent("DeveloperDiskImage.dmg")
-            let developerDiskSignatureURL = developerDiskDirectoryURL.appendingPathComponent("DeveloperDiskImage.dmg.signature")
+            let cacheKey = [osName, osVersion.stringValue].joined(separator: "_")
             
             let isCachedDiskCompatible = self.isDeveloperDiskCompatible(with: device)
-            if isCachedDiskCompatible && FileManager.default.fileExists(atPath: developerDiskURL.path) && FileManager.default.fileExists(atPath: developerDiskSignatureURL.path)
+            if isCachedDiskCompatible, let cachedURLs = self.cachedDeveloperDisk(forKey: cacheKey)
             {
                 // The developer disk is cached and we've confirmed it works, so re-use it.
-                return completionHandler(.success((developerDiskURL, developerDiskSignatureURL)))
+                return completionHandler(.success(cachedURLs))
             }
             
             func finish(_ result: Result<(URL, URL), Error>)
@@ -122,20 +149,8 @@ class DeveloperDiskManager
                 {
                     let (diskFileURL, signatureFileURL) = try result.get()
                     
-                    if FileManager.default.fileExists(atPath: developerDiskURL.path)
-                    {
-                        try FileManager.default.removeItem(at: developerDiskURL)
-                    }
-                    
-                    if FileManager.default.fileExists(atPath: developerDiskSignatureURL.path)
-                    {
-                        try FileManager.default.removeItem(at: developerDiskSignatureURL)
-                    }
-                    
-                    try FileManager.default.copyItem(at: diskFileURL, to: developerDiskURL)
-                    try FileManager.default.copyItem(at: signatureFileURL, to: developerDiskSignatureURL)
-                    
-                    completionHandler(.success((developerDiskURL, developerDiskSignatureURL)))
+                    let cachedURLs = try self.cacheDeveloperDisk(at: diskFileURL, signatureURL: signatureFileURL, forKey: cacheKey)
+                    completionHandler(.success(cachedURLs))
                 }
                 catch
                 {
@@ -184,6 +199,199 @@ class DeveloperDiskManager
 
 private extension DeveloperDiskManager
 {
+    func cachedDeveloperDisk(forKey key: String) -> (URL, URL)?
+    {
+        self.cacheQueue.sync {
+            self.migrateLegacyCacheIfNeeded()
+            
+            guard let entry = self.cacheIndex()[key] else { return nil }
+            
+            let diskURL = self.objectsDirectory.appendingPathComponent(entry.diskHash)
+            let signatureURL = self.objectsDirectory.appendingPathComponent(entry.signatureHash)
+            
+            do
+            {
+                try self.verifyCachedFile(at: diskURL, hash: entry.diskHash)
+                try self.verifyCachedFile(at: signatureURL, hash: entry.signatureHash)
+                
+                return (diskURL, signatureURL)
+            }
+            catch
+            {
+                Logger.main.error("Discarding cached developer disk for \(key, privacy: .public). \(error.localizedDescription, privacy: .public)")
+                
+                var index = self.cacheIndex()
+                index[key] = nil
+                self.saveCacheIndex(index)
+                
+                return nil
+            }
+        }
+    }
+    
+    func cacheDeveloperDisk(at diskFileURL: URL, signatureURL signatureFileURL: URL, forKey key: String) throws -> (URL, URL)
+    {
+        try self.cacheQueue.sync {
+            self.migrateLegacyCacheIfNeeded()
+            
+            try FileManager.default.createDirectory(at: self.objectsDirectory, withIntermediateDirectories: true, attributes: nil)
+            
+            let diskHash = try self.hashFile(at: diskFileURL)
+            let signatureHash = try self.hashFile(at: signatureFileURL)
+            
+            let diskURL = self.objectsDirectory.appendingPathComponent(diskHash)
+            let signatureURL = self.objectsDirectory.appendingPathComponent(signatureHash)
+            
+            // Identical disks may be shared by several OS versions, so only store each once.
+            // Downloaded files are always temporary, so move them rather than copying.
+            for (sourceURL, destinationURL) in [(diskFileURL, diskURL), (signatureFileURL, signatureURL)] where !FileManager.default.fileExists(atPath: destinationURL.path)
+            {
+                try FileManager.default.moveItem(at: sourceURL, to: destinationURL)
+            }
+            
+            self.verifiedHashes.insert(diskHash)
+            self.verifiedHashes.insert(signatureHash)
+            
+            var index = self.cacheIndex()
+            index[key] = CacheEntry(diskHash: diskHash, signatureHash: signatureHash, date: Date())
+            self.saveCacheIndex(index)
+            
+            self.removeUnreferencedCachedFiles(index: index)
+            
+            return (diskURL, signatureURL)
+        }
+    }
+    
+    // Previous versions cached disks at <osName>/<version>/DeveloperDiskImage.dmg(.signature).
+    // Move any such disks into Objects/ so they remain usable, then remove the old directories.
+    func migrateLegacyCacheIfNeeded()
+    {
+        guard !self.didMigrateLegacyCache else { return }
+        self.didMigrateLegacyCache = true
+        
+        let legacyOSNames = [ALTDeviceType.iphone, ALTDeviceType.appletv].compactMap { $0.osName }
+        
+        var index = self.cacheIndex()
+        var didMigrateDisks = false
+        
+        for osName in legacyOSNames
+        {
+            let osDirectoryURL = FileManager.default.developerDisksDirectory.appendingPathComponent(osName, isDirectory: true)
+            guard let versionDirectoryURLs = try? FileManager.default.contentsOfDirectory(at: osDirectoryURL, includingPropertiesForKeys: nil, options: [.skipsHiddenFiles]) else { continue }
+            
+            for versionDirectoryURL in versionDirectoryURLs
+            {
+                let key = [osName, versionDirectoryURL.lastPathComponent].joined(separator: "_")
+                
+                let diskFileURL = versionDirectoryURL.appendingPathComponent("DeveloperDiskImage.dmg")
+                let signatureFileURL = versionDirectoryURL.appendingPathComponent("DeveloperDiskImage.dmg.signature")
+                
+                guard index[key] == nil, FileManager.default.fileExists(atPath: diskFileURL.path), FileManager.default.fileExists(atPath: signatureFileURL.path) else { continue }
+                
+                do
+                {
+                    try FileManager.default.createDirectory(at: self.objectsDirectory, withIntermediateDirectories: true, attributes: nil)
+                    
+                    let diskHash = try self.hashFile(at: diskFileURL)
+                    let signatureHash = try self.hashFile(at: signatureFileURL)
+                    
+                    for (sourceURL, hash) in [(diskFileURL, diskHash), (signatureFileURL, signatureHash)]
+                    {
+                        let destinationURL = self.objectsDirectory.appendingPathComponent(hash)
+                        guard !FileManager.default.fileExists(atPath: destinationURL.path) else { continue }
+                        
+                        try FileManager.default.moveItem(at: sourceURL, to: destinationURL)
+                    }
+                    
+                    self.verifiedHashes.insert(diskHash)
+                    self.verifiedHashes.insert(signatureHash)
+                    
+                    index[key] = CacheEntry(diskHash: diskHash, signatureHash: signatureHash, date: Date())
+                    didMigrateDisks = true
+                }
+                catch
+                {
+                    Logger.main.error("Failed to migrate cached developer disk for \(key, privacy: .public). \(error.localizedDescription, privacy: .public)")
+                }
+            }
+            
+            // Remove legacy directory regardless of whether its contents were migrated, since nothing reads from it anymore.
+            do
+            {
+                try FileManager.default.removeItem(at: osDirectoryURL)
+            }
+            catch
+            {
+                Logger.main.error("Failed to remove legacy developer disk directory \(osDirectoryURL.lastPathComponent, privacy: .public). \(error.localizedDescription, privacy: .public)")
+            }
+        }
+        
+        if didMigrateDisks
+        {
+            self.saveCacheIndex(index)
+        }
+    }
+    
+    func cacheIndex() -> [String: CacheEntry]
+    {
+        guard let data = try? Data(contentsOf: self.indexURL) else { return [:] }
+        
+        do
+        {
+            let index = try Foundation.JSONDecoder().decode([String: CacheEntry].self, from: data)
+            return index
+        }
+        catch
+        {
+            Logger.main.error("Failed to decode developer disk cache index. \(error.localizedDescription, privacy: .public)")
+            return [:]
+        }
+    }
+    
+    func saveCacheIndex(_ index: [String: CacheEntry])
+    {
+        do
+        {
+            let data = try Foundation.JSONEncoder().encode(index)
+            try data.write(to: self.indexURL, options: .atomic)
+        }
+        catch
+        {
+            Logger.main.error("Failed to save developer disk cache index. \(error.localizedDescription, privacy: .public)")
+        }
+    }
+    
+    func verifyCachedFile(at fileURL: URL, hash: String) throws
+    {
+        guard !self.verifiedHashes.contains(hash) else { return }
+        
+        let actualHash = try self.hashFile(at: fileURL)
+        guard actualHash == hash else { throw DeveloperDiskError(.cachedDiskCorrupted) }
+        
+        self.verifiedHashes.insert(hash)
+    }
+    
+    func hashFile(at fileURL: URL) throws -> String
+    {
+        // Map file so we don't read entire disk into memory just to hash it.
+        let data = try Data(contentsOf: fileURL, options: .alwaysMapped)
+        
+        let digest = SHA256.hash(data: data)
+        let hash = digest.map { String(format: "%02x", $0) }.joined()
+        return hash
+    }
+    
+    func removeUnreferencedCachedFiles(index: [String: CacheEntry])
+    {
+        let referencedHashes = Set(index.values.flatMap { [$0.diskHash, $0.signatureHash] })
+        
+        guard let fileURLs = try? FileManager.default.contentsOfDirectory(at: self.objectsDirectory, includingPropertiesForKeys: nil, options: [.skipsHiddenFiles]) else { return }
+        for fileURL in fileURLs where !referencedHashes.contains(fileURL.lastPathComponent)
+        {
+            try? FileManager.default.removeItem(at: fileURL)
+        }
+    }
+    
     func developerDiskCompatibilityID(for device: ALTDevice) -> String?
     {
         guard let osName = device.type.osName else { return nil }
@@ -215,6 +423,61 @@ private extension DeveloperDiskManager
     }
     
     func downloadDiskArchive(from url: URL, completionHandler: @escaping (Result<(URL, URL), Error>) -> Void)
+    {
+        Task<Void, Never> {
+            let stagingDirectory = self.makeStagingDirectoryURL()
+            defer { try? FileManager.default.removeItem(at: stagingDirectory) }
+            
+            do
+            {
+                try FileManager.default.createDirectory(at: stagingDirectory, withIntermediateDirectories: true, attributes: nil)
+                
+                let fileURLs = try await self.extractDisk(fromRemoteArchiveAt: url, to: stagingDirectory)
+                completionHandler(.success(fileURLs))
+            }
+            catch let error as RemoteZipError where error.code == .rangeRequestsUnsupported
+            {
+                Logger.main.info("Server does not support range requests, downloading entire developer disk archive instead.")
+                self.downloadEntireDiskArchive(from: url, completionHandler: completionHandler)
+            }
+            catch
+            {
+                completionHandler(.failure(error))
+            }
+        }
+    }
+    
+    func extractDisk(fromRemoteArchiveAt url: URL, to directoryURL: URL) async throws -> (URL, URL)
+    {
+        let startDate = Date()
+        
+        // Only downloads central directory and the two entries we need, streaming them straight to disk.
+        let archive = RemoteZipArchive(url: url)
+        try await archive.open()
+        
+        let entries = archive.entries.values.filter { (entry) in
+            let filename = (entry.path as NSString).lastPathComponent
+            return !entry.path.hasSuffix("/") && !entry.path.contains("__MACOSX") && !filename.hasPrefix(".")
+        }
+        
+        guard let diskEntry = entries.first(where: { ($0.path as NSString).pathExtension.lowercased() == "dmg" }),
+              let signatureEntry = entries.first(where: { ($0.path as NSString).pathExtension.lowercased() == "signature" })
+        else { throw DeveloperDiskError(.downloadedDiskNotFound) }
+        
+        let diskFileURL = directoryURL.appendingPathComponent("DeveloperDiskImage.dmg")
+        let signatureFileURL = directoryURL.appendingPathComponent("DeveloperDiskImage.dmg.signature")
+        
+        async let extractDisk: Void = archive.extract(diskEntry, to: diskFileURL)
+        async let extractSignature: Void = archive.extract(signatureEntry, to: signatureFileURL)
+        _ = try await (extractDisk, extractSignature)
+        
+        let downloadedSize = diskEntry.compressedSize + signatureEntry.compressedSize
+        Logger.main.info("Extracted developer disk from remote archive in \(Date().timeIntervalSince(startDate), format: .fixed(precision: 2))s. Downloaded \(downloadedSize) of \(archive.size) bytes.")
+        
+        return (diskFileURL, signatureFileURL)
+    }
+    
+    func downloadEntireDiskArchive(from url: URL, completionHandler: @escaping (Result<(URL, URL), Error>) -> Void)
     {
         let downloadTask = URLSession.shared.downloadTask(with: url) { (fileURL, response, error) in
             do
@@ -260,69 +523,52 @@ private extension DeveloperDiskManager
     
     func downloadDisk(from diskURL: URL, signatureURL: URL, completionHandler: @escaping (Result<(URL, URL), Error>) -> Void)
     {
-        let temporaryDirectory = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
-        
-        do { try FileManager.default.createDirectory(at: temporaryDirectory, withIntermediateDirectories: true, attributes: nil) }
-        catch { return completionHandler(.failure(error)) }
-                
-        var diskFileURL: URL?
-        var signatureFileURL: URL?
-        
-        var downloadError: Error?
-        
-        let dispatchGroup = DispatchGroup()
-        dispatchGroup.enter()
-        dispatchGroup.enter()
-                
-        let diskDownloadTask = URLSession.shared.downloadTask(with: diskURL) { (fileURL, response, error) in
-            do
-            {
-                guard let fileURL = fileURL else { throw error! }
-                
-                let destinationURL = temporaryDirectory.appendingPathComponent("DeveloperDiskImage.dmg")
-                try FileManager.default.copyItem(at: fileURL, to: destinationURL)
-                
-                diskFileURL = destinationURL
-            }
-            catch
-            {
-                downloadError = error
-            }
+        Task<Void, Never> {
+            let stagingDirectory = self.makeStagingDirectoryURL()
+            defer { try? FileManager.default.removeItem(at: stagingDirectory) }
             
-            dispatchGroup.leave()
-        }
-        
-        let signatureDownloadTask = URLSession.shared.downloadTask(with: signatureURL) { (fileURL, response, error) in
             do
             {
-                guard let fileURL = fileURL else { throw error! }
+                try FileManager.default.createDirectory(at: stagingDirectory, withIntermediateDirectories: true, attributes: nil)
                 
-                let destinationURL = temporaryDirectory.appendingPathComponent("DeveloperDiskImage.dmg.signature")
-                try FileManager.default.copyItem(at: fileURL, to: destinationURL)
+                async let diskFileURL = self.downloadFile(from: diskURL, to: stagingDirectory.appendingPathComponent("DeveloperDiskImage.dmg"))
+                async let signatureFileURL = self.downloadFile(from: signatureURL, to: stagingDirectory.appendingPathComponent("DeveloperDiskImage.dmg.signature"))
                 
-                signatureFileURL = destinationURL
+                let fileURLs = try await (diskFileURL, signatureFileURL)
+                completionHandler(.success(fileURLs))
             }
             catch
             {
-                downloadError = error
+                completionHandler(.failure(error))
             }
-            
-            dispatchGroup.leave()
         }
-        
-        diskDownloadTask.resume()
-        signatureDownloadTask.resume()
-        
-        dispatchGroup.notify(queue: .global(qos: .userInitiated)) {
-            defer {
-                try? FileManager.default.removeItem(at: temporaryDirectory)
-            }
-            
-            guard let diskFileURL = diskFileURL, let signatureFileURL = signatureFileURL else {
-                return completionHandler(.failure(downloadError ?? DeveloperDiskError(.downloadedDiskNotFound)))
+    }
+    
+    func downloadFile(from url: URL, to destinationURL: URL) async throws -> URL
+    {
+        try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<URL, Error>) in
+            let downloadTask = URLSession.shared.downloadTask(with: url) { (fileURL, response, error) in
+                do
+                {
+                    guard let fileURL = fileURL else { throw error! }
+                    
+                    try FileManager.default.moveItem(at: fileURL, to: destinationURL)
+                    continuation.resume(returning: destinationURL)
+                }
+                catch
+                {
+                    continuation.resume(throwing: error)
+                }
             }
             
-            completionHandler(.success((diskFileURL, signatureFileURL)))
+            downloadTask.resume()
         }
     }
+    
+    // Staged inside developer disks directory so cached files can be moved (rather than copied) into place.
+    func makeStagingDirectoryURL() -> URL
+    {
+        let stagingDirectory = FileManager.default.developerDisksDirectory.appendingPathComponent("Staging", isDirectory: true).appendingPathComponent(UUID().uuidString, isDirectory: true)
+        return stagingDirectory
+    }
 }
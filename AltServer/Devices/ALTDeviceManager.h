@@ -29,6 +29,8 @@ extern NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification
 
 - (void)start;
 
+- (nullable ALTDevice *)availableDeviceWithUDID:(NSString *)udid;
+
 /* App Installation */
 - (NSProgress *)installAppAtURL:(NSURL *)fileURL toDeviceWithUDID:(NSString *)udid activeProvisioningProfiles:(nullable NSSet<NSString *> *)activeProvisioningProfiles completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
 - (void)removeAppForBundleIdentifier:(NSString *)bundleIdentifier fromDeviceWithUDID:(NSString *)udid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
@@ -40,8 +42,8 @@ extern NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification
 /* Developer Disk Image */
 - (void)isDeveloperDiskImageMountedForDevice:(ALTDevice *)device
                            completionHandler:(void (^)(BOOL isMounted, NSError *_Nullable error))completionHandler;
-- (void)installDeveloperDiskImageAtURL:(NSURL *)diskURL signatureURL:(NSURL *)signatureURL toDevice:(ALTDevice *)device
-                     completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
+- (NSProgress *)installDeveloperDiskImageAtURL:(NSURL *)diskURL signatureURL:(NSURL *)signatureURL toDevice:(ALTDevice *)device
+                              completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
 
 /* Apps */
 - (void)fetchInstalledAppsOnDevice:(ALTDevice *)altDevice completionHandler:(void (^)(NSSet<ALTInstalledApp *> *_Nullable installedApps, NSError *_Nullable error))completionHandler;
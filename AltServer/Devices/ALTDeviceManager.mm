@@ -11,12 +11,15 @@
 #import "ALTWiredConnection+Private.h"
 #import "ALTNotificationConnection+Private.h"
 #import "ALTDebugConnection+Private.h"
+#import "ALTDeviceSession.h"
+#import "ALTDeviceOperationScheduler.h"
 
 #import "ALTConstants.h"
 #import "NSError+ALTServerError.h"
 #import "NSError+libimobiledevice.h"
 
 #import <AppKit/AppKit.h>
+#import <CommonCrypto/CommonDigest.h>
 #import <UserNotifications/UserNotifications.h>
 #import "AltServer-Swift.h"
 
@@ -28,14 +31,55 @@
 #include <libimobiledevice/misagent.h>
 #include <libimobiledevice/mobile_image_mounter.h>
 
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
 void ALTDeviceManagerUpdateStatus(plist_t command, plist_t status, void *udid);
 void ALTDeviceManagerUpdateAppDeletionStatus(plist_t command, plist_t status, void *uuid);
+void ALTDeviceManagerUpdateBrowseStatus(plist_t command, plist_t status, void *statusHandler);
 void ALTDeviceDidChangeConnectionStatus(const idevice_event_t *event, void *user_data);
-ssize_t ALTDeviceManagerUploadFile(void *buffer, size_t size, void *user_data);
+ssize_t ALTDeviceManagerUploadMappedFile(void *buffer, size_t size, void *user_data);
+NSString *_Nullable ALTProvisioningProfileUUIDStringFromData(NSData *data);
 
 NSNotificationName const ALTDeviceManagerDeviceDidConnectNotification = @"ALTDeviceManagerDeviceDidConnectNotification";
 NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALTDeviceManagerDeviceDidDisconnectNotification";
 
+// State for streaming a memory-mapped file to mobile_image_mounter.
+struct ALTDeviceManagerMappedFileUpload
+{
+    const char *bytes;
+    size_t length;
+    size_t offset;
+    
+    __unsafe_unretained NSProgress *progress;
+};
+
+// Cached installed apps are refetched after this many seconds, in case they were changed outside AltServer.
+static const NSTimeInterval ALTDeviceManagerInstalledAppsCacheLifetime = 60.0;
+
+// Files are uploaded in chunks of this size (double-buffered), so peak memory usage doesn't depend on file size.
+static const size_t ALTDeviceManagerUploadChunkSize = 1024 * 1024;
+
+typedef struct ALTFileTransferItem
+{
+    NSURL *fileURL;
+    NSURL *destinationURL;
+    NSString *relativePath;
+    off_t size;
+    NSData *sha256Hash;
+} ALTFileTransferItem;
+
+// Staging manifests record which files were last uploaded to each device, so unchanged files can be skipped when reinstalling.
+static NSString *const ALTStagingManifestIDKey = @"StagingID";
+static NSString *const ALTStagingManifestFilesKey = @"Files";
+static NSString *const ALTStagingManifestSizeKey = @"Size";
+static NSString *const ALTStagingManifestSHA256Key = @"SHA256";
+
 @interface ALTDeviceManager ()
 
 @property (nonatomic, readonly) NSMutableDictionary<NSUUID *, void (^)(NSError *)> *installationCompletionHandlers;
@@ -43,10 +87,25 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
 
 @property (nonatomic, readonly) NSMutableDictionary<NSUUID *, NSProgress *> *installationProgress;
 
-@property (nonatomic, readonly) dispatch_queue_t installationQueue;
+@property (nonatomic, readonly) ALTDeviceOperationScheduler *installationScheduler;
 @property (nonatomic, readonly) dispatch_queue_t devicesQueue;
 
-@property (nonatomic, readonly) NSMutableSet<ALTDevice *> *cachedDevices;
+@property (nonatomic, readonly) ALTDeviceSessionPool *sessionPool;
+
+// Parsed provisioning profiles, keyed by lowercase UUID.
+@property (nonatomic, readonly) NSCache<NSString *, ALTProvisioningProfile *> *provisioningProfileCache;
+
+// Installed AltStore apps, keyed by UDID. Synchronize access with @synchronized(installedAppsCache).
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, NSSet<ALTInstalledApp *> *> *installedAppsCache;
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, NSDate *> *installedAppsCacheDates;
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, NSNumber *> *installedAppsCacheGenerations;
+
+// Device registry, kept up to date by idevice connection events. Only access on registryQueue.
+@property (nonatomic, readonly) dispatch_queue_t registryQueue;
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, ALTDevice *> *cachedDevices;
+@property (nonatomic, readonly) NSMutableSet<NSString *> *usbDeviceUDIDs;
+@property (nonatomic, readonly) NSMutableSet<NSString *> *networkDeviceUDIDs;
+@property (nonatomic) BOOL didLoadDeviceUDIDs;
 
 @end
 
@@ -73,10 +132,21 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
         
         _installationProgress = [NSMutableDictionary dictionary];
         
-        _installationQueue = dispatch_queue_create("com.rileytestut.AltServer.Installation", DISPATCH_QUEUE_SERIAL);
+        _installationScheduler = [[ALTDeviceOperationScheduler alloc] initWithMaximumConcurrentOperationCount:[[NSUserDefaults standardUserDefaults] maximumConcurrentInstallationCount]];
         _devicesQueue = dispatch_queue_create("com.rileytestut.AltServer.Devices", DISPATCH_QUEUE_CONCURRENT_WITH_AUTORELEASE_POOL);
         
-        _cachedDevices = [NSMutableSet set];
+        _sessionPool = [[ALTDeviceSessionPool alloc] init];
+        
+        _provisioningProfileCache = [[NSCache alloc] init];
+        
+        _installedAppsCache = [NSMutableDictionary dictionary];
+        _installedAppsCacheDates = [NSMutableDictionary dictionary];
+        _installedAppsCacheGenerations = [NSMutableDictionary dictionary];
+        
+        _registryQueue = dispatch_queue_create("com.rileytestut.AltServer.DeviceRegistry", DISPATCH_QUEUE_SERIAL);
+        _cachedDevices = [NSMutableDictionary dictionary];
+        _usbDeviceUDIDs = [NSMutableSet set];
+        _networkDeviceUDIDs = [NSMutableSet set];
     }
     
     return self;
@@ -93,18 +163,16 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
 {
     NSProgress *progress = [NSProgress discreteProgressWithTotalUnitCount:4];
     
-    dispatch_async(self.installationQueue, ^{
+    [self.installationScheduler scheduleOperationForDeviceWithUDID:udid usingBlock:^(dispatch_block_t operationDidFinish) {
         NSUUID *UUID = [NSUUID UUID];
         __block char *uuidString = (char *)malloc(UUID.UUIDString.length + 1);
         strncpy(uuidString, (const char *)UUID.UUIDString.UTF8String, UUID.UUIDString.length);
         uuidString[UUID.UUIDString.length] = '\0';
         
-        __block idevice_t device = NULL;
-        __block lockdownd_client_t client = NULL;
+        __block ALTDeviceSession *session = nil;
         __block instproxy_client_t ipc = NULL;
         __block afc_client_t afc = NULL;
         __block misagent_client_t mis = NULL;
-        __block lockdownd_service_descriptor_t service = NULL;
         
         NSMutableDictionary<NSString *, ALTProvisioningProfile *> *cachedProfiles = [NSMutableDictionary dictionary];
         NSMutableSet<ALTProvisioningProfile *> *installedProfiles = [NSMutableSet set];
@@ -173,12 +241,20 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
                 }
             }];
             
-            instproxy_client_free(ipc);
-            afc_client_free(afc);
-            lockdownd_client_free(client);
-            misagent_client_free(mis);
-            idevice_free(device);
-            lockdownd_service_descriptor_free(service);
+            [self invalidateInstalledAppsCacheForDeviceWithUDID:udid];
+            
+            if (session != nil)
+            {
+                if (error != nil)
+                {
+                    // Don't reuse session after failure, since we can't tell whether connection is still in a consistent state.
+                    [self.sessionPool invalidateSession:session];
+                }
+                else
+                {
+                    [self.sessionPool checkInSession:session];
+                }
+            }
             
             free(uuidString);
             uuidString = NULL;
@@ -191,6 +267,8 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
             {
                 completionHandler(YES, nil);
             }
+            
+            operationDidFinish();
         };
         
         NSURL *appBundleURL = nil;
@@ -238,58 +316,34 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
             }
         }
         
-        /* Find Device */
-        if (idevice_new_with_options(&device, udid.UTF8String, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX)) != IDEVICE_E_SUCCESS)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorDeviceNotFound userInfo:nil]);
-        }
-        
         /* Connect to Device */
-        if (lockdownd_client_new_with_handshake(device, &client, "altserver") != LOCKDOWN_E_SUCCESS)
+        NSError *sessionError = nil;
+        session = [self.sessionPool checkOutSessionForDeviceWithUDID:udid error:&sessionError];
+        if (session == nil)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
         
         /* Connect to Installation Proxy */
-        if ((lockdownd_start_service(client, "com.apple.mobile.installation_proxy", &service) != LOCKDOWN_E_SUCCESS) || service == NULL)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
-        }
-        
-        if (instproxy_client_new(device, service, &ipc) != INSTPROXY_E_SUCCESS)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
-        }
-        
-        if (service)
+        ipc = [session installationProxyClientWithError:&sessionError];
+        if (ipc == NULL)
         {
-            lockdownd_service_descriptor_free(service);
-            service = NULL;
+            return finish(sessionError);
         }
         
-        
         /* Connect to Misagent */
         // Must connect now, since if we take too long writing files to device, connecting may fail later when managing profiles.
-        if (lockdownd_start_service(client, "com.apple.misagent", &service) != LOCKDOWN_E_SUCCESS || service == NULL)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
-        }
-        
-        if (misagent_client_new(device, service, &mis) != MISAGENT_E_SUCCESS)
+        mis = [session misagentClientWithError:&sessionError];
+        if (mis == NULL)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
         
-        
         /* Connect to AFC service */
-        if ((lockdownd_start_service(client, "com.apple.afc", &service) != LOCKDOWN_E_SUCCESS) || service == NULL)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
-        }
-        
-        if (afc_client_new(device, service, &afc) != AFC_E_SUCCESS)
+        afc = [session afcClientWithError:&sessionError];
+        if (afc == NULL)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
         
         NSURL *stagingURL = [NSURL fileURLWithPath:@"PublicStaging" isDirectory:YES];
@@ -328,7 +382,11 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
         [progress becomeCurrentWithPendingUnitCount:3];
         
         NSError *writeError = nil;
-        if (![self writeDirectory:appBundleURL toDestinationURL:destinationURL client:afc progress:nil error:&writeError])
+        BOOL didWriteApp = [self writeDirectory:appBundleURL toDestinationURL:destinationURL device:session.device deviceUDID:udid lockdownClient:session.lockdownClient afc:afc error:&writeError];
+        
+        [progress resignCurrent];
+        
+        if (!didWriteApp)
         {
             int removeResult = afc_remove_path_and_contents(afc, stagingURL.relativePath.fileSystemRepresentation);
             NSLog(@"Remove staging app result: %@", @(removeResult));
@@ -338,17 +396,24 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
         
         NSLog(@"Finished writing to device.");
         
-        if (service)
+        if (activeProvisioningProfiles != nil)
         {
-            lockdownd_service_descriptor_free(service);
-            service = NULL;
+            // Sync profiles to app's profiles + active profiles before installing, so we're already under sideloaded app limit
+            // and only profiles that actually differ from the desired set are removed or installed.
+            // Any of app's profiles that aren't active are removed again once installation finishes.
+            
+            NSError *error = nil;
+            if (![self syncProvisioningProfiles:installedProfiles activeProvisioningProfiles:activeProvisioningProfiles misagent:mis error:&error])
+            {
+                return finish(error);
+            }
         }
-        
-        BOOL shouldManageProfiles = (activeProvisioningProfiles != nil || [application.provisioningProfile isFreeProvisioningProfile]);
-        if (shouldManageProfiles)
+        else if ([application.provisioningProfile isFreeProvisioningProfile])
         {
-            // Free developer account was used to sign this app, so we need to remove all
-            // provisioning profiles in order to remain under sideloaded app limit.
+            // Free developer account was used to sign this app, but we don't know which profiles are active.
+            // Without that we can't tell which profiles are safe to drop, so remove all free profiles to remain under
+            // sideloaded app limit during installation, then reinstall them afterwards. A sync can't express this
+            // temporary removal, so older clients that don't send active profiles still take this path.
             
             NSError *error = nil;
             NSDictionary<NSString *, ALTProvisioningProfile *> *removedProfiles = [self removeAllFreeProfilesExcludingBundleIdentifiers:nil misagent:mis error:&error];
@@ -357,411 +422,924 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
                 return finish(error);
             }
             
-            [removedProfiles enumerateKeysAndObjectsUsingBlock:^(NSString *bundleID, ALTProvisioningProfile *profile, BOOL * _Nonnull stop) {
-                if (activeProvisioningProfiles != nil)
+            // Cache all profiles to reinstall afterwards.
+            [cachedProfiles addEntriesFromDictionary:removedProfiles];
+        }
+        
+        NSProgress *installationProgress = [NSProgress progressWithTotalUnitCount:100 parent:progress pendingUnitCount:1];
+        
+        // Installations to other devices may be in progress, so synchronize access with instproxy callbacks.
+        @synchronized(self)
+        {
+            self.installationProgress[UUID] = installationProgress;
+            self.installationCompletionHandlers[UUID] = ^(NSError *error) {
+                finish(error);
+                
+                if (temporaryDirectoryURL != nil)
                 {
-                    if ([activeProvisioningProfiles containsObject:bundleID])
+                    NSError *error = nil;
+                    if (![[NSFileManager defaultManager] removeItemAtURL:temporaryDirectoryURL error:&error])
                     {
-                        // Only cache active profiles to reinstall afterwards.
-                        cachedProfiles[bundleID] = profile;
+                        NSLog(@"Error removing temporary directory. %@", error);
                     }
                 }
-                else
-                {
-                    // Cache all profiles to reinstall afterwards if we didn't provide activeProvisioningProfiles.
-                    cachedProfiles[bundleID] = profile;
-                }
-            }];
+            };
         }
         
-        lockdownd_client_free(client);
-        client = NULL;
-        
-        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        NSLog(@"Installing to device %@...", udid);
         
-        NSProgress *installationProgress = [NSProgress progressWithTotalUnitCount:100 parent:progress pendingUnitCount:1];
+        // Don't block while installing, so operations for other devices can continue. finish() will start the next operation for this device.
+        instproxy_error_t installError = instproxy_install(ipc, destinationURL.relativePath.fileSystemRepresentation, options, ALTDeviceManagerUpdateStatus, uuidString);
+        instproxy_client_options_free(options);
         
-        self.installationProgress[UUID] = installationProgress;
-        self.installationCompletionHandlers[UUID] = ^(NSError *error) {
-            finish(error);
+        if (installError != INSTPROXY_E_SUCCESS)
+        {
+            // Status callback will never be called, so finish manually.
+            void (^completionHandler)(NSError *) = nil;
             
-            if (temporaryDirectoryURL != nil)
+            @synchronized(self)
             {
-                NSError *error = nil;
-                if (![[NSFileManager defaultManager] removeItemAtURL:temporaryDirectoryURL error:&error])
-                {
-                    NSLog(@"Error removing temporary directory. %@", error);
-                }
+                completionHandler = self.installationCompletionHandlers[UUID];
+                self.installationCompletionHandlers[UUID] = nil;
+                self.installationProgress[UUID] = nil;
             }
             
-            dispatch_semaphore_signal(semaphore);
-        };
-        
-        NSLog(@"Installing to device %@...", udid);
-        
-        instproxy_install(ipc, destinationURL.relativePath.fileSystemRepresentation, options, ALTDeviceManagerUpdateStatus, uuidString);
-        instproxy_client_options_free(options);
-        
-        dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
-    });
+            NSError *error = [NSError errorWithInstallationProxyError:installError device:nil] ?: [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorInstallationFailed userInfo:nil];
+            completionHandler(error);
+        }
+    }];
         
     return progress;
 }
 
-- (BOOL)writeDirectory:(NSURL *)directoryURL toDestinationURL:(NSURL *)destinationURL client:(afc_client_t)afc progress:(NSProgress *)progress error:(NSError **)error
+- (BOOL)writeDirectory:(NSURL *)directoryURL toDestinationURL:(NSURL *)destinationURL device:(idevice_t)device deviceUDID:(NSString *)udid lockdownClient:(lockdownd_client_t)client afc:(afc_client_t)afc error:(NSError **)error
 {
-    afc_make_directory(afc, destinationURL.relativePath.fileSystemRepresentation);
+    /* Gather Files */
+    NSMutableArray<NSURL *> *destinationDirectoryURLs = [NSMutableArray arrayWithObject:destinationURL];
+    std::vector<ALTFileTransferItem> items;
     
-    if (progress == nil)
+    if (![self gatherFileTransferItemsInDirectory:directoryURL destinationURL:destinationURL relativePath:@"" directories:destinationDirectoryURLs items:items error:error])
     {
-        NSDirectoryEnumerator *countEnumerator = [[NSFileManager defaultManager] enumeratorAtURL:directoryURL
-                                                                      includingPropertiesForKeys:@[]
-                                                                                         options:0
-                                                                                    errorHandler:^BOOL(NSURL * _Nonnull url, NSError * _Nonnull error) {
-                                                                                        if (error) {
-                                                                                            NSLog(@"[Error] %@ (%@)", error, url);
-                                                                                            return NO;
-                                                                                        }
-                                                                                        
-                                                                                        return YES;
-                                                                                    }];
+        return NO;
+    }
+    
+    // Hash files concurrently, since most of the cost is waiting on disk reads.
+    __block NSError *hashError = nil;
+    NSObject *hashErrorLock = [[NSObject alloc] init];
+    
+    ALTFileTransferItem *itemsBuffer = items.data();
+    dispatch_apply(items.size(), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^(size_t index) {
+        NSError *error = nil;
+        itemsBuffer[index].sha256Hash = [self sha256HashOfFileAtURL:itemsBuffer[index].fileURL error:&error];
         
-        NSInteger totalCount = 0;
-        for (NSURL *__unused fileURL in countEnumerator)
+        if (itemsBuffer[index].sha256Hash == nil)
+        {
+            @synchronized(hashErrorLock)
+            {
+                hashError = hashError ?: error;
+            }
+        }
+    });
+    
+    if (hashError != nil)
+    {
+        if (error)
         {
-            totalCount++;
+            *error = hashError;
         }
         
-        progress = [NSProgress progressWithTotalUnitCount:totalCount];
+        return NO;
     }
     
-    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtURL:directoryURL
-                                                             includingPropertiesForKeys:@[NSURLIsDirectoryKey]
-                                                                                options:NSDirectoryEnumerationSkipsSubdirectoryDescendants
-                                                                           errorHandler:^BOOL(NSURL * _Nonnull url, NSError * _Nonnull error) {
-                                                                               if (error) {
-                                                                                   NSLog(@"[Error] %@ (%@)", error, url);
-                                                                                   return NO;
-                                                                               }
-                                                                               
-                                                                               return YES;
-                                                                           }];
+    /* Compare With Previous Upload */
+    NSURL *manifestURL = [self stagingManifestURLForDestinationURL:destinationURL deviceUDID:udid];
+    NSURL *markerURL = [self stagingMarkerURLForDestinationURL:destinationURL];
     
-    for (NSURL *fileURL in enumerator)
+    NSDictionary<NSString *, NSDictionary *> *stagedFiles = [self stagedFilesAtDestinationURL:destinationURL manifestURL:manifestURL markerURL:markerURL afc:afc];
+    
+    // Invalidate staged files before modifying them, so an interrupted upload is never mistaken for a complete one.
+    afc_remove_path(afc, markerURL.relativePath.fileSystemRepresentation);
+    [[NSFileManager defaultManager] removeItemAtURL:manifestURL error:nil];
+    
+    std::vector<ALTFileTransferItem> allItems = items;
+    
+    if (stagedFiles != nil)
     {
-        NSNumber *isDirectory = nil;
-        if (![fileURL getResourceValue:&isDirectory forKey:NSURLIsDirectoryKey error:error])
+        NSMutableSet<NSString *> *removedPaths = [NSMutableSet setWithArray:stagedFiles.allKeys];
+        for (const ALTFileTransferItem &item : allItems)
         {
-            return NO;
+            [removedPaths removeObject:item.relativePath];
         }
         
-        if ([isDirectory boolValue])
+        NSMutableSet<NSString *> *directoryPaths = [NSMutableSet set];
+        for (NSURL *destinationDirectoryURL in destinationDirectoryURLs)
         {
-            NSURL *destinationDirectoryURL = [destinationURL URLByAppendingPathComponent:fileURL.lastPathComponent isDirectory:YES];
-            if (![self writeDirectory:fileURL toDestinationURL:destinationDirectoryURL client:afc progress:progress error:error])
-            {
-                return NO;
-            }
+            NSArray<NSString *> *pathComponents = destinationDirectoryURL.pathComponents;
+            NSArray<NSString *> *relativePathComponents = [pathComponents subarrayWithRange:NSMakeRange(destinationURL.pathComponents.count, pathComponents.count - destinationURL.pathComponents.count)];
+            [directoryPaths addObject:[NSString pathWithComponents:relativePathComponents]];
         }
-        else
+        
+        for (NSString *relativePath in removedPaths)
         {
-            NSURL *destinationFileURL = [destinationURL URLByAppendingPathComponent:fileURL.lastPathComponent isDirectory:NO];
-            if (![self writeFile:fileURL toDestinationURL:destinationFileURL progress:progress client:afc error:error])
+            // If the file's directory no longer exists (e.g. a removed framework), remove the whole directory instead.
+            NSString *removedPath = relativePath;
+            
+            NSArray<NSString *> *pathComponents = relativePath.pathComponents;
+            for (NSUInteger count = 1; count < pathComponents.count; count++)
             {
-                return NO;
+                NSString *parentPath = [NSString pathWithComponents:[pathComponents subarrayWithRange:NSMakeRange(0, count)]];
+                if (![directoryPaths containsObject:parentPath])
+                {
+                    removedPath = parentPath;
+                    break;
+                }
             }
+            
+            NSURL *removedURL = [destinationURL URLByAppendingPathComponent:removedPath];
+            afc_remove_path_and_contents(afc, removedURL.relativePath.fileSystemRepresentation);
         }
         
-        progress.completedUnitCount += 1;
+        items.erase(std::remove_if(items.begin(), items.end(), [stagedFiles](const ALTFileTransferItem &item) {
+            NSDictionary *stagedFile = stagedFiles[item.relativePath];
+            
+            NSNumber *stagedSize = stagedFile[ALTStagingManifestSizeKey];
+            NSData *stagedHash = stagedFile[ALTStagingManifestSHA256Key];
+            
+            BOOL isUnchanged = ([stagedSize isKindOfClass:[NSNumber class]] && stagedSize.longLongValue == item.size &&
+                                [stagedHash isKindOfClass:[NSData class]] && [stagedHash isEqualToData:item.sha256Hash]);
+            return (bool)isUnchanged;
+        }), items.end());
+        
+        NSLog(@"Reusing %@ staged files, uploading %@ changed files and removing %@ stale files.", @(allItems.size() - items.size()), @(items.size()), @(removedPaths.count));
+    }
+    else
+    {
+        // We don't know what (if anything) is already staged, so start from scratch to avoid leaving stale files in the app bundle.
+        afc_remove_path_and_contents(afc, destinationURL.relativePath.fileSystemRepresentation);
     }
     
-    return YES;
-}
-
-- (BOOL)writeFile:(NSURL *)fileURL toDestinationURL:(NSURL *)destinationURL progress:(NSProgress *)progress client:(afc_client_t)afc error:(NSError **)error
-{
-    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingAtPath:fileURL.path];
-    if (fileHandle == nil)
+    int64_t totalSize = 0;
+    for (const ALTFileTransferItem &item : items)
     {
-        if (error)
-        {
-            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileNoSuchFileError userInfo:@{NSURLErrorKey: fileURL}];
-        }
-        
-        return NO;
+        totalSize += item.size;
     }
     
-    NSData *data = [fileHandle readDataToEndOfFile];
-
-    uint64_t af = 0;
+    // Track progress in bytes rather than files, since a single large asset can take longer to upload than hundreds of small files.
+    // If every file is already staged there's nothing to upload, but progress should still finish.
+    NSProgress *progress = [NSProgress progressWithTotalUnitCount:MAX(totalSize, 1)];
+    progress.kind = NSProgressKindFile;
+    progress.fileOperationKind = NSProgressFileOperationKindCopying;
     
-    int openResult = afc_file_open(afc, destinationURL.relativePath.fileSystemRepresentation, AFC_FOPEN_WRONLY, &af);
-    if (openResult != AFC_E_SUCCESS || af == 0)
+    /* Create Directories */
+    // Directories are gathered parent-first, so creating them in order guarantees every file's parent exists before any uploads start.
+    for (NSURL *destinationDirectoryURL in destinationDirectoryURLs)
     {
-        if (openResult == AFC_E_OBJECT_IS_DIR)
+        afc_make_directory(afc, destinationDirectoryURL.relativePath.fileSystemRepresentation);
+    }
+    
+    // Upload largest files first so a big asset never ends up as the last remaining transfer on a single connection.
+    std::stable_sort(items.begin(), items.end(), [](const ALTFileTransferItem &a, const ALTFileTransferItem &b) {
+        return a.size > b.size;
+    });
+    
+    /* Connect to Additional AFC Services */
+    NSInteger connectionCount = MAX(1, MIN([[NSUserDefaults standardUserDefaults] afcConnectionCount], (NSInteger)items.size()));
+    
+    std::vector<afc_client_t> clients = { afc };
+    while ((NSInteger)clients.size() < connectionCount)
+    {
+        lockdownd_service_descriptor_t service = NULL;
+        if ((lockdownd_start_service(client, "com.apple.afc", &service) != LOCKDOWN_E_SUCCESS) || service == NULL)
         {
-            NSLog(@"Treating file as directory: %@ %@", fileURL, destinationURL);
-            return [self writeDirectory:fileURL toDestinationURL:destinationURL client:afc progress:progress error:error];
+            NSLog(@"Failed to start additional AFC service, continuing with %@ connection(s).", @(clients.size()));
+            break;
         }
         
-        if (error)
+        afc_client_t additionalClient = NULL;
+        afc_error_t result = afc_client_new(device, service, &additionalClient);
+        lockdownd_service_descriptor_free(service);
+        
+        if (result != AFC_E_SUCCESS)
         {
-            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:@{NSURLErrorKey: destinationURL}];
+            NSLog(@"Failed to connect to additional AFC service (%@), continuing with %@ connection(s).", @(result), @(clients.size()));
+            break;
         }
         
-        return NO;
+        clients.push_back(additionalClient);
     }
     
-    BOOL success = YES;
-    uint32_t bytesWritten = 0;
+    /* Upload Files */
+    // Each connection pulls the next file from a shared work queue until it is empty, or until any connection fails.
+    std::atomic<size_t> nextItemIndex(0);
+    std::atomic<bool> isCancelled(false);
+    
+    std::atomic<size_t> *nextItemIndexPointer = &nextItemIndex;
+    std::atomic<bool> *isCancelledPointer = &isCancelled;
+    const std::vector<ALTFileTransferItem> *itemsPointer = &items;
+    const std::vector<afc_client_t> *clientsPointer = &clients;
+    
+    NSObject *errorLock = [[NSObject alloc] init];
+    __block NSError *transferError = nil;
+    
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    
+    dispatch_apply(clients.size(), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^(size_t connectionIndex) {
+        afc_client_t connection = (*clientsPointer)[connectionIndex];
+        NSMutableData *buffer = [NSMutableData dataWithLength:ALTDeviceManagerUploadChunkSize * 2];
         
-    while (bytesWritten < data.length)
-    {
-        uint32_t count = 0;
+        CFAbsoluteTime connectionStartTime = CFAbsoluteTimeGetCurrent();
+        int64_t bytesWritten = 0;
+        NSInteger filesWritten = 0;
         
-        int writeResult = afc_file_write(afc, af, (const char *)data.bytes + bytesWritten, (uint32_t)data.length - bytesWritten, &count);
-        if (writeResult != AFC_E_SUCCESS)
+        while (!isCancelledPointer->load())
         {
-            if (error)
+            size_t index = nextItemIndexPointer->fetch_add(1);
+            if (index >= itemsPointer->size())
             {
-                NSLog(@"Failed writing file with error: %@ (%@ %@)", @(writeResult), fileURL, destinationURL);
-                *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:@{NSURLErrorKey: destinationURL}];
+                break;
             }
             
-            success = NO;
-            break;
+            const ALTFileTransferItem &item = (*itemsPointer)[index];
+            
+            NSError *error = nil;
+            if (![self writeFile:item.fileURL toDestinationURL:item.destinationURL progress:progress client:connection buffer:buffer error:&error])
+            {
+                isCancelledPointer->store(true);
+                
+                @synchronized(errorLock)
+                {
+                    if (transferError == nil)
+                    {
+                        transferError = error;
+                    }
+                }
+                
+                break;
+            }
+            
+            bytesWritten += item.size;
+            filesWritten += 1;
         }
         
-        bytesWritten += count;
+        CFAbsoluteTime duration = MAX(CFAbsoluteTimeGetCurrent() - connectionStartTime, 0.001);
+        NSLog(@"AFC connection %@: wrote %@ files (%@ bytes) in %.2fs (%.2f MB/s)", @(connectionIndex), @(filesWritten), @(bytesWritten), duration, (double)bytesWritten / duration / 1000000.0);
+    });
+    
+    CFAbsoluteTime duration = MAX(CFAbsoluteTimeGetCurrent() - startTime, 0.001);
+    NSLog(@"Wrote %@ files (%@ bytes) over %@ AFC connection(s) in %.2fs (%.2f MB/s)", @(items.size()), @(totalSize), @(clients.size()), duration, (double)totalSize / duration / 1000000.0);
+    
+    // The first client is owned by our caller.
+    for (size_t i = 1; i < clients.size(); i++)
+    {
+        afc_client_free(clients[i]);
     }
     
-    if (bytesWritten != data.length)
+    if (transferError != nil)
     {
         if (error)
         {
-            NSLog(@"Failed writing file due to mismatched sizes: %@ vs %@ (%@ %@)", @(bytesWritten), @(data.length), fileURL, destinationURL);
-            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:@{NSURLErrorKey: destinationURL}];
+            *error = transferError;
         }
         
-        success = NO;
+        return NO;
     }
     
-    afc_file_close(afc, af);
+    progress.completedUnitCount = progress.totalUnitCount;
     
-    return success;
+    /* Save Manifest */
+    NSString *stagingID = [[NSUUID UUID] UUIDString];
+    
+    NSMutableDictionary<NSString *, NSDictionary *> *files = [NSMutableDictionary dictionary];
+    for (const ALTFileTransferItem &item : allItems)
+    {
+        files[item.relativePath] = @{ALTStagingManifestSizeKey: @(item.size), ALTStagingManifestSHA256Key: item.sha256Hash};
+    }
+    
+    NSDictionary *manifest = @{ALTStagingManifestIDKey: stagingID, ALTStagingManifestFilesKey: files};
+    
+    NSError *manifestError = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:manifestURL.URLByDeletingLastPathComponent withIntermediateDirectories:YES attributes:nil error:&manifestError] ||
+        ![manifest writeToURL:manifestURL error:&manifestError])
+    {
+        // Not fatal, the next installation will just upload every file again.
+        NSLog(@"Failed to save staging manifest. %@", manifestError);
+    }
+    else if (![self writeString:stagingID toFileAtURL:markerURL afc:afc])
+    {
+        NSLog(@"Failed to write staging marker to device.");
+        [[NSFileManager defaultManager] removeItemAtURL:manifestURL error:nil];
+    }
+    
+    return YES;
 }
 
-- (void)removeAppForBundleIdentifier:(NSString *)bundleIdentifier fromDeviceWithUDID:(NSString *)udid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+- (NSURL *)stagingManifestURLForDestinationURL:(NSURL *)destinationURL deviceUDID:(NSString *)udid
 {
-    __block idevice_t device = NULL;
-    __block lockdownd_client_t client = NULL;
-    __block instproxy_client_t ipc = NULL;
-    __block lockdownd_service_descriptor_t service = NULL;
+    NSURL *deviceDirectoryURL = [[[NSFileManager defaultManager] stagedAppManifestsDirectory] URLByAppendingPathComponent:udid isDirectory:YES];
     
-    void (^finish)(NSError *error) = ^(NSError *e) {
-        __block NSError *error = e;
-        
-        lockdownd_service_descriptor_free(service);
-        instproxy_client_free(ipc);
-        lockdownd_client_free(client);
-        idevice_free(device);
-        
-        if (error != nil)
-        {
-            completionHandler(NO, error);
-        }
-        else
-        {
-            completionHandler(YES, nil);
-        }
-    };
+    NSURL *manifestURL = [deviceDirectoryURL URLByAppendingPathComponent:[destinationURL.lastPathComponent stringByAppendingPathExtension:@"plist"] isDirectory:NO];
+    return manifestURL;
+}
+
+- (NSURL *)stagingMarkerURLForDestinationURL:(NSURL *)destinationURL
+{
+    // Store marker next to (rather than inside) staged app bundle, since any extra files inside the bundle would invalidate its signature.
+    NSString *filename = [NSString stringWithFormat:@".%@.altserver", destinationURL.lastPathComponent];
     
-    /* Find Device */
-    if (idevice_new_with_options(&device, udid.UTF8String, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX)) != IDEVICE_E_SUCCESS)
-    {
-        return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorDeviceNotFound userInfo:nil]);
-    }
+    NSURL *markerURL = [destinationURL.URLByDeletingLastPathComponent URLByAppendingPathComponent:filename isDirectory:NO];
+    return markerURL;
+}
+
+- (nullable NSDictionary<NSString *, NSDictionary *> *)stagedFilesAtDestinationURL:(NSURL *)destinationURL manifestURL:(NSURL *)manifestURL markerURL:(NSURL *)markerURL afc:(afc_client_t)afc
+{
+    NSDictionary *manifest = [NSDictionary dictionaryWithContentsOfURL:manifestURL];
     
-    /* Connect to Device */
-    if (lockdownd_client_new_with_handshake(device, &client, "altserver") != LOCKDOWN_E_SUCCESS)
+    NSString *stagingID = manifest[ALTStagingManifestIDKey];
+    NSDictionary *files = manifest[ALTStagingManifestFilesKey];
+    
+    if (![stagingID isKindOfClass:[NSString class]] || ![files isKindOfClass:[NSDictionary class]])
     {
-        return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+        return nil;
     }
     
-    /* Connect to Installation Proxy */
-    if ((lockdownd_start_service(client, "com.apple.mobile.installation_proxy", &service) != LOCKDOWN_E_SUCCESS) || service == NULL)
+    // Only trust manifest if device still has the exact upload it describes.
+    NSString *stagedID = [self readStringFromFileAtURL:markerURL afc:afc];
+    if (![stagedID isEqualToString:stagingID])
     {
-        return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+        NSLog(@"Staged app %@ does not match manifest, uploading all files.", destinationURL.lastPathComponent);
+        return nil;
     }
     
-    if (instproxy_client_new(device, service, &ipc) != INSTPROXY_E_SUCCESS)
+    // Marker lives outside the app bundle, so it survives installd consuming (or moving) the bundle itself.
+    // Make sure bundle is still there and still looks like the upload we recorded before trusting the manifest.
+    NSDictionary<NSString *, NSString *> *bundleInfo = [self fileInfoAtURL:destinationURL afc:afc];
+    if (![bundleInfo[@"st_ifmt"] isEqualToString:@"S_IFDIR"])
     {
-        return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+        NSLog(@"Staged app %@ no longer exists, uploading all files.", destinationURL.lastPathComponent);
+        return nil;
     }
     
-    if (service)
+    // Spot-check largest files (most likely to be partially written or replaced), plus a handful of others.
+    NSArray<NSString *> *relativePaths = [files keysSortedByValueUsingComparator:^NSComparisonResult(NSDictionary *file1, NSDictionary *file2) {
+        return [file2[ALTStagingManifestSizeKey] compare:file1[ALTStagingManifestSizeKey]];
+    }];
+    
+    NSMutableSet<NSString *> *spotCheckPaths = [NSMutableSet setWithArray:[relativePaths subarrayWithRange:NSMakeRange(0, MIN(relativePaths.count, 4))]];
+    for (NSUInteger i = 0; i < 4 && relativePaths.count > 0; i++)
     {
-        lockdownd_service_descriptor_free(service);
-        service = NULL;
+        [spotCheckPaths addObject:relativePaths[arc4random_uniform((uint32_t)relativePaths.count)]];
     }
     
-    NSUUID *UUID = [NSUUID UUID];
-    __block char *uuidString = (char *)malloc(UUID.UUIDString.length + 1);
-    strncpy(uuidString, (const char *)UUID.UUIDString.UTF8String, UUID.UUIDString.length);
-    uuidString[UUID.UUIDString.length] = '\0';
-    
-    self.deletionCompletionHandlers[UUID] = ^(NSError *error) {
-        if (error != nil)
-        {
-            NSString *localizedFailure = [NSString stringWithFormat:NSLocalizedString(@"Could not remove “%@”.", @""), bundleIdentifier];
-            
-            NSMutableDictionary *userInfo = [error.userInfo mutableCopy];
-            userInfo[NSLocalizedFailureErrorKey] = localizedFailure;
-            
-            NSError *localizedError = [NSError errorWithDomain:error.domain code:error.code userInfo:userInfo];
-            finish(localizedError);
-        }
-        else
+    for (NSString *relativePath in spotCheckPaths)
+    {
+        NSNumber *size = files[relativePath][ALTStagingManifestSizeKey];
+        
+        NSDictionary<NSString *, NSString *> *fileInfo = [self fileInfoAtURL:[destinationURL URLByAppendingPathComponent:relativePath isDirectory:NO] afc:afc];
+        if (fileInfo == nil || ![size isKindOfClass:[NSNumber class]] || fileInfo[@"st_size"].longLongValue != size.longLongValue)
         {
-            finish(nil);
+            NSLog(@"Staged file %@ does not match manifest, uploading all files.", relativePath);
+            return nil;
         }
-        
-        free(uuidString);
-    };
+    }
     
-    instproxy_uninstall(ipc, bundleIdentifier.UTF8String, NULL, ALTDeviceManagerUpdateAppDeletionStatus, uuidString);
+    return files;
 }
 
-#pragma mark - Provisioning Profiles -
-
-- (void)installProvisioningProfiles:(NSSet<ALTProvisioningProfile *> *)provisioningProfiles toDeviceWithUDID:(NSString *)udid activeProvisioningProfiles:(nullable NSSet<NSString *> *)activeProvisioningProfiles completionHandler:(void (^)(BOOL success, NSError *error))completionHandler
+- (nullable NSDictionary<NSString *, NSString *> *)fileInfoAtURL:(NSURL *)fileURL afc:(afc_client_t)afc
 {
-    dispatch_async(self.installationQueue, ^{
-        __block idevice_t device = NULL;
-        __block lockdownd_client_t client = NULL;
-        __block afc_client_t afc = NULL;
-        __block misagent_client_t mis = NULL;
-        __block lockdownd_service_descriptor_t service = NULL;
+    char **info = NULL;
+    if (afc_get_file_info(afc, fileURL.relativePath.fileSystemRepresentation, &info) != AFC_E_SUCCESS || info == NULL)
+    {
+        return nil;
+    }
+    
+    // Info is a NULL-terminated list of alternating keys and values.
+    NSMutableDictionary<NSString *, NSString *> *fileInfo = [NSMutableDictionary dictionary];
+    for (int i = 0; info[i] != NULL && info[i + 1] != NULL; i += 2)
+    {
+        NSString *key = @(info[i]);
+        NSString *value = @(info[i + 1]);
         
-        void (^finish)(NSError *_Nullable) = ^(NSError *error) {
-            lockdownd_service_descriptor_free(service);
-            misagent_client_free(mis);
-            afc_client_free(afc);
-            lockdownd_client_free(client);
-            idevice_free(device);
+        if (key != nil && value != nil)
+        {
+            fileInfo[key] = value;
+        }
+    }
+    
+    for (int i = 0; info[i] != NULL; i++)
+    {
+        free(info[i]);
+    }
+    
+    free(info);
+    
+    return fileInfo;
+}
+
+- (nullable NSString *)readStringFromFileAtURL:(NSURL *)fileURL afc:(afc_client_t)afc
+{
+    uint64_t af = 0;
+    if (afc_file_open(afc, fileURL.relativePath.fileSystemRepresentation, AFC_FOPEN_RDONLY, &af) != AFC_E_SUCCESS || af == 0)
+    {
+        return nil;
+    }
+    
+    char bytes[256];
+    uint32_t count = 0;
+    afc_error_t result = afc_file_read(afc, af, bytes, sizeof(bytes), &count);
+    afc_file_close(afc, af);
+    
+    if (result != AFC_E_SUCCESS)
+    {
+        return nil;
+    }
+    
+    NSString *string = [[NSString alloc] initWithBytes:bytes length:count encoding:NSUTF8StringEncoding];
+    return string;
+}
+
+- (BOOL)writeString:(NSString *)string toFileAtURL:(NSURL *)fileURL afc:(afc_client_t)afc
+{
+    uint64_t af = 0;
+    if (afc_file_open(afc, fileURL.relativePath.fileSystemRepresentation, AFC_FOPEN_WRONLY, &af) != AFC_E_SUCCESS || af == 0)
+    {
+        return NO;
+    }
+    
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    
+    uint32_t count = 0;
+    afc_error_t result = afc_file_write(afc, af, (const char *)data.bytes, (uint32_t)data.length, &count);
+    afc_file_close(afc, af);
+    
+    return (result == AFC_E_SUCCESS && count == data.length);
+}
+
+- (nullable NSData *)sha256HashOfFileAtURL:(NSURL *)fileURL error:(NSError **)error
+{
+    int fd = open(fileURL.fileSystemRepresentation, O_RDONLY);
+    if (fd == -1)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileNoSuchFileError userInfo:@{NSURLErrorKey: fileURL}];
+        }
+        
+        return nil;
+    }
+    
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    
+    char bytes[64 * 1024];
+    
+    ssize_t length = 0;
+    while ((length = read(fd, bytes, sizeof(bytes))) > 0)
+    {
+        CC_SHA256_Update(&context, bytes, (CC_LONG)length);
+    }
+    
+    close(fd);
+    
+    if (length < 0)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:@{NSURLErrorKey: fileURL}];
+        }
+        
+        return nil;
+    }
+    
+    NSMutableData *hash = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final((unsigned char *)hash.mutableBytes, &context);
+    
+    return hash;
+}
+
+- (BOOL)gatherFileTransferItemsInDirectory:(NSURL *)directoryURL destinationURL:(NSURL *)destinationURL relativePath:(NSString *)relativePath directories:(NSMutableArray<NSURL *> *)destinationDirectoryURLs items:(std::vector<ALTFileTransferItem> &)items error:(NSError **)error
+{
+    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtURL:directoryURL
+                                                             includingPropertiesForKeys:@[NSURLIsDirectoryKey]
+                                                                                options:NSDirectoryEnumerationSkipsSubdirectoryDescendants
+                                                                           errorHandler:^BOOL(NSURL * _Nonnull url, NSError * _Nonnull error) {
+                                                                               if (error) {
+                                                                                   NSLog(@"[Error] %@ (%@)", error, url);
+                                                                                   return NO;
+                                                                               }
+                                                                               
+                                                                               return YES;
+                                                                           }];
+    
+    for (NSURL *fileURL in enumerator)
+    {
+        NSNumber *isDirectory = nil;
+        if (![fileURL getResourceValue:&isDirectory forKey:NSURLIsDirectoryKey error:error])
+        {
+            return NO;
+        }
+        
+        if ([isDirectory boolValue])
+        {
+            NSURL *destinationDirectoryURL = [destinationURL URLByAppendingPathComponent:fileURL.lastPathComponent isDirectory:YES];
+            [destinationDirectoryURLs addObject:destinationDirectoryURL];
             
-            completionHandler(error == nil, error);
-        };
+            NSString *directoryRelativePath = [relativePath stringByAppendingPathComponent:fileURL.lastPathComponent];
+            if (![self gatherFileTransferItemsInDirectory:fileURL destinationURL:destinationDirectoryURL relativePath:directoryRelativePath directories:destinationDirectoryURLs items:items error:error])
+            {
+                return NO;
+            }
+        }
+        else
+        {
+            // Use stat() (rather than NSURLFileSizeKey) so symlinks are measured the same way writeFile: reads them.
+            struct stat fileInfo;
+            off_t fileSize = (stat(fileURL.fileSystemRepresentation, &fileInfo) == 0 && S_ISREG(fileInfo.st_mode)) ? fileInfo.st_size : 0;
+            
+            NSURL *destinationFileURL = [destinationURL URLByAppendingPathComponent:fileURL.lastPathComponent isDirectory:NO];
+            NSString *fileRelativePath = [relativePath stringByAppendingPathComponent:fileURL.lastPathComponent];
+            
+            items.push_back({ fileURL, destinationFileURL, fileRelativePath, fileSize, nil });
+        }
+    }
+    
+    return YES;
+}
+
+- (BOOL)writeDirectory:(NSURL *)directoryURL toDestinationURL:(NSURL *)destinationURL client:(afc_client_t)afc progress:(NSProgress *)progress buffer:(NSMutableData *)buffer error:(NSError **)error
+{
+    afc_make_directory(afc, destinationURL.relativePath.fileSystemRepresentation);
+    
+    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtURL:directoryURL
+                                                             includingPropertiesForKeys:@[NSURLIsDirectoryKey]
+                                                                                options:NSDirectoryEnumerationSkipsSubdirectoryDescendants
+                                                                           errorHandler:^BOOL(NSURL * _Nonnull url, NSError * _Nonnull error) {
+                                                                               if (error) {
+                                                                                   NSLog(@"[Error] %@ (%@)", error, url);
+                                                                                   return NO;
+                                                                               }
+                                                                               
+                                                                               return YES;
+                                                                           }];
+    
+    for (NSURL *fileURL in enumerator)
+    {
+        NSNumber *isDirectory = nil;
+        if (![fileURL getResourceValue:&isDirectory forKey:NSURLIsDirectoryKey error:error])
+        {
+            return NO;
+        }
         
-        /* Find Device */
-        if (idevice_new_with_options(&device, udid.UTF8String, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX)) != IDEVICE_E_SUCCESS)
+        if ([isDirectory boolValue])
+        {
+            NSURL *destinationDirectoryURL = [destinationURL URLByAppendingPathComponent:fileURL.lastPathComponent isDirectory:YES];
+            if (![self writeDirectory:fileURL toDestinationURL:destinationDirectoryURL client:afc progress:progress buffer:buffer error:error])
+            {
+                return NO;
+            }
+        }
+        else
+        {
+            NSURL *destinationFileURL = [destinationURL URLByAppendingPathComponent:fileURL.lastPathComponent isDirectory:NO];
+            if (![self writeFile:fileURL toDestinationURL:destinationFileURL progress:progress client:afc buffer:buffer error:error])
+            {
+                return NO;
+            }
+        }
+    }
+    
+    return YES;
+}
+
+- (BOOL)writeFile:(NSURL *)fileURL toDestinationURL:(NSURL *)destinationURL progress:(NSProgress *)progress client:(afc_client_t)afc buffer:(NSMutableData *)buffer error:(NSError **)error
+{
+    int fd = open(fileURL.fileSystemRepresentation, O_RDONLY);
+    if (fd == -1)
+    {
+        if (error)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorDeviceNotFound userInfo:nil]);
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileNoSuchFileError userInfo:@{NSURLErrorKey: fileURL}];
         }
         
-        /* Connect to Device */
-        if (lockdownd_client_new_with_handshake(device, &client, "altserver") != LOCKDOWN_E_SUCCESS)
+        return NO;
+    }
+    
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0)
+    {
+        close(fd);
+        
+        if (error)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:@{NSURLErrorKey: fileURL}];
         }
         
-        /* Connect to Misagent */
-        if (lockdownd_start_service(client, "com.apple.misagent", &service) != LOCKDOWN_E_SUCCESS || service == NULL)
+        return NO;
+    }
+    
+    uint64_t af = 0;
+    
+    int openResult = afc_file_open(afc, destinationURL.relativePath.fileSystemRepresentation, AFC_FOPEN_WRONLY, &af);
+    if (openResult != AFC_E_SUCCESS || af == 0)
+    {
+        close(fd);
+        
+        if (openResult == AFC_E_OBJECT_IS_DIR)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            NSLog(@"Treating file as directory: %@ %@", fileURL, destinationURL);
+            return [self writeDirectory:fileURL toDestinationURL:destinationURL client:afc progress:progress buffer:buffer error:error];
         }
         
-        if (misagent_client_new(device, service, &mis) != MISAGENT_E_SUCCESS)
+        if (error)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:@{NSURLErrorKey: destinationURL}];
         }
         
-        NSError *error = nil;
+        return NO;
+    }
+    
+    // Alternate between two chunk buffers: while one chunk is being written to the device, the next one is read from disk.
+    size_t chunkSize = buffer.length / 2;
+    char *chunks[2] = { (char *)buffer.mutableBytes, (char *)buffer.mutableBytes + chunkSize };
+    
+    dispatch_queue_t readQueue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+    dispatch_group_t readGroup = dispatch_group_create();
+    
+    off_t fileSize = fileInfo.st_size;
+    off_t bytesWritten = 0;
+    
+    ssize_t chunkLength = pread(fd, chunks[0], (size_t)MIN((off_t)chunkSize, fileSize), 0);
+    int chunkIndex = 0;
+    
+    BOOL success = YES;
+    
+    while (chunkLength > 0)
+    {
+        const char *chunk = chunks[chunkIndex];
+        char *nextChunk = chunks[1 - chunkIndex];
         
-        if (activeProvisioningProfiles != nil)
+        off_t nextOffset = bytesWritten + chunkLength;
+        
+        __block ssize_t nextChunkLength = 0;
+        if (nextOffset < fileSize)
         {
-            // Remove all non-active free provisioning profiles.
+            dispatch_group_async(readGroup, readQueue, ^{
+                nextChunkLength = pread(fd, nextChunk, (size_t)MIN((off_t)chunkSize, fileSize - nextOffset), nextOffset);
+            });
+        }
+        
+        uint32_t chunkBytesWritten = 0;
+        while (chunkBytesWritten < (uint32_t)chunkLength)
+        {
+            uint32_t count = 0;
             
-            NSMutableSet *excludedBundleIdentifiers = [activeProvisioningProfiles mutableCopy];
-            for (ALTProvisioningProfile *provisioningProfile in provisioningProfiles)
+            int writeResult = afc_file_write(afc, af, chunk + chunkBytesWritten, (uint32_t)chunkLength - chunkBytesWritten, &count);
+            if (writeResult != AFC_E_SUCCESS)
             {
-                // Ensure we DO remove old versions of profiles we're about to install, even if they are active.
-                [excludedBundleIdentifiers removeObject:provisioningProfile.bundleIdentifier];
+                NSLog(@"Failed writing file with error: %@ (%@ %@)", @(writeResult), fileURL, destinationURL);
+                
+                success = NO;
+                break;
             }
             
-            if (![self removeAllFreeProfilesExcludingBundleIdentifiers:excludedBundleIdentifiers misagent:mis error:&error])
+            chunkBytesWritten += count;
+        }
+        
+        // Always wait for the pending read, even if writing failed, since it still references our buffer and file descriptor.
+        dispatch_group_wait(readGroup, DISPATCH_TIME_FOREVER);
+        
+        if (!success)
+        {
+            if (error)
             {
-                return finish(error);
+                *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:@{NSURLErrorKey: destinationURL}];
             }
+            
+            break;
         }
-        else
+        
+        bytesWritten = nextOffset;
+        
+        // Files may be uploaded concurrently over several AFC connections, so serialize progress updates.
+        @synchronized(progress)
+        {
+            progress.completedUnitCount += chunkLength;
+        }
+        
+        chunkLength = nextChunkLength;
+        chunkIndex = 1 - chunkIndex;
+    }
+    
+    if (success && chunkLength < 0)
+    {
+        NSLog(@"Failed reading file: %@ (%@)", fileURL, destinationURL);
+        
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:@{NSURLErrorKey: fileURL}];
+        }
+        
+        success = NO;
+    }
+    
+    if (success && bytesWritten != fileSize)
+    {
+        NSLog(@"Failed writing file due to mismatched sizes: %@ vs %@ (%@ %@)", @(bytesWritten), @(fileSize), fileURL, destinationURL);
+        
+        if (error)
         {
-            // Remove only older versions of provisioning profiles we're about to install.
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:@{NSURLErrorKey: destinationURL}];
+        }
+        
+        success = NO;
+    }
+    
+    afc_file_close(afc, af);
+    close(fd);
+    
+    return success;
+}
+
+- (void)removeAppForBundleIdentifier:(NSString *)bundleIdentifier fromDeviceWithUDID:(NSString *)udid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    [self.installationScheduler scheduleOperationForDeviceWithUDID:udid usingBlock:^(dispatch_block_t operationDidFinish) {
+        __block ALTDeviceSession *session = nil;
+        
+        void (^finish)(NSError *error) = ^(NSError *e) {
+            __block NSError *error = e;
+            
+            [self invalidateInstalledAppsCacheForDeviceWithUDID:udid];
             
-            NSMutableSet *bundleIdentifiers = [NSMutableSet set];
-            for (ALTProvisioningProfile *provisioningProfile in provisioningProfiles)
+            if (session != nil)
             {
-                [bundleIdentifiers addObject:provisioningProfile.bundleIdentifier];
+                if (error != nil)
+                {
+                    [self.sessionPool invalidateSession:session];
+                }
+                else
+                {
+                    [self.sessionPool checkInSession:session];
+                }
             }
             
-            if (![self removeProvisioningProfilesForBundleIdentifiers:bundleIdentifiers misagent:mis error:&error])
+            if (error != nil)
             {
-                return finish(error);
+                completionHandler(NO, error);
+            }
+            else
+            {
+                completionHandler(YES, nil);
             }
+            
+            operationDidFinish();
+        };
+        
+        /* Connect to Device */
+        NSError *sessionError = nil;
+        session = [self.sessionPool checkOutSessionForDeviceWithUDID:udid error:&sessionError];
+        if (session == nil)
+        {
+            return finish(sessionError);
+        }
+        
+        /* Connect to Installation Proxy */
+        instproxy_client_t ipc = [session installationProxyClientWithError:&sessionError];
+        if (ipc == NULL)
+        {
+            return finish(sessionError);
         }
+        
+        NSUUID *UUID = [NSUUID UUID];
+        __block char *uuidString = (char *)malloc(UUID.UUIDString.length + 1);
+        strncpy(uuidString, (const char *)UUID.UUIDString.UTF8String, UUID.UUIDString.length);
+        uuidString[UUID.UUIDString.length] = '\0';
+        
+        @synchronized(self)
+        {
+            self.deletionCompletionHandlers[UUID] = ^(NSError *error) {
+                if (error != nil)
+                {
+                    NSString *localizedFailure = [NSString stringWithFormat:NSLocalizedString(@"Could not remove “%@”.", @""), bundleIdentifier];
+                    
+                    NSMutableDictionary *userInfo = [error.userInfo mutableCopy];
+                    userInfo[NSLocalizedFailureErrorKey] = localizedFailure;
+                    
+                    NSError *localizedError = [NSError errorWithDomain:error.domain code:error.code userInfo:userInfo];
+                    finish(localizedError);
+                }
+                else
+                {
+                    finish(nil);
+                }
                 
-        for (ALTProvisioningProfile *provisioningProfile in provisioningProfiles)
+                free(uuidString);
+            };
+        }
+        
+        instproxy_error_t uninstallError = instproxy_uninstall(ipc, bundleIdentifier.UTF8String, NULL, ALTDeviceManagerUpdateAppDeletionStatus, uuidString);
+        if (uninstallError != INSTPROXY_E_SUCCESS)
         {
-            if (![self installProvisioningProfile:provisioningProfile misagent:mis error:&error])
+            // Status callback will never be called, so finish manually.
+            void (^completionHandler)(NSError *) = nil;
+            
+            @synchronized(self)
             {
-                return finish(error);
+                completionHandler = self.deletionCompletionHandlers[UUID];
+                self.deletionCompletionHandlers[UUID] = nil;
             }
+            
+            NSError *error = [NSError errorWithInstallationProxyError:uninstallError device:nil] ?: [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorAppDeletionFailed userInfo:nil];
+            completionHandler(error);
+        }
+    }];
+}
+
+#pragma mark - Provisioning Profiles -
+
+- (void)installProvisioningProfiles:(NSSet<ALTProvisioningProfile *> *)provisioningProfiles toDeviceWithUDID:(NSString *)udid activeProvisioningProfiles:(nullable NSSet<NSString *> *)activeProvisioningProfiles completionHandler:(void (^)(BOOL success, NSError *error))completionHandler
+{
+    [self.installationScheduler scheduleOperationForDeviceWithUDID:udid usingBlock:^(dispatch_block_t operationDidFinish) {
+        __block ALTDeviceSession *session = nil;
+        
+        void (^finish)(NSError *_Nullable) = ^(NSError *error) {
+            if (session != nil)
+            {
+                if (error != nil)
+                {
+                    [self.sessionPool invalidateSession:session];
+                }
+                else
+                {
+                    [self.sessionPool checkInSession:session];
+                }
+            }
+            
+            completionHandler(error == nil, error);
+            
+            operationDidFinish();
+        };
+        
+        /* Connect to Device */
+        NSError *sessionError = nil;
+        session = [self.sessionPool checkOutSessionForDeviceWithUDID:udid error:&sessionError];
+        if (session == nil)
+        {
+            return finish(sessionError);
+        }
+        
+        /* Connect to Misagent */
+        misagent_client_t mis = [session misagentClientWithError:&sessionError];
+        if (mis == NULL)
+        {
+            return finish(sessionError);
+        }
+        
+        NSError *error = nil;
+        if (![self syncProvisioningProfiles:provisioningProfiles activeProvisioningProfiles:activeProvisioningProfiles misagent:mis error:&error])
+        {
+            return finish(error);
         }
         
         finish(nil);
-    });
+    }];
 }
 
 - (void)removeProvisioningProfilesForBundleIdentifiers:(NSSet<NSString *> *)bundleIdentifiers fromDeviceWithUDID:(NSString *)udid completionHandler:(void (^)(BOOL success, NSError *error))completionHandler
 {
-    dispatch_async(self.installationQueue, ^{
-        __block idevice_t device = NULL;
-        __block lockdownd_client_t client = NULL;
-        __block afc_client_t afc = NULL;
-        __block misagent_client_t mis = NULL;
-        __block lockdownd_service_descriptor_t service = NULL;
+    [self.installationScheduler scheduleOperationForDeviceWithUDID:udid usingBlock:^(dispatch_block_t operationDidFinish) {
+        __block ALTDeviceSession *session = nil;
         
         void (^finish)(NSError *_Nullable) = ^(NSError *error) {
-            lockdownd_service_descriptor_free(service);
-            misagent_client_free(mis);
-            afc_client_free(afc);
-            lockdownd_client_free(client);
-            idevice_free(device);
+            if (session != nil)
+            {
+                if (error != nil)
+                {
+                    [self.sessionPool invalidateSession:session];
+                }
+                else
+                {
+                    [self.sessionPool checkInSession:session];
+                }
+            }
             
             completionHandler(error == nil, error);
+            
+            operationDidFinish();
         };
         
-        /* Find Device */
-        if (idevice_new_with_options(&device, udid.UTF8String, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX)) != IDEVICE_E_SUCCESS)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorDeviceNotFound userInfo:nil]);
-        }
-        
         /* Connect to Device */
-        if (lockdownd_client_new_with_handshake(device, &client, "altserver") != LOCKDOWN_E_SUCCESS)
+        NSError *sessionError = nil;
+        session = [self.sessionPool checkOutSessionForDeviceWithUDID:udid error:&sessionError];
+        if (session == nil)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
         
         /* Connect to Misagent */
-        if (lockdownd_start_service(client, "com.apple.misagent", &service) != LOCKDOWN_E_SUCCESS || service == NULL)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
-        }
-        
-        if (misagent_client_new(device, service, &mis) != MISAGENT_E_SUCCESS)
+        misagent_client_t mis = [session misagentClientWithError:&sessionError];
+        if (mis == NULL)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
         
         NSError *error = nil;
@@ -771,7 +1349,107 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
         }
         
         finish(nil);
-    });
+    }];
+}
+
+- (BOOL)syncProvisioningProfiles:(NSSet<ALTProvisioningProfile *> *)provisioningProfiles activeProvisioningProfiles:(nullable NSSet<NSString *> *)activeProvisioningProfiles misagent:(misagent_client_t)mis error:(NSError **)error
+{
+    // Fetch installed profiles once, then only remove + install what actually differs from desired state.
+    
+    NSArray<ALTProvisioningProfile *> *installedProfiles = [self copyProvisioningProfilesWithClient:mis error:error];
+    if (installedProfiles == nil)
+    {
+        return NO;
+    }
+    
+    NSMutableDictionary<NSString *, ALTProvisioningProfile *> *desiredProfiles = [NSMutableDictionary dictionary];
+    for (ALTProvisioningProfile *provisioningProfile in provisioningProfiles)
+    {
+        desiredProfiles[provisioningProfile.bundleIdentifier] = provisioningProfile;
+    }
+    
+    NSMutableSet<NSUUID *> *unchangedProfileUUIDs = [NSMutableSet set];
+    NSMutableArray<ALTProvisioningProfile *> *profilesToRemove = [NSMutableArray array];
+    NSMutableDictionary<NSString *, ALTProvisioningProfile *> *keptProfiles = [NSMutableDictionary dictionary];
+    
+    for (ALTProvisioningProfile *installedProfile in installedProfiles)
+    {
+        ALTProvisioningProfile *desiredProfile = desiredProfiles[installedProfile.bundleIdentifier];
+        if (desiredProfile != nil)
+        {
+            if ([installedProfile.UUID isEqual:desiredProfile.UUID])
+            {
+                // Already installed, so don't remove + reinstall it.
+                [unchangedProfileUUIDs addObject:installedProfile.UUID];
+            }
+            else if (activeProvisioningProfiles == nil || [installedProfile isFreeProvisioningProfile])
+            {
+                // Older version of profile we're about to install.
+                [profilesToRemove addObject:installedProfile];
+            }
+            
+            continue;
+        }
+        
+        if (activeProvisioningProfiles == nil || ![installedProfile isFreeProvisioningProfile])
+        {
+            // Without active profiles, only older versions of profiles we're installing are removed.
+            continue;
+        }
+        
+        if (![activeProvisioningProfiles containsObject:installedProfile.bundleIdentifier])
+        {
+            // Remove all non-active free provisioning profiles.
+            [profilesToRemove addObject:installedProfile];
+            continue;
+        }
+        
+        // Keep only the newest profile for each active bundle identifier.
+        ALTProvisioningProfile *previousProfile = keptProfiles[installedProfile.bundleIdentifier];
+        if (previousProfile != nil)
+        {
+            BOOL isNewerThanPreviousProfile = ([installedProfile.expirationDate compare:previousProfile.expirationDate] == NSOrderedDescending);
+            ALTProvisioningProfile *oldestProfile = isNewerThanPreviousProfile ? previousProfile : installedProfile;
+            ALTProvisioningProfile *newestProfile = isNewerThanPreviousProfile ? installedProfile : previousProfile;
+            
+            keptProfiles[installedProfile.bundleIdentifier] = newestProfile;
+            [profilesToRemove addObject:oldestProfile];
+        }
+        else
+        {
+            keptProfiles[installedProfile.bundleIdentifier] = installedProfile;
+        }
+    }
+    
+    NSMutableArray<ALTProvisioningProfile *> *profilesToInstall = [NSMutableArray array];
+    for (ALTProvisioningProfile *provisioningProfile in desiredProfiles.allValues)
+    {
+        if (![unchangedProfileUUIDs containsObject:provisioningProfile.UUID])
+        {
+            [profilesToInstall addObject:provisioningProfile];
+        }
+    }
+    
+    NSLog(@"Syncing provisioning profiles. Removing: %@. Installing: %@. Unchanged: %@.", @(profilesToRemove.count), @(profilesToInstall.count), @(unchangedProfileUUIDs.count));
+    
+    // Remove profiles first to stay under free developer account limits.
+    for (ALTProvisioningProfile *provisioningProfile in profilesToRemove)
+    {
+        if (![self removeProvisioningProfile:provisioningProfile misagent:mis error:error])
+        {
+            return NO;
+        }
+    }
+    
+    for (ALTProvisioningProfile *provisioningProfile in profilesToInstall)
+    {
+        if (![self installProvisioningProfile:provisioningProfile misagent:mis error:error])
+        {
+            return NO;
+        }
+    }
+    
+    return YES;
 }
 
 - (NSDictionary<NSString *, ALTProvisioningProfile *> *)removeProvisioningProfilesForBundleIdentifiers:(NSSet<NSString *> *)bundleIdentifiers misagent:(misagent_client_t)mis error:(NSError **)error
@@ -996,7 +1674,7 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
         }
 
         NSData *data = [NSData dataWithBytesNoCopy:bytes length:length freeWhenDone:YES];
-        ALTProvisioningProfile *provisioningProfile = [[ALTProvisioningProfile alloc] initWithData:data];
+        ALTProvisioningProfile *provisioningProfile = [self provisioningProfileWithData:data];
         if (provisioningProfile == nil)
         {
             continue;
@@ -1011,64 +1689,80 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
     return provisioningProfiles;
 }
 
+- (nullable ALTProvisioningProfile *)provisioningProfileWithData:(NSData *)data
+{
+    // Decoding CMS-signed profiles is expensive, so reuse previously parsed profiles when data is unchanged.
+    NSString *UUIDString = ALTProvisioningProfileUUIDStringFromData(data);
+    if (UUIDString != nil)
+    {
+        ALTProvisioningProfile *cachedProfile = [self.provisioningProfileCache objectForKey:UUIDString.lowercaseString];
+        if (cachedProfile != nil && [cachedProfile.data isEqualToData:data])
+        {
+            return cachedProfile;
+        }
+    }
+    
+    ALTProvisioningProfile *provisioningProfile = [[ALTProvisioningProfile alloc] initWithData:data];
+    if (provisioningProfile == nil)
+    {
+        return nil;
+    }
+    
+    [self.provisioningProfileCache setObject:provisioningProfile forKey:provisioningProfile.UUID.UUIDString.lowercaseString];
+    return provisioningProfile;
+}
+
 #pragma mark - Developer Disk Image -
 
 - (void)isDeveloperDiskImageMountedForDevice:(ALTDevice *)altDevice completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler
 {
-    __block idevice_t device = NULL;
-    __block instproxy_client_t ipc = NULL;
-    __block lockdownd_client_t client = NULL;
-    __block lockdownd_service_descriptor_t service = NULL;
-    __block mobile_image_mounter_client_t mim = NULL;
-    
-    __block BOOL isMounted = NO;
-        
-    void (^finish)(NSError *) = ^(NSError *error) {
-        if (mim) {
-            mobile_image_mounter_hangup(mim);
-            mobile_image_mounter_free(mim);
-        }
-        
-        if (service) {
-            lockdownd_service_descriptor_free(service);
-        }
-        
-        if (client) {
-            lockdownd_client_free(client);
-        }
-        
-        if (ipc) {
-            instproxy_client_free(ipc);
-        }
-        
-        if (device) {
-            idevice_free(device);
-        }
-        
-        completionHandler(isMounted, error);
-    };
-    
-    dispatch_async(self.installationQueue, ^{
+    [self.installationScheduler scheduleOperationForDeviceWithUDID:altDevice.identifier usingBlock:^(dispatch_block_t operationDidFinish) {
+        __block ALTDeviceSession *session = nil;
+        __block lockdownd_service_descriptor_t service = NULL;
+        __block mobile_image_mounter_client_t mim = NULL;
         
-        /* Find Device */
-        if (idevice_new_with_options(&device, altDevice.identifier.UTF8String, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX)) != IDEVICE_E_SUCCESS)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorDeviceNotFound userInfo:nil]);
-        }
+        __block BOOL isMounted = NO;
+            
+        void (^finish)(NSError *) = ^(NSError *error) {
+            if (mim) {
+                mobile_image_mounter_hangup(mim);
+                mobile_image_mounter_free(mim);
+            }
+            
+            if (service) {
+                lockdownd_service_descriptor_free(service);
+            }
+            
+            if (session) {
+                if (error) {
+                    [self.sessionPool invalidateSession:session];
+                }
+                else {
+                    [self.sessionPool checkInSession:session];
+                }
+            }
+            
+            completionHandler(isMounted, error);
+            
+            operationDidFinish();
+        };
         
         /* Connect to Device */
-        if (lockdownd_client_new_with_handshake(device, &client, "altserver") != LOCKDOWN_E_SUCCESS)
+        NSError *sessionError = nil;
+        session = [self.sessionPool checkOutSessionForDeviceWithUDID:altDevice.identifier error:&sessionError];
+        if (session == nil)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
                         
         /* Connect to Mobile Image Mounter Proxy */
-        if ((lockdownd_start_service(client, "com.apple.mobile.mobile_image_mounter", &service) != LOCKDOWN_E_SUCCESS) || service == NULL)
+        service = [session startService:@"com.apple.mobile.mobile_image_mounter" error:&sessionError];
+        if (service == NULL)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
         
-        mobile_image_mounter_error_t err = mobile_image_mounter_new(device, service, &mim);
+        mobile_image_mounter_error_t err = mobile_image_mounter_new(session.device, service, &mim);
         if (err != MOBILE_IMAGE_MOUNTER_E_SUCCESS)
         {
             return finish([NSError errorWithMobileImageMounterError:err device:altDevice]);
@@ -1113,104 +1807,99 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
         free(it);
         
         finish(nil);
-    });
+    }];
 }
 
-- (void)installDeveloperDiskImageAtURL:(NSURL *)diskURL signatureURL:(NSURL *)signatureURL toDevice:(ALTDevice *)altDevice
-                     completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+- (NSProgress *)installDeveloperDiskImageAtURL:(NSURL *)diskURL signatureURL:(NSURL *)signatureURL toDevice:(ALTDevice *)altDevice
+                              completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
 {
-    __block idevice_t device = NULL;
-    __block instproxy_client_t ipc = NULL;
-    __block lockdownd_client_t client = NULL;
-    __block lockdownd_service_descriptor_t service = NULL;
-    __block mobile_image_mounter_client_t mim = NULL;
-        
-    void (^finish)(NSError *) = ^(NSError *error) {
-        if (mim) {
-            mobile_image_mounter_hangup(mim);
-            mobile_image_mounter_free(mim);
-        }
-        
-        if (service) {
-            lockdownd_service_descriptor_free(service);
-        }
-        
-        if (client) {
-            lockdownd_client_free(client);
-        }
-        
-        if (ipc) {
-            instproxy_client_free(ipc);
-        }
-        
-        if (device) {
-            idevice_free(device);
-        }
-        
-        if (error)
-        {
-            error = [error alt_errorWithLocalizedFailure:[NSString stringWithFormat:NSLocalizedString(@"The Developer disk image could not be installed onto %@.", @""), altDevice.name]];
-        }
-        
-        completionHandler(error == nil, error);
-    };
+    // Total unit count is updated to disk size once disk is mapped.
+    NSProgress *progress = [NSProgress discreteProgressWithTotalUnitCount:1];
     
-    dispatch_async(self.installationQueue, ^{
-        
-        /* Find Device */
-        if (idevice_new_with_options(&device, altDevice.identifier.UTF8String, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX)) != IDEVICE_E_SUCCESS)
-        {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorDeviceNotFound userInfo:nil]);
-        }
+    [self.installationScheduler scheduleOperationForDeviceWithUDID:altDevice.identifier usingBlock:^(dispatch_block_t operationDidFinish) {
+        __block ALTDeviceSession *session = nil;
+        __block lockdownd_service_descriptor_t service = NULL;
+        __block mobile_image_mounter_client_t mim = NULL;
+            
+        void (^finish)(NSError *) = ^(NSError *error) {
+            if (mim) {
+                mobile_image_mounter_hangup(mim);
+                mobile_image_mounter_free(mim);
+            }
+            
+            if (service) {
+                lockdownd_service_descriptor_free(service);
+            }
+            
+            if (session) {
+                if (error) {
+                    [self.sessionPool invalidateSession:session];
+                }
+                else {
+                    [self.sessionPool checkInSession:session];
+                }
+            }
+            
+            if (error)
+            {
+                error = [error alt_errorWithLocalizedFailure:[NSString stringWithFormat:NSLocalizedString(@"The Developer disk image could not be installed onto %@.", @""), altDevice.name]];
+            }
+            
+            completionHandler(error == nil, error);
+            
+            operationDidFinish();
+        };
         
         /* Connect to Device */
-        if (lockdownd_client_new_with_handshake(device, &client, "altserver") != LOCKDOWN_E_SUCCESS)
+        NSError *sessionError = nil;
+        session = [self.sessionPool checkOutSessionForDeviceWithUDID:altDevice.identifier error:&sessionError];
+        if (session == nil)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
                 
         /* Connect to Mobile Image Mounter Proxy */
-        if ((lockdownd_start_service(client, "com.apple.mobile.mobile_image_mounter", &service) != LOCKDOWN_E_SUCCESS) || service == NULL)
+        service = [session startService:@"com.apple.mobile.mobile_image_mounter" error:&sessionError];
+        if (service == NULL)
         {
-            return finish([NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(sessionError);
         }
                 
-        mobile_image_mounter_error_t err = mobile_image_mounter_new(device, service, &mim);
+        mobile_image_mounter_error_t err = mobile_image_mounter_new(session.device, service, &mim);
         if (err != MOBILE_IMAGE_MOUNTER_E_SUCCESS)
         {
             return finish([NSError errorWithMobileImageMounterError:err device:altDevice]);
         }
                 
         NSError *error = nil;
-        NSDictionary *diskAttributes = [[NSFileManager defaultManager] attributesOfItemAtPath:diskURL.path error:&error];
-        if (diskAttributes == nil)
-        {
-            return finish(error);
-        }
         
-        NSDictionary *signatureAttributes = [[NSFileManager defaultManager] attributesOfItemAtPath:signatureURL.path error:&error];
-        if (signatureAttributes == nil)
+        // Map disk rather than reading it into memory, so pages are only loaded as they're uploaded.
+        NSData *disk = [[NSData alloc] initWithContentsOfURL:diskURL options:NSDataReadingMappedAlways error:&error];
+        if (disk == nil)
         {
             return finish(error);
         }
         
-        size_t diskSize = [diskAttributes fileSize];
-        
         NSData *signature = [[NSData alloc] initWithContentsOfURL:signatureURL options:0 error:&error];
         if (signature == nil)
         {
             return finish(error);
         }
         
-        FILE *file = fopen(diskURL.fileSystemRepresentation, "rb");
-        err = mobile_image_mounter_upload_image(mim, "Developer", diskSize, (const char *)signature.bytes, (size_t)signature.length, ALTDeviceManagerUploadFile, file);
-        fclose(file);
+        progress.totalUnitCount = MAX(disk.length, 1);
         
+        ALTDeviceManagerMappedFileUpload upload = { (const char *)disk.bytes, disk.length, 0, progress };
+        
+        NSDate *uploadStartDate = [NSDate date];
+        err = mobile_image_mounter_upload_image(mim, "Developer", disk.length, (const char *)signature.bytes, (size_t)signature.length, ALTDeviceManagerUploadMappedFile, &upload);
         if (err != MOBILE_IMAGE_MOUNTER_E_SUCCESS)
         {
             return finish([NSError errorWithMobileImageMounterError:err device:altDevice]);
         }
         
+        NSTimeInterval uploadDuration = -[uploadStartDate timeIntervalSinceNow];
+        NSLog(@"Uploaded developer disk (%@ bytes) to %@ in %.2fs (%.1f MB/s).", @(disk.length), altDevice.name, uploadDuration, (double)disk.length / MAX(uploadDuration, 0.001) / 1000000.0);
+        
         NSString *diskPath = @"/private/var/mobile/Media/PublicStaging/staging.dimage";
 
         plist_t result = NULL;
@@ -1283,18 +1972,25 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
                 finish(error);
             }
         }];
-    });
+    }];
+    
+    return progress;
 }
 
 #pragma mark - Apps -
 
 - (void)fetchInstalledAppsOnDevice:(ALTDevice *)altDevice completionHandler:(void (^)(NSSet<ALTInstalledApp *> *_Nullable installedApps, NSError *_Nullable error))completionHandler
 {
-    __block idevice_t device = NULL;
-    __block instproxy_client_t ipc = NULL;
-    __block lockdownd_client_t client = NULL;
-    __block lockdownd_service_descriptor_t service = NULL;
+    NSSet<ALTInstalledApp *> *cachedApps = [self cachedInstalledAppsForDeviceWithUDID:altDevice.identifier];
+    if (cachedApps != nil)
+    {
+        return completionHandler(cachedApps, nil);
+    }
+    
+    __block ALTDeviceSession *session = nil;
     __block plist_t options = NULL;
+    
+    NSUInteger cacheGeneration = [self installedAppsCacheGenerationForDeviceWithUDID:altDevice.identifier];
         
     void (^finish)(NSSet<ALTInstalledApp *> *, NSError *) = ^(NSSet<ALTInstalledApp *> *installedApps, NSError *error) {
         if (error != nil) {
@@ -1305,92 +2001,195 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
             instproxy_client_options_free(options);
         }
         
-        if (service) {
-            lockdownd_service_descriptor_free(service);
-        }
-        
-        if (client) {
-            lockdownd_client_free(client);
-        }
-                
-        if (ipc) {
-            instproxy_client_free(ipc);
+        if (session) {
+            if (error) {
+                [self.sessionPool invalidateSession:session];
+            }
+            else {
+                [self.sessionPool checkInSession:session];
+            }
         }
         
-        if (device) {
-            idevice_free(device);
+        if (installedApps != nil) {
+            [self cacheInstalledApps:installedApps forDeviceWithUDID:altDevice.identifier generation:cacheGeneration];
         }
         
         completionHandler(installedApps, error);
     };
     
-    // Don't use installationQueue since this operation can potentially take a very long time and will block other operations.
-    // dispatch_async(self.installationQueue, ^{
+    // Don't use installationScheduler since this operation can potentially take a very long time and will block other operations.
     dispatch_async(self.devicesQueue, ^{
-        /* Find Device */
-        if (idevice_new_with_options(&device, altDevice.identifier.UTF8String, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX)) != IDEVICE_E_SUCCESS)
+        NSError *sessionError = nil;
+        session = [self.sessionPool checkOutSessionForDeviceWithUDID:altDevice.identifier error:&sessionError];
+        if (session == nil)
         {
-            return finish(nil, [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorDeviceNotFound userInfo:nil]);
+            return finish(nil, sessionError);
         }
         
-        if (LOCKDOWN_E_SUCCESS != lockdownd_client_new_with_handshake(device, &client, "AltServer"))
+        instproxy_client_t ipc = [session installationProxyClientWithError:&sessionError];
+        if (ipc == NULL)
         {
-            return finish(nil, [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
+            return finish(nil, sessionError);
         }
         
-        if ((lockdownd_start_service(client, "com.apple.mobile.installation_proxy", &service) != LOCKDOWN_E_SUCCESS) || !service)
-        {
-            return finish(nil, [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil]);
-        }
+        // Only request attributes ALTInstalledApp needs, rather than every Info.plist value of every app.
+        options = instproxy_client_options_new();
+        instproxy_client_options_add(options, "ApplicationType", "User", NULL);
+        instproxy_client_options_set_return_attributes(options, "CFBundleIdentifier", "CFBundleName", "CFBundleExecutable", "ALTBundleIdentifier", NULL);
+        
+        NSMutableSet<ALTInstalledApp *> *installedApps = [NSMutableSet set];
+        __block NSError *browseError = nil;
+        
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        
+        // Called on instproxy's status thread once per page of results.
+        void (^statusHandler)(plist_t) = ^(plist_t status) {
+            uint64_t total = 0;
+            uint64_t currentIndex = 0;
+            uint64_t currentAmount = 0;
+            plist_t apps = NULL;
+            instproxy_status_get_current_list(status, &total, &currentIndex, &currentAmount, &apps);
+            
+            if (apps != NULL)
+            {
+                [self addInstalledAppsInList:apps toSet:installedApps];
+                plist_free(apps);
+            }
+            
+            char *errorName = NULL;
+            char *errorDescription = NULL;
+            uint64_t code = 0;
+            instproxy_status_get_error(status, &errorName, &errorDescription, &code);
+            
+            char *statusName = NULL;
+            instproxy_status_get_name(status, &statusName);
+            
+            if (code != 0 || errorName != NULL)
+            {
+                NSError *underlyingError = [NSError errorWithDomain:AltServerInstallationErrorDomain code:code userInfo:@{NSLocalizedDescriptionKey: @(errorDescription ?: errorName ?: "")}];
+                browseError = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorUnderlyingError userInfo:@{NSUnderlyingErrorKey: underlyingError}];
+                
+                dispatch_semaphore_signal(semaphore);
+            }
+            else if (statusName != NULL && strcmp(statusName, "Complete") == 0)
+            {
+                dispatch_semaphore_signal(semaphore);
+            }
+            
+            free(errorName);
+            free(errorDescription);
+            free(statusName);
+        };
         
-        instproxy_error_t err = instproxy_client_new(device, service, &ipc);
+        instproxy_error_t err = instproxy_browse_with_callback(ipc, options, ALTDeviceManagerUpdateBrowseStatus, (__bridge void *)statusHandler);
         if (err != INSTPROXY_E_SUCCESS)
         {
             return finish(nil, [NSError errorWithInstallationProxyError:err device:altDevice]);
         }
         
-        options = instproxy_client_options_new();
-        instproxy_client_options_add(options, "ApplicationType", "User", NULL);
+        if (dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, 90 * NSEC_PER_SEC)) != 0)
+        {
+            // Status thread may still reference statusHandler, so tear down connection (which waits for thread to exit) before returning.
+            [session invalidate];
+            return finish(nil, [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorLostConnection userInfo:nil]);
+        }
         
-        plist_t plist = NULL;
-        err = instproxy_browse(ipc, options, &plist);
-        if (err != INSTPROXY_E_SUCCESS)
+        if (browseError != nil)
         {
-            return finish(nil, [NSError errorWithInstallationProxyError:err device:altDevice]);
+            return finish(nil, browseError);
+        }
+        
+        finish(installedApps, nil);
+    });
+}
+
+- (void)addInstalledAppsInList:(plist_t)apps toSet:(NSMutableSet<ALTInstalledApp *> *)installedApps
+{
+    // Walk plist nodes directly instead of round-tripping through XML.
+    uint32_t count = plist_array_get_size(apps);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        plist_t app = plist_array_get_item(apps, i);
+        if (plist_get_node_type(app) != PLIST_DICT || plist_dict_get_item(app, "ALTBundleIdentifier") == NULL)
+        {
+            // Only return apps installed with AltStore.
+            continue;
         }
         
-        char *plistXML = NULL;
-        uint32_t length = 0;
-        plist_to_xml(plist, &plistXML, &length);
+        NSMutableDictionary *appInfo = [NSMutableDictionary dictionary];
         
-        NSData *plistData = [@(plistXML) dataUsingEncoding:NSUTF8StringEncoding];
-        free(plistXML);
-        plist_free(plist);
+        for (NSString *key in @[(NSString *)kCFBundleNameKey, (NSString *)kCFBundleIdentifierKey, (NSString *)kCFBundleExecutableKey])
+        {
+            plist_t node = plist_dict_get_item(app, key.UTF8String);
+            if (node == NULL || plist_get_node_type(node) != PLIST_STRING)
+            {
+                continue;
+            }
+            
+            char *value = NULL;
+            plist_get_string_val(node, &value);
+            
+            if (value != NULL)
+            {
+                appInfo[key] = @(value);
+                free(value);
+            }
+        }
         
-        NSError *error = nil;
-        NSArray *appDictionaries = [NSPropertyListSerialization propertyListWithData:plistData options:0 format:nil error:&error];
-        if (appDictionaries == nil)
+        ALTInstalledApp *installedApp = [[ALTInstalledApp alloc] initWithDictionary:appInfo];
+        if (installedApp)
         {
-            return finish(nil, error);
+            [installedApps addObject:installedApp];
+        }
+    }
+}
+
+- (nullable NSSet<ALTInstalledApp *> *)cachedInstalledAppsForDeviceWithUDID:(NSString *)udid
+{
+    @synchronized(self.installedAppsCache)
+    {
+        NSDate *cacheDate = self.installedAppsCacheDates[udid];
+        if (cacheDate == nil || -[cacheDate timeIntervalSinceNow] > ALTDeviceManagerInstalledAppsCacheLifetime)
+        {
+            // Apps can also be installed or removed on-device, so don't trust cache forever.
+            return nil;
         }
         
-        NSMutableSet *installedApps = [NSMutableSet set];
-        for (NSDictionary *appInfo in appDictionaries)
+        return self.installedAppsCache[udid];
+    }
+}
+
+- (NSUInteger)installedAppsCacheGenerationForDeviceWithUDID:(NSString *)udid
+{
+    @synchronized(self.installedAppsCache)
+    {
+        return [self.installedAppsCacheGenerations[udid] unsignedIntegerValue];
+    }
+}
+
+- (void)cacheInstalledApps:(NSSet<ALTInstalledApp *> *)installedApps forDeviceWithUDID:(NSString *)udid generation:(NSUInteger)generation
+{
+    @synchronized(self.installedAppsCache)
+    {
+        if ([self.installedAppsCacheGenerations[udid] unsignedIntegerValue] != generation)
         {
-            if (appInfo[@"ALTBundleIdentifier"] != nil)
-            {
-                // Only return apps installed with AltStore.
-                
-                ALTInstalledApp *installedApp = [[ALTInstalledApp alloc] initWithDictionary:appInfo];
-                if (installedApp)
-                {
-                    [installedApps addObject:installedApp];
-                }
-            }
+            // Cache was invalidated while fetching, so results may already be out of date.
+            return;
         }
         
-        finish(installedApps, nil);
-    });
+        self.installedAppsCache[udid] = installedApps;
+        self.installedAppsCacheDates[udid] = [NSDate date];
+    }
+}
+
+- (void)invalidateInstalledAppsCacheForDeviceWithUDID:(NSString *)udid
+{
+    @synchronized(self.installedAppsCache)
+    {
+        self.installedAppsCache[udid] = nil;
+        self.installedAppsCacheDates[udid] = nil;
+        self.installedAppsCacheGenerations[udid] = @([self.installedAppsCacheGenerations[udid] unsignedIntegerValue] + 1);
+    }
 }
 
 #pragma mark - Connections -
@@ -1504,7 +2303,65 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
 
 - (NSArray<ALTDevice *> *)availableDevicesIncludingNetworkDevices:(BOOL)includingNetworkDevices
 {
-    NSMutableSet *connectedDevices = [NSMutableSet set];
+    [self loadConnectedDeviceUDIDsIfNeeded];
+    
+    __block NSMutableSet<NSString *> *udids = nil;
+    dispatch_sync(self.registryQueue, ^{
+        udids = [self.usbDeviceUDIDs mutableCopy];
+        
+        if (includingNetworkDevices)
+        {
+            [udids unionSet:self.networkDeviceUDIDs];
+        }
+    });
+    
+    NSMutableArray<ALTDevice *> *devices = [NSMutableArray array];
+    
+    for (NSString *udid in udids)
+    {
+        ALTDevice *device = [self cachedDeviceWithUDID:udid includingNetworkDevices:includingNetworkDevices];
+        if (device != nil)
+        {
+            [devices addObject:device];
+        }
+    }
+    
+    return devices;
+}
+
+- (nullable ALTDevice *)availableDeviceWithUDID:(NSString *)udid
+{
+    [self loadConnectedDeviceUDIDsIfNeeded];
+    
+    __block BOOL isConnected = NO;
+    dispatch_sync(self.registryQueue, ^{
+        isConnected = [self.usbDeviceUDIDs containsObject:udid] || [self.networkDeviceUDIDs containsObject:udid];
+    });
+    
+    if (!isConnected)
+    {
+        return nil;
+    }
+    
+    ALTDevice *device = [self cachedDeviceWithUDID:udid includingNetworkDevices:YES];
+    return device;
+}
+
+#pragma mark - Device Registry -
+
+- (void)loadConnectedDeviceUDIDsIfNeeded
+{
+    // Connection events keep the registry up to date, but we still need the initial list of devices
+    // in case we're asked for devices before (or without) receiving events for already-connected devices.
+    __block BOOL didLoadDeviceUDIDs = NO;
+    dispatch_sync(self.registryQueue, ^{
+        didLoadDeviceUDIDs = self.didLoadDeviceUDIDs;
+    });
+    
+    if (didLoadDeviceUDIDs)
+    {
+        return;
+    }
     
     int count = 0;
     idevice_info_t *devices = NULL;
@@ -1512,140 +2369,232 @@ NSNotificationName const ALTDeviceManagerDeviceDidDisconnectNotification = @"ALT
     if (idevice_get_device_list_extended(&devices, &count) < 0)
     {
         fprintf(stderr, "ERROR: Unable to retrieve device list!\n");
-        return @[];
+        return;
     }
     
-    for (int i = 0; i < count; i++)
-    {
-        idevice_info_t device_info = devices[i];
-        char *udid = device_info->udid;
-        
-        idevice_t device = NULL;
-        lockdownd_client_t client = NULL;
-        
-        char *device_name = NULL;
-        char *device_type_string = NULL;
-        char *device_version_string = NULL;
-        
-        plist_t device_type_plist = NULL;
-        plist_t device_version_plist = NULL;
-        
-        void (^cleanUp)(void) = ^{
-            if (device_version_plist) {
-                plist_free(device_version_plist);
-            }
-            
-            if (device_type_plist) {
-                plist_free(device_type_plist);
-            }
-            
-            if (device_version_string) {
-                free(device_version_string);
-            }
-            
-            if (device_type_string) {
-                free(device_type_string);
-            }
-            
-            if (device_name) {
-                free(device_name);
-            }
+    dispatch_sync(self.registryQueue, ^{
+        for (int i = 0; i < count; i++)
+        {
+            idevice_info_t device_info = devices[i];
+            NSString *udid = @(device_info->udid);
             
-            if (client) {
-                lockdownd_client_free(client);
+            if (device_info->conn_type == CONNECTION_NETWORK)
+            {
+                [self.networkDeviceUDIDs addObject:udid];
             }
-            
-            if (device) {
-                idevice_free(device);
+            else
+            {
+                [self.usbDeviceUDIDs addObject:udid];
             }
-        };
+        }
         
-        if (includingNetworkDevices)
+        self.didLoadDeviceUDIDs = YES;
+    });
+    
+    idevice_device_list_extended_free(devices);
+}
+
+- (nullable ALTDevice *)cachedDeviceWithUDID:(NSString *)udid includingNetworkDevices:(BOOL)includingNetworkDevices
+{
+    __block ALTDevice *cachedDevice = nil;
+    dispatch_sync(self.registryQueue, ^{
+        cachedDevice = self.cachedDevices[udid];
+    });
+    
+    if (cachedDevice != nil)
+    {
+        return cachedDevice;
+    }
+    
+    // Device metadata doesn't change while connected, so we only need to ask lockdownd once per connection.
+    ALTDevice *device = [self fetchDeviceWithUDID:udid includingNetworkDevices:includingNetworkDevices];
+    if (device == nil)
+    {
+        return nil;
+    }
+    
+    dispatch_sync(self.registryQueue, ^{
+        BOOL isConnected = [self.usbDeviceUDIDs containsObject:udid] || [self.networkDeviceUDIDs containsObject:udid];
+        if (isConnected)
         {
-            idevice_new_with_options(&device, udid, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX));
+            // Don't cache device if it disconnected while we were fetching its metadata.
+            self.cachedDevices[udid] = device;
         }
-        else
-        {
-            idevice_new_with_options(&device, udid, IDEVICE_LOOKUP_USBMUX);
+    });
+    
+    return device;
+}
+
+- (nullable ALTDevice *)fetchDeviceWithUDID:(NSString *)identifier includingNetworkDevices:(BOOL)includingNetworkDevices
+{
+    const char *udid = identifier.UTF8String;
+    
+    idevice_t device = NULL;
+    lockdownd_client_t client = NULL;
+    
+    char *device_name = NULL;
+    char *device_type_string = NULL;
+    char *device_version_string = NULL;
+    
+    plist_t device_type_plist = NULL;
+    plist_t device_version_plist = NULL;
+    
+    ALTDevice * (^finish)(ALTDevice *) = ^ALTDevice *(ALTDevice *altDevice) {
+        if (device_version_plist) {
+            plist_free(device_version_plist);
         }
         
-        if (!device)
-        {
-            continue;
+        if (device_type_plist) {
+            plist_free(device_type_plist);
         }
         
-        int result = lockdownd_client_new(device, &client, "altserver");
-        if (result != LOCKDOWN_E_SUCCESS)
-        {
-            fprintf(stderr, "ERROR: Connecting to device %s failed! (%d)\n", udid, result);
-            
-            cleanUp();
-            continue;
+        if (device_version_string) {
+            free(device_version_string);
         }
         
-        if (lockdownd_get_device_name(client, &device_name) != LOCKDOWN_E_SUCCESS || device_name == NULL)
-        {
-            fprintf(stderr, "ERROR: Could not get device name!\n");
-            
-            cleanUp();
-            continue;
+        if (device_type_string) {
+            free(device_type_string);
         }
         
-        if (lockdownd_get_value(client, NULL, "ProductType", &device_type_plist) != LOCKDOWN_E_SUCCESS)
-        {
-            fprintf(stderr, "ERROR: Could not get device type for %s!\n", device_name);
-            
-            cleanUp();
-            continue;
+        if (device_name) {
+            free(device_name);
         }
         
-        plist_get_string_val(device_type_plist, &device_type_string);
-        
-        ALTDeviceType deviceType = ALTDeviceTypeiPhone;
-        if ([@(device_type_string) hasPrefix:@"iPhone"])
-        {
-            deviceType = ALTDeviceTypeiPhone;
-        }
-        else if ([@(device_type_string) hasPrefix:@"iPad"])
-        {
-            deviceType = ALTDeviceTypeiPad;
+        if (client) {
+            lockdownd_client_free(client);
         }
-        else if ([@(device_type_string) hasPrefix:@"AppleTV"])
-        {
-            deviceType = ALTDeviceTypeAppleTV;
+        
+        if (device) {
+            idevice_free(device);
         }
-        else
+        
+        return altDevice;
+    };
+    
+    if (includingNetworkDevices)
+    {
+        idevice_new_with_options(&device, udid, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX));
+    }
+    else
+    {
+        idevice_new_with_options(&device, udid, IDEVICE_LOOKUP_USBMUX);
+    }
+    
+    if (!device)
+    {
+        return finish(nil);
+    }
+    
+    int result = lockdownd_client_new(device, &client, "altserver");
+    if (result != LOCKDOWN_E_SUCCESS)
+    {
+        fprintf(stderr, "ERROR: Connecting to device %s failed! (%d)\n", udid, result);
+        return finish(nil);
+    }
+    
+    if (lockdownd_get_device_name(client, &device_name) != LOCKDOWN_E_SUCCESS || device_name == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not get device name!\n");
+        return finish(nil);
+    }
+    
+    if (lockdownd_get_value(client, NULL, "ProductType", &device_type_plist) != LOCKDOWN_E_SUCCESS)
+    {
+        fprintf(stderr, "ERROR: Could not get device type for %s!\n", device_name);
+        return finish(nil);
+    }
+    
+    plist_get_string_val(device_type_plist, &device_type_string);
+    
+    ALTDeviceType deviceType = ALTDeviceTypeiPhone;
+    if ([@(device_type_string) hasPrefix:@"iPhone"])
+    {
+        deviceType = ALTDeviceTypeiPhone;
+    }
+    else if ([@(device_type_string) hasPrefix:@"iPad"])
+    {
+        deviceType = ALTDeviceTypeiPad;
+    }
+    else if ([@(device_type_string) hasPrefix:@"AppleTV"])
+    {
+        deviceType = ALTDeviceTypeAppleTV;
+    }
+    else
+    {
+        fprintf(stderr, "ERROR: Unknown device type %s for %s!\n", device_type_string, device_name);
+        return finish(nil);
+    }
+    
+    if (lockdownd_get_value(client, NULL, "ProductVersion", &device_version_plist) != LOCKDOWN_E_SUCCESS)
+    {
+        fprintf(stderr, "ERROR: Could not get device type for %s!\n", device_name);
+        return finish(nil);
+    }
+    
+    plist_get_string_val(device_version_plist, &device_version_string);
+    NSOperatingSystemVersion osVersion = NSOperatingSystemVersionFromString(@(device_version_string));
+    
+    NSString *name = [NSString stringWithCString:device_name encoding:NSUTF8StringEncoding];
+    
+    ALTDevice *altDevice = [[ALTDevice alloc] initWithName:name identifier:identifier type:deviceType];
+    altDevice.osVersion = osVersion;
+    
+    return finish(altDevice);
+}
+
+- (void)handleDeviceEvent:(const idevice_event_t *)event
+{
+    NSString *udid = @(event->udid);
+    BOOL isNetworkConnection = (event->conn_type == CONNECTION_NETWORK);
+    
+    switch (event->event)
+    {
+        case IDEVICE_DEVICE_ADD:
         {
-            fprintf(stderr, "ERROR: Unknown device type %s for %s!\n", device_type_string, device_name);
+            dispatch_sync(self.registryQueue, ^{
+                NSMutableSet<NSString *> *udids = isNetworkConnection ? self.networkDeviceUDIDs : self.usbDeviceUDIDs;
+                [udids addObject:udid];
+            });
             
-            cleanUp();
-            continue;
+            if (!isNetworkConnection)
+            {
+                ALTDevice *device = [self cachedDeviceWithUDID:udid includingNetworkDevices:NO];
+                [[NSNotificationCenter defaultCenter] postNotificationName:ALTDeviceManagerDeviceDidConnectNotification object:device];
+            }
+            
+            break;
         }
-        
-        if (lockdownd_get_value(client, NULL, "ProductVersion", &device_version_plist) != LOCKDOWN_E_SUCCESS)
+            
+        case IDEVICE_DEVICE_REMOVE:
         {
-            fprintf(stderr, "ERROR: Could not get device type for %s!\n", device_name);
+            __block ALTDevice *device = nil;
+            dispatch_sync(self.registryQueue, ^{
+                device = self.cachedDevices[udid];
+                
+                NSMutableSet<NSString *> *udids = isNetworkConnection ? self.networkDeviceUDIDs : self.usbDeviceUDIDs;
+                [udids removeObject:udid];
+                
+                if (![self.usbDeviceUDIDs containsObject:udid] && ![self.networkDeviceUDIDs containsObject:udid])
+                {
+                    // Forget metadata once device is completely disconnected, since it may have been renamed or updated before reconnecting.
+                    self.cachedDevices[udid] = nil;
+                }
+            });
             
-            cleanUp();
-            continue;
+            // Pooled sessions may be bound to the connection that just went away, so don't reuse them.
+            [self.sessionPool invalidateSessionsForDeviceWithUDID:udid];
+            [self invalidateInstalledAppsCacheForDeviceWithUDID:udid];
+            
+            if (!isNetworkConnection)
+            {
+                [[NSNotificationCenter defaultCenter] postNotificationName:ALTDeviceManagerDeviceDidDisconnectNotification object:device];
+            }
+            
+            break;
         }
-        
-        plist_get_string_val(device_version_plist, &device_version_string);
-        NSOperatingSystemVersion osVersion = NSOperatingSystemVersionFromString(@(device_version_string));
-        
-        NSString *name = [NSString stringWithCString:device_name encoding:NSUTF8StringEncoding];
-        NSString *identifier = [NSString stringWithCString:udid encoding:NSUTF8StringEncoding];
-        
-        ALTDevice *altDevice = [[ALTDevice alloc] initWithName:name identifier:identifier type:deviceType];
-        altDevice.osVersion = osVersion;
-        [connectedDevices addObject:altDevice];
-        
-        cleanUp();
+            
+        default: break;
     }
-    
-    idevice_device_list_extended_free(devices);
-    
-    return connectedDevices.allObjects;
 }
 
 @end
@@ -1656,7 +2605,14 @@ void ALTDeviceManagerUpdateStatus(plist_t command, plist_t status, void *uuid)
 {
     NSUUID *UUID = [[NSUUID alloc] initWithUUIDString:[NSString stringWithUTF8String:(const char *)uuid]];
     
-    NSProgress *progress = ALTDeviceManager.sharedManager.installationProgress[UUID];
+    ALTDeviceManager *manager = ALTDeviceManager.sharedManager;
+    
+    NSProgress *progress = nil;
+    @synchronized(manager)
+    {
+        progress = manager.installationProgress[UUID];
+    }
+    
     if (progress == nil)
     {
         return;
@@ -1672,7 +2628,15 @@ void ALTDeviceManagerUpdateStatus(plist_t command, plist_t status, void *uuid)
     
     if ((percent == -1 && progress.completedUnitCount > 0) || code != 0 || name != NULL)
     {
-        void (^completionHandler)(NSError *) = ALTDeviceManager.sharedManager.installationCompletionHandlers[UUID];
+        // Remove completion handler before calling it to ensure it's only called once.
+        void (^completionHandler)(NSError *) = nil;
+        @synchronized(manager)
+        {
+            completionHandler = manager.installationCompletionHandlers[UUID];
+            manager.installationCompletionHandlers[UUID] = nil;
+            manager.installationProgress[UUID] = nil;
+        }
+        
         if (completionHandler != nil)
         {
             NSString *localizedDescription = @(description ?: "");
@@ -1710,9 +2674,6 @@ void ALTDeviceManagerUpdateStatus(plist_t command, plist_t status, void *uuid)
                 NSLog(@"Finished installing app!");
                 completionHandler(nil);
             }
-            
-            ALTDeviceManager.sharedManager.installationCompletionHandlers[UUID] = nil;
-            ALTDeviceManager.sharedManager.installationProgress[UUID] = nil;
         }
     }
     else if (progress.completedUnitCount < percent)
@@ -1737,7 +2698,16 @@ void ALTDeviceManagerUpdateAppDeletionStatus(plist_t command, plist_t status, vo
     
     if ([@(statusName) isEqualToString:@"Complete"] || code != 0 || errorName != NULL)
     {
-        void (^completionHandler)(NSError *) = ALTDeviceManager.sharedManager.deletionCompletionHandlers[UUID];
+        ALTDeviceManager *manager = ALTDeviceManager.sharedManager;
+        
+        // Remove completion handler before calling it to ensure it's only called once.
+        void (^completionHandler)(NSError *) = nil;
+        @synchronized(manager)
+        {
+            completionHandler = manager.deletionCompletionHandlers[UUID];
+            manager.deletionCompletionHandlers[UUID] = nil;
+        }
+        
         if (completionHandler != nil)
         {
             if (code != 0 || errorName != NULL)
@@ -1754,59 +2724,63 @@ void ALTDeviceManagerUpdateAppDeletionStatus(plist_t command, plist_t status, vo
                 NSLog(@"Finished removing app!");
                 completionHandler(nil);
             }
-            
-            ALTDeviceManager.sharedManager.deletionCompletionHandlers[UUID] = nil;
         }
     }
 }
 
+void ALTDeviceManagerUpdateBrowseStatus(plist_t command, plist_t status, void *statusHandler)
+{
+    void (^handler)(plist_t) = (__bridge void (^)(plist_t))statusHandler;
+    handler(status);
+}
+
 void ALTDeviceDidChangeConnectionStatus(const idevice_event_t *event, void *user_data)
 {
-    ALTDevice * (^deviceForUDID)(NSString *, NSArray<ALTDevice *> *) = ^ALTDevice *(NSString *udid, NSArray<ALTDevice *> *devices) {
-        for (ALTDevice *device in devices)
-        {
-            if ([device.identifier isEqualToString:udid])
-            {
-                return device;
-            }
-        }
-        
-        return nil;
-    };
-    
-    switch (event->event)
-    {
-        case IDEVICE_DEVICE_ADD:
-        {
-            ALTDevice *device = deviceForUDID(@(event->udid), ALTDeviceManager.sharedManager.connectedDevices);
-            [[NSNotificationCenter defaultCenter] postNotificationName:ALTDeviceManagerDeviceDidConnectNotification object:device];
-            
-            if (device)
-            {
-                [ALTDeviceManager.sharedManager.cachedDevices addObject:device];
-            }
-            
-            break;
-        }
-            
-        case IDEVICE_DEVICE_REMOVE:
-        {
-            ALTDevice *device = deviceForUDID(@(event->udid), ALTDeviceManager.sharedManager.cachedDevices.allObjects);
-            [[NSNotificationCenter defaultCenter] postNotificationName:ALTDeviceManagerDeviceDidDisconnectNotification object:device];
-            
-            if (device)
-            {
-                 [ALTDeviceManager.sharedManager.cachedDevices removeObject:device];
-            }
+    [ALTDeviceManager.sharedManager handleDeviceEvent:event];
+}
 
-            break;
-        }
-            
-        default: break;
-    }
+ssize_t ALTDeviceManagerUploadMappedFile(void *buffer, size_t size, void *user_data)
+{
+    ALTDeviceManagerMappedFileUpload *upload = (ALTDeviceManagerMappedFileUpload *)user_data;
+    
+    size_t length = MIN(size, upload->length - upload->offset);
+    memcpy(buffer, upload->bytes + upload->offset, length);
+    upload->offset += length;
+    
+    upload->progress.completedUnitCount = upload->offset;
+    
+    return (ssize_t)length;
 }
 
-ssize_t ALTDeviceManagerUploadFile(void *buffer, size_t size, void *user_data)
+NSString *_Nullable ALTProvisioningProfileUUIDStringFromData(NSData *data)
 {
-    return fread(buffer, 1, size, (FILE*)user_data);
+    // Provisioning profiles embed their plist unencrypted, so we can find UUID without decoding CMS envelope.
+    static const char keyTag[] = "<key>UUID</key>";
+    static const char stringStartTag[] = "<string>";
+    static const char stringEndTag[] = "</string>";
+    
+    const char *bytes = (const char *)data.bytes;
+    const char *end = bytes + data.length;
+    
+    const char *key = (const char *)memmem(bytes, data.length, keyTag, sizeof(keyTag) - 1);
+    if (key == NULL)
+    {
+        return nil;
+    }
+    
+    const char *valueStart = (const char *)memmem(key, end - key, stringStartTag, sizeof(stringStartTag) - 1);
+    if (valueStart == NULL)
+    {
+        return nil;
+    }
+    
+    valueStart += sizeof(stringStartTag) - 1;
+    
+    const char *valueEnd = (const char *)memmem(valueStart, end - valueStart, stringEndTag, sizeof(stringEndTag) - 1);
+    if (valueEnd == NULL || valueEnd - valueStart > 64)
+    {
+        return nil;
+    }
+    
+    return [[NSString alloc] initWithBytes:valueStart length:valueEnd - valueStart encoding:NSUTF8StringEncoding];
 }
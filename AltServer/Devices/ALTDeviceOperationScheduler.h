@@ -0,0 +1,43 @@
+//
+//  ALTDeviceOperationScheduler.h
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void (^ALTDeviceOperationBlock)(dispatch_block_t operationDidFinish);
+
+@interface ALTDeviceOperationMetrics : NSObject
+
+// Operations waiting to start (not including the running one, if any).
+@property (nonatomic, readonly) NSUInteger queueDepth;
+
+@property (nonatomic, readonly) NSUInteger completedOperationCount;
+
+@property (nonatomic, readonly) NSTimeInterval averageWaitTime;
+@property (nonatomic, readonly) NSTimeInterval maximumWaitTime;
+
+@end
+
+// Runs device operations in one serial lane per device, with at most maximumConcurrentOperationCount lanes running at once.
+// When more lanes have pending operations than there are free slots, lanes are serviced round-robin so one device can't starve others.
+@interface ALTDeviceOperationScheduler : NSObject
+
+@property (nonatomic, readonly) NSInteger maximumConcurrentOperationCount;
+
+- (instancetype)initWithMaximumConcurrentOperationCount:(NSInteger)maximumConcurrentOperationCount NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+// Operation must call operationDidFinish exactly once when done (which may be asynchronous) so the next operation for device can start.
+- (void)scheduleOperationForDeviceWithUDID:(NSString *)udid usingBlock:(ALTDeviceOperationBlock)block;
+
+- (ALTDeviceOperationMetrics *)metricsForDeviceWithUDID:(NSString *)udid;
+
+@end
+
+NS_ASSUME_NONNULL_END
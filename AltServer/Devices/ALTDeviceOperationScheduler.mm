@@ -0,0 +1,202 @@
+//
+//  ALTDeviceOperationScheduler.mm
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import "ALTDeviceOperationScheduler.h"
+
+@interface ALTDeviceOperationMetrics ()
+
+@property (nonatomic, readwrite) NSUInteger queueDepth;
+@property (nonatomic, readwrite) NSUInteger completedOperationCount;
+@property (nonatomic, readwrite) NSTimeInterval averageWaitTime;
+@property (nonatomic, readwrite) NSTimeInterval maximumWaitTime;
+
+@end
+
+@implementation ALTDeviceOperationMetrics
+@end
+
+@interface ALTDeviceOperation : NSObject
+
+@property (nonatomic, copy) ALTDeviceOperationBlock block;
+@property (nonatomic) CFAbsoluteTime enqueueTime;
+@property (nonatomic) BOOL didFinish;
+
+@end
+
+@implementation ALTDeviceOperation
+@end
+
+@interface ALTDeviceOperationLane : NSObject
+
+@property (nonatomic, copy) NSString *udid;
+@property (nonatomic, readonly) NSMutableArray<ALTDeviceOperation *> *pendingOperations;
+@property (nonatomic, getter=isRunning) BOOL running;
+
+@property (nonatomic) NSUInteger startedOperationCount;
+@property (nonatomic) NSUInteger completedOperationCount;
+@property (nonatomic) NSTimeInterval totalWaitTime;
+@property (nonatomic) NSTimeInterval maximumWaitTime;
+
+@end
+
+@implementation ALTDeviceOperationLane
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _pendingOperations = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+@end
+
+@interface ALTDeviceOperationScheduler ()
+
+@property (nonatomic, readonly) dispatch_queue_t schedulerQueue;
+@property (nonatomic, readonly) dispatch_queue_t operationsQueue;
+
+// Only access on schedulerQueue.
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, ALTDeviceOperationLane *> *lanes;
+@property (nonatomic, readonly) NSMutableOrderedSet<NSString *> *readyDeviceUDIDs; // Lanes with pending operations that aren't running, in the order they became ready.
+@property (nonatomic) NSInteger runningOperationCount;
+
+@end
+
+@implementation ALTDeviceOperationScheduler
+
+- (instancetype)initWithMaximumConcurrentOperationCount:(NSInteger)maximumConcurrentOperationCount
+{
+    self = [super init];
+    if (self)
+    {
+        _maximumConcurrentOperationCount = MAX(maximumConcurrentOperationCount, 1);
+
+        _schedulerQueue = dispatch_queue_create("com.rileytestut.AltServer.DeviceOperationScheduler", DISPATCH_QUEUE_SERIAL);
+        _operationsQueue = dispatch_queue_create("com.rileytestut.AltServer.Installation", DISPATCH_QUEUE_CONCURRENT_WITH_AUTORELEASE_POOL);
+
+        _lanes = [NSMutableDictionary dictionary];
+        _readyDeviceUDIDs = [NSMutableOrderedSet orderedSet];
+    }
+
+    return self;
+}
+
+- (void)scheduleOperationForDeviceWithUDID:(NSString *)udid usingBlock:(ALTDeviceOperationBlock)block
+{
+    ALTDeviceOperation *operation = [[ALTDeviceOperation alloc] init];
+    operation.block = block;
+    operation.enqueueTime = CFAbsoluteTimeGetCurrent();
+
+    dispatch_async(self.schedulerQueue, ^{
+        ALTDeviceOperationLane *lane = self.lanes[udid];
+        if (lane == nil)
+        {
+            lane = [[ALTDeviceOperationLane alloc] init];
+            lane.udid = udid;
+            self.lanes[udid] = lane;
+        }
+
+        [lane.pendingOperations addObject:operation];
+
+        if (!lane.isRunning)
+        {
+            [self.readyDeviceUDIDs addObject:udid];
+        }
+
+        [self startOperationsIfNeeded];
+    });
+}
+
+- (ALTDeviceOperationMetrics *)metricsForDeviceWithUDID:(NSString *)udid
+{
+    ALTDeviceOperationMetrics *metrics = [[ALTDeviceOperationMetrics alloc] init];
+
+    dispatch_sync(self.schedulerQueue, ^{
+        ALTDeviceOperationLane *lane = self.lanes[udid];
+        if (lane == nil)
+        {
+            return;
+        }
+
+        metrics.queueDepth = lane.pendingOperations.count;
+        metrics.completedOperationCount = lane.completedOperationCount;
+        metrics.averageWaitTime = (lane.startedOperationCount > 0) ? lane.totalWaitTime / lane.startedOperationCount : 0;
+        metrics.maximumWaitTime = lane.maximumWaitTime;
+    });
+
+    return metrics;
+}
+
+#pragma mark - Private -
+
+- (void)startOperationsIfNeeded
+{
+    while (self.runningOperationCount < self.maximumConcurrentOperationCount && self.readyDeviceUDIDs.count > 0)
+    {
+        NSString *udid = self.readyDeviceUDIDs.firstObject;
+        [self.readyDeviceUDIDs removeObjectAtIndex:0];
+
+        ALTDeviceOperationLane *lane = self.lanes[udid];
+
+        ALTDeviceOperation *operation = lane.pendingOperations.firstObject;
+        [lane.pendingOperations removeObjectAtIndex:0];
+
+        lane.running = YES;
+        self.runningOperationCount++;
+
+        NSTimeInterval waitTime = CFAbsoluteTimeGetCurrent() - operation.enqueueTime;
+        lane.startedOperationCount++;
+        lane.totalWaitTime += waitTime;
+        lane.maximumWaitTime = MAX(lane.maximumWaitTime, waitTime);
+
+        NSLog(@"Starting operation for device %@ after waiting %.2fs. Queue Depth: %@. Running Operations: %@/%@.", udid, waitTime, @(lane.pendingOperations.count), @(self.runningOperationCount), @(self.maximumConcurrentOperationCount));
+
+        ALTDeviceOperationBlock block = operation.block;
+        dispatch_async(self.operationsQueue, ^{
+            block(^{
+                dispatch_async(self.schedulerQueue, ^{
+                    [self finishOperation:operation inLane:lane];
+                });
+            });
+        });
+    }
+}
+
+- (void)finishOperation:(ALTDeviceOperation *)operation inLane:(ALTDeviceOperationLane *)lane
+{
+    if (operation.didFinish)
+    {
+        NSLog(@"Operation for device %@ finished more than once.", lane.udid);
+        return;
+    }
+
+    operation.didFinish = YES;
+    operation.block = nil; // Break any retain cycles.
+
+    lane.running = NO;
+    lane.completedOperationCount++;
+    self.runningOperationCount--;
+
+    if (lane.pendingOperations.count > 0)
+    {
+        // Go to back of the line so other devices get a turn.
+        [self.readyDeviceUDIDs addObject:lane.udid];
+    }
+    else
+    {
+        NSLog(@"Finished all operations for device %@. Average Wait: %.2fs. Max Wait: %.2fs.", lane.udid, lane.totalWaitTime / MAX(lane.startedOperationCount, 1), lane.maximumWaitTime);
+    }
+
+    [self startOperationsIfNeeded];
+}
+
+@end
@@ -0,0 +1,67 @@
+//
+//  ALTDeviceSession.h
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#include <libimobiledevice/libimobiledevice.h>
+#include <libimobiledevice/lockdown.h>
+#include <libimobiledevice/installation_proxy.h>
+#include <libimobiledevice/afc.h>
+#include <libimobiledevice/misagent.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Paired lockdown session to a single device, plus lazily started service clients that can be reused between operations.
+// The installation proxy client is the exception: it's closed whenever the session is checked in, since its commands finish asynchronously.
+// Sessions are not thread-safe, so only use them while checked out from an ALTDeviceSessionPool.
+@interface ALTDeviceSession : NSObject
+
+@property (nonatomic, copy, readonly) NSString *udid;
+
+@property (nonatomic, readonly) idevice_t device;
+@property (nonatomic, readonly) lockdownd_client_t lockdownClient;
+
+// NO once the session has been invalidated or the device stopped responding to lockdownd.
+@property (nonatomic, readonly, getter=isValid) BOOL valid;
+
+- (nullable instancetype)initWithDeviceUDID:(NSString *)udid error:(NSError **)error NS_DESIGNATED_INITIALIZER;
+- (instancetype)init NS_UNAVAILABLE;
+
+- (nullable instproxy_client_t)installationProxyClientWithError:(NSError **)error;
+- (nullable misagent_client_t)misagentClientWithError:(NSError **)error;
+- (nullable afc_client_t)afcClientWithError:(NSError **)error;
+
+// Frees installation proxy client (if any), blocking until its status thread has exited. Must not be called from that status thread.
+- (void)closeInstallationProxyClient;
+
+// Starts an arbitrary service over this session's lockdown connection. Caller is responsible for freeing the returned descriptor.
+- (nullable lockdownd_service_descriptor_t)startService:(NSString *)serviceName error:(NSError **)error;
+
+- (void)invalidate;
+
+@end
+
+// Caches idle sessions per device so back-to-back operations can skip the lockdown handshake.
+// Sessions are checked out exclusively, then returned with checkInSession: (or discarded with invalidateSession:).
+// Both are safe to call from instproxy status callbacks.
+@interface ALTDeviceSessionPool : NSObject
+
+// Idle sessions are closed after this many seconds.
+@property (nonatomic) NSTimeInterval idleTimeout;
+
+- (nullable ALTDeviceSession *)checkOutSessionForDeviceWithUDID:(NSString *)udid error:(NSError **)error;
+
+- (void)checkInSession:(ALTDeviceSession *)session;
+- (void)invalidateSession:(ALTDeviceSession *)session;
+
+// Closes all idle sessions for device, and prevents sessions currently checked out from being reused.
+- (void)invalidateSessionsForDeviceWithUDID:(NSString *)udid;
+
+@end
+
+NS_ASSUME_NONNULL_END
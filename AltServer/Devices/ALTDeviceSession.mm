@@ -0,0 +1,419 @@
+//
+//  ALTDeviceSession.mm
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import "ALTDeviceSession.h"
+
+#import "NSError+ALTServerError.h"
+
+// Maximum number of idle sessions kept per device. Most requests are serialized per device, so more are rarely needed.
+static const NSUInteger ALTDeviceSessionPoolMaximumIdleSessionCount = 2;
+
+@interface ALTDeviceSession ()
+{
+    instproxy_client_t _installationProxyClient;
+    misagent_client_t _misagentClient;
+    afc_client_t _afcClient;
+}
+
+@property (nonatomic, readwrite) idevice_t device;
+@property (nonatomic, readwrite) lockdownd_client_t lockdownClient;
+
+// Only accessed by ALTDeviceSessionPool on its queue.
+@property (nonatomic) CFAbsoluteTime idleStartTime;
+
+@end
+
+@implementation ALTDeviceSession
+
+- (nullable instancetype)initWithDeviceUDID:(NSString *)udid error:(NSError **)error
+{
+    self = [super init];
+    if (self)
+    {
+        _udid = [udid copy];
+
+        /* Find Device */
+        if (idevice_new_with_options(&_device, udid.UTF8String, (enum idevice_options)((int)IDEVICE_LOOKUP_NETWORK | (int)IDEVICE_LOOKUP_USBMUX)) != IDEVICE_E_SUCCESS)
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorDeviceNotFound userInfo:nil];
+            }
+
+            return nil;
+        }
+
+        /* Connect to Device */
+        if (lockdownd_client_new_with_handshake(_device, &_lockdownClient, "altserver") != LOCKDOWN_E_SUCCESS)
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil];
+            }
+
+            return nil;
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self invalidate];
+}
+
+- (void)invalidate
+{
+    [self closeInstallationProxyClient];
+
+    if (_misagentClient)
+    {
+        misagent_client_free(_misagentClient);
+        _misagentClient = NULL;
+    }
+
+    if (_afcClient)
+    {
+        afc_client_free(_afcClient);
+        _afcClient = NULL;
+    }
+
+    if (_lockdownClient)
+    {
+        lockdownd_client_free(_lockdownClient);
+        _lockdownClient = NULL;
+    }
+
+    if (_device)
+    {
+        idevice_free(_device);
+        _device = NULL;
+    }
+}
+
+- (void)closeInstallationProxyClient
+{
+    if (_installationProxyClient)
+    {
+        // Waits for status thread of any in-progress asynchronous command to exit.
+        instproxy_client_free(_installationProxyClient);
+        _installationProxyClient = NULL;
+    }
+}
+
+#pragma mark - Services -
+
+- (nullable lockdownd_service_descriptor_t)startService:(NSString *)serviceName error:(NSError **)error
+{
+    lockdownd_service_descriptor_t service = NULL;
+    if (self.lockdownClient == NULL || lockdownd_start_service(self.lockdownClient, serviceName.UTF8String, &service) != LOCKDOWN_E_SUCCESS || service == NULL)
+    {
+        if (service)
+        {
+            lockdownd_service_descriptor_free(service);
+        }
+
+        if (error)
+        {
+            *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil];
+        }
+
+        return NULL;
+    }
+
+    return service;
+}
+
+- (nullable instproxy_client_t)installationProxyClientWithError:(NSError **)error
+{
+    if (_installationProxyClient)
+    {
+        return _installationProxyClient;
+    }
+
+    lockdownd_service_descriptor_t service = [self startService:@"com.apple.mobile.installation_proxy" error:error];
+    if (service == NULL)
+    {
+        return NULL;
+    }
+
+    instproxy_error_t result = instproxy_client_new(self.device, service, &_installationProxyClient);
+    lockdownd_service_descriptor_free(service);
+
+    if (result != INSTPROXY_E_SUCCESS)
+    {
+        _installationProxyClient = NULL;
+
+        if (error)
+        {
+            *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil];
+        }
+
+        return NULL;
+    }
+
+    return _installationProxyClient;
+}
+
+- (nullable misagent_client_t)misagentClientWithError:(NSError **)error
+{
+    if (_misagentClient)
+    {
+        return _misagentClient;
+    }
+
+    lockdownd_service_descriptor_t service = [self startService:@"com.apple.misagent" error:error];
+    if (service == NULL)
+    {
+        return NULL;
+    }
+
+    misagent_error_t result = misagent_client_new(self.device, service, &_misagentClient);
+    lockdownd_service_descriptor_free(service);
+
+    if (result != MISAGENT_E_SUCCESS)
+    {
+        _misagentClient = NULL;
+
+        if (error)
+        {
+            *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil];
+        }
+
+        return NULL;
+    }
+
+    return _misagentClient;
+}
+
+- (nullable afc_client_t)afcClientWithError:(NSError **)error
+{
+    if (_afcClient)
+    {
+        return _afcClient;
+    }
+
+    lockdownd_service_descriptor_t service = [self startService:@"com.apple.afc" error:error];
+    if (service == NULL)
+    {
+        return NULL;
+    }
+
+    afc_error_t result = afc_client_new(self.device, service, &_afcClient);
+    lockdownd_service_descriptor_free(service);
+
+    if (result != AFC_E_SUCCESS)
+    {
+        _afcClient = NULL;
+
+        if (error)
+        {
+            *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:nil];
+        }
+
+        return NULL;
+    }
+
+    return _afcClient;
+}
+
+#pragma mark - Getters -
+
+- (BOOL)isValid
+{
+    if (self.lockdownClient == NULL)
+    {
+        return NO;
+    }
+
+    // Cheap round trip over the existing (already paired) lockdown connection.
+    char *type = NULL;
+    lockdownd_error_t result = lockdownd_query_type(self.lockdownClient, &type);
+    free(type);
+
+    return (result == LOCKDOWN_E_SUCCESS);
+}
+
+@end
+
+@interface ALTDeviceSessionPool ()
+
+@property (nonatomic, readonly) dispatch_queue_t sessionsQueue;
+
+// Only access on sessionsQueue.
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, NSMutableArray<ALTDeviceSession *> *> *idleSessions;
+@property (nonatomic, readonly) NSMutableSet<ALTDeviceSession *> *activeSessions;
+@property (nonatomic, readonly) NSMutableSet<ALTDeviceSession *> *retiredSessions;
+
+@end
+
+@implementation ALTDeviceSessionPool
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _idleTimeout = 15.0;
+
+        _sessionsQueue = dispatch_queue_create("com.rileytestut.AltServer.DeviceSessions", DISPATCH_QUEUE_SERIAL);
+
+        _idleSessions = [NSMutableDictionary dictionary];
+        _activeSessions = [NSMutableSet set];
+        _retiredSessions = [NSMutableSet set];
+    }
+
+    return self;
+}
+
+- (nullable ALTDeviceSession *)checkOutSessionForDeviceWithUDID:(NSString *)udid error:(NSError **)error
+{
+    while (YES)
+    {
+        __block ALTDeviceSession *session = nil;
+        dispatch_sync(self.sessionsQueue, ^{
+            // Prefer most recently used session, since it's least likely to have timed out.
+            NSMutableArray<ALTDeviceSession *> *sessions = self.idleSessions[udid];
+            session = sessions.lastObject;
+
+            if (session != nil)
+            {
+                [sessions removeLastObject];
+                [self.activeSessions addObject:session];
+            }
+        });
+
+        if (session == nil)
+        {
+            break;
+        }
+
+        if (session.isValid)
+        {
+            NSLog(@"Reusing session for device %@.", udid);
+            return session;
+        }
+
+        NSLog(@"Discarding stale session for device %@.", udid);
+        [self invalidateSession:session];
+    }
+
+    ALTDeviceSession *session = [[ALTDeviceSession alloc] initWithDeviceUDID:udid error:error];
+    if (session == nil)
+    {
+        return nil;
+    }
+
+    dispatch_sync(self.sessionsQueue, ^{
+        [self.activeSessions addObject:session];
+    });
+
+    return session;
+}
+
+- (void)checkInSession:(ALTDeviceSession *)session
+{
+    // Installation proxy commands are asynchronous, so sessions are often checked in from instproxy's status thread while it still owns the client.
+    // Rather than risk the next operation racing that thread (or failing with INSTPROXY_E_OP_IN_PROGRESS), never pool installation proxy clients.
+    // Freeing client waits for status thread to exit, so do it on another queue to avoid deadlocking when called from status thread itself.
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [session closeInstallationProxyClient];
+        [self addIdleSession:session];
+    });
+}
+
+- (void)addIdleSession:(ALTDeviceSession *)session
+{
+    dispatch_async(self.sessionsQueue, ^{
+        [self.activeSessions removeObject:session];
+
+        if ([self.retiredSessions containsObject:session])
+        {
+            // Device disconnected while session was checked out.
+            [self.retiredSessions removeObject:session];
+            [self closeSessions:@[session]];
+            return;
+        }
+
+        NSMutableArray<ALTDeviceSession *> *sessions = self.idleSessions[session.udid];
+        if (sessions == nil)
+        {
+            sessions = [NSMutableArray array];
+            self.idleSessions[session.udid] = sessions;
+        }
+
+        if (sessions.count >= ALTDeviceSessionPoolMaximumIdleSessionCount)
+        {
+            [self closeSessions:@[session]];
+            return;
+        }
+
+        CFAbsoluteTime idleStartTime = CFAbsoluteTimeGetCurrent();
+        session.idleStartTime = idleStartTime;
+        [sessions addObject:session];
+
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.idleTimeout * NSEC_PER_SEC)), self.sessionsQueue, ^{
+            NSMutableArray<ALTDeviceSession *> *sessions = self.idleSessions[session.udid];
+            if (![sessions containsObject:session] || session.idleStartTime != idleStartTime)
+            {
+                // Session was checked out (and possibly checked back in) in the meantime.
+                return;
+            }
+
+            [sessions removeObject:session];
+            [self closeSessions:@[session]];
+        });
+    });
+}
+
+- (void)invalidateSession:(ALTDeviceSession *)session
+{
+    dispatch_async(self.sessionsQueue, ^{
+        [self.activeSessions removeObject:session];
+        [self.retiredSessions removeObject:session];
+
+        [self closeSessions:@[session]];
+    });
+}
+
+- (void)invalidateSessionsForDeviceWithUDID:(NSString *)udid
+{
+    dispatch_async(self.sessionsQueue, ^{
+        NSArray<ALTDeviceSession *> *sessions = [self.idleSessions[udid] copy];
+        self.idleSessions[udid] = nil;
+
+        [self closeSessions:sessions];
+
+        for (ALTDeviceSession *session in self.activeSessions)
+        {
+            if ([session.udid isEqualToString:udid])
+            {
+                [self.retiredSessions addObject:session];
+            }
+        }
+    });
+}
+
+- (void)closeSessions:(NSArray<ALTDeviceSession *> *)sessions
+{
+    if (sessions.count == 0)
+    {
+        return;
+    }
+
+    // Closing sessions may block on device I/O, so don't hold up sessionsQueue.
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        for (ALTDeviceSession *session in sessions)
+        {
+            [session invalidate];
+        }
+    });
+}
+
+@end
@@ -26,4 +26,9 @@ extension FileManager
         let developerDisksDirectoryURL = self.altserverDirectory.appendingPathComponent("DeveloperDiskImages")
         return developerDisksDirectoryURL
     }
+    
+    @objc var stagedAppManifestsDirectory: URL {
+        let stagedAppManifestsDirectoryURL = self.altserverDirectory.appendingPathComponent("StagedApps")
+        return stagedAppManifestsDirectoryURL
+    }
 }
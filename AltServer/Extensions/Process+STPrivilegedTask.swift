@@ -68,4 +68,30 @@ extension Process
         
         return task.authorization
     }
+    
+    // Launches program with admin privileges without waiting for it to exit. Used for long-running helpers.
+    class func launchAsAdmin(_ program: String, arguments: [String], authorization: AuthorizationRef? = nil) throws -> AuthorizationRef?
+    {
+        Logger.main.info("Launching background admin process: \(program, privacy: .public)")
+        
+        let task = STPrivilegedTask()
+        task.launchPath = program
+        task.arguments = arguments
+        task.freeAuthorizationWhenDone = false
+        
+        let errorCode: OSStatus
+        
+        if let authorization = authorization
+        {
+            errorCode = task.launch(withAuthorization: authorization)
+        }
+        else
+        {
+            errorCode = task.launch()
+        }
+        
+        guard errorCode == 0 else { throw ProcessError.failed(executableURL: URL(fileURLWithPath: program), exitCode: errorCode, output: nil) }
+        
+        return task.authorization
+    }
 }
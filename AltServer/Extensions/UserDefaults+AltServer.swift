@@ -41,6 +41,8 @@ extension UserDefaults
 extension UserDefaults
 {
     private static let altJITTimeoutKey = "JITTimeout"
+    private static let afcConnectionCountKey = "AFCConnectionCount"
+    private static let maximumConcurrentInstallationCountKey = "MaxConcurrentInstallations"
     
     var altJITTimeout: TimeInterval? {
         let timeout = self.double(forKey: UserDefaults.altJITTimeoutKey) // Coerces strings into doubles.
@@ -48,4 +50,20 @@ extension UserDefaults
         
         return timeout
     }
+    
+    // Number of concurrent AFC connections used to upload app bundles to each device.
+    @objc var afcConnectionCount: Int {
+        let count = self.integer(forKey: UserDefaults.afcConnectionCountKey) // Coerces strings into integers.
+        guard count > 0 else { return 4 }
+        
+        return count
+    }
+    
+    // Maximum number of devices AltServer installs to at once. Operations for the same device always run one at a time.
+    @objc var maximumConcurrentInstallationCount: Int {
+        let count = self.integer(forKey: UserDefaults.maximumConcurrentInstallationCountKey)
+        guard count > 0 else { return 2 }
+        
+        return count
+    }
 }
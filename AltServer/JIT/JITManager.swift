@@ -7,6 +7,8 @@
 //
 
 import RegexBuilder
+import Network
+import OSLog
 
 import AltSign
 
@@ -16,6 +18,12 @@ private extension URL
     static let altjit = Bundle.main.executableURL!.deletingLastPathComponent().appendingPathComponent("altjit")
 }
 
+// JIT server couldn't be reached (even after launching it), as opposed to failing after accepting a request.
+private struct JITServerUnavailableError: Error
+{
+    var underlyingError: Error
+}
+
 class JITManager
 {
     static let shared = JITManager()
@@ -24,42 +32,88 @@ class JITManager
     
     private var authorization: AuthorizationRef?
     
+    // Developer disks stay mounted until device reboots, which also disconnects it.
+    // So once we know a disk is mounted, we skip checking again until device disconnects (or record gets old).
+    private var developerDiskMountDates = [String: Date]()
+    private let developerDiskMountDatesLock = NSLock()
+    private let developerDiskMountRecordLifetime: TimeInterval = 6 * 60 * 60
+    
     private init()
     {
+        NotificationCenter.default.addObserver(forName: .deviceManagerDeviceDidDisconnect, object: nil, queue: nil) { [weak self] (notification) in
+            guard let device = notification.object as? ALTDevice else { return }
+            self?.setDeveloperDiskMounted(false, on: device)
+        }
     }
     
     func prepare(_ device: ALTDevice) async throws
     {
-        let isMounted = try await ALTDeviceManager.shared.isDeveloperDiskImageMounted(for: device)
-        guard !isMounted else { return }
+        guard !self.isDeveloperDiskKnownToBeMounted(on: device) else { return }
         
-        if #available(macOS 13, *), device.osVersion.majorVersion >= 17
-        {
-            // iOS 17+
-            try await self.installPersonalizedDeveloperDisk(onto: device)
-        }
-        else
+        let isMounted = try await ALTDeviceManager.shared.isDeveloperDiskImageMounted(for: device)
+        if !isMounted
         {
-            try await self.installDeveloperDisk(onto: device)
+            if #available(macOS 13, *), device.osVersion.majorVersion >= 17
+            {
+                // iOS 17+
+                try await self.installPersonalizedDeveloperDisk(onto: device)
+            }
+            else
+            {
+                try await self.installDeveloperDisk(onto: device)
+            }
         }
+        
+        self.setDeveloperDiskMounted(true, on: device)
     }
     
     func enableUnsignedCodeExecution(process: AppProcess, device: ALTDevice) async throws
     {
         try await self.prepare(device)
         
-        if #available(macOS 13, *), device.osVersion.majorVersion >= 17
+        do
         {
-            // iOS 17+
-            try await self.enableModernUnsignedCodeExecution(process: process, device: device)
+            if #available(macOS 13, *), device.osVersion.majorVersion >= 17
+            {
+                // iOS 17+
+                try await self.enableModernUnsignedCodeExecution(process: process, device: device)
+            }
+            else
+            {
+                try await self.enableLegacyUnsignedCodeExecution(process: process, device: device)
+            }
         }
-        else
+        catch
         {
-            try await self.enableLegacyUnsignedCodeExecution(process: process, device: device)
+            // Developer disk may have been unmounted without us noticing (e.g. device rebooted while connected over Wi-Fi), so check again next time.
+            self.setDeveloperDiskMounted(false, on: device)
+            throw error
         }
     }
 }
 
+private extension JITManager
+{
+    func isDeveloperDiskKnownToBeMounted(on device: ALTDevice) -> Bool
+    {
+        self.developerDiskMountDatesLock.lock()
+        defer { self.developerDiskMountDatesLock.unlock() }
+        
+        guard let mountDate = self.developerDiskMountDates[device.identifier] else { return false }
+        
+        let isValid = Date().timeIntervalSince(mountDate) < self.developerDiskMountRecordLifetime
+        return isValid
+    }
+    
+    func setDeveloperDiskMounted(_ isMounted: Bool, on device: ALTDevice)
+    {
+        self.developerDiskMountDatesLock.lock()
+        defer { self.developerDiskMountDatesLock.unlock() }
+        
+        self.developerDiskMountDates[device.identifier] = isMounted ? Date() : nil
+    }
+}
+
 private extension JITManager
 {
     func installDeveloperDisk(onto device: ALTDevice) async throws
@@ -129,6 +183,18 @@ private extension JITManager
                 self.authorization = try Process.runAsAdmin("echo", arguments: ["altstore"], authorization: self.authorization)
             }
             
+            do
+            {
+                // Prefer long-running JIT server, which keeps device connections open between requests.
+                try await self.enableUnsignedCodeExecutionUsingJITServer(process: process, device: device)
+                return
+            }
+            catch let error as JITServerUnavailableError
+            {
+                // Only fall back if server never received request, since otherwise it may still be using device's tunnel.
+                Logger.main.error("Unable to use JIT server, falling back to altjit process. \(error.underlyingError.localizedDescription, privacy: .public)")
+            }
+            
             var arguments = ["enable"]
             switch process
             {
@@ -150,6 +216,126 @@ private extension JITManager
         }
     }
     
+    func enableUnsignedCodeExecutionUsingJITServer(process: AppProcess, device: ALTDevice) async throws
+    {
+        let request = JITServerRequest.enableJIT(for: process, udid: device.identifier, timeout: UserDefaults.standard.altJITTimeout)
+        
+        let connection: NWConnection
+        
+        do
+        {
+            connection = try await self.connectToJITServer()
+        }
+        catch let error as NWError where error == .posix(.ENOENT) || error == .posix(.ECONNREFUSED)
+        {
+            // JIT server isn't running (yet), so launch it and try again once it's listening.
+            // Any other error may mean server is running but unhealthy, in which case launching another would orphan it (and its tunnels).
+            Logger.main.info("Launching JIT server...")
+            
+            do
+            {
+                self.authorization = try Process.launchAsAdmin(URL.altjit.path, arguments: ["serve", "--owner-uid", String(getuid())], authorization: self.authorization)
+                connection = try await self.connectToJITServer(retryingFor: 10)
+            }
+            catch
+            {
+                throw JITServerUnavailableError(underlyingError: error)
+            }
+        }
+        catch
+        {
+            throw JITServerUnavailableError(underlyingError: error)
+        }
+            
+        defer { connection.cancel() }
+        
+        // Give server a little longer than the request's own timeout, so server's (more descriptive) timeout error takes priority.
+        let timeout = (request.timeout ?? JITServer.defaultTimeout) + 30
+        let response = try await self.sendJITServerRequest(request, over: connection, timeout: timeout)
+        
+        guard response.success else {
+            // Match `altjit enable` failures so processAltJITError() can parse output.
+            throw ProcessError.failed(executableURL: .altjit, exitCode: 1, output: response.output ?? response.errorDescription)
+        }
+        
+        if let latency = response.latency
+        {
+            Logger.main.info("Enabled JIT using JIT server in \(latency, format: .fixed(precision: 2))s.")
+        }
+    }
+    
+    func connectToJITServer(retryingFor retryDuration: TimeInterval = 0) async throws -> NWConnection
+    {
+        let deadline = Date(timeIntervalSinceNow: retryDuration)
+        
+        while true
+        {
+            let connection = NWConnection(to: .unix(path: JITServer.socketPath), using: .tcp)
+            
+            do
+            {
+                try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<Void, Error>) in
+                    connection.stateUpdateHandler = { state in
+                        switch state
+                        {
+                        case .ready:
+                            connection.stateUpdateHandler = nil
+                            continuation.resume()
+                            
+                        case .failed(let error), .waiting(let error):
+                            // .waiting means socket doesn't exist (yet), so treat as failure.
+                            connection.stateUpdateHandler = nil
+                            continuation.resume(throwing: error)
+                            
+                        default: break
+                        }
+                    }
+                    
+                    connection.start(queue: .global())
+                }
+                
+                return connection
+            }
+            catch where Date() < deadline
+            {
+                connection.cancel()
+                
+                try await Task.sleep(for: .milliseconds(250))
+                continue
+            }
+            catch
+            {
+                connection.cancel()
+                throw error
+            }
+        }
+    }
+            
+    func sendJITServerRequest(_ request: JITServerRequest, over connection: NWConnection, timeout: TimeInterval) async throws -> JITServerResponse
+    {
+        try await withThrowingTaskGroup(of: JITServerResponse.self) { taskGroup in
+            taskGroup.addTask {
+                try await connection.sendJITServerMessage(request)
+            
+                let response = try await connection.receiveJITServerMessage(JITServerResponse.self)
+                return response
+            }
+            
+            taskGroup.addTask {
+                try await Task.sleep(for: .seconds(timeout))
+                
+                // Cancelling connection fails any pending send or receive, which would otherwise never return if server is wedged.
+                connection.cancel()
+                throw ProcessError.timedOut(executableURL: .altjit)
+            }
+            
+            defer { taskGroup.cancelAll() }
+            
+            let response = try await taskGroup.next()!
+            return response
+        }
+    }
+    
     func processAltJITError(_ error: some Error) throws
     {
         do
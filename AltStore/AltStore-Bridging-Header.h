@@ -4,5 +4,4 @@
 
 #import "NSAttributedString+Markdown.h"
 #import "ALTAppPatcher.h"
-
-#include "fragmentzip.h"
+#import "ALTMachOFile.h"
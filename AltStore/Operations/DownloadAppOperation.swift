@@ -9,6 +9,7 @@
 import Foundation
 import WebKit
 import UniformTypeIdentifiers
+import CryptoKit
 
 import AltStoreCore
 import AltSign
@@ -31,6 +32,9 @@ class DownloadAppOperation: ResultOperation<ALTApplication>
     
     private var downloadPatreonAppContinuation: CheckedContinuation<URL, Error>?
     
+    // SHA-256 hashes of downloaded files, computed while downloading.
+    private var downloadedFileHashes = [URL: String]()
+    
     init(app: AppProtocol, destinationURL: URL, context: InstallAppOperationContext)
     {
         self.app = app
@@ -257,9 +261,19 @@ private extension DownloadAppOperation
                     
                     // Use context's temporaryDirectory to ensure .ipa isn't deleted before we're done installing.
                     let ipaURL = self.context.temporaryDirectory.appendingPathComponent("App.ipa")
-                    try FileManager.default.copyItem(at: fileURL, to: ipaURL)
+                    
+                    if sourceURL.isFileURL
+                    {
+                        try FileManager.default.copyItem(at: fileURL, to: ipaURL)
+                    }
+                    else
+                    {
+                        // Downloaded file is deleted once we're done anyway, so move it instead of copying.
+                        try FileManager.default.moveItem(at: fileURL, to: ipaURL)
+                    }
                     
                     self.context.ipaURL = ipaURL
+                    self.context.ipaSHA256Hash = self.downloadedFileHashes[fileURL]
                 }
                 
                 guard let application = ALTApplication(fileURL: appBundleURL) else { throw OperationError.invalidApp }
@@ -275,16 +289,13 @@ private extension DownloadAppOperation
     func downloadFile(from downloadURL: URL) async throws -> URL
     {
         try await withCheckedThrowingContinuation { continuation in
-            let downloadTask = self.session.downloadTask(with: downloadURL) { (fileURL, response, error) in
+            // Hash data as it's received, rather than reading entire file again to verify it later.
+            let delegate = HashingDownloadDelegate(downloadURL: downloadURL) { result in
                 do
                 {
-                    if let response = response as? HTTPURLResponse
-                    {
-                        guard response.statusCode != 403 else { throw URLError(.noPermissionsToReadFile) }
-                        guard response.statusCode != 404 else { throw CocoaError(.fileNoSuchFile, userInfo: [NSURLErrorKey: downloadURL]) }
-                    }
+                    let (fileURL, sha256Hash) = try result.get()
+                    self.downloadedFileHashes[fileURL] = sha256Hash
                     
-                    let (fileURL, _) = try Result((fileURL, response), error).get()
                     continuation.resume(returning: fileURL)
                 }
                 catch
@@ -292,9 +303,16 @@ private extension DownloadAppOperation
                     continuation.resume(throwing: error)
                 }
             }
-            self.progress.addChild(downloadTask.progress, withPendingUnitCount: 3)
             
-            downloadTask.resume()
+            let session = URLSession(configuration: .default, delegate: delegate, delegateQueue: nil)
+            
+            let dataTask = session.dataTask(with: downloadURL)
+            self.progress.addChild(dataTask.progress, withPendingUnitCount: 3)
+            
+            dataTask.resume()
+            
+            // Sessions retain their delegates, so invalidate once task finishes.
+            session.finishTasksAndInvalidate()
         }
     }
     
@@ -586,3 +604,83 @@ private extension DownloadAppOperation
         downloadTask.resume()
     }
 }
+
+private class HashingDownloadDelegate: NSObject, URLSessionDataDelegate
+{
+    let downloadURL: URL
+    let fileURL = FileManager.default.uniqueTemporaryURL()
+    
+    private let completionHandler: (Result<(URL, String), Error>) -> Void
+    
+    private var fileHandle: FileHandle?
+    private var hasher = SHA256()
+    private var error: Error?
+    
+    init(downloadURL: URL, completionHandler: @escaping (Result<(URL, String), Error>) -> Void)
+    {
+        self.downloadURL = downloadURL
+        self.completionHandler = completionHandler
+    }
+    
+    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive response: URLResponse, completionHandler: @escaping (URLSession.ResponseDisposition) -> Void)
+    {
+        do
+        {
+            if let response = response as? HTTPURLResponse
+            {
+                guard response.statusCode != 403 else { throw URLError(.noPermissionsToReadFile) }
+                guard response.statusCode != 404 else { throw CocoaError(.fileNoSuchFile, userInfo: [NSURLErrorKey: self.downloadURL]) }
+            }
+            
+            guard FileManager.default.createFile(atPath: self.fileURL.path, contents: nil) else { throw CocoaError(.fileWriteUnknown, userInfo: [NSURLErrorKey: self.fileURL]) }
+            self.fileHandle = try FileHandle(forWritingTo: self.fileURL)
+            
+            completionHandler(.allow)
+        }
+        catch
+        {
+            self.error = error
+            completionHandler(.cancel)
+        }
+    }
+    
+    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive data: Data)
+    {
+        guard let fileHandle = self.fileHandle, self.error == nil else { return }
+        
+        do
+        {
+            try fileHandle.write(contentsOf: data)
+            self.hasher.update(data: data)
+        }
+        catch
+        {
+            self.error = error
+            dataTask.cancel()
+        }
+    }
+    
+    func urlSession(_ session: URLSession, task: URLSessionTask, didCompleteWithError error: Error?)
+    {
+        do
+        {
+            try self.fileHandle?.close()
+            self.fileHandle = nil
+            
+            if let error = self.error ?? error
+            {
+                throw error
+            }
+            
+            let sha256Hash = self.hasher.finalize()
+            let hashString = sha256Hash.compactMap { String(format: "%02x", $0) }.joined()
+            
+            self.completionHandler(.success((self.fileURL, hashString)))
+        }
+        catch
+        {
+            try? FileManager.default.removeItem(at: self.fileURL)
+            self.completionHandler(.failure(error))
+        }
+    }
+}
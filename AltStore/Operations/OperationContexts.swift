@@ -111,7 +111,15 @@ class InstallAppOperationContext: AppOperationContext
         return temporaryDirectory
     }()
     
-    var ipaURL: URL?
+    var ipaURL: URL? {
+        didSet {
+            self.ipaSHA256Hash = nil
+        }
+    }
+    
+    // Lowercase hex SHA-256 hash of ipaURL, cached so verifying it doesn't require reading the entire file again.
+    var ipaSHA256Hash: String?
+    
     var resignedApp: ALTApplication?
     
     var installationConnection: ServerConnection?
@@ -7,10 +7,14 @@
 //
 
 #import "ALTAppPatcher.h"
+#import "ALTMachOFile.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 @import Roxas;
 
@@ -19,12 +23,8 @@
 
 #define ROUND_TO_PAGE(val) (((val % 0x4000) == 0) ? val : (val + (0x4000 - (val & 0x3FFF))))
 
-typedef struct {
-    uint32_t magic;
-    uint32_t cpuType;
-    uint32_t cpuSubType;
-    // Incomplete, we don't need anything else
-} MachOHeader;
+// Maximum number of bytes written by a single pwrite() call when copying slices.
+#define COPY_CHUNK_SIZE (4 * 1024 * 1024)
 
 typedef struct {
     uint32_t cpuType;
@@ -37,29 +37,24 @@ typedef struct {
 typedef struct {
     uint32_t magic;
     uint32_t archCount;
-    FatArch  archs[0];
+    FatArch  archs[2];
 } FatHeader;
 
-// Given two MachO files, return a FAT file with the following properties:
+// Given the sizes of two MachO files, fill in a FAT header with the following properties:
 // 1. installd will still see the original MachO and validate it's code signature
 // 2. The kernel will only see the injected MachO instead
 //
 // Only arm64e for now
-void *injectApp(void *originalApp, size_t originalAppSize, void *appToInject, size_t appToInjectSize, size_t *outputSize) {
+static bool makeFatHeader(cpu_type_t injectedCPUType, cpu_subtype_t injectedCPUSubtype, size_t originalAppSize, size_t appToInjectSize, FatHeader *fatHeader, size_t *outputSize) {
     *outputSize = 0;
     
     // First validate the App to inject: It must be an arm64e application
-    if (appToInjectSize < sizeof(MachOHeader)) {
-        return NULL;
+    if (injectedCPUType != CPU_TYPE_ARM64) {
+        return false;
     }
     
-    MachOHeader *injectedHeader = (MachOHeader*) appToInject;
-    if (injectedHeader->cpuType != CPU_TYPE_ARM64) {
-        return NULL;
-    }
-    
-    if (injectedHeader->cpuSubType != (CPU_SUBTYPE_ARM64E | CPU_SUBTYPE_PAC)) {
-        return NULL;
+    if (injectedCPUSubtype != (cpu_subtype_t)(CPU_SUBTYPE_ARM64E | CPU_SUBTYPE_PAC)) {
+        return false;
     }
     
     // Ok, the App to inject is ok
@@ -68,14 +63,13 @@ void *injectApp(void *originalApp, size_t originalAppSize, void *appToInject, si
     size_t appToInjectSizeRounded = ROUND_TO_PAGE(appToInjectSize);
     size_t totalSize = 0x4000 /* Fat Header + Alignment */ + originalAppSizeRounded + appToInjectSizeRounded;
     
-    void *fatBuf = malloc(totalSize);
-    if (fatBuf == NULL) {
-        return NULL;
+    // Fat offsets and sizes are 32-bit, so both slices must lie within the first 4 GB.
+    if (0x4000 + originalAppSizeRounded + appToInjectSize > UINT32_MAX) {
+        return false;
     }
     
-    bzero(fatBuf, totalSize);
+    bzero(fatHeader, sizeof(FatHeader));
     
-    FatHeader *fatHeader = (FatHeader*) fatBuf;
     fatHeader->magic = htonl(FAT_MAGIC);
     fatHeader->archCount = htonl(2);
     
@@ -93,51 +87,140 @@ void *injectApp(void *originalApp, size_t originalAppSize, void *appToInject, si
     fatHeader->archs[1].size       = htonl(appToInjectSize);
     fatHeader->archs[1].alignment  = htonl(0xE);
     
-    // Ok, now write the MachOs
-    memcpy(fatBuf + 0x4000, originalApp, originalAppSize);
-    memcpy(fatBuf + 0x4000 + originalAppSizeRounded, appToInject, appToInjectSize);
-    
-    // We're done!
     *outputSize = totalSize;
-    return fatBuf;
+    return true;
+}
+
+// Writes size bytes from input (typically a memory-mapped file) into outputFD at offset, without copying it into a buffer first.
+// Returns false and sets errno on failure.
+static bool copySlice(const void *input, size_t size, int outputFD, off_t offset) {
+    size_t copiedSize = 0;
+    while (copiedSize < size) {
+        size_t chunkSize = MIN(size - copiedSize, COPY_CHUNK_SIZE);
+        
+        ssize_t writtenSize = pwrite(outputFD, (const uint8_t *)input + copiedSize, chunkSize, offset + copiedSize);
+        if (writtenSize < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            
+            return false;
+        }
+        
+        copiedSize += writtenSize;
+    }
+    
+    return true;
+}
+
+static NSError *ALTPOSIXError(NSURL *fileURL) {
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:@{NSURLErrorKey: fileURL}];
 }
 
 @implementation ALTAppPatcher
 
 - (BOOL)patchAppBinaryAtURL:(NSURL *)appFileURL withBinaryAtURL:(NSURL *)patchFileURL error:(NSError *__autoreleasing *)error
 {
-    NSMutableData *originalApp = [NSMutableData dataWithContentsOfURL:appFileURL options:0 error:error];
+    // Both binaries are memory-mapped, so they're never read into memory all at once.
+    ALTMachOFile *originalApp = [[ALTMachOFile alloc] initWithFileURL:appFileURL error:error];
     if (originalApp == nil)
     {
         return NO;
     }
     
-    NSMutableData *injectedApp = [NSMutableData dataWithContentsOfURL:patchFileURL options:0 error:error];
+    ALTMachOFile *injectedApp = [[ALTMachOFile alloc] initWithFileURL:patchFileURL error:error];
     if (injectedApp == nil)
     {
         return NO;
     }
-
+    
+    if (originalApp.isFat || !originalApp.slices.firstObject.is64Bit)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{NSURLErrorKey: appFileURL}];
+        }
+        
+        return NO;
+    }
+    
+    FatHeader fatHeader;
     size_t outputSize = 0;
-    void *output = injectApp(originalApp.mutableBytes, originalApp.length, injectedApp.mutableBytes, injectedApp.length, &outputSize);
-    if (output == NULL)
+    
+    ALTMachOSlice *injectedSlice = injectedApp.slices.firstObject;
+    if (injectedApp.isFat || !injectedSlice.is64Bit || !makeFatHeader(injectedSlice.cpuType, injectedSlice.cpuSubtype, originalApp.data.length, injectedApp.data.length, &fatHeader, &outputSize))
     {
         if (error)
         {
-            // If injectApp fails, it means the patch app is in the wrong format.
+            // If makeFatHeader fails, it means the patch app is in the wrong format.
             *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:@{NSURLErrorKey: patchFileURL}];
         }
         
         return NO;
     }
     
-    NSData *outputData = [NSData dataWithBytesNoCopy:output length:outputSize freeWhenDone:YES];
-    if (![outputData writeToURL:appFileURL options:NSDataWritingAtomic error:error])
+    struct stat originalInfo;
+    if (stat(appFileURL.fileSystemRepresentation, &originalInfo) == -1)
     {
+        if (error)
+        {
+            *error = ALTPOSIXError(appFileURL);
+        }
+        
         return NO;
     }
     
-    return YES;
+    // Write to separate file first so original binary is untouched if patching fails.
+    NSURL *outputFileURL = [[appFileURL URLByDeletingLastPathComponent] URLByAppendingPathComponent:[[NSUUID UUID] UUIDString] isDirectory:NO];
+    
+    int outputFD = open(outputFileURL.fileSystemRepresentation, O_WRONLY | O_CREAT | O_EXCL, originalInfo.st_mode & ALLPERMS);
+    if (outputFD == -1)
+    {
+        if (error)
+        {
+            *error = ALTPOSIXError(outputFileURL);
+        }
+        
+        return NO;
+    }
+    
+    // Slices are written at their final offsets, so padding before and between them is left as holes rather than written out as zeroes.
+    BOOL success = (pwrite(outputFD, &fatHeader, sizeof(fatHeader), 0) == sizeof(fatHeader) &&
+                    copySlice(originalApp.data.bytes, originalApp.data.length, outputFD, ntohl(fatHeader.archs[0].fileOffset)) &&
+                    copySlice(injectedApp.data.bytes, injectedApp.data.length, outputFD, ntohl(fatHeader.archs[1].fileOffset)) &&
+                    ftruncate(outputFD, outputSize) == 0); // Extend file to include trailing padding.
+    
+    if (!success && error)
+    {
+        *error = ALTPOSIXError(outputFileURL);
+    }
+    
+    if (close(outputFD) == -1 && success)
+    {
+        if (error)
+        {
+            *error = ALTPOSIXError(outputFileURL);
+        }
+        
+        success = NO;
+    }
+    
+    if (success && rename(outputFileURL.fileSystemRepresentation, appFileURL.fileSystemRepresentation) == -1)
+    {
+        if (error)
+        {
+            *error = ALTPOSIXError(appFileURL);
+        }
+        
+        success = NO;
+    }
+    
+    if (!success)
+    {
+        unlink(outputFileURL.fileSystemRepresentation);
+    }
+    
+    return success;
 }
 
 @end
@@ -68,6 +68,9 @@ private struct OTAUpdate
 {
     var url: URL
     var archivePath: String
+    
+    // Spotlight is identical for every device on the same iOS version, so extracted binaries are cached by it.
+    var osVersion: String
 }
 
 class PatchAppOperation: ResultOperation<Void>
@@ -80,6 +83,10 @@ class PatchAppOperation: ResultOperation<Void>
     private lazy var patchDirectory: URL = self.context.temporaryDirectory.appendingPathComponent("Patch", isDirectory: true)
     
     private var cancellable: AnyCancellable?
+    private var spotlightTask: Task<URL, Error>?
+    
+    // spotlightTask is assigned from Combine's thread but cancelled from whichever thread calls cancel().
+    private let spotlightTaskLock = NSLock()
     
     init(context: PatchAppContext)
     {
@@ -105,8 +112,7 @@ class PatchAppOperation: ResultOperation<Void>
         self.progressHandler?(self.progress, NSLocalizedString("Downloading iOS firmware...", comment: ""))
                 
         self.cancellable = self.fetchOTAUpdate()
-            .flatMap { self.downloadArchive(from: $0) }
-            .flatMap { self.extractSpotlightFromArchive(at: $0) }
+            .flatMap { self.fetchSpotlight(from: $0) }
             .flatMap { self.patch(resignedApp, withBinaryAt: $0) }
             .tryMap { try FileManager.default.zipAppBundle(at: $0) }
             .tryMap { (fileURL) in
@@ -131,23 +137,20 @@ class PatchAppOperation: ResultOperation<Void>
         
         self.cancellable?.cancel()
         self.cancellable = nil
+        
+        self.spotlightTaskLock.lock()
+        let spotlightTask = self.spotlightTask
+        self.spotlightTask = nil
+        self.spotlightTaskLock.unlock()
+        
+        spotlightTask?.cancel()
     }
 }
 
-private let ALTFragmentZipCallback: @convention(c) (UInt32) -> Void = { (percentageComplete) in
-    guard let progress = Progress.current() else { return }
-    
-    if percentageComplete == 100 && progress.completedUnitCount == 0
-    {
-        // Ignore first percentageComplete, which is always 100.
-        return
-    }
-    
-    progress.completedUnitCount = Int64(percentageComplete)
-}
-
 private extension PatchAppOperation
 {
+    static let spotlightCacheDirectory = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask)[0].appendingPathComponent("Fugu14", isDirectory: true)
+    
     func fetchOTAUpdate() -> AnyPublisher<OTAUpdate, Error>
     {
         Just(()).tryMap {
@@ -156,15 +159,18 @@ private extension PatchAppOperation
             {
             case (14, 3):
                 return OTAUpdate(url: URL(string: "https://updates.cdn-apple.com/2020WinterFCS/patches/001-87330/99E29969-F6B6-422A-B946-70DE2E2D73BE/com_apple_MobileAsset_SoftwareUpdate/67f9e42f5e57a20e0a87eaf81b69dd2a61311d3f.zip")!,
-                                   archivePath: "AssetData/payloadv2/payload.042")
+                                   archivePath: "AssetData/payloadv2/payload.042",
+                                   osVersion: "14.3")
                 
             case (14, 4):
                 return OTAUpdate(url: URL(string: "https://updates.cdn-apple.com/2021WinterFCS/patches/001-98606/43AF99A1-F286-43B1-A101-F9F856EA395A/com_apple_MobileAsset_SoftwareUpdate/c4985c32c344beb7b49c61919b4e39d1fd336c90.zip")!,
-                                   archivePath: "AssetData/payloadv2/payload.042")
+                                   archivePath: "AssetData/payloadv2/payload.042",
+                                   osVersion: "14.4")
                 
             case (14, 5):
                 return OTAUpdate(url: URL(string: "https://updates.cdn-apple.com/2021SpringFCS/patches/061-84483/AB525139-066E-46F8-8E85-DCE802C03BA8/com_apple_MobileAsset_SoftwareUpdate/788573ae93113881db04269acedeecabbaa643e3.zip")!,
-                                   archivePath: "AssetData/payloadv2/payload.043")
+                                   archivePath: "AssetData/payloadv2/payload.043",
+                                   osVersion: "14.5")
                 
             default: throw PatchAppError.unsupportedOperatingSystemVersion(osVersion)
             }
@@ -172,69 +178,176 @@ private extension PatchAppOperation
         .eraseToAnyPublisher()
     }
     
-    func downloadArchive(from update: OTAUpdate) -> AnyPublisher<URL, Error>
+    func fetchSpotlight(from update: OTAUpdate) -> AnyPublisher<URL, Error>
     {
-        Just(()).tryMap {
-            #if targetEnvironment(simulator)
-            throw PatchAppError.unsupportedOperatingSystemVersion(ProcessInfo.processInfo.operatingSystemVersion)
-            #else
+        Future<URL, Error> { promise in
+            let task = Task<URL, Error> {
+                try await self.downloadSpotlight(from: update)
+            }
             
-            try FileManager.default.createDirectory(at: self.patchDirectory, withIntermediateDirectories: true, attributes: nil)
+            self.spotlightTaskLock.lock()
+            self.spotlightTask = task
+            let isCancelled = self.isCancelled
+            self.spotlightTaskLock.unlock()
             
-            let archiveURL = self.patchDirectory.appendingPathComponent("ota.archive")
-            try archiveURL.withUnsafeFileSystemRepresentation { archivePath in
-                guard let fz = fragmentzip_open((update.url.absoluteString as NSString).utf8String!) else {
-                    throw URLError(.cannotConnectToHost, userInfo: [NSLocalizedDescriptionKey: NSLocalizedString("The connection failed because a connection cannot be made to the host.", comment: ""),
-                                                                                NSURLErrorKey: update.url])
-                }
-                defer { fragmentzip_close(fz) }
-                
-                self.progress.becomeCurrent(withPendingUnitCount: 100)
-                defer { self.progress.resignCurrent() }
-                
-                guard fragmentzip_download_file(fz, update.archivePath, archivePath!, ALTFragmentZipCallback) == 0 else {
-                    throw URLError(.networkConnectionLost, userInfo: [NSLocalizedDescriptionKey: NSLocalizedString("The connection failed because the network connection was lost.", comment: ""),
-                                                                                NSURLErrorKey: update.url])
-                }
+            // cancel() may have already run before task was stored, in which case it couldn't cancel it.
+            if isCancelled
+            {
+                task.cancel()
             }
             
-            Logger.fugu14.notice("Downloaded iOS OTA archive.")
-            return archiveURL
-            
-            #endif
+            Task {
+                let result = await task.result
+                promise(result)
+            }
         }
-        .mapError { ($0 as NSError).withLocalizedFailure(NSLocalizedString("Could not download OTA archive.", comment: "")) }
+        .mapError { ($0 as NSError).withLocalizedFailure(NSLocalizedString("Could not download Spotlight from OTA archive.", comment: "")) }
         .eraseToAnyPublisher()
     }
     
-    func extractSpotlightFromArchive(at archiveURL: URL) -> AnyPublisher<URL, Error>
+    // Streams just the payload containing Spotlight out of the OTA archive using HTTP range requests, and extracts Spotlight from it as it downloads.
+    func downloadSpotlight(from update: OTAUpdate) async throws -> URL
     {
-        Just(()).tryMap {
-            #if targetEnvironment(simulator)
-            throw PatchAppError.unsupportedOperatingSystemVersion(ProcessInfo.processInfo.operatingSystemVersion)
-            #else
+        #if targetEnvironment(simulator)
+        throw PatchAppError.unsupportedOperatingSystemVersion(ProcessInfo.processInfo.operatingSystemVersion)
+        #else
             
-            let spotlightPath = "Applications/Spotlight.app/Spotlight"
-            let spotlightFileURL = self.patchDirectory.appendingPathComponent(spotlightPath)
+        let cachedSpotlightURL = PatchAppOperation.spotlightCacheDirectory.appendingPathComponent("Spotlight-" + update.osVersion, isDirectory: false)
+        if FileManager.default.fileExists(atPath: cachedSpotlightURL.path)
+        {
+            do
+            {
+                // Make sure cached binary is intact before using it.
+                _ = try MachOFile(fileURL: cachedSpotlightURL)
             
-            guard let readFileStream = ArchiveByteStream.fileStream(path: FilePath(archiveURL.path), mode: .readOnly, options: [], permissions: FilePermissions(rawValue: 0o644)),
-                  let decompressStream = ArchiveByteStream.decompressionStream(readingFrom: readFileStream),
-                  let decodeStream = ArchiveStream.decodeStream(readingFrom: decompressStream),
-                  let readStream = ArchiveStream.extractStream(extractingTo: FilePath(self.patchDirectory.path))
-            else { throw CocoaError(.fileReadCorruptFile, userInfo: [NSURLErrorKey: archiveURL]) }
+                Logger.fugu14.notice("Using cached Spotlight for iOS \(update.osVersion, privacy: .public).")
             
-            _ = try ArchiveStream.process(readingFrom: decodeStream, writingTo: readStream) { message, filePath, data in
-                guard filePath == FilePath(spotlightPath) else { return .skip }
-                return .ok
+                self.progress.completedUnitCount = self.progress.totalUnitCount
+                return cachedSpotlightURL
+            }
+            catch
+            {
+                Logger.fugu14.error("Cached Spotlight for iOS \(update.osVersion, privacy: .public) is invalid, downloading again. \(error.localizedDescription, privacy: .public)")
+                try? FileManager.default.removeItem(at: cachedSpotlightURL)
+            }
+        }
+        
+        let archive = RemoteZipArchive(url: update.url)
+        try await archive.open()
+        
+        guard let entry = archive.entries[update.archivePath] else { throw CocoaError(.fileNoSuchFile, userInfo: [NSURLErrorKey: update.url, NSFilePathErrorKey: update.archivePath]) }
+        
+        Logger.fugu14.notice("Read OTA archive central directory, downloading \(entry.compressedSize) byte payload.")
+        
+        let downloadProgress = Progress(totalUnitCount: entry.compressedSize, parent: self.progress, pendingUnitCount: 100)
+        
+        try FileManager.default.createDirectory(at: self.patchDirectory, withIntermediateDirectories: true, attributes: nil)
+        
+        // Pipe payload straight into AppleArchive as it downloads, rather than saving it to disk first.
+        let pipe = Pipe()
+        
+        // Writing to pipe after extraction stops reading should fail with EPIPE, not kill AltStore with SIGPIPE.
+        _ = fcntl(pipe.fileHandleForWriting.fileDescriptor, F_SETNOSIGPIPE, 1)
+        
+        let didFinishExtracting = DispatchSemaphore(value: 0)
+        
+        // AppleArchive reads synchronously, so extract on separate thread to avoid blocking Swift concurrency's thread pool.
+        async let extractionResult: Result<URL, Error> = withCheckedContinuation { continuation in
+            DispatchQueue.global(qos: .userInitiated).async {
+                let result = Result { try self.extractSpotlight(fromPayloadAt: FileDescriptor(rawValue: pipe.fileHandleForReading.fileDescriptor)) }
+                
+                try? pipe.fileHandleForReading.close()
+                didFinishExtracting.signal()
+                
+                continuation.resume(returning: result)
+            }
+        }
+        
+        var downloadError: Error?
+        
+        do
+        {
+            try await archive.extract(entry, to: pipe.fileHandleForWriting) { receivedByteCount in
+                downloadProgress.completedUnitCount = receivedByteCount
+            }
+        }
+        catch
+        {
+            downloadError = error
+        }
+        
+        // Check before closing pipe, since closing it will cause extraction to finish (if it hasn't already).
+        let extractionFinishedEarly = (didFinishExtracting.wait(timeout: .now()) == .success)
+        try? pipe.fileHandleForWriting.close()
+        
+        let result = await extractionResult
+        
+        if let downloadError
+        {
+            // If extraction failed first, the download failed because pipe was closed, so throw extraction's (more descriptive) error instead.
+            if extractionFinishedEarly, case .failure(let error) = result
+            {
+                throw error
             }
             
-            Logger.fugu14.notice("Extracted Spotlight from OTA archive.")
-            return spotlightFileURL
+            throw downloadError
+        }
             
-            #endif
+        let spotlightFileURL = try result.get()
+        Logger.fugu14.notice("Extracted Spotlight from OTA archive.")
+        
+        try FileManager.default.createDirectory(at: PatchAppOperation.spotlightCacheDirectory, withIntermediateDirectories: true, attributes: nil)
+        
+        // Copy to temporary file in cache directory first, then swap it into place, so cachedSpotlightURL never contains a partially written binary.
+        let temporarySpotlightURL = PatchAppOperation.spotlightCacheDirectory.appendingPathComponent("." + cachedSpotlightURL.lastPathComponent + "-" + UUID().uuidString, isDirectory: false)
+        try FileManager.default.copyItem(at: spotlightFileURL, to: temporarySpotlightURL)
+        
+        do
+        {
+            if FileManager.default.fileExists(atPath: cachedSpotlightURL.path)
+            {
+                _ = try FileManager.default.replaceItemAt(cachedSpotlightURL, withItemAt: temporarySpotlightURL)
+            }
+            else
+            {
+                try FileManager.default.moveItem(at: temporarySpotlightURL, to: cachedSpotlightURL)
+            }
         }
-        .mapError { ($0 as NSError).withLocalizedFailure(NSLocalizedString("Could not extract Spotlight from OTA archive.", comment: "")) }
-        .eraseToAnyPublisher()
+        catch
+        {
+            try? FileManager.default.removeItem(at: temporarySpotlightURL)
+            throw error
+        }
+        
+        return cachedSpotlightURL
+        
+        #endif
+    }
+    
+    func extractSpotlight(fromPayloadAt fileDescriptor: FileDescriptor) throws -> URL
+    {
+        #if targetEnvironment(simulator)
+        throw PatchAppError.unsupportedOperatingSystemVersion(ProcessInfo.processInfo.operatingSystemVersion)
+        #else
+        
+        let spotlightPath = "Applications/Spotlight.app/Spotlight"
+        let spotlightFileURL = self.patchDirectory.appendingPathComponent(spotlightPath)
+        
+        guard let readFileStream = ArchiveByteStream.fileStream(fd: fileDescriptor, automaticClose: false),
+              let decompressStream = ArchiveByteStream.decompressionStream(readingFrom: readFileStream),
+              let decodeStream = ArchiveStream.decodeStream(readingFrom: decompressStream),
+              let readStream = ArchiveStream.extractStream(extractingTo: FilePath(self.patchDirectory.path))
+        else { throw CocoaError(.fileReadCorruptFile) }
+        
+        _ = try ArchiveStream.process(readingFrom: decodeStream, writingTo: readStream) { message, filePath, data in
+            guard filePath == FilePath(spotlightPath) else { return .skip }
+            return .ok
+        }
+        
+        guard FileManager.default.fileExists(atPath: spotlightFileURL.path) else { throw CocoaError(.fileNoSuchFile, userInfo: [NSFilePathErrorKey: spotlightPath]) }
+        return spotlightFileURL
+        
+        #endif
     }
     
     func patch(_ app: ALTApplication, withBinaryAt patchFileURL: URL) -> AnyPublisher<URL, Error>
@@ -61,7 +61,7 @@ class SendAppOperation: ResultOperation<ServerConnection>
                     {
                     case .failure(let error): self.finish(.failure(error))
                     case .success:
-                        self.progress.completedUnitCount += 1
+                        self.progress.completedUnitCount = self.progress.totalUnitCount
                         self.finish(.success(serverConnection))
                     }
                 }
@@ -76,10 +76,21 @@ private extension SendAppOperation
     {
         do
         {
-            guard let appData = try? Data(contentsOf: fileURL) else { throw OperationError.invalidApp }
             guard let udid = Bundle.main.object(forInfoDictionaryKey: Bundle.Info.deviceID) as? String else { throw OperationError.unknownUDID }
             
-            var request = PrepareAppRequest(udid: udid, contentSize: appData.count)
+            // Stream app from disk rather than loading it into memory, since apps can be hundreds of MB.
+            guard let contentSize = try? fileURL.resourceValues(forKeys: [.fileSizeKey]).fileSize, let fileHandle = try? FileHandle(forReadingFrom: fileURL) else { throw OperationError.invalidApp }
+            
+            func finish(_ result: Result<Void, Error>)
+            {
+                try? fileHandle.close()
+                completionHandler(result)
+            }
+            
+            // Report progress per byte sent.
+            self.progress.totalUnitCount = Int64(max(contentSize, 1))
+            
+            var request = PrepareAppRequest(udid: udid, contentSize: contentSize)
             
             if connection.server.connectionType == .local
             {
@@ -91,28 +102,30 @@ private extension SendAppOperation
             connection.send(request) { (result) in
                 switch result
                 {
-                case .failure(let error): completionHandler(.failure(error))
+                case .failure(let error): finish(.failure(error))
                 case .success:
                     
                     if connection.server.connectionType == .local
                     {
                         // Sent file URL, so don't need to send any more.
-                        completionHandler(.success(()))
+                        finish(.success(()))
                     }
                     else
                     {
-                        Logger.sideload.debug("Sending app data (\(appData.count) bytes)...")
+                        Logger.sideload.debug("Sending app data (\(contentSize) bytes)...")
                         
-                        connection.send(appData, prependSize: false) { (result) in
+                        connection.connection.send(contentsOf: fileHandle, size: contentSize, progressHandler: { (sentByteCount) in
+                            self.progress.completedUnitCount += Int64(sentByteCount)
+                        }) { (result) in
                             switch result
                             {
                             case .failure(let error):
                                 Logger.sideload.error("Failed to send app to AltServer \(connection.server.localizedName ?? "nil", privacy: .public). \(error.localizedDescription, privacy: .public)")
-                                completionHandler(.failure(error))
+                                finish(.failure(error))
                                 
                             case .success:
                                 Logger.sideload.notice("Finished sending app to AltServer \(connection.server.localizedName ?? "nil", privacy: .public)!")
-                                completionHandler(.success(()))
+                                finish(.success(()))
                             }
                         }
                     }
@@ -23,6 +23,28 @@ private extension ALTEntitlement
     ]
 }
 
+private extension ALTApplication
+{
+    // Reads entitlements straight from the memory-mapped executable, rather than loading the entire binary via AltSign.
+    var mappedEntitlements: [ALTEntitlement: Any] {
+        do
+        {
+            guard let executableURL = self.bundle.executableURL else { return self.entitlements }
+            
+            let machOFile = try MachOFile(fileURL: executableURL)
+            guard let slice = machOFile.slice(withCPUType: CPU_TYPE_ARM64, cpuSubtype: CPU_SUBTYPE_ARM64_ALL) ?? machOFile.slices.first else { return self.entitlements }
+            
+            let entitlements = try slice.entitlements()
+            return entitlements.reduce(into: [:]) { $0[ALTEntitlement(rawValue: $1.key)] = $1.value }
+        }
+        catch
+        {
+            Logger.sideload.error("Failed to read entitlements from \(self.bundleIdentifier, privacy: .public) executable, falling back to AltSign. \(error.localizedDescription, privacy: .public)")
+            return self.entitlements
+        }
+    }
+}
+
 extension VerifyAppOperation
 {
     enum PermissionReviewMode
@@ -108,15 +130,48 @@ private extension VerifyAppOperation
         // Do nothing if source doesn't provide hash.
         guard let expectedHash = await $appVersion.sha256 else { return }
 
-        let data = try Data(contentsOf: ipaURL)
-        let sha256Hash = SHA256.hash(data: data)
-        let hashString = sha256Hash.compactMap { String(format: "%02x", $0) }.joined()
+        let hashString: String
+        
+        if let cachedHash = self.context.ipaSHA256Hash
+        {
+            // Hashed while downloading, so no need to read file again.
+            hashString = cachedHash
+        }
+        else
+        {
+            hashString = try self.sha256Hash(ofFileAt: ipaURL)
+            self.context.ipaSHA256Hash = hashString
+        }
         
         Logger.sideload.debug("Comparing app hash (\(hashString, privacy: .public)) against expected hash (\(expectedHash, privacy: .public))...")
         
         guard hashString == expectedHash else { throw VerificationError.mismatchedHash(hashString, expectedHash: expectedHash, app: app) }
     }
     
+    func sha256Hash(ofFileAt fileURL: URL) throws -> String
+    {
+        let fileHandle = try FileHandle(forReadingFrom: fileURL)
+        defer { try? fileHandle.close() }
+        
+        // Hash in fixed-size chunks to avoid loading entire .ipa into memory.
+        var hasher = SHA256()
+        
+        while true
+        {
+            let didReadData = try autoreleasepool {
+                guard let data = try fileHandle.read(upToCount: 1024 * 1024), !data.isEmpty else { return false }
+                hasher.update(data: data)
+                return true
+            }
+            
+            guard didReadData else { break }
+        }
+        
+        let sha256Hash = hasher.finalize()
+        let hashString = sha256Hash.compactMap { String(format: "%02x", $0) }.joined()
+        return hashString
+    }
+    
     func verifyDownloadedVersion(of app: ALTApplication, @AsyncManaged matches appVersion: AppVersion) async throws
     {
         let (version, buildVersion) = await $appVersion.perform { ($0.version, $0.buildVersion) }
@@ -158,10 +213,10 @@ private extension VerifyAppOperation
             let installedAppURL = InstalledApp.fileURL(for: app)
             guard let previousApp = ALTApplication(fileURL: installedAppURL) else { throw OperationError.appNotFound(name: app.name) }
             
-            var previousEntitlements = Set(previousApp.entitlements.keys)
+            var previousEntitlements = Set(previousApp.mappedEntitlements.keys)
             for appExtension in previousApp.appExtensions
             {
-                previousEntitlements.formUnion(appExtension.entitlements.keys)
+                previousEntitlements.formUnion(appExtension.mappedEntitlements.keys)
             }
             
             // Make sure all entitlements already exist in previousApp.
@@ -180,16 +235,18 @@ private extension VerifyAppOperation
     func verifyPermissions(of app: ALTApplication, @AsyncManaged match storeApp: StoreApp) async throws -> [any ALTAppPermission]
     {
         // Entitlements
-        var allEntitlements = Set(app.entitlements.keys)
+        let entitlements = app.mappedEntitlements
+        
+        var allEntitlements = Set(entitlements.keys)
         for appExtension in app.appExtensions
         {
-            allEntitlements.formUnion(appExtension.entitlements.keys)
+            allEntitlements.formUnion(appExtension.mappedEntitlements.keys)
         }
              
         // Filter out ignored entitlements.
         allEntitlements = allEntitlements.filter { !ALTEntitlement.ignoredEntitlements.contains($0) }
         
-        if let isDebuggable = app.entitlements[.getTaskAllow] as? Bool, !isDebuggable
+        if let isDebuggable = entitlements[.getTaskAllow] as? Bool, !isDebuggable
         {
             // App has `get-task-allow` entitlement but the value is false, so remove from allEntitlements.
             allEntitlements.remove(.getTaskAllow)
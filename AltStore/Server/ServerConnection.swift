@@ -34,7 +34,7 @@ class ServerConnection
             }
             else
             {
-                data = try JSONEncoder().encode(payload)
+                data = try self.connection.messageEncoding.encode(payload)
             }
             
             func process<T>(_ result: Result<T, ALTServerError>) -> Bool
@@ -92,7 +92,7 @@ class ServerConnection
                     {
                         let data = try result.get()
                         
-                        let response = try AltStoreCore.JSONDecoder().decode(ServerResponse.self, from: data)
+                        let response = try ServerResponse(messageData: data, jsonDecoder: AltStoreCore.JSONDecoder())
                         completionHandler(.success(response))
                     }
                     catch
@@ -27,6 +27,11 @@ class ServerManager: NSObject
     private var incomingConnections: [NWConnection]?
     private var incomingConnectionsSemaphore: DispatchSemaphore?
     
+    // Long-lived connections that each carry many requests, keyed by multiplexingKey(for:).
+    private var multiplexedConnections = [String: MultiplexedConnection]()
+    private var legacyServerKeys = Set<String>()
+    private let multiplexedConnectionsLock = NSLock()
+    
     private override init()
     {
         super.init()
@@ -74,40 +79,175 @@ extension ServerManager
                 }
             }
             
-            switch server.connectionType
+            guard let multiplexingKey = self.multiplexingKey(for: server) else { return self.makeConnection(to: server, completion: finish(_:)) }
+            
+            if let stream = self.openStream(forKey: multiplexingKey)
             {
-            case .local: self.connectToLocalServer(server, completion: finish(_:))
-            case .wired:
-                guard let incomingConnectionsSemaphore = self.incomingConnectionsSemaphore else { return finish(.failure(ALTServerError(.connectionFailed))) }
-                
-                Logger.sideload.debug("Waiting for incoming connection...")
-                
-                let notificationCenter = CFNotificationCenterGetDarwinNotifyCenter()
-                                
-                switch server.connectionType
+                Logger.sideload.debug("Reusing multiplexed connection to AltServer.")
+                return finish(.success(stream))
+            }
+            
+            self.makeConnection(to: server) { (result) in
+                switch result
                 {
-                case .wired: CFNotificationCenterPostNotification(notificationCenter, .wiredServerConnectionStartRequest, nil, nil, true)
-                case .local, .wireless: break
+                case .failure(let error): finish(.failure(error))
+                case .success(let connection):
+                    self.multiplexedConnectionsLock.lock()
+                    let isLegacyServer = self.legacyServerKeys.contains(multiplexingKey)
+                    self.multiplexedConnectionsLock.unlock()
+                    
+                    guard !isLegacyServer else { return finish(.success(connection)) }
+                    
+                    self.upgrade(connection, to: server) { (result) in
+                        switch result
+                        {
+                        case .failure(let error): finish(.failure(error))
+                        case .success(let multiplexedConnection?):
+                            self.multiplexedConnectionsLock.lock()
+                            self.multiplexedConnections[multiplexingKey] = multiplexedConnection
+                            self.multiplexedConnectionsLock.unlock()
+                            
+                            multiplexedConnection.disconnectionHandler = { [weak self] (multiplexedConnection) in
+                                guard let self = self else { return }
+                                
+                                self.multiplexedConnectionsLock.lock()
+                                defer { self.multiplexedConnectionsLock.unlock() }
+                                
+                                guard self.multiplexedConnections[multiplexingKey] === multiplexedConnection else { return }
+                                self.multiplexedConnections[multiplexingKey] = nil
+                            }
+                            multiplexedConnection.start()
+                            
+                            finish(Result { try multiplexedConnection.openStream() })
+                        
+                        case .success(nil):
+                            // AltServer doesn't support multiplexing, so remember to skip upgrading and reconnect for this request.
+                            self.multiplexedConnectionsLock.lock()
+                            self.legacyServerKeys.insert(multiplexingKey)
+                            self.multiplexedConnectionsLock.unlock()
+                            
+                            DispatchQueue.global().async {
+                                self.makeConnection(to: server, completion: finish(_:))
+                            }
+                        }
+                    }
                 }
+            }
+        }
+    }
+}
+
+private extension ServerManager
+{
+    func makeConnection(to server: Server, completion: @escaping (Result<Connection, Error>) -> Void)
+    {
+        switch server.connectionType
+        {
+        case .local: self.connectToLocalServer(server, completion: completion)
+        case .wired:
+            guard let incomingConnectionsSemaphore = self.incomingConnectionsSemaphore else { return completion(.failure(ALTServerError(.connectionFailed))) }
+            
+            Logger.sideload.debug("Waiting for incoming connection...")
+            
+            let notificationCenter = CFNotificationCenterGetDarwinNotifyCenter()
+            
+            switch server.connectionType
+            {
+            case .wired: CFNotificationCenterPostNotification(notificationCenter, .wiredServerConnectionStartRequest, nil, nil, true)
+            case .local, .wireless: break
+            }
                 
-                _ = incomingConnectionsSemaphore.wait(timeout: .now() + 10.0)
+            _ = incomingConnectionsSemaphore.wait(timeout: .now() + 10.0)
                 
-                if let connection = self.incomingConnections?.popLast()
-                {
-                    self.connectToRemoteServer(server, connection: connection, completion: finish(_:))
-                }
-                else
-                {
-                    finish(.failure(ALTServerError(.connectionFailed)))
+            if let connection = self.incomingConnections?.popLast()
+            {
+                self.connectToRemoteServer(server, connection: connection, completion: completion)
+            }
+            else
+            {
+                completion(.failure(ALTServerError(.connectionFailed)))
+            }
+                                
+        case .wireless:
+            guard let service = server.service else { return completion(.failure(ALTServerError(.connectionFailed))) }
+            
+            Logger.sideload.debug("Connecting to AltServer: \(service.name, privacy: .public)")
+            
+            let connection = NWConnection(to: .service(name: service.name, type: service.type, domain: service.domain, interface: nil), using: .tcp)
+            self.connectToRemoteServer(server, connection: connection, completion: completion)
+        }
+    }
+    
+    func multiplexingKey(for server: Server) -> String?
+    {
+        switch server.connectionType
+        {
+        case .wired: return "wired"
+        case .wireless: return server.identifier.map { "wireless." + $0 }
+        case .local: return nil // XPC connections are cheap, so no need to multiplex.
+        }
+    }
+    
+    func openStream(forKey multiplexingKey: String) -> MultiplexedConnection.Stream?
+    {
+        self.multiplexedConnectionsLock.lock()
+        let multiplexedConnection = self.multiplexedConnections[multiplexingKey]
+        self.multiplexedConnectionsLock.unlock()
+        
+        guard let multiplexedConnection else { return nil }
+        
+        do
+        {
+            // Don't hold lock while opening stream, since openStream() waits on connection's queue.
+            return try multiplexedConnection.openStream()
+        }
+        catch
+        {
+            // Connection was lost (e.g. device unplugged), so establish a new one.
+            self.multiplexedConnectionsLock.lock()
+            defer { self.multiplexedConnectionsLock.unlock() }
+            
+            if self.multiplexedConnections[multiplexingKey] === multiplexedConnection
+            {
+                self.multiplexedConnections[multiplexingKey] = nil
+            }
+            
+            return nil
+        }
+    }
+    
+    func upgrade(_ connection: Connection, to server: Server, completion: @escaping (Result<MultiplexedConnection?, Error>) -> Void)
+    {
+        let serverConnection = ServerConnection(server: server, connection: connection)
+        serverConnection.send(UpgradeConnectionRequest()) { (result) in
+            switch result
+            {
+            case .failure(let error): completion(.failure(error))
+            case .success:
+                serverConnection.receiveResponse { (result) in
+                    switch result
+                    {
+                    case .failure(let error): completion(.failure(error))
+                    case .success(.upgradeConnection(let response)) where !(1 ... MultiplexedConnection.protocolVersion).contains(response.protocolVersion):
+                        // AltServer expects a protocol version we don't support, so fall back to one connection per request.
+                        Logger.sideload.error("Refusing to upgrade connection to unsupported multiplexing protocol version \(response.protocolVersion).")
+                        
+                        connection.disconnect()
+                        completion(.success(nil))
+                    
+                    case .success(.upgradeConnection(let response)):
+                        let messageEncoding = response.messageEncoding.flatMap { ServerMessageEncoding(rawValue: $0) } ?? .json
+                        Logger.sideload.notice("Upgraded connection to multiplexed connection (version \(response.protocolVersion), \(messageEncoding.rawValue, privacy: .public) encoding).")
+                        
+                        let multiplexedConnection = MultiplexedConnection(connection: connection, role: .client, messageEncoding: messageEncoding, idleTimeout: 30.0)
+                        completion(.success(multiplexedConnection))
+                    
+                    case .success:
+                        // Older AltServers respond to unknown requests with an error, then disconnect.
+                        connection.disconnect()
+                        completion(.success(nil))
+                    }
                 }
-                
-            case .wireless:
-                guard let service = server.service else { return finish(.failure(ALTServerError(.connectionFailed))) }
-                
-                Logger.sideload.debug("Connecting to AltServer: \(service.name, privacy: .public)")
-                
-                let connection = NWConnection(to: .service(name: service.name, type: service.type, domain: service.domain, interface: nil), using: .tcp)
-                self.connectToRemoteServer(server, connection: connection, completion: finish(_:))
             }
         }
     }
@@ -192,8 +332,12 @@ private extension ServerManager
                 
             case .ready:
                 Logger.sideload.notice("Connected to \(serverName, privacy: .public)!")
-                let connection = NetworkConnection(connection)
-                completion(.success(connection))
+                
+                // Connection may outlive this request if multiplexed, so don't report later state changes (e.g. cancelling once idle) as failures.
+                connection.stateUpdateHandler = nil
+                
+                let networkConnection = NetworkConnection(connection)
+                completion(.success(networkConnection))
                 
             case .waiting: break
             case .setup: break
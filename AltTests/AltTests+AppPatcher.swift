@@ -0,0 +1,138 @@
+//
+//  AltTests+AppPatcher.swift
+//  AltTests
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import XCTest
+import MachO
+
+@testable import AltStore
+
+private let fatSliceAlignment = 0x4000
+private let arm64ePtrAuthSubtype = CPU_SUBTYPE_ARM64E | cpu_subtype_t(bitPattern: 0x80000000)
+
+extension AltTests
+{
+    func testPatchAppBinary() throws
+    {
+        let appFileURL = try self.makeMachO(cpuSubtype: CPU_SUBTYPE_ARM64_ALL, size: 100_000)
+        let patchFileURL = try self.makeMachO(cpuSubtype: arm64ePtrAuthSubtype, size: 50_001)
+        
+        let originalApp = try Data(contentsOf: appFileURL)
+        let injectedApp = try Data(contentsOf: patchFileURL)
+        
+        try ALTAppPatcher().patchAppBinary(at: appFileURL, withBinaryAt: patchFileURL)
+        
+        let fatBinary = try Data(contentsOf: appFileURL)
+        
+        func readInteger(at offset: Int) -> UInt32
+        {
+            return fatBinary[offset ..< offset + 4].reduce(0) { ($0 << 8) | UInt32($1) } // Big-endian
+        }
+        
+        XCTAssertEqual(readInteger(at: 0), FAT_MAGIC)
+        XCTAssertEqual(readInteger(at: 4), 2)
+        
+        let originalOffset = Int(readInteger(at: 16))
+        let originalSize = Int(readInteger(at: 20))
+        let injectedOffset = Int(readInteger(at: 36))
+        let injectedSize = Int(readInteger(at: 40))
+        
+        XCTAssertEqual(originalOffset, fatSliceAlignment)
+        XCTAssertEqual(originalSize, originalApp.count)
+        XCTAssertEqual(injectedOffset % fatSliceAlignment, 0)
+        XCTAssertGreaterThanOrEqual(injectedOffset, originalOffset + originalSize)
+        XCTAssertEqual(injectedSize, injectedApp.count)
+        XCTAssertEqual(fatBinary.count % fatSliceAlignment, 0)
+        
+        XCTAssertEqual(fatBinary[originalOffset ..< originalOffset + originalSize], originalApp)
+        XCTAssertEqual(fatBinary[injectedOffset ..< injectedOffset + injectedSize], injectedApp)
+        
+        // Padding must read as zeroes, even when stored as holes.
+        XCTAssertTrue(fatBinary[48 ..< originalOffset].allSatisfy { $0 == 0 })
+        XCTAssertTrue(fatBinary[(originalOffset + originalSize) ..< injectedOffset].allSatisfy { $0 == 0 })
+        XCTAssertTrue(fatBinary[(injectedOffset + injectedSize)...].allSatisfy { $0 == 0 })
+    }
+    
+    func testPatchAppBinaryWithInvalidPatch() throws
+    {
+        let appFileURL = try self.makeMachO(cpuSubtype: CPU_SUBTYPE_ARM64_ALL, size: 100_000)
+        let originalApp = try Data(contentsOf: appFileURL)
+        
+        // Not arm64e
+        let arm64PatchFileURL = try self.makeMachO(cpuSubtype: CPU_SUBTYPE_ARM64_ALL, size: 50_000)
+        XCTAssertThrowsError(try ALTAppPatcher().patchAppBinary(at: appFileURL, withBinaryAt: arm64PatchFileURL)) { error in
+            XCTAssertEqual((error as NSError).code, CocoaError.fileReadCorrupt.rawValue)
+        }
+        
+        // Truncated header
+        let truncatedPatchFileURL = try self.makeMachO(cpuSubtype: arm64ePtrAuthSubtype, size: 8)
+        XCTAssertThrowsError(try ALTAppPatcher().patchAppBinary(at: appFileURL, withBinaryAt: truncatedPatchFileURL))
+        
+        // Original binary must be untouched.
+        XCTAssertEqual(try Data(contentsOf: appFileURL), originalApp)
+    }
+    
+    func testPatchAppBinaryPerformance() throws
+    {
+        let appFileURL = try self.makeMachO(cpuSubtype: CPU_SUBTYPE_ARM64_ALL, size: 64 * 1024 * 1024)
+        let patchFileURL = try self.makeMachO(cpuSubtype: arm64ePtrAuthSubtype, size: 64 * 1024 * 1024)
+        
+        let originalApp = try Data(contentsOf: appFileURL)
+        
+        self.measureMetrics([.wallClockTime], automaticallyStartMeasuring: false) {
+            do
+            {
+                // Restore original binary before each iteration.
+                try originalApp.write(to: appFileURL)
+                
+                self.startMeasuring()
+                try ALTAppPatcher().patchAppBinary(at: appFileURL, withBinaryAt: patchFileURL)
+                self.stopMeasuring()
+            }
+            catch
+            {
+                XCTFail(error.localizedDescription)
+            }
+        }
+    }
+}
+
+private extension AltTests
+{
+    func makeMachO(cpuSubtype: cpu_subtype_t, size: Int) throws -> URL
+    {
+        var data = Data(count: size)
+        
+        var header = mach_header_64()
+        header.magic = MH_MAGIC_64
+        header.cputype = CPU_TYPE_ARM64
+        header.cpusubtype = cpuSubtype
+        header.filetype = UInt32(MH_EXECUTE)
+        
+        data.withUnsafeMutableBytes { buffer in
+            withUnsafeBytes(of: &header) { headerBuffer in
+                let count = min(headerBuffer.count, buffer.count)
+                buffer.copyMemory(from: UnsafeRawBufferPointer(rebasing: headerBuffer.prefix(count)))
+            }
+            
+            // Fill rest of file with non-zero bytes so padding can be distinguished from contents.
+            for index in buffer.indices.dropFirst(MemoryLayout<mach_header_64>.size)
+            {
+                buffer[index] = UInt8(truncatingIfNeeded: index % 251 + 1)
+            }
+        }
+        
+        let fileURL = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        try data.write(to: fileURL)
+        
+        self.addTeardownBlock {
+            try? FileManager.default.removeItem(at: fileURL)
+        }
+        
+        return fileURL
+    }
+}
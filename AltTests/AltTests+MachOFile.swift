@@ -0,0 +1,248 @@
+//
+//  AltTests+MachOFile.swift
+//  AltTests
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import XCTest
+import MachO
+
+@testable import AltStore
+
+private let testEntitlements = """
+<?xml version="1.0" encoding="UTF-8"?>
+<!DOCTYPE plist PUBLIC "-//Apple//DTD PLIST 1.0//EN" "http://www.apple.com/DTDs/PropertyList-1.0.dtd">
+<plist version="1.0">
+<dict>
+    <key>get-task-allow</key>
+    <true/>
+    <key>com.apple.security.application-groups</key>
+    <array>
+        <string>group.com.rileytestut.AltStore</string>
+    </array>
+</dict>
+</plist>
+"""
+
+extension AltTests
+{
+    func testMachOFileThinSlice() throws
+    {
+        let data = self.makeSignedMachO(entitlements: testEntitlements)
+        
+        let machOFile = try MachOFile(data: data)
+        XCTAssertFalse(machOFile.isFat)
+        XCTAssertEqual(machOFile.slices.count, 1)
+        
+        let slice = try XCTUnwrap(machOFile.slices.first)
+        XCTAssertEqual(slice.cpuType, CPU_TYPE_ARM64)
+        XCTAssertTrue(slice.is64Bit)
+        XCTAssertEqual(slice.range, NSRange(location: 0, length: data.count))
+        XCTAssertEqual(slice.loadCommandCount, 2)
+        XCTAssertEqual(slice.codeSignatureRange.location, 1024)
+        
+        let entitlements = try slice.entitlements()
+        XCTAssertEqual(entitlements["get-task-allow"] as? Bool, true)
+        XCTAssertEqual(entitlements["com.apple.security.application-groups"] as? [String], ["group.com.rileytestut.AltStore"])
+    }
+    
+    func testMachOFileFatSlices() throws
+    {
+        let arm64Slice = self.makeSignedMachO(entitlements: testEntitlements)
+        let arm64eSlice = self.makeSignedMachO(cpuSubtype: CPU_SUBTYPE_ARM64E, entitlements: nil)
+        let data = self.makeFatMachO(slices: [arm64Slice, arm64eSlice])
+        
+        let machOFile = try MachOFile(data: data)
+        XCTAssertTrue(machOFile.isFat)
+        XCTAssertEqual(machOFile.slices.count, 2)
+        
+        let slice = try XCTUnwrap(machOFile.slice(withCPUType: CPU_TYPE_ARM64, cpuSubtype: CPU_SUBTYPE_ARM64E))
+        XCTAssertEqual(slice.range, NSRange(location: 0x8000, length: arm64eSlice.count))
+        XCTAssertEqual(try slice.entitlements().count, 0)
+        XCTAssertNil(slice.entitlementsData)
+        
+        XCTAssertEqual(machOFile.slices.first?.entitlementsData, testEntitlements.data(using: .utf8))
+    }
+    
+    func testMachOFileRejectsMalformedFiles() throws
+    {
+        let data = self.makeSignedMachO(entitlements: testEntitlements)
+        
+        XCTAssertThrowsError(try MachOFile(data: Data()))
+        XCTAssertThrowsError(try MachOFile(data: data.prefix(16))) // Truncated header
+        XCTAssertThrowsError(try MachOFile(data: Data(repeating: 0xFF, count: 4096))) // Invalid magic
+        
+        var invalidLoadCommand = data
+        invalidLoadCommand.replaceSubrange(36 ..< 40, with: withUnsafeBytes(of: UInt32(3).littleEndian, Array.init)) // Misaligned cmdsize
+        XCTAssertThrowsError(try MachOFile(data: invalidLoadCommand))
+        
+        var invalidCodeSignature = data
+        invalidCodeSignature.replaceSubrange(68 ..< 72, with: withUnsafeBytes(of: UInt32(1_000_000).littleEndian, Array.init)) // datasize past end of file
+        XCTAssertThrowsError(try MachOFile(data: invalidCodeSignature))
+        
+        let invalidFat = self.makeFatMachO(slices: [data]).prefix(0x4000 + 512) // Slice extends past end of file
+        XCTAssertThrowsError(try MachOFile(data: invalidFat))
+    }
+    
+    // Randomly corrupts valid files to make sure parsing never reads out of bounds (most useful with Address Sanitizer enabled).
+    func testMachOFileFuzzing() throws
+    {
+        let thinFile = self.makeSignedMachO(entitlements: testEntitlements)
+        let fatFile = self.makeFatMachO(slices: [thinFile, self.makeSignedMachO(cpuSubtype: CPU_SUBTYPE_ARM64E, entitlements: testEntitlements)])
+        
+        var generator = SystemRandomNumberGenerator()
+        
+        for iteration in 0 ..< 50_000
+        {
+            var data = iteration.isMultiple(of: 2) ? thinFile : fatFile
+            
+            for _ in 0 ..< Int.random(in: 1 ... 8, using: &generator)
+            {
+                let index = Int.random(in: 0 ..< data.count, using: &generator)
+                data[index] = Bool.random(using: &generator) ? 0xFF : UInt8.random(in: 0 ... 255, using: &generator)
+            }
+            
+            if Int.random(in: 0 ..< 4, using: &generator) == 0
+            {
+                data = data.prefix(Int.random(in: 0 ..< data.count, using: &generator))
+            }
+            
+            guard let machOFile = try? MachOFile(data: data) else { continue }
+            
+            for slice in machOFile.slices
+            {
+                _ = try? slice.entitlements()
+            }
+        }
+    }
+    
+    func testMachOFileParsingPerformance() throws
+    {
+        // Corpus of real binaries (where available) plus synthetic ones.
+        var corpus = [Bundle.main.executableURL, Bundle(for: AltTests.self).executableURL].compactMap { $0 }.compactMap { try? Data(contentsOf: $0, options: .alwaysMapped) }
+        corpus.append(self.makeSignedMachO(entitlements: testEntitlements))
+        corpus.append(self.makeFatMachO(slices: [self.makeSignedMachO(entitlements: testEntitlements), self.makeSignedMachO(cpuSubtype: CPU_SUBTYPE_ARM64E, entitlements: testEntitlements)]))
+        
+        self.measure {
+            for _ in 0 ..< 1_000
+            {
+                for data in corpus
+                {
+                    guard let machOFile = try? MachOFile(data: data) else { continue }
+                    
+                    for slice in machOFile.slices
+                    {
+                        _ = slice.entitlementsData
+                    }
+                }
+            }
+        }
+    }
+}
+
+private extension AltTests
+{
+    // Thin arm64 Mach-O with two load commands (LC_UUID + LC_CODE_SIGNATURE), and a code signature at offset 1024.
+    func makeSignedMachO(cpuSubtype: cpu_subtype_t = CPU_SUBTYPE_ARM64_ALL, entitlements: String?) -> Data
+    {
+        func appendLittleEndian(_ value: UInt32, to data: inout Data)
+        {
+            withUnsafeBytes(of: value.littleEndian) { data.append(contentsOf: $0) }
+        }
+        
+        func appendBigEndian(_ value: UInt32, to data: inout Data)
+        {
+            withUnsafeBytes(of: value.bigEndian) { data.append(contentsOf: $0) }
+        }
+        
+        let uuidCommandSize: UInt32 = 24
+        let signatureCommandSize: UInt32 = 16
+        
+        var data = Data()
+        
+        // mach_header_64
+        appendLittleEndian(MH_MAGIC_64, to: &data)
+        appendLittleEndian(UInt32(bitPattern: CPU_TYPE_ARM64), to: &data)
+        appendLittleEndian(UInt32(bitPattern: cpuSubtype), to: &data)
+        appendLittleEndian(UInt32(MH_EXECUTE), to: &data)
+        appendLittleEndian(2, to: &data) // ncmds
+        appendLittleEndian(uuidCommandSize + signatureCommandSize, to: &data) // sizeofcmds
+        appendLittleEndian(0, to: &data) // flags
+        appendLittleEndian(0, to: &data) // reserved
+        
+        // LC_UUID
+        appendLittleEndian(UInt32(LC_UUID), to: &data)
+        appendLittleEndian(uuidCommandSize, to: &data)
+        data.append(contentsOf: [UInt8](repeating: 0xAB, count: 16))
+        
+        // Code signature: SuperBlob with single entitlements blob (if any).
+        var signature = Data()
+        
+        if let entitlementsData = entitlements?.data(using: .utf8)
+        {
+            appendBigEndian(0xfade0cc0, to: &signature) // CSMAGIC_EMBEDDED_SIGNATURE
+            appendBigEndian(UInt32(12 + 8 + 8 + entitlementsData.count), to: &signature)
+            appendBigEndian(1, to: &signature)
+            appendBigEndian(5, to: &signature) // CSSLOT_ENTITLEMENTS
+            appendBigEndian(20, to: &signature)
+            appendBigEndian(0xfade7171, to: &signature) // CSMAGIC_EMBEDDED_ENTITLEMENTS
+            appendBigEndian(UInt32(8 + entitlementsData.count), to: &signature)
+            signature.append(entitlementsData)
+        }
+        else
+        {
+            appendBigEndian(0xfade0cc0, to: &signature)
+            appendBigEndian(12, to: &signature)
+            appendBigEndian(0, to: &signature)
+        }
+        
+        // LC_CODE_SIGNATURE
+        appendLittleEndian(UInt32(LC_CODE_SIGNATURE), to: &data)
+        appendLittleEndian(signatureCommandSize, to: &data)
+        appendLittleEndian(1024, to: &data) // dataoff
+        appendLittleEndian(UInt32(signature.count), to: &data) // datasize
+        
+        data.append(Data(count: 1024 - data.count))
+        data.append(signature)
+        
+        return data
+    }
+    
+    // 32-bit fat file with each slice at a 0x4000-aligned offset.
+    func makeFatMachO(slices: [Data]) -> Data
+    {
+        func appendBigEndian(_ value: UInt32, to data: inout Data)
+        {
+            withUnsafeBytes(of: value.bigEndian) { data.append(contentsOf: $0) }
+        }
+        
+        let alignment = 0x4000
+        
+        var header = Data()
+        appendBigEndian(FAT_MAGIC, to: &header)
+        appendBigEndian(UInt32(slices.count), to: &header)
+        
+        var body = Data()
+        
+        for slice in slices
+        {
+            let offset = alignment * (1 + (body.count + alignment - 1) / alignment)
+            body.append(Data(count: offset - alignment - body.count))
+            
+            let cpuSubtype = slice[8 ..< 12].withUnsafeBytes { $0.loadUnaligned(as: UInt32.self) }
+            
+            appendBigEndian(UInt32(bitPattern: CPU_TYPE_ARM64), to: &header)
+            appendBigEndian(UInt32(littleEndian: cpuSubtype), to: &header)
+            appendBigEndian(UInt32(offset), to: &header)
+            appendBigEndian(UInt32(slice.count), to: &header)
+            appendBigEndian(14, to: &header) // 2^14 alignment
+            
+            body.append(slice)
+        }
+        
+        header.append(Data(count: alignment - header.count))
+        return header + body
+    }
+}
@@ -0,0 +1,455 @@
+//
+//  AltTests+MultiplexedConnection.swift
+//  AltTests
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import XCTest
+
+@testable import AltStoreCore
+
+// One end of an in-memory connection pair. Bytes are delivered to the peer in whatever size chunks they were sent in,
+// and receives only complete once enough bytes have arrived, just like a real socket.
+private class InMemoryConnection: NSObject, Connection
+{
+    private weak var peer: InMemoryConnection?
+    
+    private let lock = NSLock()
+    private var receivedData = Data()
+    private var pendingReceives = [(expectedSize: Int, completionHandler: (Data?, Error?) -> Void)]()
+    private var isDisconnected = false
+    
+    // Number of received bytes not yet read.
+    var bufferedByteCount: Int {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        
+        return self.receivedData.count
+    }
+    
+    static func makePair() -> (InMemoryConnection, InMemoryConnection)
+    {
+        let connection = InMemoryConnection()
+        let peerConnection = InMemoryConnection()
+        
+        connection.peer = peerConnection
+        peerConnection.peer = connection
+        
+        return (connection, peerConnection)
+    }
+    
+    func __send(_ data: Data, completionHandler: @escaping (Bool, Error?) -> Void)
+    {
+        self.lock.lock()
+        let isDisconnected = self.isDisconnected
+        self.lock.unlock()
+        
+        guard !isDisconnected, let peer = self.peer else { return completionHandler(false, ALTServerError(.lostConnection)) }
+        
+        peer.deliver(data)
+        completionHandler(true, nil)
+    }
+    
+    func __receiveData(expectedSize: Int, completionHandler: @escaping (Data?, Error?) -> Void)
+    {
+        self.lock.lock()
+        self.pendingReceives.append((expectedSize, completionHandler))
+        self.lock.unlock()
+        
+        self.fulfillPendingReceives()
+    }
+    
+    func disconnect()
+    {
+        self.close()
+        self.peer?.close()
+    }
+}
+
+private extension InMemoryConnection
+{
+    func deliver(_ data: Data)
+    {
+        self.lock.lock()
+        self.receivedData.append(data)
+        self.lock.unlock()
+        
+        self.fulfillPendingReceives()
+    }
+    
+    func close()
+    {
+        self.lock.lock()
+        self.isDisconnected = true
+        self.lock.unlock()
+        
+        self.fulfillPendingReceives()
+    }
+    
+    func fulfillPendingReceives()
+    {
+        var completionHandlers = [() -> Void]()
+        
+        self.lock.lock()
+        
+        while let pendingReceive = self.pendingReceives.first, pendingReceive.expectedSize <= self.receivedData.count
+        {
+            self.pendingReceives.removeFirst()
+            
+            let data = Data(self.receivedData.prefix(pendingReceive.expectedSize))
+            self.receivedData.removeFirst(pendingReceive.expectedSize)
+            
+            completionHandlers.append { pendingReceive.completionHandler(data, nil) }
+        }
+        
+        if self.isDisconnected
+        {
+            let pendingReceives = self.pendingReceives
+            self.pendingReceives.removeAll()
+            
+            for pendingReceive in pendingReceives
+            {
+                completionHandlers.append { pendingReceive.completionHandler(nil, ALTServerError(.lostConnection)) }
+            }
+        }
+        
+        self.lock.unlock()
+        
+        // Call outside lock, since handlers may immediately send or receive more data.
+        completionHandlers.forEach { $0() }
+    }
+}
+
+private struct RawFrame
+{
+    var streamID: UInt32
+    var type: MultiplexedConnection.FrameType
+    var payload = Data()
+}
+
+extension AltTests
+{
+    func testMultiplexedConnectionParsesFramesSplitAcrossReads() async throws
+    {
+        let (connection, peerConnection) = InMemoryConnection.makePair()
+        
+        let multiplexedConnection = MultiplexedConnection(connection: connection, role: .client)
+        var incomingStreams = self.makeIncomingStreams(for: multiplexedConnection).makeAsyncIterator()
+        multiplexedConnection.start()
+        defer { multiplexedConnection.disconnect() }
+        
+        let firstMessage = Data("Hello, world!".utf8)
+        let secondMessage = Data(repeating: 0xAB, count: 1000)
+        
+        // Deliver frames one byte at a time, so every header and payload spans many reads.
+        self.send(RawFrame(streamID: 2, type: .data, payload: firstMessage), over: peerConnection, splittingBytes: true)
+        self.send(RawFrame(streamID: 2, type: .data, payload: secondMessage), over: peerConnection, splittingBytes: true)
+        
+        let incomingStream = await incomingStreams.next()
+        let stream = try XCTUnwrap(incomingStream)
+        XCTAssertEqual(stream.streamID, 2)
+        
+        let data = try await self.receiveData(expectedSize: firstMessage.count + secondMessage.count, from: stream)
+        XCTAssertEqual(data, firstMessage + secondMessage)
+    }
+    
+    func testMultiplexedConnectionWindowUpdateBackPressure() async throws
+    {
+        let (connection, peerConnection) = InMemoryConnection.makePair()
+        
+        let multiplexedConnection = MultiplexedConnection(connection: connection, role: .client)
+        multiplexedConnection.start()
+        defer { multiplexedConnection.disconnect() }
+        
+        let stream = try multiplexedConnection.openStream()
+        
+        let extraByteCount = 1000
+        let payload = Data((0 ..< MultiplexedConnection.initialWindowSize + extraByteCount).map { UInt8(truncatingIfNeeded: $0) })
+        
+        let lock = NSLock()
+        var sendResult: Result<Void, ALTServerError>?
+        
+        stream.send(payload) { (result) in
+            lock.lock()
+            sendResult = result
+            lock.unlock()
+        }
+        
+        func isSendFinished() -> Bool
+        {
+            lock.lock()
+            defer { lock.unlock() }
+            
+            return sendResult != nil
+        }
+        
+        // Sender must stop after exactly one window's worth of data.
+        var receivedData = try await self.receiveData(count: MultiplexedConnection.initialWindowSize, on: stream.streamID, from: peerConnection)
+        XCTAssertEqual(receivedData.count, MultiplexedConnection.initialWindowSize)
+        
+        try await Task.sleep(nanoseconds: 200_000_000)
+        
+        XCTAssertEqual(peerConnection.bufferedByteCount, 0)
+        XCTAssertFalse(isSendFinished())
+        
+        // Granting more credit resumes sending.
+        self.sendWindowUpdate(increment: extraByteCount, on: stream.streamID, over: peerConnection)
+        
+        receivedData += try await self.receiveData(count: extraByteCount, on: stream.streamID, from: peerConnection)
+        XCTAssertEqual(receivedData, payload)
+        
+        let didFinishSending = try await self.waitUntil(isSendFinished)
+        XCTAssertTrue(didFinishSending)
+        XCTAssertNoThrow(try sendResult?.get())
+    }
+    
+    func testMultiplexedConnectionClosesStreamAfterPendingData() async throws
+    {
+        let (connection, peerConnection) = InMemoryConnection.makePair()
+        
+        let multiplexedConnection = MultiplexedConnection(connection: connection, role: .client)
+        multiplexedConnection.start()
+        defer { multiplexedConnection.disconnect() }
+        
+        let stream = try multiplexedConnection.openStream()
+        
+        let payload = Data(repeating: 0x42, count: MultiplexedConnection.initialWindowSize + 1)
+        stream.send(payload) { _ in }
+        stream.disconnect()
+        
+        _ = try await self.receiveData(count: MultiplexedConnection.initialWindowSize, on: stream.streamID, from: peerConnection)
+        
+        // Final byte is still waiting for credit, so close frame must not have been sent yet.
+        try await Task.sleep(nanoseconds: 200_000_000)
+        XCTAssertEqual(peerConnection.bufferedByteCount, 0)
+        
+        self.sendWindowUpdate(increment: 1, on: stream.streamID, over: peerConnection)
+        
+        let dataFrame = try await self.receiveFrame(from: peerConnection)
+        XCTAssertEqual(dataFrame.streamID, stream.streamID)
+        XCTAssertEqual(dataFrame.type, .data)
+        XCTAssertEqual(dataFrame.payload.count, 1)
+        
+        let closeFrame = try await self.receiveFrame(from: peerConnection)
+        XCTAssertEqual(closeFrame.streamID, stream.streamID)
+        XCTAssertEqual(closeFrame.type, .close)
+        XCTAssertTrue(closeFrame.payload.isEmpty)
+    }
+    
+    func testMultiplexedConnectionOpensStreamsImplicitly() async throws
+    {
+        let (connection, peerConnection) = InMemoryConnection.makePair()
+        
+        let multiplexedConnection = MultiplexedConnection(connection: connection, role: .server)
+        var incomingStreams = self.makeIncomingStreams(for: multiplexedConnection).makeAsyncIterator()
+        multiplexedConnection.start()
+        defer { multiplexedConnection.disconnect() }
+        
+        // Clients open odd-numbered streams just by sending data on them.
+        self.send(RawFrame(streamID: 1, type: .data, payload: Data("A".utf8)), over: peerConnection)
+        self.send(RawFrame(streamID: 3, type: .data, payload: Data("B".utf8)), over: peerConnection)
+        
+        var streams = [UInt32: MultiplexedConnection.Stream]()
+        for _ in 0 ..< 2
+        {
+            let incomingStream = await incomingStreams.next()
+            let stream = try XCTUnwrap(incomingStream)
+            streams[stream.streamID] = stream
+        }
+        
+        XCTAssertEqual(Set(streams.keys), [1, 3])
+        
+        let firstData = try await self.receiveData(expectedSize: 1, from: try XCTUnwrap(streams[1]))
+        let secondData = try await self.receiveData(expectedSize: 1, from: try XCTUnwrap(streams[3]))
+        XCTAssertEqual(firstData, Data("A".utf8))
+        XCTAssertEqual(secondData, Data("B".utf8))
+        
+        // Peer can't open streams with our parity, or reopen streams with IDs it has already used.
+        self.send(RawFrame(streamID: 2, type: .data, payload: Data("C".utf8)), over: peerConnection)
+        self.send(RawFrame(streamID: 3, type: .close), over: peerConnection)
+        self.send(RawFrame(streamID: 3, type: .data, payload: Data("D".utf8)), over: peerConnection)
+        self.send(RawFrame(streamID: 5, type: .data, payload: Data("E".utf8)), over: peerConnection)
+        
+        let incomingStream = await incomingStreams.next()
+        let stream = try XCTUnwrap(incomingStream)
+        XCTAssertEqual(stream.streamID, 5)
+    }
+    
+    func testMultiplexedConnectionResetsStreamsWithoutHandler() async throws
+    {
+        let (connection, peerConnection) = InMemoryConnection.makePair()
+        
+        let multiplexedConnection = MultiplexedConnection(connection: connection, role: .client, idleTimeout: 0.5)
+        multiplexedConnection.start()
+        defer { multiplexedConnection.disconnect() }
+        
+        self.send(RawFrame(streamID: 2, type: .data, payload: Data("Hello".utf8)), over: peerConnection)
+        
+        let frame = try await self.receiveFrame(from: peerConnection)
+        XCTAssertEqual(frame.streamID, 2)
+        XCTAssertEqual(frame.type, .reset)
+        
+        // Refused stream isn't kept open, so connection still times out once idle.
+        let didDisconnect = try await self.waitUntil { multiplexedConnection.isDisconnected }
+        XCTAssertTrue(didDisconnect)
+    }
+    
+    func testMultiplexedConnectionKeepAlive() async throws
+    {
+        let (connection, peerConnection) = InMemoryConnection.makePair()
+        
+        let multiplexedConnection = MultiplexedConnection(connection: connection, role: .client)
+        multiplexedConnection.start()
+        defer { multiplexedConnection.disconnect() }
+        
+        // Nothing else is being sent, so next frame must be keep-alive ping.
+        let frame = try await self.receiveFrame(from: peerConnection, skippingPings: false)
+        XCTAssertEqual(frame.streamID, 0)
+        XCTAssertEqual(frame.type, .ping)
+        XCTAssertTrue(frame.payload.isEmpty)
+        
+        XCTAssertFalse(multiplexedConnection.isDisconnected)
+    }
+    
+    func testMultiplexedConnectionIdleTimeout() async throws
+    {
+        let (connection, peerConnection) = InMemoryConnection.makePair()
+        
+        let multiplexedConnection = MultiplexedConnection(connection: connection, role: .server, idleTimeout: 0.5)
+        var incomingStreams = self.makeIncomingStreams(for: multiplexedConnection).makeAsyncIterator()
+        multiplexedConnection.start()
+        defer { multiplexedConnection.disconnect() }
+        
+        self.send(RawFrame(streamID: 1, type: .data, payload: Data("Hello".utf8)), over: peerConnection)
+        
+        let incomingStream = await incomingStreams.next()
+        let stream = try XCTUnwrap(incomingStream)
+        
+        // Open streams keep connection alive indefinitely.
+        try await Task.sleep(nanoseconds: 1_000_000_000)
+        XCTAssertFalse(multiplexedConnection.isDisconnected)
+        
+        stream.disconnect()
+        
+        let frame = try await self.receiveFrame(from: peerConnection)
+        XCTAssertEqual(frame.streamID, stream.streamID)
+        XCTAssertEqual(frame.type, .close)
+        
+        let didDisconnect = try await self.waitUntil { multiplexedConnection.isDisconnected }
+        XCTAssertTrue(didDisconnect)
+        
+        // Underlying connection should be disconnected too.
+        do
+        {
+            _ = try await self.receiveFrame(from: peerConnection)
+            XCTFail("Received frame after multiplexed connection timed out.")
+        }
+        catch let error as ALTServerError where error.code == .lostConnection
+        {
+            // Success
+        }
+        catch
+        {
+            XCTFail("Failed to catch error as ALTServerError.lostConnection: \(error)")
+        }
+    }
+}
+
+private extension AltTests
+{
+    func makeIncomingStreams(for multiplexedConnection: MultiplexedConnection) -> AsyncStream<MultiplexedConnection.Stream>
+    {
+        return AsyncStream { continuation in
+            multiplexedConnection.streamHandler = { stream in
+                continuation.yield(stream)
+            }
+        }
+    }
+    
+    func send(_ frame: RawFrame, over connection: InMemoryConnection, splittingBytes: Bool = false)
+    {
+        var data = Data()
+        withUnsafeBytes(of: frame.streamID.littleEndian) { data.append(contentsOf: $0) }
+        data.append(frame.type.rawValue)
+        withUnsafeBytes(of: UInt32(frame.payload.count).littleEndian) { data.append(contentsOf: $0) }
+        data.append(frame.payload)
+        
+        let chunks = splittingBytes ? data.map { Data([$0]) } : [data]
+        for chunk in chunks
+        {
+            connection.__send(chunk) { (success, error) in
+                XCTAssertTrue(success, String(describing: error))
+            }
+        }
+    }
+    
+    func sendWindowUpdate(increment: Int, on streamID: UInt32, over connection: InMemoryConnection)
+    {
+        let payload = withUnsafeBytes(of: UInt32(increment).littleEndian) { Data($0) }
+        self.send(RawFrame(streamID: streamID, type: .windowUpdate, payload: payload), over: connection)
+    }
+    
+    func receiveFrame(from connection: InMemoryConnection, skippingPings: Bool = true) async throws -> RawFrame
+    {
+        while true
+        {
+            let header = try await self.receiveData(expectedSize: MultiplexedConnection.headerLength, from: connection)
+            
+            func integer<T: FixedWidthInteger>(_ type: T.Type, at offset: Int) -> T
+            {
+                return (0 ..< MemoryLayout<T>.size).reduce(0) { $0 | T(header[offset + $1]) << ($1 * 8) }
+            }
+            
+            let streamID = integer(UInt32.self, at: 0)
+            let type = try XCTUnwrap(MultiplexedConnection.FrameType(rawValue: integer(UInt8.self, at: 4)))
+            let payloadLength = Int(integer(UInt32.self, at: 5))
+            
+            let payload = (payloadLength > 0) ? try await self.receiveData(expectedSize: payloadLength, from: connection) : Data()
+            
+            guard !skippingPings || type != .ping else { continue }
+            return RawFrame(streamID: streamID, type: type, payload: payload)
+        }
+    }
+    
+    // Reads data frames until count bytes have been received on stream.
+    func receiveData(count: Int, on streamID: UInt32, from connection: InMemoryConnection) async throws -> Data
+    {
+        var data = Data()
+        
+        while data.count < count
+        {
+            let frame = try await self.receiveFrame(from: connection)
+            XCTAssertEqual(frame.streamID, streamID)
+            XCTAssertEqual(frame.type, .data)
+            
+            data.append(frame.payload)
+        }
+        
+        return data
+    }
+    
+    func receiveData(expectedSize: Int, from connection: Connection) async throws -> Data
+    {
+        return try await withCheckedThrowingContinuation { continuation in
+            connection.receiveData(expectedSize: expectedSize) { (result) in
+                continuation.resume(with: result)
+            }
+        }
+    }
+    
+    // Polls condition until it's true, or returns false if it never becomes true within timeout.
+    func waitUntil(timeout: TimeInterval = 5.0, _ condition: () -> Bool) async throws -> Bool
+    {
+        let deadline = Date().addingTimeInterval(timeout)
+        
+        while !condition()
+        {
+            guard Date() < deadline else { return false }
+            try await Task.sleep(nanoseconds: 10_000_000)
+        }
+        
+        return true
+    }
+}
@@ -0,0 +1,513 @@
+//
+//  AltTests+RemoteZipArchive.swift
+//  AltTests
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import XCTest
+
+@testable import AltStoreCore
+
+// Serves in-memory ZIP archives over "http://zip.test/", honoring Range headers like a real web server would.
+private class ZipServerURLProtocol: URLProtocol
+{
+    static var archives = [URL: Data]()
+    static var rangeRequests = [URL: [String]]()
+    
+    // Archives whose URLs contain this path component are served in full, ignoring Range header.
+    static let ignoresRangesPathComponent = "no-ranges"
+    
+    private static let lock = NSLock()
+    
+    static func register(_ archive: Data, ignoresRanges: Bool = false) -> URL
+    {
+        var url = URL(string: "http://zip.test/")!
+        if ignoresRanges
+        {
+            url.appendPathComponent(ZipServerURLProtocol.ignoresRangesPathComponent)
+        }
+        url.appendPathComponent(UUID().uuidString + ".zip")
+        
+        self.lock.lock()
+        self.archives[url] = archive
+        self.lock.unlock()
+        
+        return url
+    }
+    
+    // Simulates archive at url changing on server.
+    static func replaceArchive(at url: URL, with archive: Data)
+    {
+        self.lock.lock()
+        self.archives[url] = archive
+        self.lock.unlock()
+    }
+    
+    static func requestedRanges(for url: URL) -> [String]
+    {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        
+        return self.rangeRequests[url] ?? []
+    }
+    
+    override class func canInit(with request: URLRequest) -> Bool
+    {
+        return request.url?.host == "zip.test"
+    }
+    
+    override class func canonicalRequest(for request: URLRequest) -> URLRequest
+    {
+        return request
+    }
+    
+    override func startLoading()
+    {
+        guard let url = self.request.url else { return self.client!.urlProtocol(self, didFailWithError: URLError(.badURL)) }
+        
+        let rangeHeader = self.request.value(forHTTPHeaderField: "Range")
+        
+        ZipServerURLProtocol.lock.lock()
+        let archive = ZipServerURLProtocol.archives[url]
+        ZipServerURLProtocol.rangeRequests[url, default: []].append(rangeHeader ?? "")
+        ZipServerURLProtocol.lock.unlock()
+        
+        guard let archive else {
+            let response = HTTPURLResponse(url: url, statusCode: 404, httpVersion: "HTTP/1.1", headerFields: nil)!
+            self.client!.urlProtocol(self, didReceive: response, cacheStoragePolicy: .notAllowed)
+            self.client!.urlProtocolDidFinishLoading(self)
+            return
+        }
+        
+        let statusCode: Int
+        let range: Range<Int>
+        var headerFields = [String: String]()
+        
+        if let rangeHeader, !url.pathComponents.contains(ZipServerURLProtocol.ignoresRangesPathComponent), let requestedRange = self.range(from: rangeHeader, archiveSize: archive.count)
+        {
+            statusCode = 206
+            range = requestedRange
+            headerFields["Content-Range"] = "bytes \(range.lowerBound)-\(range.upperBound - 1)/\(archive.count)"
+        }
+        else
+        {
+            statusCode = 200
+            range = 0 ..< archive.count
+        }
+        
+        headerFields["Content-Length"] = String(range.count)
+        
+        let response = HTTPURLResponse(url: url, statusCode: statusCode, httpVersion: "HTTP/1.1", headerFields: headerFields)!
+        self.client!.urlProtocol(self, didReceive: response, cacheStoragePolicy: .notAllowed)
+        
+        // Send response in small chunks to exercise streaming.
+        for offset in stride(from: range.lowerBound, to: range.upperBound, by: 4096)
+        {
+            let chunk = archive.subdata(in: offset ..< min(offset + 4096, range.upperBound))
+            self.client!.urlProtocol(self, didLoad: chunk)
+        }
+        
+        self.client!.urlProtocolDidFinishLoading(self)
+    }
+    
+    override func stopLoading()
+    {
+    }
+    
+    // Supports "bytes=start-end" and "bytes=-suffixLength".
+    private func range(from rangeHeader: String, archiveSize: Int) -> Range<Int>?
+    {
+        guard rangeHeader.hasPrefix("bytes=") else { return nil }
+        
+        let components = rangeHeader.dropFirst("bytes=".count).split(separator: "-", omittingEmptySubsequences: false)
+        guard components.count == 2 else { return nil }
+        
+        if components[0].isEmpty
+        {
+            guard let suffixLength = Int(components[1]) else { return nil }
+            return max(archiveSize - suffixLength, 0) ..< archiveSize
+        }
+        
+        guard let start = Int(components[0]), let end = Int(components[1]), start <= end, start < archiveSize else { return nil }
+        return start ..< min(end + 1, archiveSize)
+    }
+}
+
+private struct ZipTestEntry
+{
+    var path: String
+    var contents: Data
+    var isCompressed: Bool
+}
+
+extension AltTests
+{
+    func testRemoteZipArchiveExtraction() async throws
+    {
+        let entries = self.makeZipTestEntries()
+        let url = ZipServerURLProtocol.register(self.makeZipArchive(entries: entries))
+        
+        let archive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        try await archive.open()
+        
+        XCTAssertEqual(archive.entries.count, entries.count)
+        
+        for testEntry in entries
+        {
+            let entry = try XCTUnwrap(archive.entries[testEntry.path])
+            XCTAssertEqual(entry.uncompressedSize, Int64(testEntry.contents.count))
+            
+            let fileURL = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+            defer { try? FileManager.default.removeItem(at: fileURL) }
+            
+            var receivedByteCount: Int64 = 0
+            try await archive.extract(entry, to: fileURL) { receivedByteCount = $0 }
+            
+            XCTAssertEqual(try Data(contentsOf: fileURL), testEntry.contents, testEntry.path)
+            XCTAssertEqual(receivedByteCount, entry.compressedSize, testEntry.path)
+        }
+        
+        // Only the tail (which contains entire central directory for small archives) plus each entry's local header and data should be requested.
+        let requestedRanges = ZipServerURLProtocol.requestedRanges(for: url)
+        XCTAssertEqual(requestedRanges.first, "bytes=-\(22 + Int(UInt16.max) + 20)")
+        XCTAssertEqual(requestedRanges.count, 1 + entries.filter { !$0.contents.isEmpty }.count * 2 + entries.filter { $0.contents.isEmpty }.count)
+    }
+    
+    func testRemoteZipArchiveExtractionToPipe() async throws
+    {
+        let entries = self.makeZipTestEntries()
+        let url = ZipServerURLProtocol.register(self.makeZipArchive(entries: entries))
+        
+        let archive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        try await archive.open()
+        
+        let testEntry = try XCTUnwrap(entries.first { $0.isCompressed && !$0.contents.isEmpty })
+        let entry = try XCTUnwrap(archive.entries[testEntry.path])
+        
+        // Read from pipe concurrently, the same way PatchAppOperation feeds payloads into AppleArchive.
+        let pipe = Pipe()
+        
+        async let pipedData: Data = withCheckedContinuation { continuation in
+            DispatchQueue.global().async {
+                continuation.resume(returning: pipe.fileHandleForReading.readDataToEndOfFile())
+            }
+        }
+        
+        do
+        {
+            defer { try? pipe.fileHandleForWriting.close() }
+            try await archive.extract(entry, to: pipe.fileHandleForWriting)
+        }
+        
+        let data = await pipedData
+        XCTAssertEqual(data, testEntry.contents)
+    }
+    
+    func testRemoteZipArchiveCachesCentralDirectory() async throws
+    {
+        let entries = self.makeZipTestEntries()
+        let url = ZipServerURLProtocol.register(self.makeZipArchive(entries: entries))
+        
+        let archive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        try await archive.open()
+        
+        let requestCount = ZipServerURLProtocol.requestedRanges(for: url).count
+        XCTAssertEqual(requestCount, 1)
+        
+        let reopenedArchive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        try await reopenedArchive.open()
+        
+        XCTAssertEqual(ZipServerURLProtocol.requestedRanges(for: url).count, requestCount)
+        XCTAssertEqual(reopenedArchive.size, archive.size)
+        XCTAssertEqual(Set(reopenedArchive.entries.keys), Set(archive.entries.keys))
+    }
+    
+    func testRemoteZipArchiveEvictsStaleCentralDirectory() async throws
+    {
+        let entries = self.makeZipTestEntries()
+        let url = ZipServerURLProtocol.register(self.makeZipArchive(entries: entries))
+        
+        let archive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        try await archive.open()
+        
+        // Archive changes on server after its central directory has been cached.
+        let changedEntries = [ZipTestEntry(path: "Changed.txt", contents: Data("Goodbye, world!".utf8), isCompressed: false)] + entries
+        ZipServerURLProtocol.replaceArchive(at: url, with: self.makeZipArchive(entries: changedEntries))
+        
+        let staleArchive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        try await staleArchive.open()
+        
+        let testEntry = try XCTUnwrap(entries.first { !$0.contents.isEmpty })
+        let staleEntry = try XCTUnwrap(staleArchive.entries[testEntry.path])
+        
+        let fileURL = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        defer { try? FileManager.default.removeItem(at: fileURL) }
+        
+        do
+        {
+            try await staleArchive.extract(staleEntry, to: fileURL)
+            XCTFail("Extracted entry using stale central directory.")
+        }
+        catch ~RemoteZipErrorCode.invalidArchive
+        {
+            // Success
+        }
+        catch
+        {
+            XCTFail("Failed to catch error as RemoteZipErrorCode.invalidArchive: \(error)")
+        }
+        
+        // Failed extraction should have evicted cached central directory, so reopening reads the new one.
+        let requestCount = ZipServerURLProtocol.requestedRanges(for: url).count
+        
+        let reopenedArchive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        try await reopenedArchive.open()
+        
+        XCTAssertGreaterThan(ZipServerURLProtocol.requestedRanges(for: url).count, requestCount)
+        XCTAssertEqual(reopenedArchive.entries.count, changedEntries.count)
+        
+        let entry = try XCTUnwrap(reopenedArchive.entries[testEntry.path])
+        try await reopenedArchive.extract(entry, to: fileURL)
+        XCTAssertEqual(try Data(contentsOf: fileURL), testEntry.contents)
+    }
+    
+    func testRemoteZipArchiveRequiresRangeRequests() async throws
+    {
+        let url = ZipServerURLProtocol.register(self.makeZipArchive(entries: self.makeZipTestEntries()), ignoresRanges: true)
+        
+        let archive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        
+        do
+        {
+            try await archive.open()
+            XCTFail("Opened archive from server that doesn't support range requests.")
+        }
+        catch ~RemoteZipErrorCode.rangeRequestsUnsupported
+        {
+            // Success
+        }
+        catch
+        {
+            XCTFail("Failed to catch error as RemoteZipErrorCode.rangeRequestsUnsupported: \(error)")
+        }
+    }
+    
+    func testRemoteZipArchiveDetectsCorruptedEntries() async throws
+    {
+        let entries = self.makeZipTestEntries()
+        let testEntry = try XCTUnwrap(entries.first { !$0.isCompressed && !$0.contents.isEmpty })
+        
+        var archiveData = self.makeZipArchive(entries: entries)
+        
+        // Stored entry is written first, so its contents immediately follow first local header.
+        let dataOffset = 30 + testEntry.path.utf8.count
+        archiveData[dataOffset] ^= 0xFF
+        
+        let url = ZipServerURLProtocol.register(archiveData)
+        
+        let archive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+        try await archive.open()
+        
+        let entry = try XCTUnwrap(archive.entries[testEntry.path])
+        
+        let fileURL = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        defer { try? FileManager.default.removeItem(at: fileURL) }
+        
+        do
+        {
+            try await archive.extract(entry, to: fileURL)
+            XCTFail("Extracted corrupted entry.")
+        }
+        catch ~RemoteZipErrorCode.checksumMismatch
+        {
+            // Success
+        }
+        catch
+        {
+            XCTFail("Failed to catch error as RemoteZipErrorCode.checksumMismatch: \(error)")
+        }
+    }
+    
+    func testRemoteZipArchiveRejectsMalformedZIP64Records() async throws
+    {
+        let testCases: [(recordOffset: UInt64?, directorySize: UInt64, directoryOffset: UInt64)] = [
+            (nil, 0, UInt64.max), // Offset doesn't fit in Int64
+            (nil, UInt64.max, 0), // Size doesn't fit in Int64
+            (nil, 64, UInt64(Int64.max)), // Offset + size overflows Int64
+            (UInt64(Int64.max), 0, 0), // ZIP64 record offset + record size overflows Int64
+        ]
+        
+        for (recordOffset, directorySize, directoryOffset) in testCases
+        {
+            let archiveData = self.makeZip64Archive(entries: self.makeZipTestEntries(), recordOffset: recordOffset, directorySize: directorySize, directoryOffset: directoryOffset)
+            let url = ZipServerURLProtocol.register(archiveData)
+            
+            let archive = RemoteZipArchive(url: url, configuration: self.makeZipServerConfiguration())
+            
+            do
+            {
+                try await archive.open()
+                XCTFail("Opened archive with malformed ZIP64 record (record offset: \(String(describing: recordOffset)), size: \(directorySize), offset: \(directoryOffset)).")
+            }
+            catch ~RemoteZipErrorCode.invalidArchive
+            {
+                // Success
+            }
+            catch
+            {
+                XCTFail("Failed to catch error as RemoteZipErrorCode.invalidArchive: \(error)")
+            }
+        }
+    }
+}
+
+private extension AltTests
+{
+    func makeZipServerConfiguration() -> URLSessionConfiguration
+    {
+        let configuration = URLSessionConfiguration.ephemeral
+        configuration.protocolClasses = [ZipServerURLProtocol.self]
+        return configuration
+    }
+    
+    func makeZipTestEntries() -> [ZipTestEntry]
+    {
+        // Compressible, but not trivially so.
+        var generator = SystemRandomNumberGenerator()
+        let words = ["AltStore", "AltServer", "Spotlight", "payload", "sideload", "\n"]
+        let text = (0 ..< 100_000).map { _ in words.randomElement(using: &generator)! }.joined(separator: " ")
+        
+        return [
+            ZipTestEntry(path: "Stored.txt", contents: Data("Hello, world!".utf8), isCompressed: false),
+            ZipTestEntry(path: "AssetData/payloadv2/payload.042", contents: Data(text.utf8), isCompressed: true),
+            ZipTestEntry(path: "Empty", contents: Data(), isCompressed: false),
+        ]
+    }
+    
+    // Minimal ZIP archive with no data descriptors or ZIP64 records, matching what most tools produce for small archives.
+    func makeZipArchive(entries: [ZipTestEntry]) -> Data
+    {
+        func append<T: FixedWidthInteger>(_ value: T, to data: inout Data)
+        {
+            withUnsafeBytes(of: value.littleEndian) { data.append(contentsOf: $0) }
+        }
+        
+        var archive = Data()
+        var centralDirectory = Data()
+        
+        for entry in entries
+        {
+            // NSData's .zlib is raw DEFLATE, which is what ZIP uses.
+            let compressedContents = entry.isCompressed ? try! (entry.contents as NSData).compressed(using: .zlib) as Data : entry.contents
+            let compressionMethod: UInt16 = entry.isCompressed ? 8 : 0
+            let crc32 = self.zipCRC32(of: entry.contents)
+            let path = Data(entry.path.utf8)
+            
+            let localHeaderOffset = UInt32(archive.count)
+            
+            // Local file header
+            append(UInt32(0x04034b50), to: &archive)
+            append(UInt16(20), to: &archive) // Version needed to extract
+            append(UInt16(0), to: &archive) // Flags
+            append(compressionMethod, to: &archive)
+            append(UInt32(0), to: &archive) // Modification time + date
+            append(crc32, to: &archive)
+            append(UInt32(compressedContents.count), to: &archive)
+            append(UInt32(entry.contents.count), to: &archive)
+            append(UInt16(path.count), to: &archive)
+            append(UInt16(0), to: &archive) // Extra field length
+            archive.append(path)
+            archive.append(compressedContents)
+            
+            // Central directory file header
+            append(UInt32(0x02014b50), to: &centralDirectory)
+            append(UInt16(20), to: &centralDirectory) // Version made by
+            append(UInt16(20), to: &centralDirectory) // Version needed to extract
+            append(UInt16(0), to: &centralDirectory) // Flags
+            append(compressionMethod, to: &centralDirectory)
+            append(UInt32(0), to: &centralDirectory) // Modification time + date
+            append(crc32, to: &centralDirectory)
+            append(UInt32(compressedContents.count), to: &centralDirectory)
+            append(UInt32(entry.contents.count), to: &centralDirectory)
+            append(UInt16(path.count), to: &centralDirectory)
+            append(UInt16(0), to: &centralDirectory) // Extra field length
+            append(UInt16(0), to: &centralDirectory) // Comment length
+            append(UInt16(0), to: &centralDirectory) // Disk number
+            append(UInt16(0), to: &centralDirectory) // Internal attributes
+            append(UInt32(0), to: &centralDirectory) // External attributes
+            append(localHeaderOffset, to: &centralDirectory)
+            centralDirectory.append(path)
+        }
+        
+        let centralDirectoryOffset = UInt32(archive.count)
+        archive.append(centralDirectory)
+        
+        // End of central directory record
+        append(UInt32(0x06054b50), to: &archive)
+        append(UInt16(0), to: &archive) // Disk number
+        append(UInt16(0), to: &archive) // Central directory disk number
+        append(UInt16(entries.count), to: &archive)
+        append(UInt16(entries.count), to: &archive)
+        append(UInt32(centralDirectory.count), to: &archive)
+        append(centralDirectoryOffset, to: &archive)
+        append(UInt16(0), to: &archive) // Comment length
+        
+        return archive
+    }
+    
+    // Inserts ZIP64 end of central directory record + locator with the given (possibly bogus) values before end of central directory record.
+    // recordOffset defaults to the actual offset of the ZIP64 record.
+    func makeZip64Archive(entries: [ZipTestEntry], recordOffset: UInt64?, directorySize: UInt64, directoryOffset: UInt64) -> Data
+    {
+        func append<T: FixedWidthInteger>(_ value: T, to data: inout Data)
+        {
+            withUnsafeBytes(of: value.littleEndian) { data.append(contentsOf: $0) }
+        }
+        
+        let archive = self.makeZipArchive(entries: entries)
+        
+        let endRecordOffset = archive.count - 22
+        var zip64Archive = archive.prefix(endRecordOffset)
+        
+        let zip64RecordOffset = UInt64(zip64Archive.count)
+        
+        // ZIP64 end of central directory record
+        append(UInt32(0x06064b50), to: &zip64Archive)
+        append(UInt64(44), to: &zip64Archive) // Remaining record size
+        append(UInt16(45), to: &zip64Archive) // Version made by
+        append(UInt16(45), to: &zip64Archive) // Version needed to extract
+        append(UInt32(0), to: &zip64Archive) // Disk number
+        append(UInt32(0), to: &zip64Archive) // Central directory disk number
+        append(UInt64(entries.count), to: &zip64Archive)
+        append(UInt64(entries.count), to: &zip64Archive)
+        append(directorySize, to: &zip64Archive)
+        append(directoryOffset, to: &zip64Archive)
+        
+        // ZIP64 end of central directory locator
+        append(UInt32(0x07064b50), to: &zip64Archive)
+        append(UInt32(0), to: &zip64Archive) // ZIP64 record disk number
+        append(recordOffset ?? zip64RecordOffset, to: &zip64Archive)
+        append(UInt32(1), to: &zip64Archive) // Total disks
+        
+        zip64Archive.append(archive.suffix(from: endRecordOffset))
+        return zip64Archive
+    }
+    
+    func zipCRC32(of data: Data) -> UInt32
+    {
+        var crc: UInt32 = 0xFFFFFFFF
+        
+        for byte in data
+        {
+            crc ^= UInt32(byte)
+            for _ in 0 ..< 8
+            {
+                crc = (crc & 1 == 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1)
+            }
+        }
+        
+        return crc ^ 0xFFFFFFFF
+    }
+}
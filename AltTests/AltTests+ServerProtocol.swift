@@ -0,0 +1,175 @@
+//
+//  AltTests+ServerProtocol.swift
+//  AltTests
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import XCTest
+
+@testable import AltStoreCore
+
+import AltSign
+
+extension AltTests
+{
+    func testBinaryEncodingRoundTrip() throws
+    {
+        let prepareAppRequest = PrepareAppRequest(udid: "00008030-001A2B3C4D5E6F70", contentSize: 123_456_789, fileURL: .testFileURL)
+        let beginInstallationRequest = BeginInstallationRequest(activeProfiles: ["com.rileytestut.AltStore", "com.rileytestut.Delta"], bundleIdentifier: nil)
+        let jitRequest = EnableUnsignedCodeExecutionRequest(udid: "00008030-001A2B3C4D5E6F70", processID: nil, processName: "Delta")
+        
+        guard case .prepareApp(let decodedPrepareAppRequest) = try ServerRequest(messageData: try ServerMessageEncoding.binary.encode(prepareAppRequest)) else { return XCTFail("Decoded wrong request type.") }
+        XCTAssertEqual(decodedPrepareAppRequest.udid, prepareAppRequest.udid)
+        XCTAssertEqual(decodedPrepareAppRequest.contentSize, prepareAppRequest.contentSize)
+        XCTAssertEqual(decodedPrepareAppRequest.fileURL, prepareAppRequest.fileURL)
+        
+        guard case .beginInstallation(let decodedBeginInstallationRequest) = try ServerRequest(messageData: try ServerMessageEncoding.binary.encode(beginInstallationRequest)) else { return XCTFail("Decoded wrong request type.") }
+        XCTAssertEqual(decodedBeginInstallationRequest.version, beginInstallationRequest.version)
+        XCTAssertEqual(decodedBeginInstallationRequest.activeProfiles, beginInstallationRequest.activeProfiles)
+        XCTAssertNil(decodedBeginInstallationRequest.bundleIdentifier)
+        
+        guard case .enableUnsignedCodeExecution(let decodedJITRequest) = try ServerRequest(messageData: try ServerMessageEncoding.binary.encode(jitRequest)) else { return XCTFail("Decoded wrong request type.") }
+        XCTAssertEqual(decodedJITRequest.udid, jitRequest.udid)
+        XCTAssertNil(decodedJITRequest.processID)
+        XCTAssertEqual(decodedJITRequest.processName, jitRequest.processName)
+        
+        let progressResponse = InstallationProgressResponse(progress: 0.42)
+        guard case .installationProgress(let decodedProgressResponse) = try ServerResponse(messageData: try ServerMessageEncoding.binary.encode(progressResponse)) else { return XCTFail("Decoded wrong response type.") }
+        XCTAssertEqual(decodedProgressResponse.progress, progressResponse.progress)
+    }
+    
+    func testBinaryEncodingErrorResponse() throws
+    {
+        for error in ALTServerError.testErrors
+        {
+            let response = ErrorResponse(error: error)
+            
+            guard case .error(let decodedResponse) = try ServerResponse(messageData: try ServerMessageEncoding.binary.encode(response)) else { return XCTFail("Decoded wrong response type.") }
+            XCTAssertEqual(decodedResponse.version, response.version)
+            XCTAssertEqual(decodedResponse.error.code, error.code)
+        }
+    }
+    
+    func testBinaryEncodingFallsBackToJSON() throws
+    {
+        // Messages without a binary schema must still be sent as JSON.
+        let upgradeRequest = UpgradeConnectionRequest()
+        let data = try ServerMessageEncoding.binary.encode(upgradeRequest)
+        XCTAssertEqual(data.first, UInt8(ascii: "{"))
+        
+        guard case .upgradeConnection(let decodedRequest) = try ServerRequest(messageData: data) else { return XCTFail("Decoded wrong request type.") }
+        XCTAssertEqual(decodedRequest.messageEncodings, upgradeRequest.messageEncodings)
+        
+        // JSON-encoded messages must still be decoded when binary encoding is supported.
+        let jsonData = try ServerMessageEncoding.json.encode(InstallationProgressResponse(progress: 1.0))
+        guard case .installationProgress(let decodedResponse) = try ServerResponse(messageData: jsonData) else { return XCTFail("Decoded wrong response type.") }
+        XCTAssertEqual(decodedResponse.progress, 1.0)
+    }
+    
+    func testBinaryDecodingTruncatedMessage() throws
+    {
+        let request = RemoveAppRequest(udid: "00008030-001A2B3C4D5E6F70", bundleIdentifier: "com.rileytestut.Delta")
+        let data = try ServerMessageEncoding.binary.encode(request)
+        
+        XCTAssertThrowsError(try ServerRequest(messageData: data.dropLast()))
+    }
+}
+
+// Benchmarks
+extension AltTests
+{
+    private static let benchmarkIterationCount = 10_000
+    
+    private var benchmarkRequests: [any Encodable] {
+        [
+            PrepareAppRequest(udid: "00008030-001A2B3C4D5E6F70", contentSize: 123_456_789, fileURL: nil),
+            BeginInstallationRequest(activeProfiles: ["com.rileytestut.AltStore", "com.rileytestut.Delta", "com.rileytestut.Clip"], bundleIdentifier: "com.rileytestut.Delta"),
+            RemoveProvisioningProfilesRequest(udid: "00008030-001A2B3C4D5E6F70", bundleIdentifiers: ["com.rileytestut.Delta.Extension"]),
+            RemoveAppRequest(udid: "00008030-001A2B3C4D5E6F70", bundleIdentifier: "com.rileytestut.Delta"),
+            EnableUnsignedCodeExecutionRequest(udid: "00008030-001A2B3C4D5E6F70", processID: 1234, processName: nil),
+        ]
+    }
+    
+    private var benchmarkResponses: [any Encodable] {
+        [
+            InstallationProgressResponse(progress: 0.5),
+            InstallProvisioningProfilesResponse(),
+            RemoveAppResponse(),
+            EnableUnsignedCodeExecutionResponse(),
+        ]
+    }
+    
+    func testJSONEncodingPerformance()
+    {
+        self.measureEncoding(using: .json)
+    }
+    
+    func testBinaryEncodingPerformance()
+    {
+        self.measureEncoding(using: .binary)
+    }
+    
+    func testJSONDecodingPerformance() throws
+    {
+        try self.measureDecoding(using: .json)
+    }
+    
+    func testBinaryDecodingPerformance() throws
+    {
+        try self.measureDecoding(using: .binary)
+    }
+    
+    // InstallationProgressResponse is sent many times per installation, so compare it separately.
+    func testInstallationProgressResponseSize() throws
+    {
+        let response = InstallationProgressResponse(progress: 0.123456789)
+        
+        let jsonData = try ServerMessageEncoding.json.encode(response)
+        let binaryData = try ServerMessageEncoding.binary.encode(response)
+        
+        XCTAssertLessThan(binaryData.count, jsonData.count, "Binary InstallationProgressResponse (\(binaryData.count) bytes) should be smaller than JSON (\(jsonData.count) bytes).")
+    }
+}
+
+private extension AltTests
+{
+    func measureEncoding(using encoding: ServerMessageEncoding)
+    {
+        let messages = self.benchmarkRequests + self.benchmarkResponses
+        
+        self.measure {
+            for _ in 0 ..< AltTests.benchmarkIterationCount / messages.count
+            {
+                for message in messages
+                {
+                    _ = try? encoding.encode(message)
+                }
+            }
+        }
+    }
+    
+    func measureDecoding(using encoding: ServerMessageEncoding) throws
+    {
+        let requests = try self.benchmarkRequests.map { try encoding.encode($0) }
+        let responses = try self.benchmarkResponses.map { try encoding.encode($0) }
+        
+        let iterationCount = AltTests.benchmarkIterationCount / (requests.count + responses.count)
+        
+        self.measure {
+            for _ in 0 ..< iterationCount
+            {
+                for data in requests
+                {
+                    _ = try? ServerRequest(messageData: data)
+                }
+                
+                for data in responses
+                {
+                    _ = try? ServerResponse(messageData: data)
+                }
+            }
+        }
+    }
+}
@@ -18,6 +18,15 @@ NS_SWIFT_NAME(Connection)
 
 - (void)disconnect;
 
+@optional
+
+// Sends each region back-to-back as a single message without first concatenating them.
+- (void)sendDataRegions:(NSArray<NSData *> *)regions completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler NS_SWIFT_NAME(__send(regions:completionHandler:));
+
+// Writes received bytes directly to fileDescriptor instead of buffering entire message in memory.
+// chunkHandler is passed each chunk after it's been written; chunks are only valid for the duration of the call.
+- (void)receiveDataWithExpectedSize:(NSInteger)expectedSize toFileDescriptor:(int)fileDescriptor chunkHandler:(nullable void (^)(NSData *chunk))chunkHandler completionHandler:(void (^)(BOOL, NSError * _Nullable))completionHandler NS_SWIFT_NAME(__receiveData(expectedSize:fileDescriptor:chunkHandler:completionHandler:));
+
 @end
 
 NS_ASSUME_NONNULL_END
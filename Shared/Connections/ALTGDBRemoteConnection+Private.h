@@ -0,0 +1,28 @@
+//
+//  ALTGDBRemoteConnection+Private.h
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import "ALTGDBRemoteConnection.h"
+
+#include "GDBRemoteClient.hpp"
+
+NS_ASSUME_NONNULL_BEGIN
+
+extern NSError *_Nullable ALTErrorForGDBRemoteError(gdbremote::Error error);
+
+@interface ALTGDBRemoteConnection ()
+
+// Negotiates no-ack mode before returning, so must not be called on the main thread.
+- (instancetype)initWithTransport:(std::unique_ptr<gdbremote::Transport>)transport;
+
+// Converts a failed (or unexpected) attach response into an NSError. Returns YES if process is now stopped under the debugger.
++ (BOOL)processAttachResponse:(const gdbremote::Response &)response error:(NSError **)error;
++ (BOOL)processDetachResponse:(const gdbremote::Response &)response error:(NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
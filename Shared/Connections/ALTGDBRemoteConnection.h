@@ -0,0 +1,37 @@
+//
+//  ALTGDBRemoteConnection.h
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Speaks the GDB remote protocol directly to debugserver, so attaching/detaching doesn't require launching lldb.
+// Requests are performed in order on a private serial queue.
+NS_SWIFT_NAME(GDBRemoteConnection)
+@interface ALTGDBRemoteConnection : NSObject
+
+// Connects over TCP, e.g. to debugserver exposed by an RSD tunnel.
++ (void)connectToHost:(NSString *)host port:(NSInteger)port completionHandler:(void (^)(ALTGDBRemoteConnection *_Nullable connection, NSError *_Nullable error))completionHandler;
+
+- (void)attachToProcessWithID:(NSInteger)pid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
+
+// If waitForLaunch is YES, debugserver waits for a process with name to launch rather than failing if it's not running.
+- (void)attachToProcessWithName:(NSString *)name waitForLaunch:(BOOL)waitForLaunch completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
+
+// Detaching resumes the process.
+- (void)detachWithCompletionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
+
+// Attaches then immediately detaches, pipelining both packets so it costs a single round trip.
+- (void)attachToAndDetachFromProcessWithID:(NSInteger)pid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
+- (void)attachToAndDetachFromProcessWithName:(NSString *)name waitForLaunch:(BOOL)waitForLaunch completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler;
+
+- (void)disconnect;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,280 @@
+//
+//  ALTGDBRemoteConnection.mm
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import "ALTGDBRemoteConnection+Private.h"
+
+#import "NSError+ALTServerError.h"
+
+static const unsigned int ALTGDBRemoteConnectTimeout = 10 * 1000;
+static const unsigned int ALTGDBRemoteAttachTimeout = 120 * 1000;
+static const unsigned int ALTGDBRemoteDetachTimeout = 10 * 1000;
+
+// debugserver's error number for "no such process".
+static const int ALTGDBRemoteProcessNotFoundErrorNumber = 0x96;
+
+NSError *ALTErrorForGDBRemoteError(gdbremote::Error error)
+{
+    switch (error)
+    {
+        case gdbremote::Error::None: return nil;
+        case gdbremote::Error::Disconnected: return [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorLostConnection userInfo:nil];
+        case gdbremote::Error::TimedOut: return [NSError errorWithDomain:AltServerConnectionErrorDomain code:ALTServerConnectionErrorTimedOut userInfo:nil];
+        case gdbremote::Error::InvalidPacket:
+        case gdbremote::Error::NotAcknowledged: return [NSError errorWithDomain:AltServerConnectionErrorDomain code:ALTServerConnectionErrorInvalidResponse userInfo:nil];
+    }
+}
+
+@interface ALTGDBRemoteConnection ()
+{
+    std::shared_ptr<gdbremote::Client> _client;
+}
+
+@end
+
+@implementation ALTGDBRemoteConnection
+
++ (void)connectToHost:(NSString *)host port:(NSInteger)port completionHandler:(void (^)(ALTGDBRemoteConnection *_Nullable connection, NSError *_Nullable error))completionHandler
+{
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        int errorCode = 0;
+        std::unique_ptr<gdbremote::SocketTransport> transport = gdbremote::SocketTransport::connect(host.UTF8String, (uint16_t)port, ALTGDBRemoteConnectTimeout, &errorCode);
+        if (transport == nullptr)
+        {
+            NSError *underlyingError = [NSError errorWithDomain:NSPOSIXErrorDomain code:errorCode userInfo:nil];
+            NSError *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorConnectionFailed userInfo:@{NSUnderlyingErrorKey: underlyingError}];
+            return completionHandler(nil, error);
+        }
+
+        ALTGDBRemoteConnection *connection = [[ALTGDBRemoteConnection alloc] initWithTransport:std::move(transport)];
+        completionHandler(connection, nil);
+    });
+}
+
+- (instancetype)initWithTransport:(std::unique_ptr<gdbremote::Transport>)transport
+{
+    self = [super init];
+    if (self)
+    {
+        _client = gdbremote::Client::make(std::move(transport));
+
+        // Without acks, each request is a single packet in each direction.
+        if (!_client->enableNoAckMode(ALTGDBRemoteConnectTimeout))
+        {
+            NSLog(@"debugserver does not support no-ack mode, falling back to acks.");
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self disconnect];
+}
+
+- (void)disconnect
+{
+    @synchronized(self)
+    {
+        // Closes transport once any in-flight requests finish.
+        _client = nullptr;
+    }
+}
+
+- (void)attachToProcessWithID:(NSInteger)pid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    std::shared_ptr<gdbremote::Client> client = [self clientWithCompletionHandler:completionHandler];
+    if (client == nullptr)
+    {
+        return;
+    }
+
+    client->perform([pid, completionHandler](gdbremote::Client &client) {
+        gdbremote::Response response = client.attach((int32_t)pid, ALTGDBRemoteAttachTimeout);
+
+        NSError *error = nil;
+        BOOL success = [ALTGDBRemoteConnection processAttachResponse:response error:&error];
+        completionHandler(success, error);
+    });
+}
+
+- (void)attachToProcessWithName:(NSString *)name waitForLaunch:(BOOL)waitForLaunch completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    std::shared_ptr<gdbremote::Client> client = [self clientWithCompletionHandler:completionHandler];
+    if (client == nullptr)
+    {
+        return;
+    }
+
+    std::string processName = name.UTF8String;
+    client->perform([processName, waitForLaunch, completionHandler](gdbremote::Client &client) {
+        gdbremote::Response response = client.attach(processName, waitForLaunch, ALTGDBRemoteAttachTimeout);
+
+        NSError *error = nil;
+        BOOL success = [ALTGDBRemoteConnection processAttachResponse:response error:&error];
+        completionHandler(success, error);
+    });
+}
+
+- (void)detachWithCompletionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    std::shared_ptr<gdbremote::Client> client = [self clientWithCompletionHandler:completionHandler];
+    if (client == nullptr)
+    {
+        return;
+    }
+
+    client->perform([completionHandler](gdbremote::Client &client) {
+        gdbremote::Response response = client.detach(ALTGDBRemoteDetachTimeout);
+
+        NSError *error = nil;
+        BOOL success = [ALTGDBRemoteConnection processDetachResponse:response error:&error];
+        completionHandler(success, error);
+    });
+}
+
+- (void)attachToAndDetachFromProcessWithID:(NSInteger)pid completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    [self attachToAndDetachWithAttachPacket:gdbremote::Client::attachPacket((int32_t)pid) completionHandler:completionHandler];
+}
+
+- (void)attachToAndDetachFromProcessWithName:(NSString *)name waitForLaunch:(BOOL)waitForLaunch completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    [self attachToAndDetachWithAttachPacket:gdbremote::Client::attachPacket(name.UTF8String, waitForLaunch) completionHandler:completionHandler];
+}
+
+#pragma mark - Responses -
+
++ (BOOL)processAttachResponse:(const gdbremote::Response &)response error:(NSError **)error
+{
+    if (!response.succeeded())
+    {
+        if (error)
+        {
+            *error = ALTErrorForGDBRemoteError(response.error);
+        }
+
+        return NO;
+    }
+
+    if (!response.output.empty())
+    {
+        NSLog(@"Response: %s", response.output.c_str());
+    }
+
+    if (std::optional<gdbremote::StopReply> stopReply = response.stopReply())
+    {
+        NSLog(@"Thread stopped. Details:\n%s", response.packet.c_str());
+
+        // If process exited or main thread == 0, app is not running.
+        if (stopReply->processExited() || (stopReply->threadID.has_value() && *stopReply->threadID == 0))
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorRequestedAppNotRunning userInfo:nil];
+            }
+
+            return NO;
+        }
+
+        return YES;
+    }
+
+    if (std::optional<int> errorNumber = response.errorNumber())
+    {
+        if (error)
+        {
+            if (*errorNumber == ALTGDBRemoteProcessNotFoundErrorNumber)
+            {
+                *error = [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorRequestedAppNotRunning userInfo:nil];
+            }
+            else
+            {
+                *error = [NSError errorWithDomain:AltServerConnectionErrorDomain code:ALTServerConnectionErrorUnknown userInfo:@{
+                    NSLocalizedFailureReasonErrorKey: @(response.packet.c_str())
+                }];
+            }
+        }
+
+        return NO;
+    }
+
+    NSLog(@"Unexpected attach response: %s", response.packet.c_str());
+    return YES;
+}
+
++ (BOOL)processDetachResponse:(const gdbremote::Response &)response error:(NSError **)error
+{
+    if (!response.succeeded())
+    {
+        if (error)
+        {
+            *error = ALTErrorForGDBRemoteError(response.error);
+        }
+
+        return NO;
+    }
+
+    if (response.errorNumber().has_value())
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:AltServerConnectionErrorDomain code:ALTServerConnectionErrorUnknown userInfo:@{
+                NSLocalizedFailureReasonErrorKey: @(response.packet.c_str())
+            }];
+        }
+
+        return NO;
+    }
+
+    return YES;
+}
+
+#pragma mark - Private -
+
+- (void)attachToAndDetachWithAttachPacket:(std::string)attachPacket completionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    std::shared_ptr<gdbremote::Client> client = [self clientWithCompletionHandler:completionHandler];
+    if (client == nullptr)
+    {
+        return;
+    }
+
+    client->perform([attachPacket, completionHandler](gdbremote::Client &client) {
+        // If attaching fails, debugserver just rejects the detach.
+        std::vector<gdbremote::Response> responses = client.pipeline({ attachPacket, gdbremote::Client::detachPacket() }, ALTGDBRemoteAttachTimeout + ALTGDBRemoteDetachTimeout);
+
+        NSError *error = nil;
+        if (![ALTGDBRemoteConnection processAttachResponse:responses[0] error:&error])
+        {
+            return completionHandler(NO, error);
+        }
+
+        BOOL success = [ALTGDBRemoteConnection processDetachResponse:responses[1] error:&error];
+        completionHandler(success, error);
+    });
+}
+
+- (std::shared_ptr<gdbremote::Client>)clientWithCompletionHandler:(void (^)(BOOL success, NSError *_Nullable error))completionHandler
+{
+    std::shared_ptr<gdbremote::Client> client = nullptr;
+
+    @synchronized(self)
+    {
+        client = _client;
+    }
+
+    if (client == nullptr)
+    {
+        completionHandler(NO, [NSError errorWithDomain:AltServerErrorDomain code:ALTServerErrorLostConnection userInfo:nil]);
+    }
+
+    return client;
+}
+
+@end
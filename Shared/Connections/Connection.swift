@@ -11,6 +11,12 @@ import Network
 
 public extension Connection
 {
+    // Only multiplexed connections negotiate an encoding, everything else uses JSON.
+    var messageEncoding: ServerMessageEncoding {
+        guard let stream = self as? MultiplexedConnection.Stream else { return .json }
+        return stream.multiplexedConnection.messageEncoding
+    }
+    
     func send(_ data: Data, completionHandler: @escaping (Result<Void, ALTServerError>) -> Void)
     {
         self.__send(data) { (success, error) in
@@ -23,6 +29,36 @@ public extension Connection
         }
     }
     
+    func send(_ regions: [Data], completionHandler: @escaping (Result<Void, ALTServerError>) -> Void)
+    {
+        guard let sendRegions = self.__send(regions:completionHandler:) else {
+            // Connection doesn't support sending multiple regions at once, so send them one at a time instead.
+            func sendRegion(at index: Int)
+            {
+                guard index < regions.count else { return completionHandler(.success(())) }
+                
+                self.send(regions[index]) { (result) in
+                    switch result
+                    {
+                    case .failure(let error): completionHandler(.failure(error))
+                    case .success: sendRegion(at: index + 1)
+                    }
+                }
+            }
+            
+            return sendRegion(at: 0)
+        }
+        
+        sendRegions(regions) { (success, error) in
+            let result = Result(success, error).mapError { (error) -> ALTServerError in
+                guard let nwError = error as? NWError else { return ALTServerError(error) }
+                return ALTServerError(.lostConnection, underlyingError: nwError)
+            }
+            
+            completionHandler(result)
+        }
+    }
+    
     func receiveData(expectedSize: Int, completionHandler: @escaping (Result<Data, ALTServerError>) -> Void)
     {
         self.__receiveData(expectedSize: expectedSize) { (data, error) in
@@ -35,6 +71,119 @@ public extension Connection
         }
     }
     
+    func receiveData(expectedSize: Int, to fileHandle: FileHandle, chunkHandler: ((Data) -> Void)? = nil, completionHandler: @escaping (Result<Void, ALTServerError>) -> Void)
+    {
+        guard let receiveData = self.__receiveData(expectedSize:fileDescriptor:chunkHandler:completionHandler:) else {
+            // Connection can't write to file descriptors directly, so receive and write bounded chunks ourselves instead.
+            let maximumChunkSize = 1024 * 1024
+            
+            func receiveChunk(remainingSize: Int)
+            {
+                guard remainingSize > 0 else { return completionHandler(.success(())) }
+                
+                self.receiveData(expectedSize: min(remainingSize, maximumChunkSize)) { (result) in
+                    do
+                    {
+                        let chunk = try result.get()
+                        try fileHandle.write(contentsOf: chunk)
+                        
+                        chunkHandler?(chunk)
+                        
+                        receiveChunk(remainingSize: remainingSize - chunk.count)
+                    }
+                    catch
+                    {
+                        completionHandler(.failure(ALTServerError(error)))
+                    }
+                }
+            }
+            
+            return receiveChunk(remainingSize: expectedSize)
+        }
+        
+        receiveData(expectedSize, fileHandle.fileDescriptor, chunkHandler) { (success, error) in
+            let result = Result(success, error).mapError { (error) -> ALTServerError in
+                guard let nwError = error as? NWError else { return ALTServerError(error) }
+                return ALTServerError(.lostConnection, underlyingError: nwError)
+            }
+            
+            completionHandler(result)
+        }
+    }
+    
+    // Sends size bytes from fileHandle in bounded chunks, so memory usage doesn't depend on file size.
+    // Only one chunk is sent at a time (preserving order for every Connection), while the next one is read ahead.
+    func send(contentsOf fileHandle: FileHandle, size: Int, progressHandler: ((Int) -> Void)? = nil, completionHandler: @escaping (Result<Void, ALTServerError>) -> Void)
+    {
+        let maximumChunkSize = 1024 * 1024
+        let readQueue = DispatchQueue(label: "com.rileytestut.AltKit.SendFile", qos: .userInitiated)
+        
+        func readChunk(size: Int) -> Result<Data, ALTServerError>
+        {
+            do
+            {
+                guard let chunk = try fileHandle.read(upToCount: size), !chunk.isEmpty else { throw CocoaError(.fileReadCorruptFile) }
+                return .success(chunk)
+            }
+            catch
+            {
+                return .failure(ALTServerError(error))
+            }
+        }
+        
+        func sendChunk(_ chunk: Data, remainingSize: Int)
+        {
+            let dispatchGroup = DispatchGroup()
+            
+            var sendResult: Result<Void, ALTServerError>?
+            var nextChunkResult: Result<Data, ALTServerError>?
+            
+            // Connection calls completionHandler once chunk has been handed off (e.g. NWConnection's .contentProcessed),
+            // so waiting for it before sending next chunk applies back-pressure rather than queueing up entire file.
+            dispatchGroup.enter()
+            self.send(chunk) { (result) in
+                sendResult = result
+                dispatchGroup.leave()
+            }
+            
+            if remainingSize > 0
+            {
+                dispatchGroup.enter()
+                readQueue.async {
+                    nextChunkResult = readChunk(size: min(remainingSize, maximumChunkSize))
+                    dispatchGroup.leave()
+                }
+            }
+            
+            dispatchGroup.notify(queue: readQueue) {
+                do
+                {
+                    try sendResult?.get()
+                    progressHandler?(chunk.count)
+                    
+                    guard let nextChunkResult = nextChunkResult else { return completionHandler(.success(())) }
+                    
+                    let nextChunk = try nextChunkResult.get()
+                    sendChunk(nextChunk, remainingSize: remainingSize - nextChunk.count)
+                }
+                catch
+                {
+                    completionHandler(.failure(ALTServerError(error)))
+                }
+            }
+        }
+        
+        readQueue.async {
+            guard size > 0 else { return completionHandler(.success(())) }
+            
+            switch readChunk(size: min(size, maximumChunkSize))
+            {
+            case .failure(let error): completionHandler(.failure(error))
+            case .success(let chunk): sendChunk(chunk, remainingSize: size - chunk.count)
+            }
+        }
+    }
+    
     func send<T: Encodable>(_ response: T, shouldDisconnect: Bool = false, completionHandler: @escaping (Result<Void, ALTServerError>) -> Void)
     {
         func finish(_ result: Result<Void, ALTServerError>)
@@ -43,6 +192,9 @@ public extension Connection
             
             if shouldDisconnect
             {
+                // Streams only send close frame after all pending data, so they can disconnect immediately.
+                guard !(self is MultiplexedConnection.Stream) else { return self.disconnect() }
+                
                 // Add short delay to prevent us from dropping connection too quickly.
                 DispatchQueue.global().asyncAfter(deadline: .now() + 1.0) {
                     self.disconnect()
@@ -52,21 +204,14 @@ public extension Connection
         
         do
         {
-            let data = try JSONEncoder().encode(response)
+            let data = try self.messageEncoding.encode(response)
             let responseSize = withUnsafeBytes(of: Int32(data.count)) { Data($0) }
             
-            self.send(responseSize) { (result) in
+            self.send([responseSize, data]) { (result) in
                 switch result
                 {
                 case .failure(let error): finish(.failure(error))
-                case .success:
-                    self.send(data) { (result) in
-                        switch result
-                        {
-                        case .failure(let error): finish(.failure(error))
-                        case .success: finish(.success(()))
-                        }
-                    }
+                case .success: finish(.success(()))
                 }
             }
         }
@@ -93,7 +238,7 @@ public extension Connection
                     do
                     {
                         let data = try result.get()
-                        let request = try JSONDecoder().decode(ServerRequest.self, from: data)
+                        let request = try ServerRequest(messageData: data)
                         
                         print("Received request:", request)
                         completionHandler(.success(request))
@@ -43,6 +43,9 @@ public class ConnectionManager<RequestHandlerType: RequestHandler>
     private var connections = [Connection]()
     private let connectionsLock = NSLock()
     
+    // Connections that have been upgraded to carry multiple requests, keyed by underlying connection.
+    private var multiplexedConnections = [ObjectIdentifier: MultiplexedConnection]()
+    
     public init(requestHandler: RequestHandlerType, connectionHandlers: [ConnectionHandler])
     {
         self.requestHandler = requestHandler
@@ -105,6 +108,45 @@ private extension ConnectionManager
         
         guard let index = self.connections.firstIndex(where: { $0 === connection }) else { return }
         self.connections.remove(at: index)
+        
+        if let multiplexedConnection = self.multiplexedConnections.removeValue(forKey: ObjectIdentifier(connection))
+        {
+            multiplexedConnection.disconnect()
+        }
+    }
+    
+    func upgrade(_ connection: Connection, request: UpgradeConnectionRequest)
+    {
+        let supportedEncodings = request.messageEncodings?.compactMap { ServerMessageEncoding(rawValue: $0) } ?? []
+        let messageEncoding = supportedEncodings.first ?? .json
+        
+        let response = UpgradeConnectionResponse(messageEncoding: messageEncoding)
+        
+        // Keep connection open, since it'll now carry every subsequent request.
+        connection.send(response, shouldDisconnect: false) { (result) in
+            switch result
+            {
+            case .failure(let error):
+                print("Failed to upgrade connection \(connection).", error)
+                connection.disconnect()
+            
+            case .success:
+                let multiplexedConnection = MultiplexedConnection(connection: connection, role: .server, messageEncoding: messageEncoding)
+                multiplexedConnection.streamHandler = { [weak self] (stream) in
+                    self?.handleRequest(for: stream)
+                }
+                multiplexedConnection.disconnectionHandler = { [weak self] (multiplexedConnection) in
+                    self?.disconnect(multiplexedConnection.connection)
+                }
+                
+                self.connectionsLock.lock()
+                self.multiplexedConnections[ObjectIdentifier(connection)] = multiplexedConnection
+                self.connectionsLock.unlock()
+                
+                print("Upgraded connection \(connection) to multiplexed connection (version \(request.protocolVersion), \(messageEncoding.rawValue) encoding).")
+                multiplexedConnection.start()
+            }
+        }
     }
     
     func handleRequest(for connection: Connection)
@@ -166,7 +208,12 @@ private extension ConnectionManager
                     finish(result)
                 }
                 
-            case .success(.unknown):
+            case .success(.upgradeConnection(let request)) where !(connection is MultiplexedConnection.Stream) && request.protocolVersion <= MultiplexedConnection.protocolVersion:
+                self.upgrade(connection, request: request)
+            
+            case .success(.upgradeConnection), .success(.unknown):
+                // Clients requesting a newer protocol version than we support get the same response as from servers that can't upgrade at all,
+                // so they fall back to one connection per request.
                 finish(Result<ErrorResponse, Error>.failure(ALTServerError(.unknownRequest)))
             }
         }
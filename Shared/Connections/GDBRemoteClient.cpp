@@ -0,0 +1,710 @@
+//
+//  GDBRemoteClient.cpp
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#include "GDBRemoteClient.hpp"
+
+#include <dispatch/dispatch.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace gdbremote
+{
+
+// Number of times to resend a packet debugserver didn't acknowledge.
+static const int MaximumRetransmitCount = 3;
+
+static unsigned int RemainingMilliseconds(std::chrono::steady_clock::time_point deadline)
+{
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    return (remaining > 0) ? (unsigned int)remaining : 0;
+}
+
+static uint8_t Checksum(const std::string &data)
+{
+    uint8_t checksum = 0;
+    for (unsigned char c : data)
+    {
+        checksum += c;
+    }
+
+    return checksum;
+}
+
+static std::string EscapePayload(const std::string &payload)
+{
+    std::string escapedPayload;
+    escapedPayload.reserve(payload.size());
+
+    for (char c : payload)
+    {
+        switch (c)
+        {
+            case '$':
+            case '#':
+            case '}':
+            case '*':
+                escapedPayload += '}';
+                escapedPayload += (char)(c ^ 0x20);
+                break;
+
+            default:
+                escapedPayload += c;
+                break;
+        }
+    }
+
+    return escapedPayload;
+}
+
+static std::string DecodePayload(const std::string &rawPayload)
+{
+    std::string payload;
+    payload.reserve(rawPayload.size());
+
+    for (size_t i = 0; i < rawPayload.size(); i++)
+    {
+        char c = rawPayload[i];
+
+        if (c == '}' && i + 1 < rawPayload.size())
+        {
+            // Escaped character.
+            payload += (char)(rawPayload[++i] ^ 0x20);
+        }
+        else if (c == '*' && i + 1 < rawPayload.size() && !payload.empty())
+        {
+            // Run-length encoding: repeat previous character (N - 29) more times.
+            int count = (unsigned char)rawPayload[++i] - 29;
+            if (count > 0)
+            {
+                payload.append((size_t)count, payload.back());
+            }
+        }
+        else
+        {
+            payload += c;
+        }
+    }
+
+    return payload;
+}
+
+#pragma mark - SocketTransport -
+
+std::unique_ptr<SocketTransport> SocketTransport::connect(const std::string &host, uint16_t port, unsigned int timeoutMilliseconds, int *errorCode)
+{
+    std::string hostname = host;
+    if (hostname.size() >= 2 && hostname.front() == '[' && hostname.back() == ']')
+    {
+        hostname = hostname.substr(1, hostname.size() - 2);
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+
+    struct addrinfo *addresses = nullptr;
+    if (getaddrinfo(hostname.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+    {
+        if (errorCode) *errorCode = EHOSTUNREACH;
+        return nullptr;
+    }
+
+    int lastError = ECONNREFUSED;
+
+    for (struct addrinfo *address = addresses; address != nullptr; address = address->ai_next)
+    {
+        int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0)
+        {
+            lastError = errno;
+            continue;
+        }
+
+        int enabled = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+
+        // Connect without blocking so we can enforce timeout.
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        int result = ::connect(fd, address->ai_addr, address->ai_addrlen);
+        if (result != 0 && errno == EINPROGRESS)
+        {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            result = poll(&pfd, 1, (int)timeoutMilliseconds);
+
+            if (result > 0)
+            {
+                int socketError = 0;
+                socklen_t length = sizeof(socketError);
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &socketError, &length);
+
+                errno = socketError;
+                result = (socketError == 0) ? 0 : -1;
+            }
+            else
+            {
+                errno = (result == 0) ? ETIMEDOUT : errno;
+                result = -1;
+            }
+        }
+
+        if (result != 0)
+        {
+            lastError = errno;
+            close(fd);
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, flags);
+        freeaddrinfo(addresses);
+
+        return std::make_unique<SocketTransport>(fd);
+    }
+
+    freeaddrinfo(addresses);
+
+    if (errorCode) *errorCode = lastError;
+    return nullptr;
+}
+
+SocketTransport::SocketTransport(int fileDescriptor) : _fileDescriptor(fileDescriptor)
+{
+}
+
+SocketTransport::~SocketTransport()
+{
+    if (_fileDescriptor >= 0)
+    {
+        close(_fileDescriptor);
+    }
+}
+
+bool SocketTransport::send(const char *data, size_t length)
+{
+    size_t totalSent = 0;
+    while (totalSent < length)
+    {
+        ssize_t sent = ::send(_fileDescriptor, data + totalSent, length - totalSent, 0);
+        if (sent < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        totalSent += (size_t)sent;
+    }
+
+    return true;
+}
+
+ssize_t SocketTransport::receive(char *buffer, size_t length, unsigned int timeoutMilliseconds)
+{
+    struct pollfd pfd = { _fileDescriptor, POLLIN, 0 };
+
+    int result = poll(&pfd, 1, (int)timeoutMilliseconds);
+    if (result == 0)
+    {
+        return 0;
+    }
+    else if (result < 0)
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    ssize_t received = recv(_fileDescriptor, buffer, length, 0);
+    if (received <= 0)
+    {
+        // 0 == connection closed.
+        return -1;
+    }
+
+    return received;
+}
+
+#pragma mark - Responses -
+
+std::optional<int> Response::errorNumber() const
+{
+    if (!this->succeeded() || this->packet.size() < 2 || this->packet[0] != 'E')
+    {
+        return std::nullopt;
+    }
+
+    // debugserver may append a textual description after a semicolon, e.g. "E96;...".
+    char *end = nullptr;
+    long value = strtol(this->packet.c_str() + 1, &end, 16);
+    if (end == this->packet.c_str() + 1)
+    {
+        return std::nullopt;
+    }
+
+    return (int)value;
+}
+
+std::optional<StopReply> Response::stopReply() const
+{
+    if (!this->succeeded())
+    {
+        return std::nullopt;
+    }
+
+    return StopReply::parse(this->packet);
+}
+
+std::optional<StopReply> StopReply::parse(const std::string &packet)
+{
+    if (packet.size() < 3)
+    {
+        return std::nullopt;
+    }
+
+    char type = packet[0];
+    if (type != 'T' && type != 'S' && type != 'W' && type != 'X')
+    {
+        return std::nullopt;
+    }
+
+    StopReply stopReply;
+    stopReply.type = type;
+    stopReply.value = (uint8_t)strtoul(packet.substr(1, 2).c_str(), nullptr, 16);
+
+    if (type != 'T')
+    {
+        return stopReply;
+    }
+
+    // T packets are followed by "key:value;" pairs.
+    size_t position = 3;
+    while (position < packet.size())
+    {
+        size_t separator = packet.find(':', position);
+        size_t terminator = packet.find(';', position);
+
+        if (separator == std::string::npos || (terminator != std::string::npos && separator > terminator))
+        {
+            break;
+        }
+
+        std::string key = packet.substr(position, separator - position);
+        std::string value = packet.substr(separator + 1, (terminator == std::string::npos) ? std::string::npos : terminator - separator - 1);
+
+        if (key == "thread")
+        {
+            stopReply.threadID = strtoull(value.c_str(), nullptr, 16);
+        }
+
+        stopReply.fields[key] = value;
+
+        if (terminator == std::string::npos)
+        {
+            break;
+        }
+
+        position = terminator + 1;
+    }
+
+    return stopReply;
+}
+
+#pragma mark - Client -
+
+std::shared_ptr<Client> Client::make(std::unique_ptr<Transport> transport)
+{
+    return std::make_shared<Client>(std::move(transport));
+}
+
+Client::Client(std::unique_ptr<Transport> transport) : _transport(std::move(transport)), _noAckModeEnabled(false)
+{
+    _queue = (void *)dispatch_queue_create("io.altstore.GDBRemoteClient", DISPATCH_QUEUE_SERIAL);
+}
+
+Client::~Client()
+{
+    dispatch_release((dispatch_queue_t)_queue);
+}
+
+Error Client::sendPacket(const std::string &payload, unsigned int timeoutMilliseconds)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+
+    std::string escapedPayload = EscapePayload(payload);
+
+    char checksum[3];
+    snprintf(checksum, sizeof(checksum), "%02x", Checksum(escapedPayload));
+
+    std::string packet;
+    packet.reserve(escapedPayload.size() + 4);
+    packet += '$';
+    packet += escapedPayload;
+    packet += '#';
+    packet += checksum;
+
+    for (int attempt = 0; attempt <= MaximumRetransmitCount; attempt++)
+    {
+        if (!_transport->send(packet.data(), packet.size()))
+        {
+            return Error::Disconnected;
+        }
+
+        if (_noAckModeEnabled)
+        {
+            return Error::None;
+        }
+
+        Error error = this->waitForAck(deadline);
+        if (error != Error::NotAcknowledged)
+        {
+            return error;
+        }
+    }
+
+    return Error::NotAcknowledged;
+}
+
+Response Client::receiveResponse(unsigned int timeoutMilliseconds)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+
+    Response response;
+
+    while (true)
+    {
+        std::string payload;
+        response.error = this->readPacket(payload, deadline);
+
+        if (response.error != Error::None)
+        {
+            return response;
+        }
+
+        if (payload.size() > 1 && payload[0] == 'O' && payload != "OK")
+        {
+            // Console output from inferior, not the actual response.
+            response.output += decodeHex(payload.substr(1));
+            continue;
+        }
+
+        response.packet = std::move(payload);
+        return response;
+    }
+}
+
+Response Client::request(const std::string &payload, unsigned int timeoutMilliseconds)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+
+    Error error = this->sendPacket(payload, timeoutMilliseconds);
+    if (error != Error::None)
+    {
+        Response response;
+        response.error = error;
+        return response;
+    }
+
+    return this->receiveResponse(RemainingMilliseconds(deadline));
+}
+
+std::vector<Response> Client::pipeline(const std::vector<std::string> &payloads, unsigned int timeoutMilliseconds)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+
+    std::vector<Response> responses;
+    responses.reserve(payloads.size());
+
+    Error error = Error::None;
+
+    size_t sentCount = 0;
+    for (const std::string &payload : payloads)
+    {
+        error = this->sendPacket(payload, RemainingMilliseconds(deadline));
+        if (error != Error::None)
+        {
+            break;
+        }
+
+        sentCount++;
+    }
+
+    for (size_t i = 0; i < payloads.size(); i++)
+    {
+        if (i >= sentCount || error != Error::None)
+        {
+            // Don't wait for responses to packets after one fails.
+            Response response;
+            response.error = (error != Error::None) ? error : Error::Disconnected;
+            responses.push_back(std::move(response));
+            continue;
+        }
+
+        Response response = this->receiveResponse(RemainingMilliseconds(deadline));
+        error = response.error;
+
+        responses.push_back(std::move(response));
+    }
+
+    return responses;
+}
+
+bool Client::enableNoAckMode(unsigned int timeoutMilliseconds)
+{
+    if (_noAckModeEnabled)
+    {
+        return true;
+    }
+
+    Response response = this->request("QStartNoAckMode", timeoutMilliseconds);
+    if (!response.isOK())
+    {
+        return false;
+    }
+
+    // debugserver stops acking after it acks this response.
+    _noAckModeEnabled = true;
+    return true;
+}
+
+Response Client::attach(int32_t pid, unsigned int timeoutMilliseconds)
+{
+    return this->request(attachPacket(pid), timeoutMilliseconds);
+}
+
+Response Client::attach(const std::string &processName, bool waitForLaunch, unsigned int timeoutMilliseconds)
+{
+    return this->request(attachPacket(processName, waitForLaunch), timeoutMilliseconds);
+}
+
+Response Client::detach(unsigned int timeoutMilliseconds)
+{
+    return this->request(detachPacket(), timeoutMilliseconds);
+}
+
+void Client::perform(std::function<void(Client &client)> block)
+{
+    struct Context
+    {
+        std::shared_ptr<Client> client;
+        std::function<void(Client &client)> block;
+    };
+
+    // Keep client alive until block has run.
+    auto context = new Context{ this->shared_from_this(), std::move(block) };
+
+    dispatch_async_f((dispatch_queue_t)_queue, context, [](void *rawContext) {
+        auto context = static_cast<Context *>(rawContext);
+        context->block(*context->client);
+        delete context;
+    });
+}
+
+void Client::request(const std::string &payload, unsigned int timeoutMilliseconds, std::function<void(Response response)> completionHandler)
+{
+    this->perform([payload, timeoutMilliseconds, completionHandler = std::move(completionHandler)](Client &client) {
+        Response response = client.request(payload, timeoutMilliseconds);
+        completionHandler(std::move(response));
+    });
+}
+
+std::string Client::attachPacket(int32_t pid)
+{
+    // PID is sent as big-endian hex.
+    char encodedPID[16];
+    snprintf(encodedPID, sizeof(encodedPID), "%08x", (uint32_t)pid);
+
+    return std::string("vAttach;") + encodedPID;
+}
+
+std::string Client::attachPacket(const std::string &processName, bool waitForLaunch)
+{
+    std::string packet = waitForLaunch ? "vAttachOrWait;" : "vAttachName;";
+    packet += encodeHex(processName.data(), processName.size());
+
+    return packet;
+}
+
+std::string Client::detachPacket()
+{
+    return "D";
+}
+
+std::string Client::encodeHex(const void *bytes, size_t length)
+{
+    static const char *digits = "0123456789abcdef";
+
+    std::string hex;
+    hex.reserve(length * 2);
+
+    const unsigned char *data = static_cast<const unsigned char *>(bytes);
+    for (size_t i = 0; i < length; i++)
+    {
+        hex += digits[data[i] >> 4];
+        hex += digits[data[i] & 0x0F];
+    }
+
+    return hex;
+}
+
+std::string Client::decodeHex(const std::string &hex)
+{
+    std::string data;
+    data.reserve(hex.size() / 2);
+
+    for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    {
+        char byte[3] = { hex[i], hex[i + 1], '\0' };
+        data += (char)strtoul(byte, nullptr, 16);
+    }
+
+    return data;
+}
+
+#pragma mark - Private -
+
+Error Client::fillBuffer(Deadline deadline)
+{
+    char buffer[4096];
+
+    while (true)
+    {
+        unsigned int timeout = RemainingMilliseconds(deadline);
+        if (timeout == 0)
+        {
+            return Error::TimedOut;
+        }
+
+        ssize_t received = _transport->receive(buffer, sizeof(buffer), timeout);
+        if (received < 0)
+        {
+            return Error::Disconnected;
+        }
+        else if (received > 0)
+        {
+            _buffer.append(buffer, (size_t)received);
+            return Error::None;
+        }
+    }
+}
+
+Error Client::waitForAck(Deadline deadline)
+{
+    while (true)
+    {
+        while (!_buffer.empty())
+        {
+            char c = _buffer[0];
+
+            if (c == '+')
+            {
+                _buffer.erase(0, 1);
+                return Error::None;
+            }
+            else if (c == '-')
+            {
+                _buffer.erase(0, 1);
+                return Error::NotAcknowledged;
+            }
+            else if (c == '$' || c == '%')
+            {
+                // Packet arrived without an ack. Leave it for readPacket() and treat as acknowledged.
+                return Error::None;
+            }
+
+            // Ignore noise.
+            _buffer.erase(0, 1);
+        }
+
+        Error error = this->fillBuffer(deadline);
+        if (error != Error::None)
+        {
+            return error;
+        }
+    }
+}
+
+Error Client::readPacket(std::string &payload, Deadline deadline)
+{
+    while (true)
+    {
+        size_t start = _buffer.find_first_of("$%");
+        if (start == std::string::npos)
+        {
+            // Only acks or noise, so discard.
+            _buffer.clear();
+        }
+        else
+        {
+            if (start > 0)
+            {
+                _buffer.erase(0, start);
+            }
+
+            size_t end = _buffer.find('#', 1);
+            if (end != std::string::npos && end + 2 < _buffer.size())
+            {
+                bool isNotification = (_buffer[0] == '%');
+
+                std::string rawPayload = _buffer.substr(1, end - 1);
+                uint8_t expectedChecksum = (uint8_t)strtoul(_buffer.substr(end + 1, 2).c_str(), nullptr, 16);
+                _buffer.erase(0, end + 3);
+
+                bool isValid = (Checksum(rawPayload) == expectedChecksum);
+
+                if (!_noAckModeEnabled && !isNotification)
+                {
+                    // Ask debugserver to retransmit invalid packets.
+                    const char *ack = isValid ? "+" : "-";
+                    if (!_transport->send(ack, 1))
+                    {
+                        return Error::Disconnected;
+                    }
+                }
+
+                if (!isValid)
+                {
+                    if (_noAckModeEnabled)
+                    {
+                        return Error::InvalidPacket;
+                    }
+
+                    continue;
+                }
+
+                if (isNotification)
+                {
+                    // Asynchronous notifications aren't responses, so ignore them.
+                    continue;
+                }
+
+                payload = DecodePayload(rawPayload);
+                return Error::None;
+            }
+        }
+
+        Error error = this->fillBuffer(deadline);
+        if (error != Error::None)
+        {
+            return error;
+        }
+    }
+}
+
+}
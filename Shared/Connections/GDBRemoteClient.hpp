@@ -0,0 +1,173 @@
+//
+//  GDBRemoteClient.hpp
+//  AltServer
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#ifndef GDBRemoteClient_hpp
+#define GDBRemoteClient_hpp
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Minimal client for the GDB remote serial protocol, which is all debugserver needs to attach to and detach from a process.
+// https://sourceware.org/gdb/current/onlinedocs/gdb.html/Remote-Protocol.html
+namespace gdbremote
+{
+
+enum class Error
+{
+    None,
+    Disconnected,
+    TimedOut,
+    InvalidPacket,
+    NotAcknowledged,
+};
+
+// Reliable byte stream to debugserver.
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    // Sends all bytes. Returns false if connection failed.
+    virtual bool send(const char *data, size_t length) = 0;
+
+    // Receives up to length bytes. Returns number of bytes received, 0 if timed out, or -1 if connection failed.
+    virtual ssize_t receive(char *buffer, size_t length, unsigned int timeoutMilliseconds) = 0;
+};
+
+// Plain TCP connection, e.g. to a debugserver exposed over an RSD tunnel.
+class SocketTransport : public Transport
+{
+public:
+    // host may be an IPv6 address wrapped in [brackets]. Returns nullptr on failure, with errorCode set to the errno.
+    static std::unique_ptr<SocketTransport> connect(const std::string &host, uint16_t port, unsigned int timeoutMilliseconds, int *errorCode = nullptr);
+
+    explicit SocketTransport(int fileDescriptor);
+    ~SocketTransport() override;
+
+    SocketTransport(const SocketTransport &) = delete;
+    SocketTransport &operator=(const SocketTransport &) = delete;
+
+    bool send(const char *data, size_t length) override;
+    ssize_t receive(char *buffer, size_t length, unsigned int timeoutMilliseconds) override;
+
+private:
+    int _fileDescriptor;
+};
+
+struct StopReply
+{
+    // 'T' or 'S' = stopped with signal, 'W' = exited with status, 'X' = terminated by signal.
+    char type = 0;
+    uint8_t value = 0;
+
+    std::optional<uint64_t> threadID;
+    std::map<std::string, std::string> fields;
+
+    bool processExited() const { return this->type == 'W' || this->type == 'X'; }
+
+    static std::optional<StopReply> parse(const std::string &packet);
+};
+
+struct Response
+{
+    Error error = Error::None;
+
+    // Decoded payload, without framing.
+    std::string packet;
+
+    // Console output ('O' packets) received before the response.
+    std::string output;
+
+    bool succeeded() const { return this->error == Error::None; }
+    bool isOK() const { return this->succeeded() && this->packet == "OK"; }
+
+    // Error number if packet is an "Exx" error reply.
+    std::optional<int> errorNumber() const;
+
+    std::optional<StopReply> stopReply() const;
+};
+
+// Not thread-safe. Either use the synchronous API from one thread at a time, or only use the asynchronous API.
+class Client : public std::enable_shared_from_this<Client>
+{
+public:
+    static std::shared_ptr<Client> make(std::unique_ptr<Transport> transport);
+
+    explicit Client(std::unique_ptr<Transport> transport);
+    ~Client();
+
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    bool isNoAckModeEnabled() const { return _noAckModeEnabled; }
+
+    /* Synchronous */
+
+    Error sendPacket(const std::string &payload, unsigned int timeoutMilliseconds);
+    Response receiveResponse(unsigned int timeoutMilliseconds);
+
+    Response request(const std::string &payload, unsigned int timeoutMilliseconds);
+
+    // Sends all packets before reading any responses, saving a round trip per packet. Returns one response per packet, in order.
+    // Only use for packets that don't depend on each other's results, or where debugserver rejecting a later packet is harmless.
+    std::vector<Response> pipeline(const std::vector<std::string> &payloads, unsigned int timeoutMilliseconds);
+
+    // Asks debugserver to stop sending (and expecting) acks. Returns false if unsupported, in which case acks continue to be used.
+    bool enableNoAckMode(unsigned int timeoutMilliseconds);
+
+    Response attach(int32_t pid, unsigned int timeoutMilliseconds);
+    Response attach(const std::string &processName, bool waitForLaunch, unsigned int timeoutMilliseconds);
+    Response detach(unsigned int timeoutMilliseconds);
+
+    /* Asynchronous */
+
+    // Runs block on the client's serial queue. Blocks run in the order they are submitted.
+    void perform(std::function<void(Client &client)> block);
+
+    void request(const std::string &payload, unsigned int timeoutMilliseconds, std::function<void(Response response)> completionHandler);
+
+    /* Packets */
+
+    static std::string attachPacket(int32_t pid);
+    static std::string attachPacket(const std::string &processName, bool waitForLaunch);
+    static std::string detachPacket();
+
+    /* Utilities */
+
+    static std::string encodeHex(const void *bytes, size_t length);
+    static std::string decodeHex(const std::string &hex);
+
+private:
+    using Deadline = std::chrono::steady_clock::time_point;
+
+    std::unique_ptr<Transport> _transport;
+
+    // dispatch_queue_t, but type-erased so this header can be included from ARC code.
+    void *_queue;
+
+    // Bytes received but not yet parsed.
+    std::string _buffer;
+
+    bool _noAckModeEnabled;
+
+    Error fillBuffer(Deadline deadline);
+    Error waitForAck(Deadline deadline);
+    Error readPacket(std::string &payload, Deadline deadline);
+};
+
+}
+
+#endif /* GDBRemoteClient_hpp */
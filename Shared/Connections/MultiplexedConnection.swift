@@ -0,0 +1,671 @@
+//
+//  MultiplexedConnection.swift
+//  AltKit
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import Foundation
+
+public extension MultiplexedConnection
+{
+    enum Role
+    {
+        // Opens odd-numbered streams.
+        case client
+        
+        // Opens even-numbered streams.
+        case server
+    }
+    
+    static let protocolVersion = 1
+}
+
+extension MultiplexedConnection
+{
+    enum FrameType: UInt8
+    {
+        case data = 1
+        case close = 2
+        case windowUpdate = 3
+        case ping = 4
+        
+        // Refuses stream opened by peer, discarding any data already sent on it.
+        case reset = 5
+    }
+    
+    // UInt32 stream ID, UInt8 frame type, and UInt32 payload length, all little-endian.
+    static let headerLength = 9
+    static let maximumFrameSize = 64 * 1024
+    
+    // Number of bytes either side may send on a stream before receiving a window update.
+    static let initialWindowSize = 4 * 1024 * 1024
+    
+    // Maximum number of bytes to coalesce into a single write to the underlying connection.
+    static let maximumWriteSize = 1024 * 1024
+    
+    // ALTWiredConnection times out after 10 seconds without receiving data, so ping idle connections well before then.
+    static let keepAliveInterval: TimeInterval = 3.0
+}
+
+fileprivate extension MultiplexedConnection
+{
+    struct Frame
+    {
+        var streamID: UInt32
+        var type: FrameType
+        var payload = Data()
+        
+        var completionHandler: ((Error?) -> Void)?
+        
+        var header: Data {
+            var header = Data(capacity: MultiplexedConnection.headerLength)
+            withUnsafeBytes(of: self.streamID.littleEndian) { header.append(contentsOf: $0) }
+            header.append(self.type.rawValue)
+            withUnsafeBytes(of: UInt32(self.payload.count).littleEndian) { header.append(contentsOf: $0) }
+            return header
+        }
+    }
+    
+    struct PendingSend
+    {
+        var data: Data
+        var completionHandler: (Bool, Error?) -> Void
+    }
+    
+    struct PendingReceive
+    {
+        var expectedSize: Int
+        var completionHandler: (Data?, Error?) -> Void
+    }
+}
+
+public extension MultiplexedConnection
+{
+    // Independent, ordered byte stream within a MultiplexedConnection. Behaves like any other Connection, so existing request handling works unchanged.
+    class Stream: NSObject, Connection
+    {
+        public let streamID: UInt32
+        public let multiplexedConnection: MultiplexedConnection
+        
+        // Only accessed on multiplexedConnection's queue.
+        fileprivate var receivedChunks = [Data]()
+        fileprivate var receivedByteCount = 0
+        fileprivate var pendingReceives = [PendingReceive]()
+        
+        // Number of bytes peer may still send before we grant it more.
+        fileprivate var receiveCredit = MultiplexedConnection.initialWindowSize
+        
+        // Number of bytes we may still send before peer grants us more.
+        fileprivate var sendCredit = MultiplexedConnection.initialWindowSize
+        fileprivate var pendingSends = [PendingSend]()
+        
+        fileprivate var isLocallyClosed = false
+        fileprivate var isRemotelyClosed = false
+        
+        fileprivate init(streamID: UInt32, multiplexedConnection: MultiplexedConnection)
+        {
+            self.streamID = streamID
+            self.multiplexedConnection = multiplexedConnection
+        }
+        
+        public func __send(_ data: Data, completionHandler: @escaping (Bool, Error?) -> Void)
+        {
+            self.multiplexedConnection.queue.async {
+                self.multiplexedConnection.send(data, on: self, completionHandler: completionHandler)
+            }
+        }
+        
+        public func __receiveData(expectedSize: Int, completionHandler: @escaping (Data?, Error?) -> Void)
+        {
+            self.multiplexedConnection.queue.async {
+                self.multiplexedConnection.receiveData(expectedSize: expectedSize, on: self, completionHandler: completionHandler)
+            }
+        }
+        
+        // Closes stream once all pending data has been sent. Doesn't affect other streams.
+        public func disconnect()
+        {
+            self.multiplexedConnection.queue.async {
+                self.multiplexedConnection.close(self)
+            }
+        }
+        
+        override public var description: String {
+            return "\(self.multiplexedConnection.connection) (Stream \(self.streamID))"
+        }
+    }
+}
+
+// Carries many concurrent streams over a single underlying connection, so clients don't need to reconnect for every request.
+// Each stream has its own flow control window, so a large transfer on one stream can't starve the others of buffer space.
+public class MultiplexedConnection: NSObject
+{
+    public let connection: Connection
+    public let role: Role
+    
+    // If non-nil, disconnects once there have been no open streams for this long.
+    public let idleTimeout: TimeInterval?
+    
+    // Encoding negotiated for ServerRequests and ServerResponses sent over this connection's streams.
+    public let messageEncoding: ServerMessageEncoding
+    
+    // Called whenever peer opens a new stream.
+    public var streamHandler: ((Stream) -> Void)?
+    public var disconnectionHandler: ((MultiplexedConnection) -> Void)?
+    
+    public var isDisconnected: Bool {
+        return self.queue.sync { self.isClosed }
+    }
+    
+    fileprivate let queue = DispatchQueue(label: "com.rileytestut.AltKit.MultiplexedConnection")
+    
+    private var isStarted = false
+    private var isClosed = false
+    
+    private var streams = [UInt32: Stream]() {
+        didSet {
+            self.updateIdleTimer()
+        }
+    }
+    private var nextStreamID: UInt32
+    private var highestRemoteStreamID: UInt32 = 0
+    
+    private var outgoingFrames = [Frame]()
+    private var isWriting = false
+    
+    private var keepAliveTimer: DispatchSourceTimer?
+    private var didWriteSinceKeepAlive = false
+    
+    private var idleWorkItem: DispatchWorkItem?
+    
+    public init(connection: Connection, role: Role, messageEncoding: ServerMessageEncoding = .json, idleTimeout: TimeInterval? = nil)
+    {
+        self.connection = connection
+        self.role = role
+        self.messageEncoding = messageEncoding
+        self.idleTimeout = idleTimeout
+        self.nextStreamID = (role == .client) ? 1 : 2
+        
+        super.init()
+    }
+    
+    public func start()
+    {
+        self.queue.async {
+            guard !self.isStarted else { return }
+            self.isStarted = true
+            
+            self.receiveFrame()
+            self.startKeepAliveTimer()
+            self.updateIdleTimer()
+        }
+    }
+    
+    public func openStream() throws -> Stream
+    {
+        return try self.queue.sync {
+            guard !self.isClosed else { throw ALTServerError(.lostConnection) }
+            
+            let stream = Stream(streamID: self.nextStreamID, multiplexedConnection: self)
+            self.nextStreamID += 2
+            
+            self.streams[stream.streamID] = stream
+            return stream
+        }
+    }
+    
+    public func disconnect()
+    {
+        self.queue.async {
+            self.finish(error: nil)
+        }
+    }
+}
+
+extension MultiplexedConnection
+{
+    override public var description: String {
+        return "\(self.connection) (Multiplexed)"
+    }
+}
+
+private extension MultiplexedConnection
+{
+    func isRemoteStreamID(_ streamID: UInt32) -> Bool
+    {
+        // Clients open odd-numbered streams, servers open even-numbered ones.
+        let isOdd = (streamID % 2 == 1)
+        return (self.role == .client) ? !isOdd : isOdd
+    }
+    
+    func finish(error: Error?)
+    {
+        guard !self.isClosed else { return }
+        self.isClosed = true
+        
+        if let error = error
+        {
+            print("Multiplexed connection \(self) failed:", error)
+        }
+        
+        self.keepAliveTimer?.cancel()
+        self.keepAliveTimer = nil
+        
+        self.idleWorkItem?.cancel()
+        self.idleWorkItem = nil
+        
+        let streams = self.streams.values
+        self.streams.removeAll()
+        
+        for stream in streams
+        {
+            stream.isLocallyClosed = true
+            stream.isRemotelyClosed = true
+            
+            self.failPendingSends(for: stream)
+            self.fulfillPendingReceives(for: stream)
+        }
+        
+        let frames = self.outgoingFrames
+        self.outgoingFrames.removeAll()
+        
+        for frame in frames
+        {
+            frame.completionHandler?(ALTServerError(.lostConnection))
+        }
+        
+        self.connection.disconnect()
+        
+        let disconnectionHandler = self.disconnectionHandler
+        self.disconnectionHandler = nil
+        self.streamHandler = nil
+        
+        if let disconnectionHandler
+        {
+            // Never call out while on our serial queue, since handler may take locks held by threads waiting on queue (e.g. in openStream()).
+            DispatchQueue.global().async {
+                disconnectionHandler(self)
+            }
+        }
+    }
+    
+    func updateIdleTimer()
+    {
+        self.idleWorkItem?.cancel()
+        self.idleWorkItem = nil
+        
+        guard let idleTimeout = self.idleTimeout, self.isStarted, !self.isClosed, self.streams.isEmpty else { return }
+        
+        let workItem = DispatchWorkItem { [weak self] in
+            guard let self = self, self.streams.isEmpty else { return }
+            self.finish(error: nil)
+        }
+        self.queue.asyncAfter(deadline: .now() + idleTimeout, execute: workItem)
+        
+        self.idleWorkItem = workItem
+    }
+}
+
+private extension MultiplexedConnection
+{
+    func send(_ data: Data, on stream: Stream, completionHandler: @escaping (Bool, Error?) -> Void)
+    {
+        guard !stream.isLocallyClosed && !stream.isRemotelyClosed else { return completionHandler(false, ALTServerError(.lostConnection)) }
+        guard !data.isEmpty else { return completionHandler(true, nil) }
+        
+        stream.pendingSends.append(PendingSend(data: data, completionHandler: completionHandler))
+        self.flushPendingSends(for: stream)
+    }
+    
+    func flushPendingSends(for stream: Stream)
+    {
+        while stream.sendCredit > 0, var pendingSend = stream.pendingSends.first
+        {
+            let size = min(pendingSend.data.count, stream.sendCredit, MultiplexedConnection.maximumFrameSize)
+            
+            var frame = Frame(streamID: stream.streamID, type: .data, payload: pendingSend.data.prefix(size))
+            pendingSend.data = pendingSend.data.dropFirst(size)
+            stream.sendCredit -= size
+            
+            if pendingSend.data.isEmpty
+            {
+                stream.pendingSends.removeFirst()
+                
+                frame.completionHandler = { (error) in
+                    pendingSend.completionHandler(error == nil, error)
+                }
+            }
+            else
+            {
+                stream.pendingSends[0] = pendingSend
+            }
+            
+            self.enqueue(frame)
+        }
+        
+        // Only send close frame once peer has received everything else.
+        guard stream.isLocallyClosed, stream.pendingSends.isEmpty, self.streams[stream.streamID] === stream else { return }
+        self.streams[stream.streamID] = nil
+        
+        if !stream.isRemotelyClosed
+        {
+            self.enqueue(Frame(streamID: stream.streamID, type: .close))
+        }
+    }
+    
+    func failPendingSends(for stream: Stream)
+    {
+        let pendingSends = stream.pendingSends
+        stream.pendingSends.removeAll()
+        
+        for pendingSend in pendingSends
+        {
+            pendingSend.completionHandler(false, ALTServerError(.lostConnection))
+        }
+    }
+    
+    func receiveData(expectedSize: Int, on stream: Stream, completionHandler: @escaping (Data?, Error?) -> Void)
+    {
+        stream.pendingReceives.append(PendingReceive(expectedSize: expectedSize, completionHandler: completionHandler))
+        self.fulfillPendingReceives(for: stream)
+    }
+    
+    func fulfillPendingReceives(for stream: Stream)
+    {
+        while let pendingReceive = stream.pendingReceives.first, pendingReceive.expectedSize <= stream.receivedByteCount
+        {
+            stream.pendingReceives.removeFirst()
+            
+            let data = self.dequeueReceivedData(count: pendingReceive.expectedSize, from: stream)
+            pendingReceive.completionHandler(data, nil)
+        }
+        
+        if stream.isLocallyClosed || stream.isRemotelyClosed
+        {
+            // No more data will arrive, so remaining receives can never be fulfilled.
+            let pendingReceives = stream.pendingReceives
+            stream.pendingReceives.removeAll()
+            
+            for pendingReceive in pendingReceives
+            {
+                pendingReceive.completionHandler(nil, ALTServerError(.lostConnection))
+            }
+        }
+        else
+        {
+            self.updateReceiveWindow(for: stream)
+        }
+    }
+    
+    func dequeueReceivedData(count: Int, from stream: Stream) -> Data
+    {
+        stream.receivedByteCount -= count
+        
+        if let chunk = stream.receivedChunks.first, chunk.count == count
+        {
+            // Common case: receiving exactly one frame's worth of data, so avoid copying.
+            stream.receivedChunks.removeFirst()
+            return chunk
+        }
+        
+        var data = Data(capacity: count)
+        while data.count < count
+        {
+            let chunk = stream.receivedChunks.removeFirst()
+            let remainingCount = count - data.count
+            
+            if chunk.count > remainingCount
+            {
+                data.append(chunk.prefix(remainingCount))
+                stream.receivedChunks.insert(chunk.dropFirst(remainingCount), at: 0)
+            }
+            else
+            {
+                data.append(chunk)
+            }
+        }
+        
+        return data
+    }
+    
+    func updateReceiveWindow(for stream: Stream)
+    {
+        // Let peer send enough to refill window, or to fulfill next receive if that's larger.
+        let requiredSize = stream.pendingReceives.first?.expectedSize ?? 0
+        let targetCredit = max(MultiplexedConnection.initialWindowSize, requiredSize) - stream.receivedByteCount
+        
+        let increment = min(targetCredit - stream.receiveCredit, Int(UInt32.max))
+        guard increment > 0 else { return }
+        
+        // Batch window updates, unless peer would otherwise stall before fulfilling the next receive.
+        let isPeerBlocked = stream.receivedByteCount + stream.receiveCredit < requiredSize
+        guard increment >= MultiplexedConnection.initialWindowSize / 2 || isPeerBlocked else { return }
+        
+        stream.receiveCredit += increment
+        
+        let payload = withUnsafeBytes(of: UInt32(increment).littleEndian) { Data($0) }
+        self.enqueue(Frame(streamID: stream.streamID, type: .windowUpdate, payload: payload))
+    }
+    
+    func close(_ stream: Stream)
+    {
+        guard !stream.isLocallyClosed else { return }
+        stream.isLocallyClosed = true
+        
+        self.fulfillPendingReceives(for: stream)
+        self.flushPendingSends(for: stream)
+    }
+}
+
+private extension MultiplexedConnection
+{
+    func enqueue(_ frame: Frame)
+    {
+        guard !self.isClosed else {
+            frame.completionHandler?(ALTServerError(.lostConnection))
+            return
+        }
+        
+        self.outgoingFrames.append(frame)
+        self.writeFrames()
+    }
+    
+    func writeFrames()
+    {
+        guard !self.isWriting, !self.isClosed, !self.outgoingFrames.isEmpty else { return }
+        
+        // Coalesce queued frames into as few writes as possible.
+        var regions = [Data]()
+        var completionHandlers = [(Error?) -> Void]()
+        var writeSize = 0
+        
+        var frameCount = 0
+        for frame in self.outgoingFrames
+        {
+            let frameSize = MultiplexedConnection.headerLength + frame.payload.count
+            guard frameCount == 0 || writeSize + frameSize <= MultiplexedConnection.maximumWriteSize else { break }
+            
+            regions.append(frame.header)
+            
+            if !frame.payload.isEmpty
+            {
+                regions.append(frame.payload)
+            }
+            
+            if let completionHandler = frame.completionHandler
+            {
+                completionHandlers.append(completionHandler)
+            }
+            
+            writeSize += frameSize
+            frameCount += 1
+        }
+        
+        self.outgoingFrames.removeFirst(frameCount)
+        
+        self.isWriting = true
+        self.didWriteSinceKeepAlive = true
+        
+        self.connection.send(regions) { (result) in
+            self.queue.async {
+                self.isWriting = false
+                
+                switch result
+                {
+                case .failure(let error):
+                    completionHandlers.forEach { $0(error) }
+                    self.finish(error: error)
+                
+                case .success:
+                    completionHandlers.forEach { $0(nil) }
+                    self.writeFrames()
+                }
+            }
+        }
+    }
+    
+    func startKeepAliveTimer()
+    {
+        let timer = DispatchSource.makeTimerSource(queue: self.queue)
+        timer.schedule(deadline: .now() + MultiplexedConnection.keepAliveInterval, repeating: MultiplexedConnection.keepAliveInterval)
+        timer.setEventHandler { [weak self] in
+            guard let self = self else { return }
+            
+            if !self.didWriteSinceKeepAlive && !self.isWriting
+            {
+                self.enqueue(Frame(streamID: 0, type: .ping))
+            }
+            
+            self.didWriteSinceKeepAlive = false
+        }
+        timer.resume()
+        
+        self.keepAliveTimer = timer
+    }
+}
+
+private extension MultiplexedConnection
+{
+    func receiveFrame()
+    {
+        self.connection.receiveData(expectedSize: MultiplexedConnection.headerLength) { (result) in
+            self.queue.async {
+                guard !self.isClosed else { return }
+                
+                do
+                {
+                    let header = try result.get()
+                    
+                    let streamID = header.multiplexedInteger(UInt32.self, at: 0)
+                    let rawType = header.multiplexedInteger(UInt8.self, at: 4)
+                    let payloadLength = Int(header.multiplexedInteger(UInt32.self, at: 5))
+                    
+                    guard let type = FrameType(rawValue: rawType), payloadLength <= MultiplexedConnection.maximumFrameSize else { throw ALTServerError(.invalidResponse) }
+                    
+                    guard payloadLength > 0 else {
+                        try self.handleFrame(type: type, streamID: streamID, payload: Data())
+                        return self.receiveFrame()
+                    }
+                    
+                    self.connection.receiveData(expectedSize: payloadLength) { (result) in
+                        self.queue.async {
+                            guard !self.isClosed else { return }
+                            
+                            do
+                            {
+                                let payload = try result.get()
+                                try self.handleFrame(type: type, streamID: streamID, payload: payload)
+                                
+                                self.receiveFrame()
+                            }
+                            catch
+                            {
+                                self.finish(error: error)
+                            }
+                        }
+                    }
+                }
+                catch
+                {
+                    self.finish(error: error)
+                }
+            }
+        }
+    }
+    
+    func handleFrame(type: FrameType, streamID: UInt32, payload: Data) throws
+    {
+        switch type
+        {
+        case .ping: break
+        
+        case .data:
+            var stream = self.streams[streamID]
+            
+            if stream == nil && self.isRemoteStreamID(streamID) && streamID > self.highestRemoteStreamID
+            {
+                self.highestRemoteStreamID = streamID
+                
+                guard let streamHandler = self.streamHandler else {
+                    // Nothing would ever read from or close stream, so refuse it rather than keeping it open forever.
+                    self.enqueue(Frame(streamID: streamID, type: .reset))
+                    return
+                }
+                
+                // Peers open streams implicitly by sending data, so requests can be pipelined without waiting for a round trip.
+                let remoteStream = Stream(streamID: streamID, multiplexedConnection: self)
+                self.streams[streamID] = remoteStream
+                
+                DispatchQueue.global().async {
+                    streamHandler(remoteStream)
+                }
+                
+                stream = remoteStream
+            }
+            
+            // Stream has already been closed locally, so discard data.
+            guard let stream = stream else { return }
+            
+            // Peer must never send more than we've allowed.
+            guard payload.count <= stream.receiveCredit else { throw ALTServerError(.invalidResponse) }
+            stream.receiveCredit -= payload.count
+            
+            stream.receivedChunks.append(payload)
+            stream.receivedByteCount += payload.count
+            
+            self.fulfillPendingReceives(for: stream)
+        
+        case .close, .reset:
+            guard let stream = self.streams[streamID] else { return }
+            self.streams[streamID] = nil
+            
+            stream.isRemotelyClosed = true
+            
+            self.failPendingSends(for: stream)
+            self.fulfillPendingReceives(for: stream)
+        
+        case .windowUpdate:
+            guard let stream = self.streams[streamID] else { return }
+            guard payload.count == MemoryLayout<UInt32>.size else { throw ALTServerError(.invalidResponse) }
+            
+            stream.sendCredit += Int(payload.multiplexedInteger(UInt32.self, at: 0))
+            self.flushPendingSends(for: stream)
+        }
+    }
+}
+
+private extension Data
+{
+    func multiplexedInteger<T: FixedWidthInteger>(_ type: T.Type, at offset: Int) -> T
+    {
+        var value: T = 0
+        withUnsafeMutableBytes(of: &value) { buffer in
+            let startIndex = self.startIndex + offset
+            _ = self.copyBytes(to: buffer, from: startIndex ..< startIndex + MemoryLayout<T>.size)
+        }
+        
+        return T(littleEndian: value)
+    }
+}
@@ -0,0 +1,622 @@
+//
+//  BinaryServerMessage.swift
+//  AltKit
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import Foundation
+import AltSign
+
+public enum ServerMessageEncoding: String, Codable
+{
+    case json
+    
+    // Compact binary encoding. Only sent once both sides have agreed to it when upgrading connection (see UpgradeConnectionRequest).
+    case binary
+}
+
+public extension ServerMessageEncoding
+{
+    func encode<T: Encodable>(_ message: T) throws -> Data
+    {
+        // Messages without a binary schema are always sent as JSON, which receivers can distinguish by first byte.
+        guard self == .binary, let message = message as? BinaryServerMessage else { return try JSONEncoder().encode(message) }
+        
+        let data = try message.binaryData()
+        return data
+    }
+}
+
+// Raw values are sent over the wire, so never change existing ones.
+enum ServerMessageType: UInt16
+{
+    case anisetteDataRequest = 1
+    case prepareAppRequest = 2
+    case beginInstallationRequest = 3
+    case installProvisioningProfilesRequest = 4
+    case removeProvisioningProfilesRequest = 5
+    case removeAppRequest = 6
+    case enableUnsignedCodeExecutionRequest = 7
+    
+    case errorResponse = 100
+    case anisetteDataResponse = 101
+    case installationProgressResponse = 102
+    case installProvisioningProfilesResponse = 103
+    case removeProvisioningProfilesResponse = 104
+    case removeAppResponse = 105
+    case enableUnsignedCodeExecutionResponse = 106
+}
+
+// Binary messages start with a fixed-layout header, followed by each field in the order defined by the message's schema (encodeBinary(to:)).
+// UInt8 magic, UInt8 format version, UInt16 message type, UInt16 message version, all little-endian.
+struct BinaryServerMessageHeader
+{
+    // JSON messages always start with "{", so receivers can tell encodings apart without any extra framing.
+    static let magic: UInt8 = 0xB1
+    static let formatVersion: UInt8 = 1
+    
+    var rawMessageType: UInt16
+    var version: Int
+    
+    var messageType: ServerMessageType? {
+        return ServerMessageType(rawValue: self.rawMessageType)
+    }
+    
+    static func isBinaryMessage(_ data: Data) -> Bool
+    {
+        return data.first == BinaryServerMessageHeader.magic
+    }
+    
+    init(rawMessageType: UInt16, version: Int)
+    {
+        self.rawMessageType = rawMessageType
+        self.version = version
+    }
+    
+    init(reader: inout BinaryMessageReader) throws
+    {
+        let magic = try reader.readInteger(UInt8.self)
+        let formatVersion = try reader.readInteger(UInt8.self)
+        guard magic == BinaryServerMessageHeader.magic, formatVersion == BinaryServerMessageHeader.formatVersion else { throw reader.makeError("Unsupported binary message format.") }
+        
+        self.rawMessageType = try reader.readInteger(UInt16.self)
+        self.version = Int(try reader.readInteger(UInt16.self))
+    }
+    
+    func write(to writer: inout BinaryMessageWriter)
+    {
+        writer.writeInteger(BinaryServerMessageHeader.magic)
+        writer.writeInteger(BinaryServerMessageHeader.formatVersion)
+        writer.writeInteger(self.rawMessageType)
+        writer.writeInteger(UInt16(clamping: self.version))
+    }
+}
+
+protocol BinaryServerMessage: ServerMessageProtocol
+{
+    static var messageType: ServerMessageType { get }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+}
+
+extension BinaryServerMessage
+{
+    func binaryData() throws -> Data
+    {
+        var writer = BinaryMessageWriter()
+        
+        let header = BinaryServerMessageHeader(rawMessageType: Self.messageType.rawValue, version: self.version)
+        header.write(to: &writer)
+        
+        try self.encodeBinary(to: &writer)
+        return writer.data
+    }
+}
+
+struct BinaryMessageWriter
+{
+    private(set) var data = Data(capacity: 64)
+    
+    mutating func writeInteger<T: FixedWidthInteger>(_ value: T)
+    {
+        withUnsafeBytes(of: value.littleEndian) { self.data.append(contentsOf: $0) }
+    }
+    
+    mutating func writeInt(_ value: Int)
+    {
+        self.writeInteger(Int64(value))
+    }
+    
+    mutating func writeBool(_ value: Bool)
+    {
+        self.writeInteger(value ? 1 as UInt8 : 0)
+    }
+    
+    mutating func writeDouble(_ value: Double)
+    {
+        self.writeInteger(value.bitPattern)
+    }
+    
+    mutating func writeData(_ value: Data)
+    {
+        self.writeInteger(UInt32(value.count))
+        self.data.append(value)
+    }
+    
+    mutating func writeString(_ value: String)
+    {
+        self.writeData(Data(value.utf8))
+    }
+    
+    mutating func writeOptional<T>(_ value: T?, using writeValue: (inout BinaryMessageWriter, T) throws -> Void) rethrows
+    {
+        guard let value = value else { return self.writeBool(false) }
+        
+        self.writeBool(true)
+        try writeValue(&self, value)
+    }
+    
+    mutating func writeArray<C: Collection>(_ values: C, using writeValue: (inout BinaryMessageWriter, C.Element) throws -> Void) rethrows
+    {
+        self.writeInteger(UInt32(values.count))
+        
+        for value in values
+        {
+            try writeValue(&self, value)
+        }
+    }
+}
+
+struct BinaryMessageReader
+{
+    private let data: Data
+    private var offset = 0
+    
+    init(data: Data)
+    {
+        // Copy data (if it's a slice) so indices start at 0.
+        self.data = (data.startIndex == 0) ? data : Data(data)
+    }
+    
+    func makeError(_ debugDescription: String) -> DecodingError
+    {
+        let context = DecodingError.Context(codingPath: [], debugDescription: debugDescription)
+        return DecodingError.dataCorrupted(context)
+    }
+    
+    mutating func readInteger<T: FixedWidthInteger>(_ type: T.Type) throws -> T
+    {
+        let size = MemoryLayout<T>.size
+        guard self.offset + size <= self.data.count else { throw self.makeError("Unexpected end of binary message.") }
+        
+        var value: T = 0
+        withUnsafeMutableBytes(of: &value) { buffer in
+            _ = self.data.copyBytes(to: buffer, from: self.offset ..< self.offset + size)
+        }
+        self.offset += size
+        
+        return T(littleEndian: value)
+    }
+    
+    mutating func readInt() throws -> Int
+    {
+        let value = try self.readInteger(Int64.self)
+        guard let int = Int(exactly: value) else { throw self.makeError("Integer \(value) out of range.") }
+        
+        return int
+    }
+    
+    mutating func readBool() throws -> Bool
+    {
+        return try self.readInteger(UInt8.self) != 0
+    }
+    
+    mutating func readDouble() throws -> Double
+    {
+        return Double(bitPattern: try self.readInteger(UInt64.self))
+    }
+    
+    mutating func readData() throws -> Data
+    {
+        let count = Int(try self.readInteger(UInt32.self))
+        guard self.offset + count <= self.data.count else { throw self.makeError("Unexpected end of binary message.") }
+        
+        let value = self.data.subdata(in: self.offset ..< self.offset + count)
+        self.offset += count
+        
+        return value
+    }
+    
+    mutating func readString() throws -> String
+    {
+        let data = try self.readData()
+        guard let value = String(data: data, encoding: .utf8) else { throw self.makeError("Invalid UTF-8 string.") }
+        
+        return value
+    }
+    
+    mutating func readOptional<T>(using readValue: (inout BinaryMessageReader) throws -> T) throws -> T?
+    {
+        guard try self.readBool() else { return nil }
+        
+        let value = try readValue(&self)
+        return value
+    }
+    
+    mutating func readArray<T>(using readValue: (inout BinaryMessageReader) throws -> T) throws -> [T]
+    {
+        let count = Int(try self.readInteger(UInt32.self))
+        
+        // Every element takes at least one byte, so don't trust counts larger than what's left.
+        guard count <= self.data.count - self.offset else { throw self.makeError("Invalid element count \(count).") }
+        
+        var values = [T]()
+        values.reserveCapacity(count)
+        
+        for _ in 0 ..< count
+        {
+            let value = try readValue(&self)
+            values.append(value)
+        }
+        
+        return values
+    }
+}
+
+public extension ServerRequest
+{
+    // Decodes request in whichever encoding peer used. Peers may send messages without a binary schema as JSON, even if binary encoding was negotiated.
+    init(messageData: Data, jsonDecoder: Foundation.JSONDecoder = Foundation.JSONDecoder()) throws
+    {
+        if BinaryServerMessageHeader.isBinaryMessage(messageData)
+        {
+            try self.init(binaryData: messageData)
+        }
+        else
+        {
+            self = try jsonDecoder.decode(ServerRequest.self, from: messageData)
+        }
+    }
+}
+
+public extension ServerResponse
+{
+    // Decodes response in whichever encoding peer used. Peers may send messages without a binary schema as JSON, even if binary encoding was negotiated.
+    init(messageData: Data, jsonDecoder: Foundation.JSONDecoder = Foundation.JSONDecoder()) throws
+    {
+        if BinaryServerMessageHeader.isBinaryMessage(messageData)
+        {
+            try self.init(binaryData: messageData)
+        }
+        else
+        {
+            self = try jsonDecoder.decode(ServerResponse.self, from: messageData)
+        }
+    }
+}
+
+extension ServerRequest
+{
+    init(binaryData: Data) throws
+    {
+        var reader = BinaryMessageReader(data: binaryData)
+        let header = try BinaryServerMessageHeader(reader: &reader)
+        
+        switch header.messageType
+        {
+        case .anisetteDataRequest?: self = .anisetteData(try AnisetteDataRequest(version: header.version, reader: &reader))
+        case .prepareAppRequest?: self = .prepareApp(try PrepareAppRequest(version: header.version, reader: &reader))
+        case .beginInstallationRequest?: self = .beginInstallation(try BeginInstallationRequest(version: header.version, reader: &reader))
+        case .installProvisioningProfilesRequest?: self = .installProvisioningProfiles(try InstallProvisioningProfilesRequest(version: header.version, reader: &reader))
+        case .removeProvisioningProfilesRequest?: self = .removeProvisioningProfiles(try RemoveProvisioningProfilesRequest(version: header.version, reader: &reader))
+        case .removeAppRequest?: self = .removeApp(try RemoveAppRequest(version: header.version, reader: &reader))
+        case .enableUnsignedCodeExecutionRequest?: self = .enableUnsignedCodeExecution(try EnableUnsignedCodeExecutionRequest(version: header.version, reader: &reader))
+        
+        case .errorResponse?, .anisetteDataResponse?, .installationProgressResponse?, .installProvisioningProfilesResponse?,
+             .removeProvisioningProfilesResponse?, .removeAppResponse?, .enableUnsignedCodeExecutionResponse?, nil:
+            self = .unknown(identifier: "BinaryMessage\(header.rawMessageType)", version: header.version)
+        }
+    }
+}
+
+extension ServerResponse
+{
+    init(binaryData: Data) throws
+    {
+        var reader = BinaryMessageReader(data: binaryData)
+        let header = try BinaryServerMessageHeader(reader: &reader)
+        
+        switch header.messageType
+        {
+        case .errorResponse?: self = .error(try ErrorResponse(version: header.version, reader: &reader))
+        case .anisetteDataResponse?: self = .anisetteData(try AnisetteDataResponse(version: header.version, reader: &reader))
+        case .installationProgressResponse?: self = .installationProgress(try InstallationProgressResponse(version: header.version, reader: &reader))
+        case .installProvisioningProfilesResponse?: self = .installProvisioningProfiles(try InstallProvisioningProfilesResponse(version: header.version, reader: &reader))
+        case .removeProvisioningProfilesResponse?: self = .removeProvisioningProfiles(try RemoveProvisioningProfilesResponse(version: header.version, reader: &reader))
+        case .removeAppResponse?: self = .removeApp(try RemoveAppResponse(version: header.version, reader: &reader))
+        case .enableUnsignedCodeExecutionResponse?: self = .enableUnsignedCodeExecution(try EnableUnsignedCodeExecutionResponse(version: header.version, reader: &reader))
+        
+        case .anisetteDataRequest?, .prepareAppRequest?, .beginInstallationRequest?, .installProvisioningProfilesRequest?,
+             .removeProvisioningProfilesRequest?, .removeAppRequest?, .enableUnsignedCodeExecutionRequest?, nil:
+            self = .unknown(identifier: "BinaryMessage\(header.rawMessageType)", version: header.version)
+        }
+    }
+}
+
+extension AnisetteDataRequest: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .anisetteDataRequest }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        self.init()
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+    }
+}
+
+extension PrepareAppRequest: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .prepareAppRequest }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        let udid = try reader.readString()
+        let contentSize = try reader.readInt()
+        let fileURL = try reader.readOptional { try $0.readString() }.flatMap(URL.init(string:))
+        
+        self.init(udid: udid, contentSize: contentSize, fileURL: fileURL)
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        writer.writeString(self.udid)
+        writer.writeInt(self.contentSize)
+        writer.writeOptional(self.fileURL) { $0.writeString($1.absoluteString) }
+    }
+}
+
+extension BeginInstallationRequest: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .beginInstallationRequest }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        let activeProfiles = try reader.readOptional { try $0.readArray { try $0.readString() } }
+        let bundleIdentifier = try reader.readOptional { try $0.readString() }
+        
+        self.init(activeProfiles: activeProfiles.map { Set($0) }, bundleIdentifier: bundleIdentifier)
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        writer.writeOptional(self.activeProfiles) { $0.writeArray($1) { $0.writeString($1) } }
+        writer.writeOptional(self.bundleIdentifier) { $0.writeString($1) }
+    }
+}
+
+extension InstallProvisioningProfilesRequest: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .installProvisioningProfilesRequest }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        let udid = try reader.readString()
+        
+        let provisioningProfiles = try reader.readArray { (reader) -> ALTProvisioningProfile in
+            let data = try reader.readData()
+            guard let profile = ALTProvisioningProfile(data: data) else { throw reader.makeError("Could not parse provisioning profile from data.") }
+            
+            return profile
+        }
+        
+        let activeProfiles = try reader.readOptional { try $0.readArray { try $0.readString() } }
+        
+        self.init(udid: udid, provisioningProfiles: Set(provisioningProfiles), activeProfiles: activeProfiles.map { Set($0) })
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        writer.writeString(self.udid)
+        writer.writeArray(self.provisioningProfiles) { $0.writeData($1.data) }
+        writer.writeOptional(self.activeProfiles) { $0.writeArray($1) { $0.writeString($1) } }
+    }
+}
+
+extension RemoveProvisioningProfilesRequest: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .removeProvisioningProfilesRequest }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        let udid = try reader.readString()
+        let bundleIdentifiers = try reader.readArray { try $0.readString() }
+        
+        self.init(udid: udid, bundleIdentifiers: Set(bundleIdentifiers))
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        writer.writeString(self.udid)
+        writer.writeArray(self.bundleIdentifiers) { $0.writeString($1) }
+    }
+}
+
+extension RemoveAppRequest: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .removeAppRequest }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        let udid = try reader.readString()
+        let bundleIdentifier = try reader.readString()
+        
+        self.init(udid: udid, bundleIdentifier: bundleIdentifier)
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        writer.writeString(self.udid)
+        writer.writeString(self.bundleIdentifier)
+    }
+}
+
+extension EnableUnsignedCodeExecutionRequest: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .enableUnsignedCodeExecutionRequest }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        let udid = try reader.readString()
+        let processID = try reader.readOptional { try $0.readInt() }
+        let processName = try reader.readOptional { try $0.readString() }
+        
+        self.init(udid: udid, processID: processID, processName: processName)
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        writer.writeString(self.udid)
+        writer.writeOptional(self.processID) { $0.writeInt($1) }
+        writer.writeOptional(self.processName) { $0.writeString($1) }
+    }
+}
+
+extension ErrorResponse: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .errorResponse }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        // Errors are rare and arbitrarily nested, so embed CodableError's JSON representation rather than defining a schema for it.
+        let errorData = try reader.readData()
+        let codableError = try Foundation.JSONDecoder().decode(CodableError.self, from: errorData)
+        
+        self.init(error: ALTServerError(codableError.error))
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        let errorData = try JSONEncoder().encode(CodableError(error: self.error))
+        writer.writeData(errorData)
+    }
+}
+
+extension AnisetteDataResponse: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .anisetteDataResponse }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        let keyValuePairs = try reader.readArray { (reader) -> (String, String) in
+            let key = try reader.readString()
+            let value = try reader.readString()
+            return (key, value)
+        }
+        
+        let json = Dictionary(keyValuePairs, uniquingKeysWith: { $1 })
+        guard let anisetteData = ALTAnisetteData(json: json) else { throw reader.makeError("Could not parse anisette data.") }
+        
+        self.init(anisetteData: anisetteData)
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        writer.writeArray(self.anisetteData.json()) { (writer, keyValuePair) in
+            writer.writeString(keyValuePair.key)
+            writer.writeString(keyValuePair.value)
+        }
+    }
+}
+
+extension InstallationProgressResponse: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .installationProgressResponse }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        let progress = try reader.readDouble()
+        
+        self.init(progress: progress)
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+        writer.writeDouble(self.progress)
+    }
+}
+
+extension InstallProvisioningProfilesResponse: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .installProvisioningProfilesResponse }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        self.init()
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+    }
+}
+
+extension RemoveProvisioningProfilesResponse: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .removeProvisioningProfilesResponse }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        self.init()
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+    }
+}
+
+extension RemoveAppResponse: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .removeAppResponse }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        self.init()
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+    }
+}
+
+extension EnableUnsignedCodeExecutionResponse: BinaryServerMessage
+{
+    static var messageType: ServerMessageType { .enableUnsignedCodeExecutionResponse }
+    
+    init(version: Int, reader: inout BinaryMessageReader) throws
+    {
+        self.init()
+        self.version = version
+    }
+    
+    func encodeBinary(to writer: inout BinaryMessageWriter) throws
+    {
+    }
+}
@@ -26,6 +26,7 @@ public enum ServerRequest: Decodable
     case removeProvisioningProfiles(RemoveProvisioningProfilesRequest)
     case removeApp(RemoveAppRequest)
     case enableUnsignedCodeExecution(EnableUnsignedCodeExecutionRequest)
+    case upgradeConnection(UpgradeConnectionRequest)
     case unknown(identifier: String, version: Int)
     
     var identifier: String {
@@ -38,6 +39,7 @@ public enum ServerRequest: Decodable
         case .removeProvisioningProfiles(let request): return request.identifier
         case .removeApp(let request): return request.identifier
         case .enableUnsignedCodeExecution(let request): return request.identifier
+        case .upgradeConnection(let request): return request.identifier
         case .unknown(let identifier, _): return identifier
         }
     }
@@ -52,6 +54,7 @@ public enum ServerRequest: Decodable
         case .removeProvisioningProfiles(let request): return request.version
         case .removeApp(let request): return request.version
         case .enableUnsignedCodeExecution(let request): return request.version
+        case .upgradeConnection(let request): return request.version
         case .unknown(_, let version): return version
         }
     }
@@ -99,6 +102,10 @@ public enum ServerRequest: Decodable
             let request = try EnableUnsignedCodeExecutionRequest(from: decoder)
             self = .enableUnsignedCodeExecution(request)
             
+        case "UpgradeConnectionRequest":
+            let request = try UpgradeConnectionRequest(from: decoder)
+            self = .upgradeConnection(request)
+        
         default:
             self = .unknown(identifier: identifier, version: version)
         }
@@ -113,6 +120,7 @@ public enum ServerResponse: Decodable
     case removeProvisioningProfiles(RemoveProvisioningProfilesResponse)
     case removeApp(RemoveAppResponse)
     case enableUnsignedCodeExecution(EnableUnsignedCodeExecutionResponse)
+    case upgradeConnection(UpgradeConnectionResponse)
     case error(ErrorResponse)
     case unknown(identifier: String, version: Int)
     
@@ -125,6 +133,7 @@ public enum ServerResponse: Decodable
         case .removeProvisioningProfiles(let response): return response.identifier
         case .removeApp(let response): return response.identifier
         case .enableUnsignedCodeExecution(let response): return response.identifier
+        case .upgradeConnection(let response): return response.identifier
         case .error(let response): return response.identifier
         case .unknown(let identifier, _): return identifier
         }
@@ -139,6 +148,7 @@ public enum ServerResponse: Decodable
         case .removeProvisioningProfiles(let response): return response.version
         case .removeApp(let response): return response.version
         case .enableUnsignedCodeExecution(let response): return response.version
+        case .upgradeConnection(let response): return response.version
         case .error(let response): return response.version
         case .unknown(_, let version): return version
         }
@@ -182,6 +192,10 @@ public enum ServerResponse: Decodable
         case "EnableUnsignedCodeExecutionResponse":
             let response = try EnableUnsignedCodeExecutionResponse(from: decoder)
             self = .enableUnsignedCodeExecution(response)
+        
+        case "UpgradeConnectionResponse":
+            let response = try UpgradeConnectionResponse(from: decoder)
+            self = .upgradeConnection(response)
             
         case "ErrorResponse":
             let response = try ErrorResponse(from: decoder)
@@ -466,3 +480,39 @@ public struct EnableUnsignedCodeExecutionResponse: ServerMessageProtocol
     {
     }
 }
+
+// Asks server to keep connection open and multiplex requests over it (see MultiplexedConnection).
+// Older servers respond with an ErrorResponse and disconnect, in which case clients should keep using one connection per request.
+public struct UpgradeConnectionRequest: ServerMessageProtocol
+{
+    public var version = 1
+    public var identifier = "UpgradeConnectionRequest"
+    
+    public var protocolVersion: Int
+    
+    // Raw ServerMessageEncoding values, in order of preference. Raw strings so that unrecognized encodings can be ignored.
+    public var messageEncodings: [String]?
+    
+    public init(protocolVersion: Int = MultiplexedConnection.protocolVersion, messageEncodings: [ServerMessageEncoding] = [.binary, .json])
+    {
+        self.protocolVersion = protocolVersion
+        self.messageEncodings = messageEncodings.map { $0.rawValue }
+    }
+}
+
+public struct UpgradeConnectionResponse: ServerMessageProtocol
+{
+    public var version = 1
+    public var identifier = "UpgradeConnectionResponse"
+    
+    public var protocolVersion: Int
+    
+    // Encoding both sides should use for subsequent messages, chosen from request's messageEncodings. JSON if nil.
+    public var messageEncoding: String?
+    
+    public init(protocolVersion: Int = MultiplexedConnection.protocolVersion, messageEncoding: ServerMessageEncoding = .json)
+    {
+        self.protocolVersion = protocolVersion
+        self.messageEncoding = messageEncoding.rawValue
+    }
+}
@@ -0,0 +1,63 @@
+//
+//  ALTMachOFile.h
+//  AltStore
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <mach/machine.h>
+
+@class ALTMachOFile;
+
+NS_ASSUME_NONNULL_BEGIN
+
+NS_SWIFT_NAME(MachOSlice)
+@interface ALTMachOSlice : NSObject
+
+@property (nonatomic, weak, readonly) ALTMachOFile *file;
+
+@property (nonatomic, readonly) cpu_type_t cpuType;
+@property (nonatomic, readonly) cpu_subtype_t cpuSubtype;
+@property (nonatomic, readonly) BOOL is64Bit;
+
+// Location of slice within file.
+@property (nonatomic, readonly) NSRange range;
+
+@property (nonatomic, readonly) NSInteger loadCommandCount;
+
+// Location of code signature relative to start of slice, or {NSNotFound, 0} if unsigned.
+@property (nonatomic, readonly) NSRange codeSignatureRange;
+
+// Raw XML entitlements embedded in code signature. Points directly into file's data rather than copying it.
+@property (nonatomic, readonly, nullable) NSData *entitlementsData;
+
+// Returns empty dictionary if slice has no entitlements.
+- (nullable NSDictionary<NSString *, id> *)entitlementsWithError:(NSError **)error;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+// Read-only view of a thin or fat Mach-O file. Files are memory-mapped rather than read, and parsed without copying.
+NS_SWIFT_NAME(MachOFile)
+@interface ALTMachOFile : NSObject
+
+@property (nonatomic, readonly, nullable) NSURL *fileURL;
+@property (nonatomic, readonly) NSData *data;
+
+@property (nonatomic, readonly, getter=isFat) BOOL fat;
+@property (nonatomic, copy, readonly) NSArray<ALTMachOSlice *> *slices;
+
+- (nullable instancetype)initWithFileURL:(NSURL *)fileURL error:(NSError **)error;
+- (nullable instancetype)initWithData:(NSData *)data error:(NSError **)error;
+
+// Returns first slice matching cpuType, ignoring capability bits in cpuSubtype.
+- (nullable ALTMachOSlice *)sliceWithCPUType:(cpu_type_t)cpuType cpuSubtype:(cpu_subtype_t)cpuSubtype;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+NS_ASSUME_NONNULL_END
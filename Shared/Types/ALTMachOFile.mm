@@ -0,0 +1,232 @@
+//
+//  ALTMachOFile.mm
+//  AltStore
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#import "ALTMachOFile.h"
+
+#include "MachOFile.hpp"
+
+static NSError *ALTMachOFileError(NSURL *_Nullable fileURL)
+{
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+    userInfo[NSURLErrorKey] = fileURL;
+    
+    return [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError userInfo:userInfo];
+}
+
+@interface ALTMachOSlice ()
+{
+    macho::Slice _slice;
+    
+    // Strong reference to file's data, since pointers in _slice point into it.
+    NSData *_data;
+}
+
+- (instancetype)initWithFile:(ALTMachOFile *)file slice:(const macho::Slice &)slice range:(macho::Range)range;
+
+@end
+
+@implementation ALTMachOSlice
+
+- (instancetype)initWithFile:(ALTMachOFile *)file slice:(const macho::Slice &)slice range:(macho::Range)range
+{
+    self = [super init];
+    if (self)
+    {
+        _file = file;
+        _data = file.data;
+        _slice = slice;
+        
+        _range = NSMakeRange((NSUInteger)range.offset, (NSUInteger)range.size);
+    }
+    
+    return self;
+}
+
+#pragma mark - Entitlements -
+
+- (nullable NSDictionary<NSString *, id> *)entitlementsWithError:(NSError **)error
+{
+    const char *bytes = nullptr;
+    size_t length = 0;
+    
+    if (_slice.entitlements(bytes, length) != macho::Error::None)
+    {
+        if (error)
+        {
+            *error = ALTMachOFileError(self.file.fileURL);
+        }
+        
+        return nil;
+    }
+    
+    if (length == 0)
+    {
+        return @{};
+    }
+    
+    NSData *entitlementsData = self.entitlementsData;
+    
+    NSDictionary *entitlements = [NSPropertyListSerialization propertyListWithData:entitlementsData options:NSPropertyListImmutable format:nil error:error];
+    if (entitlements == nil)
+    {
+        return nil;
+    }
+    
+    if (![entitlements isKindOfClass:[NSDictionary class]])
+    {
+        if (error)
+        {
+            *error = ALTMachOFileError(self.file.fileURL);
+        }
+        
+        return nil;
+    }
+    
+    return entitlements;
+}
+
+#pragma mark - Getters/Setters -
+
+- (cpu_type_t)cpuType
+{
+    return _slice.cpuType();
+}
+
+- (cpu_subtype_t)cpuSubtype
+{
+    return _slice.cpuSubtype();
+}
+
+- (BOOL)is64Bit
+{
+    return _slice.is64Bit();
+}
+
+- (NSInteger)loadCommandCount
+{
+    return _slice.loadCommandCount();
+}
+
+- (NSRange)codeSignatureRange
+{
+    if (!_slice.hasCodeSignature())
+    {
+        return NSMakeRange(NSNotFound, 0);
+    }
+    
+    macho::Range range = _slice.codeSignatureRange();
+    return NSMakeRange((NSUInteger)range.offset, (NSUInteger)range.size);
+}
+
+- (NSData *)entitlementsData
+{
+    const char *bytes = nullptr;
+    size_t length = 0;
+    
+    if (_slice.entitlements(bytes, length) != macho::Error::None || length == 0)
+    {
+        return nil;
+    }
+    
+    // Capture _data in deallocator to keep mapped file alive as long as returned data.
+    NSData *data = _data;
+    return [[NSData alloc] initWithBytesNoCopy:(void *)bytes length:length deallocator:^(void *mappedBytes, NSUInteger mappedLength) {
+        (void)data;
+    }];
+}
+
+@end
+
+@implementation ALTMachOFile
+{
+    macho::File _machOFile;
+}
+
+- (nullable instancetype)initWithFileURL:(NSURL *)fileURL error:(NSError **)error
+{
+    // Map file rather than reading it, so only the pages we actually parse are loaded into memory.
+    NSData *data = [NSData dataWithContentsOfURL:fileURL options:NSDataReadingMappedAlways error:error];
+    if (data == nil)
+    {
+        return nil;
+    }
+    
+    return [self initWithData:data fileURL:fileURL error:error];
+}
+
+- (nullable instancetype)initWithData:(NSData *)data error:(NSError **)error
+{
+    return [self initWithData:data fileURL:nil error:error];
+}
+
+- (nullable instancetype)initWithData:(NSData *)data fileURL:(nullable NSURL *)fileURL error:(NSError **)error
+{
+    self = [super init];
+    if (self)
+    {
+        _data = [data copy];
+        _fileURL = [fileURL copy];
+        
+        const uint8_t *bytes = (const uint8_t *)_data.bytes;
+        if (macho::File::parse(bytes, _data.length, _machOFile) != macho::Error::None)
+        {
+            if (error)
+            {
+                *error = ALTMachOFileError(fileURL);
+            }
+            
+            return nil;
+        }
+        
+        NSMutableArray<ALTMachOSlice *> *slices = [NSMutableArray arrayWithCapacity:_machOFile.sliceCount()];
+        for (uint32_t i = 0; i < _machOFile.sliceCount(); i++)
+        {
+            macho::Slice slice;
+            macho::Range range;
+            
+            if (_machOFile.slice(i, slice, &range) != macho::Error::None)
+            {
+                if (error)
+                {
+                    *error = ALTMachOFileError(fileURL);
+                }
+                
+                return nil;
+            }
+            
+            ALTMachOSlice *machOSlice = [[ALTMachOSlice alloc] initWithFile:self slice:slice range:range];
+            [slices addObject:machOSlice];
+        }
+        
+        _slices = [slices copy];
+    }
+    
+    return self;
+}
+
+- (nullable ALTMachOSlice *)sliceWithCPUType:(cpu_type_t)cpuType cpuSubtype:(cpu_subtype_t)cpuSubtype
+{
+    for (ALTMachOSlice *slice in self.slices)
+    {
+        if (slice.cpuType == cpuType && (slice.cpuSubtype & ~CPU_SUBTYPE_MASK) == (cpuSubtype & ~CPU_SUBTYPE_MASK))
+        {
+            return slice;
+        }
+    }
+    
+    return nil;
+}
+
+#pragma mark - Getters/Setters -
+
+- (BOOL)isFat
+{
+    return _machOFile.isFat();
+}
+
+@end
@@ -0,0 +1,137 @@
+//
+//  JITServerMessage.swift
+//  AltStore
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import Foundation
+import Network
+
+// Messages exchanged between AltServer and `altjit serve` over a local Unix socket.
+// Each connection carries a single request followed by a single response, each encoded as one line of JSON.
+enum JITServer
+{
+    static let socketPath = "/var/run/altjit.sock"
+    
+    static let messageDelimiter = UInt8(ascii: "\n")
+    
+    // Messages cross the user/root privilege boundary, so cap how much either side will buffer.
+    static let maximumMessageSize = 1024 * 1024
+    
+    // Used when requests don't specify their own timeout.
+    static let defaultTimeout: TimeInterval = 90.0
+}
+
+struct JITServerRequest: Codable
+{
+    enum Action: String, Codable
+    {
+        case enableJIT = "enable"
+        case statistics = "stats"
+    }
+    
+    var action: Action
+    
+    var udid: String?
+    var process: String?
+    var timeout: TimeInterval?
+    
+    static func enableJIT(for process: AppProcess, udid: String, timeout: TimeInterval?) -> JITServerRequest
+    {
+        let value: String
+        switch process
+        {
+        case .name(let name): value = name
+        case .pid(let pid): value = String(pid)
+        }
+        
+        return JITServerRequest(action: .enableJIT, udid: udid, process: value, timeout: timeout)
+    }
+}
+
+struct JITServerStatistics: Codable
+{
+    var requestCount: Int
+    var reusedSessionCount: Int
+    var activeSessionCount: Int
+    
+    // Latency percentiles (in seconds) over the most recent requests.
+    var p50: TimeInterval?
+    var p90: TimeInterval?
+    var p99: TimeInterval?
+}
+
+struct JITServerResponse: Codable
+{
+    var success: Bool
+    
+    // Combined process output, so clients can parse failures the same way as `altjit enable`.
+    var output: String?
+    var errorDescription: String?
+    
+    var latency: TimeInterval?
+    var statistics: JITServerStatistics?
+}
+
+extension NWConnection
+{
+    func sendJITServerMessage(_ message: some Encodable) async throws
+    {
+        var data = try JSONEncoder().encode(message)
+        data.append(JITServer.messageDelimiter)
+        
+        try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<Void, Error>) in
+            self.send(content: data, completion: .contentProcessed { error in
+                if let error
+                {
+                    continuation.resume(throwing: error)
+                }
+                else
+                {
+                    continuation.resume()
+                }
+            })
+        }
+    }
+    
+    func receiveJITServerMessage<T: Decodable>(_ type: T.Type) async throws -> T
+    {
+        var buffer = Data()
+        
+        while true
+        {
+            let (data, isComplete) = try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<(Data?, Bool), Error>) in
+                self.receive(minimumIncompleteLength: 1, maximumLength: 64 * 1024) { (data, _, isComplete, error) in
+                    if let error
+                    {
+                        continuation.resume(throwing: error)
+                    }
+                    else
+                    {
+                        continuation.resume(returning: (data, isComplete))
+                    }
+                }
+            }
+            
+            if let data
+            {
+                buffer.append(data)
+            }
+            
+            if let index = buffer.firstIndex(of: JITServer.messageDelimiter)
+            {
+                let message = try JSONDecoder().decode(T.self, from: buffer[buffer.startIndex ..< index])
+                return message
+            }
+            
+            guard buffer.count <= JITServer.maximumMessageSize else {
+                self.cancel()
+                throw NWError.posix(.EMSGSIZE)
+            }
+            
+            guard !isComplete else { throw NWError.posix(.ECONNRESET) }
+        }
+    }
+}
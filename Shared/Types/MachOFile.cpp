@@ -0,0 +1,360 @@
+//
+//  MachOFile.cpp
+//  AltStore
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#include "MachOFile.hpp"
+
+#include <mach-o/fat.h>
+#include <mach-o/loader.h>
+
+namespace macho
+{
+
+// Code signing constants, from xnu's osfmk/kern/cs_blobs.h (not public on iOS).
+static const uint32_t CodeSignatureMagic = 0xfade0cc0; // CSMAGIC_EMBEDDED_SIGNATURE
+static const uint32_t EntitlementsMagic = 0xfade7171; // CSMAGIC_EMBEDDED_ENTITLEMENTS
+static const uint32_t DEREntitlementsMagic = 0xfade7172; // CSMAGIC_EMBEDDED_DER_ENTITLEMENTS
+
+static const uint32_t EntitlementsSlot = 5; // CSSLOT_ENTITLEMENTS
+static const uint32_t DEREntitlementsSlot = 7; // CSSLOT_DER_ENTITLEMENTS
+
+// Buffers may be unaligned (e.g. slices inside fuzzed files), so always read integers with memcpy.
+template <typename T>
+static T Read(const uint8_t *data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// Fat headers and code signatures are always big-endian.
+static uint32_t ReadBigEndian32(const uint8_t *data)
+{
+    return __builtin_bswap32(Read<uint32_t>(data));
+}
+
+static uint64_t ReadBigEndian64(const uint8_t *data)
+{
+    return __builtin_bswap64(Read<uint64_t>(data));
+}
+
+#pragma mark - Slice -
+
+Error Slice::parse(const uint8_t *data, size_t size, Slice &slice)
+{
+    if (size < sizeof(uint32_t))
+    {
+        return Error::Truncated;
+    }
+
+    uint32_t magic = Read<uint32_t>(data);
+
+    size_t headerSize = 0;
+    switch (magic)
+    {
+        case MH_MAGIC: headerSize = sizeof(struct mach_header); break;
+        case MH_MAGIC_64: headerSize = sizeof(struct mach_header_64); break;
+
+        // Big-endian Mach-Os aren't supported by any Apple platform we run on.
+        default: return Error::InvalidMagic;
+    }
+
+    if (size < headerSize)
+    {
+        return Error::Truncated;
+    }
+
+    // mach_header is a prefix of mach_header_64.
+    struct mach_header header = Read<struct mach_header>(data);
+
+    if (header.sizeofcmds > size - headerSize)
+    {
+        return Error::Truncated;
+    }
+
+    if (header.ncmds > header.sizeofcmds / sizeof(struct load_command))
+    {
+        return Error::InvalidLoadCommand;
+    }
+
+    Range codeSignature;
+
+    const uint8_t *command = data + headerSize;
+    uint32_t remainingSize = header.sizeofcmds;
+
+    for (uint32_t i = 0; i < header.ncmds; i++)
+    {
+        if (remainingSize < sizeof(struct load_command))
+        {
+            return Error::InvalidLoadCommand;
+        }
+
+        struct load_command loadCommand = Read<struct load_command>(command);
+        if (loadCommand.cmdsize < sizeof(struct load_command) || loadCommand.cmdsize > remainingSize || loadCommand.cmdsize % sizeof(uint32_t) != 0)
+        {
+            return Error::InvalidLoadCommand;
+        }
+
+        if (loadCommand.cmd == LC_CODE_SIGNATURE)
+        {
+            if (loadCommand.cmdsize < sizeof(struct linkedit_data_command))
+            {
+                return Error::InvalidLoadCommand;
+            }
+
+            struct linkedit_data_command signatureCommand = Read<struct linkedit_data_command>(command);
+            if ((uint64_t)signatureCommand.dataoff + signatureCommand.datasize > size)
+            {
+                return Error::InvalidCodeSignature;
+            }
+
+            codeSignature.offset = signatureCommand.dataoff;
+            codeSignature.size = signatureCommand.datasize;
+        }
+
+        command += loadCommand.cmdsize;
+        remainingSize -= loadCommand.cmdsize;
+    }
+
+    slice._data = data;
+    slice._size = size;
+    slice._headerSize = headerSize;
+
+    slice._is64Bit = (magic == MH_MAGIC_64);
+    slice._cpuType = header.cputype;
+    slice._cpuSubtype = header.cpusubtype;
+    slice._fileType = header.filetype;
+
+    slice._loadCommandCount = header.ncmds;
+    slice._codeSignature = codeSignature;
+
+    return Error::None;
+}
+
+Error Slice::entitlements(const char *&data, size_t &length) const
+{
+    const uint8_t *blob = nullptr;
+
+    Error error = this->codeSignatureBlob(EntitlementsSlot, EntitlementsMagic, blob, length);
+    data = reinterpret_cast<const char *>(blob);
+
+    return error;
+}
+
+Error Slice::derEntitlements(const uint8_t *&data, size_t &length) const
+{
+    return this->codeSignatureBlob(DEREntitlementsSlot, DEREntitlementsMagic, data, length);
+}
+
+Error Slice::codeSignatureBlob(uint32_t slotType, uint32_t blobMagic, const uint8_t *&data, size_t &length) const
+{
+    data = nullptr;
+    length = 0;
+
+    if (!this->hasCodeSignature())
+    {
+        return Error::None;
+    }
+
+    // Layout: SuperBlob { magic, length, count, BlobIndex { type, offset }[count] }, followed by blobs { magic, length, data[] }.
+    const uint8_t *signature = _data + _codeSignature.offset;
+    const size_t superBlobHeaderSize = 3 * sizeof(uint32_t);
+    const size_t blobIndexSize = 2 * sizeof(uint32_t);
+    const size_t blobHeaderSize = 2 * sizeof(uint32_t);
+
+    if (_codeSignature.size < superBlobHeaderSize || ReadBigEndian32(signature) != CodeSignatureMagic)
+    {
+        return Error::InvalidCodeSignature;
+    }
+
+    uint32_t signatureLength = ReadBigEndian32(signature + 4);
+    uint32_t blobCount = ReadBigEndian32(signature + 8);
+
+    if (signatureLength < superBlobHeaderSize || signatureLength > _codeSignature.size || blobCount > (signatureLength - superBlobHeaderSize) / blobIndexSize)
+    {
+        return Error::InvalidCodeSignature;
+    }
+
+    for (uint32_t i = 0; i < blobCount; i++)
+    {
+        const uint8_t *blobIndex = signature + superBlobHeaderSize + i * blobIndexSize;
+        if (ReadBigEndian32(blobIndex) != slotType)
+        {
+            continue;
+        }
+
+        uint32_t blobOffset = ReadBigEndian32(blobIndex + 4);
+        if (blobOffset > signatureLength - blobHeaderSize)
+        {
+            return Error::InvalidCodeSignature;
+        }
+
+        const uint8_t *blob = signature + blobOffset;
+
+        uint32_t blobLength = ReadBigEndian32(blob + 4);
+        if (ReadBigEndian32(blob) != blobMagic || blobLength < blobHeaderSize || blobLength > signatureLength - blobOffset)
+        {
+            return Error::InvalidCodeSignature;
+        }
+
+        data = blob + blobHeaderSize;
+        length = blobLength - blobHeaderSize;
+        break;
+    }
+
+    return Error::None;
+}
+
+#pragma mark - File -
+
+Error File::parse(const uint8_t *data, size_t size, File &file)
+{
+    if (size < sizeof(uint32_t))
+    {
+        return Error::Truncated;
+    }
+
+    uint32_t magic = ReadBigEndian32(data);
+    if (magic != FAT_MAGIC && magic != FAT_MAGIC_64)
+    {
+        // Thin file, so validate it now since there's no fat header to validate instead.
+        Slice slice;
+
+        Error error = Slice::parse(data, size, slice);
+        if (error != Error::None)
+        {
+            return error;
+        }
+
+        file._data = data;
+        file._size = size;
+        file._isFat = false;
+        file._is64BitFat = false;
+        file._sliceCount = 1;
+
+        return Error::None;
+    }
+
+    if (size < sizeof(struct fat_header))
+    {
+        return Error::Truncated;
+    }
+
+    bool is64BitFat = (magic == FAT_MAGIC_64);
+    size_t archSize = is64BitFat ? sizeof(struct fat_arch_64) : sizeof(struct fat_arch);
+
+    uint32_t sliceCount = ReadBigEndian32(data + 4);
+    if (sliceCount == 0)
+    {
+        return Error::InvalidFatHeader;
+    }
+
+    if (sliceCount > (size - sizeof(struct fat_header)) / archSize)
+    {
+        return Error::Truncated;
+    }
+
+    file._data = data;
+    file._size = size;
+    file._isFat = true;
+    file._is64BitFat = is64BitFat;
+    file._sliceCount = sliceCount;
+
+    // Slices are parsed lazily, but make sure they're all within the file now.
+    uint64_t headerSize = sizeof(struct fat_header) + sliceCount * archSize;
+    for (uint32_t i = 0; i < sliceCount; i++)
+    {
+        Range range = file.sliceRange(i, nullptr, nullptr);
+        if (range.size == 0 || range.offset < headerSize || range.offset > size || range.size > size - range.offset)
+        {
+            file = File();
+            return Error::InvalidFatHeader;
+        }
+    }
+
+    return Error::None;
+}
+
+Error File::slice(uint32_t index, Slice &slice, Range *range) const
+{
+    if (index >= _sliceCount)
+    {
+        return Error::SliceNotFound;
+    }
+
+    Range sliceRange = _isFat ? this->sliceRange(index, nullptr, nullptr) : Range{0, _size};
+
+    if (range != nullptr)
+    {
+        *range = sliceRange;
+    }
+
+    return Slice::parse(_data + sliceRange.offset, (size_t)sliceRange.size, slice);
+}
+
+Error File::slice(cpu_type_t cpuType, cpu_subtype_t cpuSubtype, Slice &slice, Range *range) const
+{
+    if (!_isFat)
+    {
+        Error error = this->slice(0, slice, range);
+        if (error != Error::None)
+        {
+            return error;
+        }
+
+        bool matches = (slice.cpuType() == cpuType && (slice.cpuSubtype() & ~CPU_SUBTYPE_MASK) == (cpuSubtype & ~CPU_SUBTYPE_MASK));
+        return matches ? Error::None : Error::SliceNotFound;
+    }
+
+    for (uint32_t i = 0; i < _sliceCount; i++)
+    {
+        cpu_type_t sliceCPUType = 0;
+        cpu_subtype_t sliceCPUSubtype = 0;
+        this->sliceRange(i, &sliceCPUType, &sliceCPUSubtype);
+
+        if (sliceCPUType == cpuType && (sliceCPUSubtype & ~CPU_SUBTYPE_MASK) == (cpuSubtype & ~CPU_SUBTYPE_MASK))
+        {
+            return this->slice(i, slice, range);
+        }
+    }
+
+    return Error::SliceNotFound;
+}
+
+Range File::sliceRange(uint32_t index, cpu_type_t *cpuType, cpu_subtype_t *cpuSubtype) const
+{
+    // Index has already been validated against fat header.
+    const uint8_t *arch = _data + sizeof(struct fat_header) + index * (_is64BitFat ? sizeof(struct fat_arch_64) : sizeof(struct fat_arch));
+
+    Range range;
+
+    if (_is64BitFat)
+    {
+        range.offset = ReadBigEndian64(arch + offsetof(struct fat_arch_64, offset));
+        range.size = ReadBigEndian64(arch + offsetof(struct fat_arch_64, size));
+    }
+    else
+    {
+        range.offset = ReadBigEndian32(arch + offsetof(struct fat_arch, offset));
+        range.size = ReadBigEndian32(arch + offsetof(struct fat_arch, size));
+    }
+
+    // cputype and cpusubtype are at the same offsets in both fat_arch and fat_arch_64.
+    if (cpuType != nullptr)
+    {
+        *cpuType = (cpu_type_t)ReadBigEndian32(arch + offsetof(struct fat_arch, cputype));
+    }
+
+    if (cpuSubtype != nullptr)
+    {
+        *cpuSubtype = (cpu_subtype_t)ReadBigEndian32(arch + offsetof(struct fat_arch, cpusubtype));
+    }
+
+    return range;
+}
+
+}
@@ -0,0 +1,142 @@
+//
+//  MachOFile.hpp
+//  AltStore
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+#ifndef MachOFile_hpp
+#define MachOFile_hpp
+
+#include <mach/machine.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Read-only views over thin and fat Mach-O files that are already in memory (typically mapped with mmap).
+// Nothing is copied or allocated: every pointer returned points into the original buffer, which must outlive the views.
+// All offsets and sizes are validated against the buffer, so malformed files fail to parse rather than reading out of bounds.
+namespace macho
+{
+
+enum class Error
+{
+    None,
+    Truncated,
+    InvalidMagic,
+    InvalidFatHeader,
+    InvalidLoadCommand,
+    InvalidCodeSignature,
+    SliceNotFound,
+};
+
+struct Range
+{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+struct LoadCommand
+{
+    uint32_t command;
+
+    // Entire load command, including command and size fields.
+    const uint8_t *data;
+    uint32_t size;
+};
+
+// A single-architecture Mach-O image, either an entire thin file or one slice of a fat file.
+class Slice
+{
+public:
+    static Error parse(const uint8_t *data, size_t size, Slice &slice);
+
+    const uint8_t *data() const { return _data; }
+    size_t size() const { return _size; }
+
+    bool is64Bit() const { return _is64Bit; }
+
+    cpu_type_t cpuType() const { return _cpuType; }
+    cpu_subtype_t cpuSubtype() const { return _cpuSubtype; }
+    uint32_t fileType() const { return _fileType; }
+
+    uint32_t loadCommandCount() const { return _loadCommandCount; }
+
+    // Calls body for each load command, in order, until it returns false.
+    template <typename Function>
+    void enumerateLoadCommands(Function body) const
+    {
+        const uint8_t *data = _data + _headerSize;
+        for (uint32_t i = 0; i < _loadCommandCount; i++)
+        {
+            // Bounds have already been validated by parse().
+            uint32_t command, size;
+            std::memcpy(&command, data, sizeof(command));
+            std::memcpy(&size, data + sizeof(command), sizeof(size));
+
+            if (!body(LoadCommand{command, data, size}))
+            {
+                break;
+            }
+
+            data += size;
+        }
+    }
+
+    // Location of code signature relative to start of slice, as described by LC_CODE_SIGNATURE.
+    bool hasCodeSignature() const { return _codeSignature.size > 0; }
+    Range codeSignatureRange() const { return _codeSignature; }
+
+    // XML entitlements embedded in the code signature (if any). Returns Error::None with length 0 if there are none.
+    Error entitlements(const char *&data, size_t &length) const;
+
+    // DER entitlements embedded in the code signature (if any). Returns Error::None with length 0 if there are none.
+    Error derEntitlements(const uint8_t *&data, size_t &length) const;
+
+private:
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+    size_t _headerSize = 0;
+
+    bool _is64Bit = false;
+    cpu_type_t _cpuType = 0;
+    cpu_subtype_t _cpuSubtype = 0;
+    uint32_t _fileType = 0;
+
+    uint32_t _loadCommandCount = 0;
+    Range _codeSignature;
+
+    Error codeSignatureBlob(uint32_t slotType, uint32_t blobMagic, const uint8_t *&data, size_t &length) const;
+};
+
+// A thin or fat Mach-O file. Thin files are treated as a file with a single slice.
+class File
+{
+public:
+    static Error parse(const uint8_t *data, size_t size, File &file);
+
+    bool isFat() const { return _isFat; }
+    uint32_t sliceCount() const { return _sliceCount; }
+
+    // Parses slice at index. If range is non-null, it's set to the slice's location within the file.
+    Error slice(uint32_t index, Slice &slice, Range *range = nullptr) const;
+
+    // Parses first slice matching cpuType, ignoring capability bits in cpuSubtype.
+    Error slice(cpu_type_t cpuType, cpu_subtype_t cpuSubtype, Slice &slice, Range *range = nullptr) const;
+
+private:
+    const uint8_t *_data = nullptr;
+    size_t _size = 0;
+
+    bool _isFat = false;
+    bool _is64BitFat = false;
+    uint32_t _sliceCount = 0;
+
+    Range sliceRange(uint32_t index, cpu_type_t *cpuType, cpu_subtype_t *cpuSubtype) const;
+};
+
+}
+
+#endif /* MachOFile_hpp */
@@ -0,0 +1,613 @@
+//
+//  RemoteZipArchive.swift
+//  AltStore
+//
+//  Created by Riley Testut on 10/16/26.
+//  Copyright © 2026 Riley Testut. All rights reserved.
+//
+
+import Foundation
+import Compression
+
+public typealias RemoteZipError = RemoteZipErrorCode.Error
+public enum RemoteZipErrorCode: Int, ALTErrorEnum
+{
+    case rangeRequestsUnsupported
+    case invalidArchive
+    case unsupportedCompressionMethod
+    case checksumMismatch
+    
+    public var errorFailureReason: String {
+        switch self
+        {
+        case .rangeRequestsUnsupported: return NSLocalizedString("The server does not support downloading part of a file.", comment: "")
+        case .invalidArchive: return NSLocalizedString("The downloaded archive is invalid.", comment: "")
+        case .unsupportedCompressionMethod: return NSLocalizedString("The downloaded archive uses an unsupported compression method.", comment: "")
+        case .checksumMismatch: return NSLocalizedString("The file extracted from the downloaded archive is corrupted.", comment: "")
+        }
+    }
+}
+
+extension RemoteZipArchive
+{
+    public struct Entry
+    {
+        public var path: String
+        
+        public var compressionMethod: UInt16
+        public var crc32: UInt32
+        
+        public var compressedSize: Int64
+        public var uncompressedSize: Int64
+        
+        public var localHeaderOffset: Int64
+    }
+}
+
+private extension RemoteZipArchive
+{
+    static let endOfCentralDirectorySignature: UInt32 = 0x06054b50
+    static let zip64EndOfCentralDirectoryLocatorSignature: UInt32 = 0x07064b50
+    static let zip64EndOfCentralDirectorySignature: UInt32 = 0x06064b50
+    static let centralDirectoryFileHeaderSignature: UInt32 = 0x02014b50
+    static let localFileHeaderSignature: UInt32 = 0x04034b50
+    
+    static let endOfCentralDirectorySize = 22
+    static let zip64EndOfCentralDirectoryLocatorSize = 20
+    static let zip64EndOfCentralDirectorySize = 56
+    static let centralDirectoryFileHeaderSize = 46
+    static let localFileHeaderSize = 30
+    
+    static let zip64ExtraFieldID: UInt16 = 0x0001
+    
+    static let storedCompressionMethod: UInt16 = 0
+    static let deflateCompressionMethod: UInt16 = 8
+    
+    // Large enough for end record with maximum length comment, plus ZIP64 locator.
+    static let tailSize = endOfCentralDirectorySize + Int(UInt16.max) + zip64EndOfCentralDirectoryLocatorSize
+    
+    // Keeps memory bounded for archives with huge central directories.
+    static let maximumCentralDirectorySize: Int64 = 64 * 1024 * 1024
+    
+    struct CachedCentralDirectory
+    {
+        var size: Int64
+        var entityTag: String?
+        var entries: [String: Entry]
+    }
+    
+    // Central directories of previously opened archives, keyed by URL, so reopening an archive doesn't require any requests.
+    // Every later range request is checked against cached size + ETag, and entries are evicted whenever extraction finds archive invalid,
+    // so a changed (or badly fetched) archive is only ever trusted until the next failure.
+    static var centralDirectoryCache = [URL: CachedCentralDirectory]()
+    static let centralDirectoryCacheLock = NSLock()
+    
+    // Each cached central directory may be up to maximumCentralDirectorySize, so only keep a few.
+    static let maximumCachedCentralDirectoryCount = 4
+}
+
+// Reads individual files from a ZIP archive on a web server using HTTP range requests,
+// downloading just the central directory and requested entries rather than the entire archive.
+public class RemoteZipArchive
+{
+    public let url: URL
+    
+    // Valid after calling open().
+    public private(set) var size: Int64 = 0
+    public private(set) var entries = [String: Entry]()
+    
+    // Used to detect archive changing between requests, if server provides it.
+    private var entityTag: String?
+    
+    private let session: URLSession
+    private let delegate = RangeRequestDelegate()
+    
+    public init(url: URL, configuration: URLSessionConfiguration = .ephemeral)
+    {
+        self.url = url
+        self.session = URLSession(configuration: configuration, delegate: self.delegate, delegateQueue: nil)
+    }
+    
+    deinit
+    {
+        self.session.finishTasksAndInvalidate()
+    }
+    
+    // Reads central directory. Throws RemoteZipError(.rangeRequestsUnsupported) if server would send entire archive instead.
+    public func open() async throws
+    {
+        RemoteZipArchive.centralDirectoryCacheLock.lock()
+        let cachedCentralDirectory = RemoteZipArchive.centralDirectoryCache[self.url]
+        RemoteZipArchive.centralDirectoryCacheLock.unlock()
+        
+        if let cachedCentralDirectory
+        {
+            self.size = cachedCentralDirectory.size
+            self.entityTag = cachedCentralDirectory.entityTag
+            self.entries = cachedCentralDirectory.entries
+            return
+        }
+        
+        let (tail, archiveSize, entityTag) = try await self.fetchTail()
+        self.size = archiveSize
+        self.entityTag = entityTag
+        
+        let tailOffset = archiveSize - Int64(tail.count)
+        
+        guard let endRecordOffset = tail.lastOffset(ofSignature: RemoteZipArchive.endOfCentralDirectorySignature, recordSize: RemoteZipArchive.endOfCentralDirectorySize) else {
+            throw RemoteZipError(.invalidArchive)
+        }
+        
+        var entryCount = Int64(try tail.zipInteger(UInt16.self, at: endRecordOffset + 10))
+        var directorySize = Int64(try tail.zipInteger(UInt32.self, at: endRecordOffset + 12))
+        var directoryOffset = Int64(try tail.zipInteger(UInt32.self, at: endRecordOffset + 16))
+        
+        let locatorOffset = endRecordOffset - RemoteZipArchive.zip64EndOfCentralDirectoryLocatorSize
+        if locatorOffset >= 0, try tail.zipInteger(UInt32.self, at: locatorOffset) == RemoteZipArchive.zip64EndOfCentralDirectoryLocatorSignature
+        {
+            // ZIP64, so real values are in ZIP64 end record instead.
+            let zip64RecordOffset = try tail.zip64Integer(at: locatorOffset + 8)
+            let zip64RecordEndOffset = try zip64RecordOffset.zipAdding(Int64(RemoteZipArchive.zip64EndOfCentralDirectorySize))
+            guard zip64RecordEndOffset <= archiveSize else { throw RemoteZipError(.invalidArchive) }
+            
+            let zip64Record: Data
+            if zip64RecordOffset >= tailOffset
+            {
+                zip64Record = tail.subdata(in: Int(zip64RecordOffset - tailOffset) ..< tail.count)
+            }
+            else
+            {
+                zip64Record = try await self.fetchData(in: zip64RecordOffset ..< zip64RecordEndOffset)
+            }
+            
+            guard try zip64Record.zipInteger(UInt32.self, at: 0) == RemoteZipArchive.zip64EndOfCentralDirectorySignature else { throw RemoteZipError(.invalidArchive) }
+            
+            entryCount = try zip64Record.zip64Integer(at: 32)
+            directorySize = try zip64Record.zip64Integer(at: 40)
+            directoryOffset = try zip64Record.zip64Integer(at: 48)
+        }
+        
+        guard directorySize <= RemoteZipArchive.maximumCentralDirectorySize, try directoryOffset.zipAdding(directorySize) <= archiveSize else { throw RemoteZipError(.invalidArchive) }
+        
+        let centralDirectory: Data
+        if directoryOffset >= tailOffset
+        {
+            let startIndex = Int(directoryOffset - tailOffset)
+            centralDirectory = tail.subdata(in: startIndex ..< startIndex + Int(directorySize))
+        }
+        else
+        {
+            centralDirectory = try await self.fetchData(in: directoryOffset ..< directoryOffset + directorySize)
+        }
+        
+        self.entries = try self.parseCentralDirectory(centralDirectory, entryCount: entryCount)
+        
+        RemoteZipArchive.centralDirectoryCacheLock.lock()
+        if RemoteZipArchive.centralDirectoryCache[self.url] == nil, RemoteZipArchive.centralDirectoryCache.count >= RemoteZipArchive.maximumCachedCentralDirectoryCount, let url = RemoteZipArchive.centralDirectoryCache.keys.first
+        {
+            RemoteZipArchive.centralDirectoryCache[url] = nil
+        }
+        RemoteZipArchive.centralDirectoryCache[self.url] = CachedCentralDirectory(size: self.size, entityTag: self.entityTag, entries: self.entries)
+        RemoteZipArchive.centralDirectoryCacheLock.unlock()
+    }
+    
+    // Streams entry to fileURL, decompressing and verifying it as it downloads. progressHandler is called with the number of compressed bytes received so far.
+    public func extract(_ entry: Entry, to fileURL: URL, progressHandler: ((Int64) -> Void)? = nil) async throws
+    {
+        guard FileManager.default.createFile(atPath: fileURL.path, contents: nil, attributes: nil) else { throw CocoaError(.fileWriteUnknown, userInfo: [NSURLErrorKey: fileURL]) }
+        
+        let fileHandle = try FileHandle(forWritingTo: fileURL)
+        defer { try? fileHandle.close() }
+        
+        try await self.extract(entry, to: fileHandle, progressHandler: progressHandler)
+    }
+    
+    // Same as above, but writes to fileHandle instead, which may be a pipe to stream entry directly into another consumer.
+    // The caller is responsible for closing fileHandle.
+    public func extract(_ entry: Entry, to fileHandle: FileHandle, progressHandler: ((Int64) -> Void)? = nil) async throws
+    {
+        do
+        {
+            try await self.extractEntry(entry, to: fileHandle, progressHandler: progressHandler)
+        }
+        catch
+        {
+            switch error
+            {
+            case ~RemoteZipErrorCode.invalidArchive, ~RemoteZipErrorCode.checksumMismatch:
+                // Archive may have changed since we cached its central directory (or we cached a bad one), so fetch it again next time.
+                RemoteZipArchive.centralDirectoryCacheLock.lock()
+                RemoteZipArchive.centralDirectoryCache[self.url] = nil
+                RemoteZipArchive.centralDirectoryCacheLock.unlock()
+                
+            default: break
+            }
+            
+            throw error
+        }
+    }
+    
+    private func extractEntry(_ entry: Entry, to fileHandle: FileHandle, progressHandler: ((Int64) -> Void)?) async throws
+    {
+        guard entry.compressionMethod == RemoteZipArchive.storedCompressionMethod || entry.compressionMethod == RemoteZipArchive.deflateCompressionMethod else {
+            throw RemoteZipError(.unsupportedCompressionMethod)
+        }
+        
+        // Local header's extra field may differ from central directory's, so read it to find where data starts.
+        let localHeaderEndOffset = try entry.localHeaderOffset.zipAdding(Int64(RemoteZipArchive.localFileHeaderSize))
+        let localHeader = try await self.fetchData(in: entry.localHeaderOffset ..< localHeaderEndOffset)
+        guard try localHeader.zipInteger(UInt32.self, at: 0) == RemoteZipArchive.localFileHeaderSignature else { throw RemoteZipError(.invalidArchive) }
+        
+        let nameLength = Int64(try localHeader.zipInteger(UInt16.self, at: 26))
+        let extraFieldLength = Int64(try localHeader.zipInteger(UInt16.self, at: 28))
+        let dataOffset = try localHeaderEndOffset.zipAdding(nameLength + extraFieldLength)
+        let dataEndOffset = try dataOffset.zipAdding(entry.compressedSize)
+        
+        var checksum = CRC32()
+        
+        func write(_ data: Data) throws
+        {
+            checksum.update(with: data)
+            try fileHandle.write(contentsOf: data)
+        }
+        
+        if entry.compressedSize > 0
+        {
+            var filter: OutputFilter?
+            if entry.compressionMethod == RemoteZipArchive.deflateCompressionMethod
+            {
+                // Compression's .zlib is raw DEFLATE, which is exactly what ZIP uses.
+                filter = try OutputFilter(.decompress, using: .zlib, writingTo: { data in
+                    guard let data else { return }
+                    try write(data)
+                })
+            }
+            
+            var receivedByteCount: Int64 = 0
+            
+            try await self.streamData(in: dataOffset ..< dataEndOffset) { chunk in
+                if let filter
+                {
+                    try filter.write(chunk)
+                }
+                else
+                {
+                    try write(chunk)
+                }
+                
+                receivedByteCount += Int64(chunk.count)
+                progressHandler?(receivedByteCount)
+            }
+            
+            try filter?.finalize()
+        }
+        
+        guard checksum.value == entry.crc32 else { throw RemoteZipError(.checksumMismatch) }
+    }
+}
+
+private extension RemoteZipArchive
+{
+    func fetchTail() async throws -> (Data, Int64, String?)
+    {
+        var tail = Data()
+        var archiveSize: Int64?
+        var entityTag: String?
+        
+        try await self.stream(rangeHeader: "bytes=-\(RemoteZipArchive.tailSize)", responseHandler: { response in
+            archiveSize = response.totalContentLength
+            entityTag = response.value(forHTTPHeaderField: "ETag")
+        }) { chunk in
+            tail.append(chunk)
+        }
+        
+        guard let archiveSize else { throw RemoteZipError(.rangeRequestsUnsupported) }
+        return (tail, archiveSize, entityTag)
+    }
+    
+    func fetchData(in range: Range<Int64>) async throws -> Data
+    {
+        var data = Data(capacity: Int(range.count))
+        try await self.streamData(in: range) { chunk in
+            data.append(chunk)
+        }
+        
+        guard data.count == range.count else { throw RemoteZipError(.invalidArchive) }
+        return data
+    }
+    
+    func streamData(in range: Range<Int64>, chunkHandler: @escaping (Data) throws -> Void) async throws
+    {
+        guard !range.isEmpty else { return }
+        try await self.stream(rangeHeader: "bytes=\(range.lowerBound)-\(range.upperBound - 1)", responseHandler: { response in
+            // Offsets are only meaningful for the archive we read central directory from.
+            guard response.totalContentLength == self.size else { throw RemoteZipError(.invalidArchive) }
+            
+            if let entityTag = self.entityTag, let responseEntityTag = response.value(forHTTPHeaderField: "ETag"), responseEntityTag != entityTag
+            {
+                throw RemoteZipError(.invalidArchive)
+            }
+        }, chunkHandler: chunkHandler)
+    }
+    
+    func stream(rangeHeader: String, responseHandler: @escaping (HTTPURLResponse) throws -> Void, chunkHandler: @escaping (Data) throws -> Void) async throws
+    {
+        var request = URLRequest(url: self.url)
+        request.setValue(rangeHeader, forHTTPHeaderField: "Range")
+        
+        // Byte offsets would be meaningless if server compressed response.
+        request.setValue("identity", forHTTPHeaderField: "Accept-Encoding")
+        
+        let task = self.session.dataTask(with: request)
+        
+        // Cancelling the calling Task cancels the request, which then completes with URLError(.cancelled).
+        try await withTaskCancellationHandler {
+            try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<Void, Error>) in
+                self.delegate.register(task, responseHandler: responseHandler, chunkHandler: chunkHandler) { result in
+                    continuation.resume(with: result)
+                }
+                task.resume()
+            }
+        } onCancel: {
+            task.cancel()
+        }
+    }
+    
+    func parseCentralDirectory(_ data: Data, entryCount: Int64) throws -> [String: Entry]
+    {
+        var entries = [String: Entry]()
+        var offset = 0
+        
+        for _ in 0 ..< entryCount
+        {
+            guard try data.zipInteger(UInt32.self, at: offset) == RemoteZipArchive.centralDirectoryFileHeaderSignature else { throw RemoteZipError(.invalidArchive) }
+            
+            let compressionMethod = try data.zipInteger(UInt16.self, at: offset + 10)
+            let crc32 = try data.zipInteger(UInt32.self, at: offset + 16)
+            var compressedSize = Int64(try data.zipInteger(UInt32.self, at: offset + 20))
+            var uncompressedSize = Int64(try data.zipInteger(UInt32.self, at: offset + 24))
+            let nameLength = Int(try data.zipInteger(UInt16.self, at: offset + 28))
+            let extraFieldLength = Int(try data.zipInteger(UInt16.self, at: offset + 30))
+            let commentLength = Int(try data.zipInteger(UInt16.self, at: offset + 32))
+            var localHeaderOffset = Int64(try data.zipInteger(UInt32.self, at: offset + 42))
+            
+            let nameOffset = offset + RemoteZipArchive.centralDirectoryFileHeaderSize
+            let extraFieldOffset = nameOffset + nameLength
+            guard extraFieldOffset + extraFieldLength + commentLength <= data.count else { throw RemoteZipError(.invalidArchive) }
+            
+            // ZIP64 extra field only contains values whose regular fields are maxed out, in this order.
+            var fieldOffset = extraFieldOffset
+            while fieldOffset + 4 <= extraFieldOffset + extraFieldLength
+            {
+                let fieldID = try data.zipInteger(UInt16.self, at: fieldOffset)
+                let fieldLength = Int(try data.zipInteger(UInt16.self, at: fieldOffset + 2))
+                
+                if fieldID == RemoteZipArchive.zip64ExtraFieldID
+                {
+                    var valueOffset = fieldOffset + 4
+                    
+                    if uncompressedSize == 0xFFFFFFFF
+                    {
+                        uncompressedSize = try data.zip64Integer(at: valueOffset)
+                        valueOffset += 8
+                    }
+                    
+                    if compressedSize == 0xFFFFFFFF
+                    {
+                        compressedSize = try data.zip64Integer(at: valueOffset)
+                        valueOffset += 8
+                    }
+                    
+                    if localHeaderOffset == 0xFFFFFFFF
+                    {
+                        localHeaderOffset = try data.zip64Integer(at: valueOffset)
+                    }
+                    
+                    break
+                }
+                
+                fieldOffset += 4 + fieldLength
+            }
+            
+            if let path = String(data: data[nameOffset ..< extraFieldOffset], encoding: .utf8)
+            {
+                entries[path] = Entry(path: path, compressionMethod: compressionMethod, crc32: crc32, compressedSize: compressedSize, uncompressedSize: uncompressedSize, localHeaderOffset: localHeaderOffset)
+            }
+            
+            offset = extraFieldOffset + extraFieldLength + commentLength
+        }
+        
+        return entries
+    }
+}
+
+private class RangeRequestDelegate: NSObject, URLSessionDataDelegate
+{
+    private struct Handlers
+    {
+        var responseHandler: (HTTPURLResponse) throws -> Void
+        var chunkHandler: (Data) throws -> Void
+        var completionHandler: (Result<Void, Error>) -> Void
+        
+        var error: Error?
+    }
+    
+    // Keyed by task identifier.
+    private var handlers = [Int: Handlers]()
+    private let lock = NSLock()
+    
+    func register(_ task: URLSessionTask, responseHandler: @escaping (HTTPURLResponse) throws -> Void, chunkHandler: @escaping (Data) throws -> Void, completionHandler: @escaping (Result<Void, Error>) -> Void)
+    {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        
+        self.handlers[task.taskIdentifier] = Handlers(responseHandler: responseHandler, chunkHandler: chunkHandler, completionHandler: completionHandler)
+    }
+    
+    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive response: URLResponse, completionHandler: @escaping (URLSession.ResponseDisposition) -> Void)
+    {
+        guard let handlers = self.handlers(for: dataTask) else { return completionHandler(.cancel) }
+        
+        guard let response = response as? HTTPURLResponse, response.statusCode == 206 else {
+            // Server is sending entire file (or an error), so cancel instead of downloading it.
+            let statusCode = (response as? HTTPURLResponse)?.statusCode ?? 0
+            self.setError((200 ..< 300).contains(statusCode) ? RemoteZipError(.rangeRequestsUnsupported) : URLError(.badServerResponse), for: dataTask)
+            return completionHandler(.cancel)
+        }
+        
+        do
+        {
+            try handlers.responseHandler(response)
+        }
+        catch
+        {
+            self.setError(error, for: dataTask)
+            return completionHandler(.cancel)
+        }
+        
+        completionHandler(.allow)
+    }
+    
+    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive data: Data)
+    {
+        guard let handlers = self.handlers(for: dataTask), handlers.error == nil else { return }
+        
+        do
+        {
+            try handlers.chunkHandler(data)
+        }
+        catch
+        {
+            self.setError(error, for: dataTask)
+            dataTask.cancel()
+        }
+    }
+    
+    func urlSession(_ session: URLSession, task: URLSessionTask, didCompleteWithError error: Error?)
+    {
+        self.lock.lock()
+        let handlers = self.handlers.removeValue(forKey: task.taskIdentifier)
+        self.lock.unlock()
+        
+        guard let handlers else { return }
+        
+        if let error = handlers.error ?? error
+        {
+            handlers.completionHandler(.failure(error))
+        }
+        else
+        {
+            handlers.completionHandler(.success(()))
+        }
+    }
+    
+    private func handlers(for task: URLSessionTask) -> Handlers?
+    {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        
+        return self.handlers[task.taskIdentifier]
+    }
+    
+    private func setError(_ error: Error, for task: URLSessionTask)
+    {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        
+        self.handlers[task.taskIdentifier]?.error = error
+    }
+}
+
+private struct CRC32
+{
+    private static let table: [UInt32] = (0 ..< 256).map { index in
+        var value = UInt32(index)
+        for _ in 0 ..< 8
+        {
+            value = (value & 1 == 1) ? (0xEDB88320 ^ (value >> 1)) : (value >> 1)
+        }
+        
+        return value
+    }
+    
+    private var crc: UInt32 = 0xFFFFFFFF
+    
+    var value: UInt32 {
+        self.crc ^ 0xFFFFFFFF
+    }
+    
+    mutating func update(with data: Data)
+    {
+        var crc = self.crc
+        data.withUnsafeBytes { buffer in
+            for byte in buffer
+            {
+                crc = CRC32.table[Int((crc ^ UInt32(byte)) & 0xFF)] ^ (crc >> 8)
+            }
+        }
+        self.crc = crc
+    }
+}
+
+private extension HTTPURLResponse
+{
+    // Total size from "Content-Range: bytes start-end/total".
+    var totalContentLength: Int64? {
+        guard let contentRange = self.value(forHTTPHeaderField: "Content-Range"), let totalLength = contentRange.split(separator: "/").last else { return nil }
+        return Int64(totalLength)
+    }
+}
+
+private extension Data
+{
+    func zipInteger<T: FixedWidthInteger>(_ type: T.Type, at offset: Int) throws -> T
+    {
+        guard offset >= 0, offset + MemoryLayout<T>.size <= self.count else { throw RemoteZipError(.invalidArchive) }
+        
+        // ZIP integers are little-endian and unaligned.
+        var value: T = 0
+        for index in 0 ..< MemoryLayout<T>.size
+        {
+            value |= T(self[self.startIndex + offset + index]) << (index * 8)
+        }
+        
+        return value
+    }
+    
+    // ZIP64 values are unsigned, but anything that doesn't fit in Int64 can't be a valid size or offset.
+    func zip64Integer(at offset: Int) throws -> Int64
+    {
+        let value = try self.zipInteger(UInt64.self, at: offset)
+        guard let integer = Int64(exactly: value) else { throw RemoteZipError(.invalidArchive) }
+        
+        return integer
+    }
+    
+    func lastOffset(ofSignature signature: UInt32, recordSize: Int) -> Int?
+    {
+        let lastPossibleOffset = self.count - recordSize
+        guard lastPossibleOffset >= 0 else { return nil }
+        
+        for offset in stride(from: lastPossibleOffset, through: 0, by: -1)
+        {
+            if (try? self.zipInteger(UInt32.self, at: offset)) == signature
+            {
+                return offset
+            }
+        }
+        
+        return nil
+    }
+}
+
+private extension Int64
+{
+    // Offsets come from untrusted archive data, so throw rather than trap on overflow.
+    func zipAdding(_ other: Int64) throws -> Int64
+    {
+        let (result, didOverflow) = self.addingReportingOverflow(other)
+        guard !didOverflow else { throw RemoteZipError(.invalidArchive) }
+        
+        return result
+    }
+}